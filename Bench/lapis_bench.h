@@ -0,0 +1,100 @@
+#ifndef __LAPIS_BENCH_INTERNAL_HEADER_H__
+#define __LAPIS_BENCH_INTERNAL_HEADER_H__ (1)
+#include <stdio.h>
+
+#include "lapis/lapis.h"
+
+/*************************************************************************************************************
+ * Lapis Bench
+ * Measures how fast lapis allocates, clears, rasterizes and runs whole frames, and writes the results out as
+ * JSON which a later run can be compared against to catch regressions.
+ *
+ * Every benchmark runs its work once to warm up, then times it a number of times and keeps the median so a
+ * single slow run can't move the result. Scenes are built from a fixed seed, so every run draws exactly the
+ * same thing. Rasterizing uses one worker unless asked for more, so results don't depend on how busy the
+ * rest of the machine is.
+ *
+ * Golden scenes check rendering is still correct in the same run. Each renders into a headless window whose
+ * frames are captured, and the last frame has to match a stored image to within a small tolerance.
+ *************************************************************************************************************/
+
+// Most results one run can produce
+#define BENCH_MAX_RESULTS (64)
+
+// Longest name of a result, names are made of the benchmark and its parameters like clear/1024x1024
+#define BENCH_MAX_NAME (64)
+
+typedef struct BenchResult {
+    char name[BENCH_MAX_NAME];
+    const char* unit;
+    double value;
+    double spread;  // Difference between the slowest and fastest timings as a fraction of the median
+    int higher_is_better;
+} BenchResult;
+
+typedef struct BenchRun {
+    const char* filter;  // Only benchmarks whose names contain this run, null for all of them
+    uint32_t repeats;    // Timings taken of each benchmark
+    uint32_t workers;    // Threads the context rasterizes with
+    LapisContext context;
+    BenchResult results[BENCH_MAX_RESULTS];
+    uint32_t result_count;
+} BenchRun;
+
+// Work being timed, run iterations times in a row
+typedef void (*BenchFunc)(void* user, uint32_t iterations);
+
+// Current time on a monotonic clock in nanoseconds
+uint64_t bench_now();
+
+// Checks whether a benchmark is wanted by the filter
+int bench_wanted(const BenchRun* run, const char* name);
+
+/**
+ * @brief Warms up then times the work repeatedly
+ * @returns The median nanoseconds per iteration
+ * @param run The run, which decides how many timings are taken
+ * @param func The work to time
+ * @param user Passed to func
+ * @param iterations Iterations in each timing, enough for a timing to take a few milliseconds
+ * @param spread Filled in with the spread of the timings
+ */
+double bench_measure(const BenchRun* run, BenchFunc func, void* user, uint32_t iterations, double* spread);
+
+// Adds a result to the run and prints it as it goes
+void bench_add(BenchRun* run, const char* name, const char* unit, double value, double spread,
+               int higher_is_better);
+
+// Small linear congruential generator returning 0 to 1, so scenes come out the same on every platform
+float bench_random(uint32_t* state);
+
+// Each suite adds its results to the run
+void bench_alloc(BenchRun* run);
+void bench_clear(BenchRun* run);
+void bench_raster(BenchRun* run);
+void bench_frame(BenchRun* run);
+
+/**
+ * @brief Renders the scripted scenes through a captured headless window, adding each scene's frame time to
+ * the run and comparing its last frame against the golden image in dir
+ * @returns The number of scenes which didn't match their golden image, or couldn't be rendered
+ * @param run The run
+ * @param dir Directory of golden images, named after the scenes
+ * @param update Non zero writes the golden images instead of comparing against them
+ */
+int bench_golden(BenchRun* run, const char* dir, int update);
+
+// Writes the run's results out as JSON
+void bench_write_json(const BenchRun* run, FILE* file);
+
+/**
+ * @brief Compares the run against a baseline written by an earlier run, printing every result which got
+ * worse by more than the threshold
+ * @returns The number of regressions, or -1 if the baseline couldn't be read
+ * @param run The run
+ * @param path The baseline JSON
+ * @param threshold Fraction a result can get worse by before it counts as a regression
+ */
+int bench_compare(const BenchRun* run, const char* path, double threshold);
+
+#endif  // !__LAPIS_BENCH_INTERNAL_HEADER_H__
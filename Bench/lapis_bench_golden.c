@@ -0,0 +1,340 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lapis_bench.h"
+
+// Size of the window every scene renders into
+#define BENCH_GOLDEN_WIDTH (160)
+#define BENCH_GOLDEN_HEIGHT (120)
+
+// Frames in each timing, the frame compared against the golden image is always the same one after them
+#define BENCH_GOLDEN_FRAMES (30)
+#define BENCH_GOLDEN_LAST_FRAME (37)
+
+// How far a channel can be from the golden image, and how many pixels can be further than that, before the
+// scene fails. Rasterizers on different compilers and instruction sets round edges slightly differently
+#define BENCH_GOLDEN_TOLERANCE (8)
+#define BENCH_GOLDEN_MISMATCHES (BENCH_GOLDEN_WIDTH * BENCH_GOLDEN_HEIGHT / 1000)
+
+// Particles in the particles scene
+#define BENCH_GOLDEN_PARTICLES (2000)
+
+#define BENCH_GOLDEN_BYTES (BENCH_GOLDEN_WIDTH * BENCH_GOLDEN_HEIGHT * 3)
+
+// Where the view of the scenes which have one sits in the window
+#define BENCH_GOLDEN_VIEW_X (16)
+#define BENCH_GOLDEN_VIEW_Y (16)
+#define BENCH_GOLDEN_VIEW_SIZE (32)
+
+// Draws one frame of a scene, view is null unless the scene asks for one
+typedef void (*BenchSceneFunc)(LapisTarget* target, LapisTarget* view, uint32_t frame);
+
+typedef struct BenchScene {
+    const char* name;
+    BenchSceneFunc draw;
+    uint32_t depth;  // Non zero renders with a depth buffer
+    uint32_t view;   // Non zero also makes a view into the target, and runs every call as it's made
+} BenchScene;
+
+// What the frame loop needs, frame counts up through every timing
+typedef struct BenchGolden {
+    const BenchScene* scene;
+    LapisWindow* window;
+    LapisTarget* target;
+    LapisTarget* view;
+    uint32_t frame;
+} BenchGolden;
+
+/**
+ * Scenes
+ */
+
+// The hello triangle example
+static void bench_scene_triangle(LapisTarget* target, LapisTarget* view, uint32_t frame)
+{
+    float pos[9] = {0.0f, 0.4f, 0.0f, 0.4f, -0.4f, 0.0f, -0.4f, -0.4f, 0.0f};
+    float col[9] = {0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f};
+    float clear[3] = {0.0f, 0.0f, 0.0f};
+    lapis_gfx_target_clear(target, clear);
+    lapis_gfx_immediate_pos_color(target, pos, col, 1);
+}
+
+// A triangle turning a little every frame, so every angle of edge gets rasterized
+static void bench_scene_spin(LapisTarget* target, LapisTarget* view, uint32_t frame)
+{
+    float col[9] = {1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 0.0f, 1.0f};
+    float clear[3] = {0.1f, 0.1f, 0.2f};
+    float pos[9];
+    float angle;
+    uint32_t i;
+    for (i = 0; i < 3; i++) {
+        angle = (float)frame * 0.05f + (float)i * 2.0943951f;
+        pos[i * 3 + 0] = 0.45f * sinf(angle);
+        pos[i * 3 + 1] = 0.45f * cosf(angle);
+        pos[i * 3 + 2] = 0.0f;
+    }
+    lapis_gfx_target_clear(target, clear);
+    lapis_gfx_immediate_pos_color(target, pos, col, 1);
+}
+
+// Lots of tiny triangles drifting across the window, submitted as streams
+static void bench_scene_particles(LapisTarget* target, LapisTarget* view, uint32_t frame)
+{
+    static float streams[6][BENCH_GOLDEN_PARTICLES * 3];
+    float clear[3] = {0.0f, 0.0f, 0.0f};
+    LapisVertexStreams vertices;
+    uint32_t state = 0x50415254u;
+    float x, y, drift = (float)frame * 0.004f;
+    uint32_t i, v;
+
+    for (i = 0; i < BENCH_GOLDEN_PARTICLES; i++) {
+        x = fmodf(bench_random(&state) + drift, 1.0f) - 0.5f;
+        y = bench_random(&state) - 0.5f;
+        for (v = 0; v < 3; v++) {
+            streams[0][i * 3 + v] = x + (v == 1 ? 0.01f : 0.0f);
+            streams[1][i * 3 + v] = y + (v == 2 ? 0.01f : 0.0f);
+            streams[2][i * 3 + v] = 0.0f;
+            streams[3][i * 3 + v] = bench_random(&state);
+            streams[4][i * 3 + v] = bench_random(&state);
+            streams[5][i * 3 + v] = bench_random(&state);
+        }
+    }
+    vertices.x = streams[0];
+    vertices.y = streams[1];
+    vertices.z = streams[2];
+    vertices.r = streams[3];
+    vertices.g = streams[4];
+    vertices.b = streams[5];
+    lapis_gfx_target_clear(target, clear);
+    lapis_gfx_immediate_streams(target, &vertices, BENCH_GOLDEN_PARTICLES);
+}
+
+// Two triangles passing through each other, so which is in front changes across them
+static void bench_scene_depth(LapisTarget* target, LapisTarget* view, uint32_t frame)
+{
+    float tilt = 0.3f * sinf((float)frame * 0.1f);
+    float pos[18] = {-0.45f, -0.4f, -0.4f, 0.45f, -0.4f, 0.4f, 0.0f, 0.45f, 0.0f,
+                     -0.45f, 0.4f, tilt, 0.45f, 0.4f, -tilt, 0.0f, -0.45f, 0.0f};
+    float col[18] = {1.0f, 0.2f, 0.2f, 1.0f, 0.2f, 0.2f, 1.0f, 0.6f, 0.2f,
+                     0.2f, 0.4f, 1.0f, 0.2f, 0.4f, 1.0f, 0.2f, 1.0f, 0.6f};
+    float clear[3] = {0.05f, 0.05f, 0.05f};
+    lapis_gfx_target_clear(target, clear);
+    lapis_gfx_immediate_pos_color(target, pos, col, 2);
+}
+
+// The view is cleared after its parent, then the parent is drawn over everything and the view over that. A
+// view's clear must not land on top of what the parent drew after it
+static void bench_scene_views(LapisTarget* target, LapisTarget* view, uint32_t frame)
+{
+    float pos[18] = {-0.5f, -0.5f, 0.0f, -0.5f, 0.5f, 0.0f, 0.5f, 0.5f, 0.0f,
+                     -0.5f, -0.5f, 0.0f, 0.5f, 0.5f, 0.0f, 0.5f, -0.5f, 0.0f};
+    float green[18] = {0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+                       0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f};
+    float tri[9] = {0.0f, 0.3f, 0.0f, 0.3f, -0.3f, 0.0f, -0.3f, -0.3f, 0.0f};
+    float blue[9] = {0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f};
+    float black[3] = {0.0f, 0.0f, 0.0f};
+    float red[3] = {1.0f, 0.0f, 0.0f};
+    lapis_gfx_target_clear(target, black);
+    lapis_gfx_target_clear(view, red);
+    lapis_gfx_immediate_pos_color(target, pos, green, 2);
+    lapis_gfx_immediate_pos_color(view, tri, blue, 1);
+}
+
+static const BenchScene bench_scenes[] = {
+    {"triangle", bench_scene_triangle, 0, 0},
+    {"spin", bench_scene_spin, 0, 0},
+    {"particles", bench_scene_particles, 0, 0},
+    {"depth", bench_scene_depth, 1, 0},
+    {"views", bench_scene_views, 0, 1},
+};
+
+/**
+ * Rendering and comparing
+ */
+
+static void bench_golden_frame(BenchGolden* golden)
+{
+    lapis_window_poll_events(golden->window);
+    golden->scene->draw(golden->target, golden->view, golden->frame++);
+    lapis_gfx_target_schedule(golden->target);
+    if (golden->view) lapis_gfx_target_schedule(golden->view);
+    lapis_window_swap(golden->window);
+}
+
+static void bench_golden_loop(void* user, uint32_t iterations)
+{
+    uint32_t i;
+    for (i = 0; i < iterations; i++) bench_golden_frame((BenchGolden*)user);
+}
+
+// Reads the last frame of a stream of PPM images, every one of them the same size
+static int bench_read_last_frame(FILE* file, uint8_t* pixels)
+{
+    if (fseek(file, -(long)BENCH_GOLDEN_BYTES, SEEK_END) != 0) return 0;
+    return fread(pixels, 1, BENCH_GOLDEN_BYTES, file) == BENCH_GOLDEN_BYTES;
+}
+
+static int bench_read_ppm(const char* path, uint8_t* pixels)
+{
+    unsigned width, height, max;
+    FILE* file = fopen(path, "rb");
+    int ok;
+    if (!file) return 0;
+    ok = fscanf(file, "P6 %u %u %u", &width, &height, &max) == 3 && fgetc(file) != EOF;
+    ok = ok && width == BENCH_GOLDEN_WIDTH && height == BENCH_GOLDEN_HEIGHT && max == 255;
+    ok = ok && fread(pixels, 1, BENCH_GOLDEN_BYTES, file) == BENCH_GOLDEN_BYTES;
+    fclose(file);
+    return ok;
+}
+
+static int bench_write_ppm(const char* path, const uint8_t* pixels)
+{
+    FILE* file = fopen(path, "wb");
+    int ok;
+    if (!file) return 0;
+    fprintf(file, "P6\n%u %u\n255\n", BENCH_GOLDEN_WIDTH, BENCH_GOLDEN_HEIGHT);
+    ok = fwrite(pixels, 1, BENCH_GOLDEN_BYTES, file) == BENCH_GOLDEN_BYTES;
+    return fclose(file) == 0 && ok;
+}
+
+// Counts the pixels with a channel further than the tolerance from the golden image
+static uint32_t bench_mismatches(const uint8_t* pixels, const uint8_t* expected, int* worst)
+{
+    uint32_t i, c, count = 0;
+    int difference, over;
+    *worst = 0;
+    for (i = 0; i < BENCH_GOLDEN_WIDTH * BENCH_GOLDEN_HEIGHT; i++) {
+        over = 0;
+        for (c = 0; c < 3; c++) {
+            difference = abs((int)pixels[i * 3 + c] - (int)expected[i * 3 + c]);
+            if (difference > *worst) *worst = difference;
+            if (difference > BENCH_GOLDEN_TOLERANCE) over = 1;
+        }
+        count += over;
+    }
+    return count;
+}
+
+// Renders a scene with every frame captured, then fills pixels with the last of them
+static int bench_golden_render(BenchRun* run, const BenchScene* scene, uint8_t* pixels)
+{
+    LapisWindowHelper window_helper;
+    LapisTargetHelper target_helper;
+    LapisTargetHelper view_helper;
+    LapisCaptureHelper capture_helper;
+    LapisCaptureStats stats;
+    char name[BENCH_MAX_NAME];
+    LapisWindow window;
+    LapisTarget target;
+    LapisTarget view;
+    BenchGolden golden;
+    double ns, spread;
+    FILE* capture;
+    int ok = 0;
+
+    // Two frames in flight so the capture is fed from the present thread like it would be in an application
+    memset(&window_helper, 0, sizeof(window_helper));
+    window_helper.width = BENCH_GOLDEN_WIDTH;
+    window_helper.height = BENCH_GOLDEN_HEIGHT;
+    window_helper.frames_in_flight = 2;
+    capture = tmpfile();
+    if (!capture) return 0;
+    if (lapis_allocate_dynamic(&window, &window_helper, e_lapis_type_window) != e_lapis_return_success) {
+        fclose(capture);
+        return 0;
+    }
+    if (lapis_create_window(&run->context, &window, &window_helper) != e_lapis_return_success) {
+        lapis_free(&window);
+        fclose(capture);
+        return 0;
+    }
+    target.cpu_mem = NULL;
+    view.cpu_mem = NULL;
+    lapis_window_fill_target_helper(&window, &target_helper);
+    target_helper.depth = scene->depth;
+    if (scene->view) target_helper.command_bytes = 0;
+    ok = lapis_allocate_dynamic(&target, &target_helper, e_lapis_type_target) == e_lapis_return_success &&
+         lapis_create_gfx_target(&target, &target_helper) == e_lapis_return_success;
+    if (ok && scene->view) {
+        lapis_target_fill_view_helper(&target, &target_helper, &view_helper, BENCH_GOLDEN_VIEW_X,
+                                      BENCH_GOLDEN_VIEW_Y, BENCH_GOLDEN_VIEW_SIZE, BENCH_GOLDEN_VIEW_SIZE);
+        ok = lapis_allocate_dynamic(&view, &view_helper, e_lapis_type_target) == e_lapis_return_success &&
+             lapis_create_gfx_target(&view, &view_helper) == e_lapis_return_success;
+    }
+    if (ok) {
+        memset(&capture_helper, 0, sizeof(capture_helper));
+        capture_helper.fd = fileno(capture);
+        capture_helper.format = e_lapis_capture_ppm;
+        capture_helper.lossless = 1;
+        ok = lapis_window_start_capture(&window, &capture_helper) == e_lapis_return_success;
+    }
+
+    if (ok) {
+        golden.scene = scene;
+        golden.window = &window;
+        golden.target = &target;
+        golden.view = scene->view ? &view : NULL;
+        golden.frame = 0;
+        ns = bench_measure(run, bench_golden_loop, &golden, BENCH_GOLDEN_FRAMES, &spread);
+        golden.frame = BENCH_GOLDEN_LAST_FRAME;
+        bench_golden_frame(&golden);
+        lapis_window_stop_capture(&window, &stats);
+        ok = !stats.failed && !stats.dropped && bench_read_last_frame(capture, pixels);
+
+        snprintf(name, sizeof(name), "golden/%s", scene->name);
+        bench_add(run, name, "ms/frame", ns / 1e6, spread, 0);
+    }
+
+    lapis_destroy_window(&window);
+    lapis_free(&view);
+    lapis_free(&target);
+    lapis_free(&window);
+    fclose(capture);
+    return ok;
+}
+
+int bench_golden(BenchRun* run, const char* dir, int update)
+{
+    static uint8_t pixels[BENCH_GOLDEN_BYTES];
+    static uint8_t expected[BENCH_GOLDEN_BYTES];
+    char name[BENCH_MAX_NAME];
+    char path[1024];
+    uint32_t i, count;
+    int failures = 0, worst;
+
+    for (i = 0; i < sizeof(bench_scenes) / sizeof(bench_scenes[0]); i++) {
+        snprintf(name, sizeof(name), "golden/%s", bench_scenes[i].name);
+        if (!bench_wanted(run, name)) continue;
+        if (!bench_golden_render(run, &bench_scenes[i], pixels)) {
+            fprintf(stderr, "%-32s couldn't be rendered and captured\n", name);
+            failures++;
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "%s/%s.ppm", dir, bench_scenes[i].name);
+        if (update) {
+            if (!bench_write_ppm(path, pixels)) {
+                fprintf(stderr, "%-32s couldn't write %s\n", name, path);
+                failures++;
+            }
+            continue;
+        }
+        if (!bench_read_ppm(path, expected)) {
+            fprintf(stderr, "%-32s couldn't read %s\n", name, path);
+            failures++;
+            continue;
+        }
+
+        // Whatever did render is kept next to the golden image so the two can be looked at side by side
+        count = bench_mismatches(pixels, expected, &worst);
+        if (count > BENCH_GOLDEN_MISMATCHES) {
+            snprintf(path, sizeof(path), "%s/%s.actual.ppm", dir, bench_scenes[i].name);
+            bench_write_ppm(path, pixels);
+            fprintf(stderr, "%-32s MISMATCHED %u pixels, up to %d away, wrote %s\n", name, count, worst,
+                    path);
+            failures++;
+        }
+    }
+    return failures;
+}
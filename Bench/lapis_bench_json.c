@@ -0,0 +1,86 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "lapis_bench.h"
+
+// Largest baseline that will be read
+#define BENCH_MAX_BASELINE (1 << 20)
+
+void bench_write_json(const BenchRun* run, FILE* file)
+{
+    const BenchResult* result;
+    uint32_t i;
+
+    // One result per line, so baselines checked in alongside the code diff nicely
+    fprintf(file, "{\"version\":1,\"repeats\":%u,\"workers\":%u,\"benchmarks\":[\n", run->repeats,
+            run->workers);
+    for (i = 0; i < run->result_count; i++) {
+        result = &run->results[i];
+        fprintf(file, "{\"name\":\"%s\",\"unit\":\"%s\",\"value\":%.6g,\"spread\":%.4f,", result->name,
+                result->unit, result->value, result->spread);
+        fprintf(file, "\"higher_is_better\":%d}%s\n", result->higher_is_better,
+                i + 1 < run->result_count ? "," : "");
+    }
+    fprintf(file, "]}\n");
+}
+
+// Finds a result in a baseline written by bench_write_json, returns 0 if it isn't there
+static int bench_baseline_value(const char* json, const char* name, double* value)
+{
+    char key[BENCH_MAX_NAME + 16];
+    const char* found;
+    const char* end;
+
+    snprintf(key, sizeof(key), "\"name\":\"%s\"", name);
+    found = strstr(json, key);
+    if (!found) return 0;
+
+    // The value belongs to this result as long as it comes before the end of the result's object
+    end = strchr(found, '}');
+    found = strstr(found, "\"value\":");
+    if (!found || (end && found > end)) return 0;
+    *value = strtod(found + strlen("\"value\":"), NULL);
+    return 1;
+}
+
+int bench_compare(const BenchRun* run, const char* path, double threshold)
+{
+    const BenchResult* result;
+    double base, change;
+    char* json;
+    FILE* file;
+    size_t size;
+    int regressions = 0;
+    uint32_t i;
+
+    file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "lapis_bench: couldn't read the baseline %s\n", path);
+        return -1;
+    }
+    json = (char*)malloc(BENCH_MAX_BASELINE);
+    if (!json) {
+        fclose(file);
+        return -1;
+    }
+    size = fread(json, 1, BENCH_MAX_BASELINE - 1, file);
+    json[size] = '\0';
+    fclose(file);
+
+    // Change is how much better the result got, so regressions are the ones below -threshold whichever way
+    // the unit goes
+    fprintf(stderr, "\nCompared against %s\n", path);
+    for (i = 0; i < run->result_count; i++) {
+        result = &run->results[i];
+        if (!bench_baseline_value(json, result->name, &base) || base <= 0.0) {
+            fprintf(stderr, "%-32s %12s\n", result->name, "new");
+            continue;
+        }
+        change = result->higher_is_better ? result->value / base - 1.0 : base / result->value - 1.0;
+        fprintf(stderr, "%-32s %+11.1f%%%s\n", result->name, change * 100.0,
+                change < -threshold ? "  REGRESSED" : "");
+        if (change < -threshold) regressions++;
+    }
+    free(json);
+    return regressions;
+}
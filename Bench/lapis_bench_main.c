@@ -0,0 +1,143 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lapis_bench.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+uint64_t bench_now()
+{
+#ifdef _WIN32
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (uint64_t)(counter.QuadPart / frequency.QuadPart * 1000000000 +
+                      counter.QuadPart % frequency.QuadPart * 1000000000 / frequency.QuadPart);
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#endif
+}
+
+int bench_wanted(const BenchRun* run, const char* name) { return !run->filter || strstr(name, run->filter); }
+
+static int bench_order(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+double bench_measure(const BenchRun* run, BenchFunc func, void* user, uint32_t iterations, double* spread)
+{
+    double timings[BENCH_MAX_RESULTS];
+    uint32_t repeats = run->repeats < BENCH_MAX_RESULTS ? run->repeats : BENCH_MAX_RESULTS;
+    uint64_t start;
+    uint32_t i;
+
+    func(user, iterations);
+    for (i = 0; i < repeats; i++) {
+        start = bench_now();
+        func(user, iterations);
+        timings[i] = (double)(bench_now() - start) / iterations;
+    }
+
+    qsort(timings, repeats, sizeof(double), bench_order);
+    *spread = (timings[repeats - 1] - timings[0]) / timings[repeats / 2];
+    return timings[repeats / 2];
+}
+
+void bench_add(BenchRun* run, const char* name, const char* unit, double value, double spread,
+               int higher_is_better)
+{
+    BenchResult* result;
+    if (run->result_count == BENCH_MAX_RESULTS) return;
+    result = &run->results[run->result_count++];
+    strncpy(result->name, name, BENCH_MAX_NAME - 1);
+    result->name[BENCH_MAX_NAME - 1] = '\0';
+    result->unit = unit;
+    result->value = value;
+    result->spread = spread;
+    result->higher_is_better = higher_is_better;
+    fprintf(stderr, "%-32s %12.3f %-14s +-%.1f%%\n", name, value, unit, spread * 50.0);
+}
+
+static void bench_usage()
+{
+    fprintf(stderr,
+            "usage: lapis_bench [options]\n"
+            "  -f name       only run benchmarks whose names contain name\n"
+            "  -r repeats    timings taken of each benchmark, 7 by default\n"
+            "  -w workers    threads to rasterize with, 1 by default\n"
+            "  -o out.json   write the results to a file instead of stdout\n"
+            "  -b base.json  compare against an earlier run, failing if anything regressed\n"
+            "  -t percent    how much worse than the baseline counts as a regression, 10 by default\n"
+            "  -g dir        render the golden scenes and compare them against the images in dir\n"
+            "  -u            write the golden scenes' images into dir instead of comparing them\n");
+}
+
+int main(int argc, char** argv)
+{
+    LapisContextHelper context_helper;
+    BenchRun run;
+    const char* output = NULL;
+    const char* baseline = NULL;
+    const char* golden = NULL;
+    double threshold = 10.0;
+    FILE* file;
+    int i, update = 0, mismatches = 0, regressions = 0;
+
+    memset(&run, 0, sizeof(run));
+    run.repeats = 7;
+    run.workers = 1;
+    for (i = 1; i < argc; i += 2) {
+        if (!strcmp(argv[i], "-u")) {
+            update = 1;
+            i--;
+            continue;
+        }
+        if (i + 1 == argc) break;
+        if (!strcmp(argv[i], "-f")) run.filter = argv[i + 1];
+        else if (!strcmp(argv[i], "-r")) run.repeats = (uint32_t)atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-w")) run.workers = (uint32_t)atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-o")) output = argv[i + 1];
+        else if (!strcmp(argv[i], "-b")) baseline = argv[i + 1];
+        else if (!strcmp(argv[i], "-t")) threshold = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "-g")) golden = argv[i + 1];
+        else break;
+    }
+    if (i != argc || !run.repeats || !run.workers || (update && !golden)) {
+        bench_usage();
+        return 1;
+    }
+
+    lapis_connect();
+    context_helper.worker_count = run.workers;
+    if (lapis_allocate(&run.context, e_lapis_type_context) != e_lapis_return_success ||
+        lapis_create_context(&run.context, &context_helper) != e_lapis_return_success) {
+        fprintf(stderr, "lapis_bench: couldn't create the context\n");
+        return 1;
+    }
+
+    bench_alloc(&run);
+    bench_clear(&run);
+    bench_raster(&run);
+    bench_frame(&run);
+    if (golden) mismatches = bench_golden(&run, golden, update);
+
+    file = output ? fopen(output, "w") : stdout;
+    if (!file) {
+        fprintf(stderr, "lapis_bench: couldn't write %s\n", output);
+        return 1;
+    }
+    bench_write_json(&run, file);
+    if (output) fclose(file);
+
+    if (baseline) regressions = bench_compare(&run, baseline, threshold / 100.0);
+    lapis_destroy_context(&run.context);
+    lapis_free(&run.context);
+    return regressions != 0 || mismatches != 0;
+}
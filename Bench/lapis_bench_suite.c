@@ -0,0 +1,302 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "lapis_bench.h"
+
+// Objects allocated before the arena is reset, or taken from the pool before they're all given back
+#define BENCH_ALLOC_BATCH (64)
+
+// Size of the target triangles are rasterized into
+#define BENCH_RASTER_SIZE (512)
+
+// Seed every scene is built from
+#define BENCH_SEED (0x4C415053u)
+
+// Everything the work being timed needs
+typedef struct BenchWork {
+    LapisTarget* target;
+    LapisWindow* window;
+    LapisPool* pool;
+    LapisArena* arena;
+    float* pos;
+    float* col;
+    uint32_t tri_count;
+} BenchWork;
+
+float bench_random(uint32_t* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return (float)(*state >> 8) / 16777216.0f;
+}
+
+// Fills the work with triangles of roughly the given size in pixels scattered across the target
+static int bench_scene(BenchWork* work, uint32_t tri_count, float size, uint32_t target_size)
+{
+    uint32_t state = BENCH_SEED;
+    float x, y, extent = size / (float)target_size;
+    uint32_t i;
+
+    work->pos = (float*)malloc(tri_count * 9 * sizeof(float));
+    work->col = (float*)malloc(tri_count * 9 * sizeof(float));
+    work->tri_count = tri_count;
+    if (!work->pos || !work->col) return 0;
+    for (i = 0; i < tri_count; i++) {
+        x = bench_random(&state) - 0.5f;
+        y = bench_random(&state) - 0.5f;
+        work->pos[i * 9 + 0] = x - extent * bench_random(&state);
+        work->pos[i * 9 + 1] = y - extent * bench_random(&state);
+        work->pos[i * 9 + 3] = x + extent * bench_random(&state);
+        work->pos[i * 9 + 4] = y - extent * bench_random(&state);
+        work->pos[i * 9 + 6] = x;
+        work->pos[i * 9 + 7] = y + extent * bench_random(&state);
+        work->pos[i * 9 + 2] = work->pos[i * 9 + 5] = work->pos[i * 9 + 8] = 0.0f;
+    }
+    for (i = 0; i < tri_count * 9; i++) work->col[i] = bench_random(&state);
+    return 1;
+}
+
+static void bench_free_scene(BenchWork* work)
+{
+    free(work->pos);
+    free(work->col);
+    work->pos = work->col = NULL;
+}
+
+static LapisReturnCode bench_create_target(BenchRun* run, LapisTarget* target, uint32_t width,
+                                           uint32_t height, uint32_t format)
+{
+    LapisTargetHelper helper;
+    LapisReturnCode code;
+    memset(&helper, 0, sizeof(helper));
+    helper.width = width;
+    helper.height = height;
+    helper.context = &run->context;
+    helper.format = format;
+    code = lapis_allocate_dynamic(target, &helper, e_lapis_type_target);
+    if (code != e_lapis_return_success) return code;
+    return lapis_create_gfx_target(target, &helper);
+}
+
+/**
+ * Allocation
+ */
+
+static void bench_arena_churn(void* user, uint32_t iterations)
+{
+    BenchWork* work = (BenchWork*)user;
+    LapisStructure objects[BENCH_ALLOC_BATCH];
+    uint32_t i;
+    for (i = 0; i < iterations; i++) {
+        lapis_allocate(&objects[i % BENCH_ALLOC_BATCH], e_lapis_type_context);
+        if (i % BENCH_ALLOC_BATCH == BENCH_ALLOC_BATCH - 1) lapis_arena_reset(work->arena);
+    }
+    lapis_arena_reset(work->arena);
+}
+
+static void bench_pool_churn(void* user, uint32_t iterations)
+{
+    BenchWork* work = (BenchWork*)user;
+    LapisStructure objects[BENCH_ALLOC_BATCH];
+    uint32_t i, j;
+    for (i = 0; i < iterations; i += BENCH_ALLOC_BATCH) {
+        for (j = 0; j < BENCH_ALLOC_BATCH; j++) lapis_allocate_from_pool(work->pool, &objects[j]);
+        for (j = 0; j < BENCH_ALLOC_BATCH; j++) lapis_free(&objects[j]);
+    }
+}
+
+void bench_alloc(BenchRun* run)
+{
+    BenchWork work;
+    LapisSize size;
+    double ns, spread;
+
+    memset(&work, 0, sizeof(work));
+    if (bench_wanted(run, "alloc/arena") &&
+        lapis_create_arena(&work.arena, "bench", LAPIS_CONTEXT_CPU_SIZE * BENCH_ALLOC_BATCH * 2, 0) ==
+            e_lapis_return_success) {
+        lapis_set_arena(work.arena);
+        ns = bench_measure(run, bench_arena_churn, &work, 1 << 16, &spread);
+        lapis_set_arena(NULL);
+        lapis_destroy_arena(work.arena);
+        bench_add(run, "alloc/arena", "ns/alloc", ns, spread, 0);
+    }
+
+    // Pool allocations are given back one at a time, so this also times lapis_free finding the pool
+    lapis_size_context(&size);
+    if (bench_wanted(run, "alloc/pool") &&
+        lapis_create_pool(&work.pool, "bench", &size, BENCH_ALLOC_BATCH) == e_lapis_return_success) {
+        ns = bench_measure(run, bench_pool_churn, &work, 1 << 16, &spread);
+        lapis_destroy_pool(work.pool);
+        bench_add(run, "alloc/pool", "ns/alloc", ns, spread, 0);
+    }
+}
+
+/**
+ * Clearing
+ */
+
+static void bench_clear_target(void* user, uint32_t iterations)
+{
+    BenchWork* work = (BenchWork*)user;
+    float color[3] = {0.25f, 0.5f, 0.75f};
+    uint32_t i;
+    for (i = 0; i < iterations; i++) {
+        color[0] = (float)(i & 1);
+        lapis_gfx_target_clear(work->target, color);
+        lapis_gfx_target_schedule(work->target);
+    }
+}
+
+void bench_clear(BenchRun* run)
+{
+    static const uint32_t sizes[][2] = {{64, 64}, {256, 256}, {1024, 1024}, {1920, 1080}};
+
+    // RGBA8 keeps the names it had before targets had formats, so old baselines still compare
+    static const char* format_names[] = {"", "rgb565/"};
+    static const uint32_t formats[] = {e_lapis_format_rgba8, e_lapis_format_rgb565};
+    char name[BENCH_MAX_NAME];
+    LapisTarget target;
+    BenchWork work;
+    double ns, spread;
+    uint32_t f, i, pixels;
+
+    memset(&work, 0, sizeof(work));
+    work.target = &target;
+    for (f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+        for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            snprintf(name, sizeof(name), "clear/%s%ux%u", format_names[f], sizes[i][0], sizes[i][1]);
+            if (!bench_wanted(run, name)) continue;
+            if (bench_create_target(run, &target, sizes[i][0], sizes[i][1], formats[f]) !=
+                e_lapis_return_success) {
+                continue;
+            }
+
+            // Enough clears that every timing covers a few hundred megapixels at most
+            pixels = sizes[i][0] * sizes[i][1];
+            ns = bench_measure(run, bench_clear_target, &work, 1 + (1 << 24) / pixels, &spread);
+            lapis_free(&target);
+            bench_add(run, name, "Mpixel/s", pixels * 1000.0 / ns, spread, 1);
+        }
+    }
+}
+
+/**
+ * Rasterizing
+ */
+
+static void bench_raster_scene(void* user, uint32_t iterations)
+{
+    BenchWork* work = (BenchWork*)user;
+    uint32_t i;
+    for (i = 0; i < iterations; i++) {
+        lapis_gfx_immediate_pos_color(work->target, work->pos, work->col, work->tri_count);
+        lapis_gfx_target_schedule(work->target);
+    }
+}
+
+void bench_raster(BenchRun* run)
+{
+    static const char* size_names[] = {"small", "medium", "large"};
+    static const float sizes[] = {4.0f, 32.0f, 256.0f};
+    static const uint32_t counts[] = {100, 1000, 10000};
+    float black[3] = {0.0f, 0.0f, 0.0f};
+    char name[BENCH_MAX_NAME];
+    LapisTarget target;
+    BenchWork work;
+    double ns, spread;
+    uint32_t s, c, iterations;
+
+    memset(&work, 0, sizeof(work));
+    work.target = &target;
+    if (bench_create_target(run, &target, BENCH_RASTER_SIZE, BENCH_RASTER_SIZE, e_lapis_format_rgba8) !=
+        e_lapis_return_success) {
+        return;
+    }
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        for (c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+            snprintf(name, sizeof(name), "raster/%s/%u", size_names[s], counts[c]);
+            if (!bench_wanted(run, name)) continue;
+            if (!bench_scene(&work, counts[c], sizes[s], BENCH_RASTER_SIZE)) {
+                bench_free_scene(&work);
+                continue;
+            }
+
+            // Keep the pixels rasterized per timing roughly the same whatever the size of the triangles
+            iterations = 1 + (uint32_t)(2e8 / (counts[c] * (double)sizes[s] * sizes[s]));
+            if (iterations > 1000) iterations = 1000;
+            lapis_gfx_target_clear(&target, black);
+            ns = bench_measure(run, bench_raster_scene, &work, iterations, &spread);
+            bench_free_scene(&work);
+            bench_add(run, name, "triangles/s", counts[c] * 1e9 / ns, spread, 1);
+        }
+    }
+    lapis_free(&target);
+}
+
+/**
+ * Whole frames
+ */
+
+static void bench_frame_loop(void* user, uint32_t iterations)
+{
+    BenchWork* work = (BenchWork*)user;
+    float color[3] = {0.1f, 0.1f, 0.1f};
+    uint32_t i;
+    for (i = 0; i < iterations; i++) {
+        lapis_window_poll_events(work->window);
+        lapis_gfx_target_clear(work->target, color);
+        lapis_gfx_immediate_pos_color(work->target, work->pos, work->col, work->tri_count);
+        lapis_gfx_target_schedule(work->target);
+        lapis_window_swap(work->window);
+    }
+}
+
+void bench_frame(BenchRun* run)
+{
+    LapisWindowHelper window_helper;
+    LapisTargetHelper target_helper;
+    char name[BENCH_MAX_NAME];
+    LapisWindow window;
+    LapisTarget target;
+    BenchWork work;
+    double ns, spread;
+    uint32_t frames;
+
+    memset(&work, 0, sizeof(work));
+    work.window = &window;
+    work.target = &target;
+    for (frames = 1; frames <= 2; frames++) {
+        snprintf(name, sizeof(name), "frame/%u_in_flight", frames);
+        if (!bench_wanted(run, name)) continue;
+
+        // Headless and unpaced, so the frame rate is only limited by lapis itself
+        memset(&window_helper, 0, sizeof(window_helper));
+        window_helper.width = 1280;
+        window_helper.height = 720;
+        window_helper.frames_in_flight = frames;
+        if (lapis_allocate_dynamic(&window, &window_helper, e_lapis_type_window) != e_lapis_return_success) {
+            continue;
+        }
+        if (lapis_create_window(&run->context, &window, &window_helper) != e_lapis_return_success) {
+            lapis_free(&window);
+            continue;
+        }
+        lapis_window_fill_target_helper(&window, &target_helper);
+        if (lapis_allocate_dynamic(&target, &target_helper, e_lapis_type_target) != e_lapis_return_success ||
+            lapis_create_gfx_target(&target, &target_helper) != e_lapis_return_success ||
+            !bench_scene(&work, 1000, 32.0f, window_helper.width)) {
+            lapis_destroy_window(&window);
+            bench_free_scene(&work);
+            continue;
+        }
+
+        ns = bench_measure(run, bench_frame_loop, &work, 60, &spread);
+
+        // The window presents whatever is still in flight before it goes, which needs the target
+        lapis_destroy_window(&window);
+        lapis_free(&target);
+        lapis_free(&window);
+        bench_free_scene(&work);
+        bench_add(run, name, "frames/s", 1e9 / ns, spread, 1);
+    }
+}
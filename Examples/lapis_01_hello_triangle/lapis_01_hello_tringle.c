@@ -5,10 +5,13 @@ int main()
     // Start lapis
     lapis_connect();
 
-    // Allocate enough space for the lapis context, the user can do this manually
+    // Allocate enough space for the lapis context, the user can do this manually. The context also decides
+    // how many threads lapis is allowed to render with
     LapisContext context;
+    LapisContextHelper context_helper;
+    context_helper.worker_count = 4;
     lapis_allocate(&context, e_lapis_type_context);
-    lapis_create_context(&context);
+    lapis_create_context(&context, &context_helper);
 
     // Using the context now create a window. Since the window size is going to effect how much memory we need
     // to allocate, we need to tell the window how large we expect it to be. The other important information
@@ -18,6 +21,10 @@ int main()
     LapisWindowHelper window_helper;
     window_helper.width = 720;
     window_helper.height = 360;
+    window_helper.refresh_rate = 60;
+    window_helper.name = "/lapis_01_hello_triangle";
+    window_helper.frames_in_flight = 2;
+    window_helper.format = e_lapis_format_rgba8;
     lapis_allocate_dynamic(&window, &window_helper, e_lapis_type_window);
     lapis_create_window(&context, &window, &window_helper);
 
@@ -33,11 +40,11 @@ int main()
     // supply a list of colours to associate with each vertex will be, this will then be interpolated on the
     // gpu
     float vertex_positions[9] = {// Top
-                                 0.0, 0.0, 0.0,
+                                 0.0, 0.4, 0.0,
                                  // Right
-                                 0.0, 0.0, 0.0,
+                                 0.4, -0.4, 0.0,
                                  // Left
-                                 0.0, 0.0, 0.0};
+                                 -0.4, -0.4, 0.0};
 
     float vertex_colors[9] = {// Top
                               0.0, 1.0, 0.0,
@@ -71,5 +78,8 @@ int main()
 
     // Now be good and free the memory we allocated
     lapis_free(&target);
+    lapis_destroy_window(&window);
     lapis_free(&window);
+    lapis_destroy_context(&context);
+    lapis_free(&context);
 }
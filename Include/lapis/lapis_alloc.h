@@ -2,6 +2,15 @@
  * Lapis - Alloc
  * One of the helper libraries which users can implement themselves if required
  *
+ * Two kinds of allocator are provided. Arenas hand memory out front to back and get it all back in one go
+ * when they're reset, which suits long lived objects like the context, windows and targets, or anything which
+ * only lives for a frame. Pools hold blocks of one fixed size, which suits objects that are created and
+ * destroyed all the time. Both honour LapisSize.gpu_align.
+ *
+ * lapis_allocate and lapis_allocate_dynamic allocate from the current arena, unless a pool has been created
+ * for exactly the size of the object in which case it comes from the pool. lapis_free gives the memory back
+ * to wherever it came from. None of the allocators are thread safe.
+ *
  * License   : GPL3
  * Copyright : 2022 Mesopotamic
  * Authors   : Lawrence G
@@ -10,6 +19,12 @@
 #define __LAPIS_ALLOC_EXTERNAL_HEADER_H__ (1)
 #include "lapis_core.h"
 
+// A linear allocator, objects are allocated one after another and freed all at once when the arena is reset
+typedef struct LapisArena LapisArena;
+
+// An allocator of equally sized blocks
+typedef struct LapisPool LapisPool;
+
 /**
  * @brief Allocates a lapis structure for the user
  * @returns Lapis success code
@@ -28,10 +43,75 @@ LapisReturnCode lapis_allocate(LapisStructure* object, LapisType type);
 LapisReturnCode lapis_allocate_dynamic(LapisStructure* object, void* helper, LapisType type);
 
 /**
- * @brief Free a lapis structure which has been allocated with lapis_alloc
+ * @brief Free a lapis structure which has been allocated with lapis_alloc. Pool memory goes straight back to
+ * the pool, arena memory is only reused once the arena is reset unless it was the last thing allocated
  * @returns Lapis success code
  * @param object the lapis object to free
  */
 LapisReturnCode lapis_free(LapisStructure* object);
 
+/**
+ * Arenas
+ */
+
+/**
+ * @brief Creates a named arena. The capacities are how much memory the arena grabs at a time, when they run
+ * out it grabs more rather than failing
+ * @returns Lapis success code
+ * @param arena Pointer to fill in with the new arena
+ * @param name Name the arena can be found by, copied into the arena
+ * @param cpu_capacity Bytes of cpu memory to reserve up front
+ * @param gpu_capacity Bytes of gpu visible memory to reserve up front
+ */
+LapisReturnCode lapis_create_arena(LapisArena** arena, const char* name, size_t cpu_capacity,
+                                   size_t gpu_capacity);
+
+// Finds an arena by the name it was created with, null if there isn't one
+LapisArena* lapis_find_arena(const char* name);
+
+/**
+ * @brief Makes lapis_allocate and lapis_allocate_dynamic allocate from an arena
+ * @returns Lapis success code
+ * @param arena The arena to allocate from, null goes back to the default arena
+ */
+LapisReturnCode lapis_set_arena(LapisArena* arena);
+
+/**
+ * @brief Frees everything allocated from the arena at once while keeping hold of its memory, for example at
+ * the end of every frame
+ * @returns Lapis success code
+ * @param arena The arena to reset
+ */
+LapisReturnCode lapis_arena_reset(LapisArena* arena);
+
+// Gives all of the arena's memory back to the system, anything allocated from it becomes invalid
+LapisReturnCode lapis_destroy_arena(LapisArena* arena);
+
+/**
+ * Pools
+ */
+
+/**
+ * @brief Creates a pool of blocks which can each hold one object of the given size, all of the memory is
+ * reserved up front. Once created, lapis_allocate_dynamic will take any object of exactly this size from the
+ * pool until it is empty
+ * @returns Lapis success code
+ * @param pool Pointer to fill in with the new pool
+ * @param name Name of the pool, copied into the pool
+ * @param size Size of the objects the pool holds, from one of the lapis_size functions
+ * @param capacity Number of objects the pool can hold
+ */
+LapisReturnCode lapis_create_pool(LapisPool** pool, const char* name, LapisSize* size, uint32_t capacity);
+
+/**
+ * @brief Allocates an object from a pool
+ * @returns Lapis success code, out of memory when every block is in use
+ * @param pool The pool to allocate from
+ * @param object Pointer to the object to be allocated
+ */
+LapisReturnCode lapis_allocate_from_pool(LapisPool* pool, LapisStructure* object);
+
+// Gives all of the pool's memory back to the system, anything allocated from it becomes invalid
+LapisReturnCode lapis_destroy_pool(LapisPool* pool);
+
 #endif
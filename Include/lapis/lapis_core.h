@@ -49,6 +49,7 @@ typedef enum LapisType {
     e_lapis_type_context,  // The context that holds everything to get started
     e_lapis_type_window,   // The window
     e_lapis_type_target,   // Lapis target which can be rendered to
+    e_lapis_type_mesh,     // Geometry uploaded once and drawn many times
 } LapisType;
 
 // Represents the information required to represent a gpu memory allocation. We're using size_t as it should
@@ -60,6 +61,35 @@ typedef struct LapisSize {
     uint32_t gpu_align;
 } LapisSize;
 
+/*************************************************************************************************************
+ * LAPIS STATIC SIZES
+ * Upper bounds on the size of the types which don't need a helper to be sized, so they can be declared as
+ * static or stack arrays without asking lapis first. The backend lapis was built with is passed on as
+ * LAPIS_BACKEND_<NAME>, without it the bounds cover every backend. cpu memory should be aligned to
+ * LAPIS_CPU_ALIGN, gpu memory to the gpu_align the size functions return. A plain array only gets the
+ * alignment of its element type, so ask for it with _Alignas on C11 or the attribute on gcc and clang
+ *         static _Alignas(LAPIS_CPU_ALIGN)
+ *             uint64_t context_memory[LAPIS_CONTEXT_CPU_SIZE / sizeof(uint64_t)];
+ *         static uint64_t context_memory[LAPIS_CONTEXT_CPU_SIZE / sizeof(uint64_t)]
+ *             __attribute__((aligned(LAPIS_CPU_ALIGN)));
+ *************************************************************************************************************/
+#define LAPIS_CPU_ALIGN (64)
+
+#if defined(LAPIS_BACKEND_SOFT)
+#define LAPIS_CONTEXT_CPU_SIZE (8192)
+#elif defined(LAPIS_BACKEND_GLSL) || defined(LAPIS_BACKEND_WII)
+#define LAPIS_CONTEXT_CPU_SIZE (64)
+#else
+#define LAPIS_CONTEXT_CPU_SIZE LAPIS_CONTEXT_CPU_SIZE_MAX
+#endif
+
+// No backend keeps any of the context in gpu memory
+#define LAPIS_CONTEXT_GPU_SIZE (0)
+#define LAPIS_CONTEXT_GPU_ALIGN (1)
+
+// Largest of the bounds across all the backends
+#define LAPIS_CONTEXT_CPU_SIZE_MAX (8192)
+
 // Represents all lapis structs as a set of two pointers
 typedef struct LapisStructure {
     void* cpu_mem;
@@ -69,6 +99,15 @@ typedef struct LapisStructure {
 // Represents all the state for the graphics context
 typedef LapisStructure LapisContext;
 
+// Helper which tells lapis how to create the context
+typedef struct LapisContextHelper {
+    uint32_t worker_count;  // Threads used for rendering including the calling thread, 0 or 1 for no threads
+} LapisContextHelper;
+
+// A function which the context can run across its workers, index is which of the tasks to run and worker is
+// which thread it's running on, 0 being the thread which asked for the work
+typedef void (*LapisTaskFunc)(void* user, uint32_t index, uint32_t worker);
+
 /*************************************************************************************************************
  * LAPIS ERROR CODES
  * Most lapis functions are going to want to comunicate with you if they were successful, it's obviously not
@@ -76,7 +115,11 @@ typedef LapisStructure LapisContext;
  * successful.
  *************************************************************************************************************/
 typedef enum LapisReturnCode {
-    e_lapis_return_success,  // Everything went as expected!
+    e_lapis_return_success,           // Everything went as expected!
+    e_lapis_return_invalid_argument,  // A required pointer was null or a size was out of range
+    e_lapis_return_unsupported,       // The selected backend can't do that
+    e_lapis_return_system_error,      // The operating system refused a request, like starting a thread
+    e_lapis_return_out_of_memory,     // There wasn't enough memory left to satisfy the request
 } LapisReturnCode;
 
 /*************************************************************************************************************
@@ -93,10 +136,194 @@ typedef enum LapisReturnCode {
  */
 LapisReturnCode lapis_connect();
 
+// Fetch the size of the lapis context
+LapisReturnCode lapis_size_context(LapisSize* size);
+
+/**
+ * @brief Fetches the size of any type which can be sized without a helper, which is only the context. Types
+ * whose size depends on how they're created have to use their own size function like lapis_size_window
+ * @returns Lapis success code, invalid argument for types which need a helper
+ * @param size Pointer to the size to fill in
+ * @param type The type to get the size of
+ */
+LapisReturnCode lapis_get_size(LapisSize* size, LapisType type);
+
+/**
+ * @brief Reserves room for an object at the end of a bundle, so several objects can share one allocation. The
+ * bundle should start out zeroed, afterwards it holds the total size and the strictest gpu alignment of
+ * everything added so far. The object's cpu memory is placed at a multiple of LAPIS_CPU_ALIGN and its gpu
+ * memory at a multiple of its gpu_align, from the start of the bundle's memory
+ * @returns Lapis success code
+ * @param bundle The size of the bundle so far
+ * @param object The size of the object being added
+ * @param cpu_offset Filled in with where the object's cpu memory starts
+ * @param gpu_offset Filled in with where the object's gpu memory starts
+ */
+LapisReturnCode lapis_bundle_add(LapisSize* bundle, const LapisSize* object, size_t* cpu_offset,
+                                 size_t* gpu_offset);
+
 /**
- * @brief Creates the lapis context which has already been allocated
+ * @brief Creates the lapis context which has already been allocated, any worker threads are started here
  * @returns Lapis success code
  * @param context Pointer to the context to create
+ * @param helper Pointer to the helper struct so lapis knows how to create the context, null for the defaults
+ */
+LapisReturnCode lapis_create_context(LapisContext* context, LapisContextHelper* helper);
+
+/**
+ * @brief Stops the context's worker threads, the context's memory can be freed afterwards
+ * @returns Lapis success code
+ * @param context Pointer to the context to destroy
+ */
+LapisReturnCode lapis_destroy_context(LapisContext* context);
+
+// Number of threads the context renders with, including the calling thread
+uint32_t lapis_context_worker_count(LapisContext* context);
+
+/**
+ * @brief Runs func count times spread across the context's workers, blocks until every task has finished.
+ * The calling thread works on the tasks too, and idle workers steal tasks from busy ones
+ * @returns Lapis success code
+ * @param context Pointer to the context owning the workers
+ * @param func The function to run for each task
+ * @param user Pointer passed to every call of func
+ * @param count Number of tasks to run
+ */
+LapisReturnCode lapis_context_parallel_for(LapisContext* context, LapisTaskFunc func, void* user,
+                                           uint32_t count);
+
+/*************************************************************************************************************
+ * LAPIS INSTRUMENTATION
+ * What:
+ *     Built with LAPIS_INSTRUMENTATION defined, which the cmake option of the same name does, lapis times
+ *     each stage of every frame and keeps the last LAPIS_STATS_FRAMES frames to take percentiles over, along
+ *     with the last LAPIS_TRACE_EVENTS stages which ran to export as a chrome trace.
+ *
+ * How:
+ *     Frames end when a window presents. Stages are counted in the frame they finished in, so with more than
+ *     one frame in flight the recording of a frame lands alongside the rasterizing of the frame before it.
+ *     Stages nest, a draw into a target which doesn't record includes the rasterizing it does, and a swap
+ *     with one frame in flight includes rasterizing and presenting the frame
+ *         LapisFrameStats stats;
+ *         if (lapis_get_frame_stats(&stats) == e_lapis_return_success) {
+ *             printf("p99 frame %llu ns\n", stats.frame_p99);
+ *         }
+ *
+ * Why:
+ *     Frame time spikes are rare and hard to reproduce under a profiler. Without the define the timing calls
+ *     compile to nothing, so there's no cost to leaving them in the hot paths
+ *************************************************************************************************************/
+typedef enum LapisStage {
+    e_lapis_stage_clear,    // Clearing targets
+    e_lapis_stage_record,   // Draw calls, recording them or drawing straight away
+    e_lapis_stage_raster,   // Running a target's recorded commands and rasterizing what they binned
+    e_lapis_stage_present,  // Waiting for vsync and publishing the frame
+    e_lapis_stage_swap,     // How long lapis_window_swap blocked the thread calling it
+    e_lapis_stage_count,
+} LapisStage;
+
+// Frames the percentiles are taken over, and stages kept to export as a trace
+#define LAPIS_STATS_FRAMES (128)
+#define LAPIS_TRACE_EVENTS (4096)
+
+// Time a stage took in each frame, all in nanoseconds
+typedef struct LapisStageStats {
+    uint64_t p50;
+    uint64_t p99;
+    uint64_t max;
+    uint64_t last;   // Time taken in the last frame
+    uint32_t calls;  // Times the stage ran in the last frame
+} LapisStageStats;
+
+typedef struct LapisFrameStats {
+    uint32_t frames;     // Frames the percentiles were taken over
+    uint64_t frame_p50;  // Time from the end of one frame to the end of the next in nanoseconds
+    uint64_t frame_p99;
+    uint64_t frame_max;
+    uint64_t frame_last;
+    LapisStageStats stages[e_lapis_stage_count];
+} LapisFrameStats;
+
+#ifdef LAPIS_INSTRUMENTATION
+// Marks the start and end of a stage on the calling thread, a stage can't nest inside of itself
+void lapis_trace_begin(LapisStage stage);
+void lapis_trace_end(LapisStage stage);
+
+// Ends the frame, called by the window as it presents
+void lapis_trace_end_frame();
+
+#define LAPIS_TRACE_BEGIN(stage) lapis_trace_begin(stage)
+#define LAPIS_TRACE_END(stage) lapis_trace_end(stage)
+#define LAPIS_TRACE_END_FRAME() lapis_trace_end_frame()
+#else
+#define LAPIS_TRACE_BEGIN(stage) ((void)0)
+#define LAPIS_TRACE_END(stage) ((void)0)
+#define LAPIS_TRACE_END_FRAME() ((void)0)
+#endif
+
+/**
+ * @brief Fetches the percentiles and worst of how long each stage took per frame, over the recent frames
+ * @returns Lapis success code, unsupported when lapis was built without instrumentation
+ * @param stats Filled in with the stats
+ */
+LapisReturnCode lapis_get_frame_stats(LapisFrameStats* stats);
+
+/**
+ * @brief Writes the most recent stages out as chrome trace event JSON, which chrome://tracing and perfetto
+ * can open. Nothing is allocated, the JSON goes into memory the caller provides
+ * @returns Lapis success code, out of memory if the JSON didn't fit, unsupported when lapis was built
+ * without instrumentation
+ * @param json Memory to write the null terminated JSON into, null to only find out how large it is
+ * @param capacity Bytes json can hold
+ * @param size Filled in with the length of the JSON, not counting the terminator, even if it didn't fit
+ */
+LapisReturnCode lapis_export_trace(char* json, size_t capacity, size_t* size);
+
+/*************************************************************************************************************
+ * LAPIS PIXEL FORMATS
+ * What:
+ *     How the pixels of targets and window framebuffers are laid out in memory. Colors are always given to
+ *     lapis as floats, the format only decides what gets stored. 16 bit pixels are stored in the cpu's own
+ *     byte order, one after another in rows.
+ *
+ * How:
+ *     Targets rasterize straight into their format. A window target in a different format to its window
+ *     keeps pixels of its own, and only the pixels which changed are converted into the window's framebuffer
+ *     as the frame is presented
+ *         target_helper.format = e_lapis_format_rgb565;
+ *
+ * Why:
+ *     Memory and bandwidth are what run out first on small devices, and a 16 bit target halves both for the
+ *     clears, the rasterizing and the present. The wii's external framebuffer is YUYV, which can't be
+ *     rasterized into, so its targets draw in a 16 bit format and are converted at present
+ *************************************************************************************************************/
+typedef enum LapisPixelFormat {
+    e_lapis_format_rgba8,   // 32 bits, red in the lowest byte and alpha in the highest
+    e_lapis_format_rgb565,  // 16 bits, red in the top 5 bits and blue in the bottom 5
+    e_lapis_format_rgb5a3,  // 16 bits, the wii's texture format. RGB555 with the top bit set for opaque
+                            // pixels, otherwise 3 bits of alpha then RGB444. Lapis only writes opaque pixels
+    e_lapis_format_yuyv,    // 16 bits, each pair of pixels is Y0 U Y1 V in limited range BT.601. The wii's
+                            // external framebuffer, windows can use it but targets can't rasterize into it
+    e_lapis_format_count,
+} LapisPixelFormat;
+
+// Bytes each pixel of a format takes, 0 for a format that doesn't exist
+uint32_t lapis_format_bytes(uint32_t format);
+
+/**
+ * @brief Converts a rectangle of pixels from one format into another, using vector kernels where the cpu
+ * has them. Converting between a format and itself copies
+ * @returns Lapis success code, invalid argument for formats which don't exist or a YUYV rectangle with an
+ * odd width
+ * @param dst Pixel the rectangle starts at in the destination
+ * @param dst_format Format of the destination
+ * @param dst_stride Distance between rows of the destination in bytes
+ * @param src Pixel the rectangle starts at in the source
+ * @param src_format Format of the source
+ * @param src_stride Distance between rows of the source in bytes
+ * @param width Width of the rectangle in pixels
+ * @param height Height of the rectangle in pixels
  */
-LapisReturnCode lapis_create_context(LapisContext* context);
+LapisReturnCode lapis_convert_pixels(void* dst, uint32_t dst_format, size_t dst_stride, const void* src,
+                                     uint32_t src_format, size_t src_stride, uint32_t width, uint32_t height);
 #endif
@@ -21,42 +21,347 @@ typedef LapisStructure LapisTarget;
 typedef struct LapisTargetHelper {
     uint32_t width;
     uint32_t height;
+
+    // Context to render with. When the context has more than one worker, triangles are binned into screen
+    // tiles and the tiles are rasterized in parallel when the target is scheduled. Null renders immediately
+    // on the calling thread
+    LapisContext* context;
+
+    // Triangles which can be binned before the target has to be rasterized early, 0 for the default
+    uint32_t bin_triangles;
+
+    // Window the target presents to, null for offscreen targets. Backends which can render straight into the
+    // window's framebuffer don't need any gpu memory for window targets
+    LapisWindow* window;
+
+    // Bytes of the target's memory set aside to record clears and draws into, which then run together when
+    // the target is flushed. Consecutive draws are merged into one batch. 0 runs every call as it's made
+    uint32_t command_bytes;
+
+    // Target this one is a view into, null for a target with pixels of its own. A view draws straight into
+    // its parent's pixels starting at x, y and shares the parent's stride, so it needs no gpu memory and
+    // presenting the parent presents the view. Views clear, draw, schedule and track what changed on their
+    // own
+    LapisTarget* parent;
+    uint32_t x;
+    uint32_t y;
+
+    // Non zero gives the target a depth buffer, kept in its cpu memory. z runs from -0.5 nearest to 0.5
+    // furthest like x and y, and a triangle only draws the pixels where it's at least as near as what's
+    // already there. Clearing the target clears the depth to the far end. Views get a depth buffer of their
+    // own rather than sharing their parent's
+    uint32_t depth;
+
+    // How many buffers of command_bytes to record into, 0 for one and at most LAPIS_MAX_FRAMES_IN_FLIGHT. A
+    // window target with one for each frame the window has in flight records the next frame while the
+    // window is still drawing the ones before it, with fewer it waits for them instead
+    uint32_t command_buffers;
+
+    // LapisPixelFormat to rasterize into, 0 for RGBA8. Any format but YUYV, and views have their parent's. A
+    // window target in a different format to its window needs gpu memory for pixels of its own, which are
+    // converted into the window's framebuffer as it presents
+    uint32_t format;
 } LapisTargetHelper;
 
 // Fetch the size of the lapis render target
-LapisReturnCode lapis_size_target(LapisSize* size, LapisWindowHelper* helper);
+LapisReturnCode lapis_size_target(LapisSize* size, LapisTargetHelper* helper);
 
-// Special helper function which will fill in the target helper information from the selected window
+// Special helper function which will fill in the target helper information from the selected window,
+// including the window's context and a command buffer for each frame it can have in flight. The target
+// takes the window's format, or RGB565 when the window's is YUYV
 LapisReturnCode lapis_window_fill_target_helper(LapisWindow* window, LapisTargetHelper* helper);
 
+/**
+ * @brief Fills in a helper for a view into part of a target, taking the context, command buffer size, format
+ * and whether there's a depth buffer from the parent's helper. Views can be made of views
+ * @returns Lapis success code
+ * @param parent The target to make a view into, has to be created already
+ * @param parent_helper The helper the parent was created with
+ * @param helper The helper to fill in
+ * @param x Left edge of the view inside of the parent
+ * @param y Top edge of the view inside of the parent
+ * @param width Width of the view, which has to fit inside of the parent
+ * @param height Height of the view
+ */
+LapisReturnCode lapis_target_fill_view_helper(LapisTarget* parent, LapisTargetHelper* parent_helper,
+                                              LapisTargetHelper* helper, uint32_t x, uint32_t y,
+                                              uint32_t width, uint32_t height);
+
 /**
  * @brief Creates a lais target to render to
  * @param returns a lapis success code
- * @param window Pointer to a window to own the target, null pointer for offscreen targets
  * @param target Pointer to the target to create
  * @param helper Pointer to the helper struct so that lapis knows how ti create the target
  */
 LapisReturnCode lapis_create_gfx_target(LapisTarget* target, LapisTargetHelper* helper);
 
+/**
+ * Bundles, a context, a window and the targets drawing into it packed into a single allocation so starting
+ * lapis needs one allocation rather than one per object, or none at all when the memory is static
+ */
+
+// Describes everything going into a bundle
+typedef struct LapisBundleHelper {
+    LapisContextHelper* context;  // How to create the context, null for the defaults
+    LapisWindowHelper* window;    // How to create the window, null for a bundle without a window
+
+    // Targets to create. The context is filled in by the bundle, targets with a width and height of 0 draw
+    // into the window at its size and the rest are offscreen targets
+    LapisTargetHelper* targets;
+    uint32_t target_count;
+} LapisBundleHelper;
+
+/**
+ * @brief Fetches the size of a bundle, cpu memory has to be aligned to LAPIS_CPU_ALIGN
+ * @returns Lapis success code
+ * @param size Pointer to the size to fill in
+ * @param helper Pointer to the description of the bundle
+ */
+LapisReturnCode lapis_size_bundle(LapisSize* size, LapisBundleHelper* helper);
+
+/**
+ * @brief Carves the objects out of the bundle's memory and creates them in order, the context, the window
+ * and then the targets. Destroy the window and then the context as normal when done, then free the memory
+ * in one go
+ * @returns Lapis success code, out of memory if the window came out larger than it asked for so its targets
+ * don't fit
+ * @param bundle Memory of at least the size returned by lapis_size_bundle for the same helper
+ * @param helper Pointer to the description of the bundle, the target helpers are filled in as they're created
+ * @param context Filled in with the created context
+ * @param window Filled in with the created window, unused when the bundle doesn't have a window
+ * @param targets Array of target_count targets to fill in
+ */
+LapisReturnCode lapis_create_bundle(LapisStructure* bundle, LapisBundleHelper* helper, LapisContext* context,
+                                    LapisWindow* window, LapisTarget* targets);
+
 /**
  * Target manipulation functions
  */
 
 /**
- * @brief Schedules a target as outdated and ready for updating next time a window flips
+ * @brief Schedules a target as outdated and ready for updating next time a window flips. Window targets run
+ * their recorded commands when the window swaps, offscreen targets run them straight away
  * @param returns Lapis siccess code
  * @param target The lapis target to schedule an update for
  */
 LapisReturnCode lapis_gfx_target_schedule(LapisTarget* target);
 
 /**
- * @brief Clears the target to the requested color
+ * @brief Clears the target to the requested color, and its depth buffer if it has one to the far end
  * @returns Lapis success code
  * @param target Pointer to the lapis target to clear
  * @param color An array of 3 floats representing the clear color
  */
 LapisReturnCode lapis_gfx_target_clear(LapisTarget* target, float* color);
 
+/**
+ * @brief Fetches the rectangles of pixels which changed the last time the target was scheduled, taken from
+ * the bounds of every clear and draw. Windows only present these parts of the frame and copy the rest of
+ * the previous frame forward, so a target which only draws what changed only pays for what changed. For a
+ * window target that's the newest scheduled frame whose fence has been reached, frames still in flight
+ * aren't seen until they're done, and nothing is before the first one is
+ * @returns Lapis success code
+ * @param target The target to fetch the dirty rectangles of
+ * @param rects Array to fill in, never needs to be longer than LAPIS_MAX_DIRTY_RECTS
+ * @param count Length of rects, filled in with how many rectangles changed
+ */
+LapisReturnCode lapis_gfx_target_get_dirty(LapisTarget* target, LapisRect* rects, uint32_t* count);
+
+// Tests which throw triangles away before they reach the rasterizer, combined as flags. Triangles with no
+// area or outside of the target are always thrown away since they can't draw anything
+typedef enum LapisCullFlags {
+    e_lapis_cull_none = 0,
+    e_lapis_cull_back = 1 << 0,   // Triangles whose corners go clockwise with y pointing up
+    e_lapis_cull_front = 1 << 1,  // Triangles whose corners go counter clockwise
+    e_lapis_cull_small = 1 << 2,  // Tests triangles only a few pixels across against every pixel centre
+    e_lapis_cull_clip = 1 << 3,   // Clips triangles reaching past the guard band rather than dropping them
+    e_lapis_cull_default = e_lapis_cull_small | e_lapis_cull_clip,
+} LapisCullFlags;
+
+// What happened to the triangles drawn into a target. Triangles which are clipped are split in pieces, and
+// the pieces are culled and drawn like any other triangle
+typedef struct LapisCullStats {
+    uint32_t submitted;   // Triangles drawn by the application, including every triangle of a mesh
+    uint32_t drawn;       // Triangles which reached the rasterizer
+    uint32_t clipped;     // Triangles split along the guard band
+    uint32_t guard_band;  // Reached past the guard band and weren't clipped, or had NaN positions
+    uint32_t degenerate;  // Had no area once snapped to the subpixel grid
+    uint32_t facing;      // Faced the way the target culls
+    uint32_t small;       // Fell between pixel centres
+    uint32_t offscreen;   // Were entirely outside of the target
+    uint32_t occluded;    // Were behind the depth buffer everywhere they touched
+} LapisCullStats;
+
+/**
+ * @brief Picks which tests throw triangles away before they're drawn into a target, targets start with
+ * e_lapis_cull_default. Recording targets cull when their commands run, so they use the flags set then
+ * @returns Lapis success code
+ * @param target The target to set the tests of
+ * @param flags LapisCullFlags combined together
+ */
+LapisReturnCode lapis_gfx_target_set_cull(LapisTarget* target, uint32_t flags);
+
+/**
+ * @brief Fetches how many triangles each test threw away the last time the target was scheduled. For a
+ * window target that's the newest scheduled frame whose fence has been reached, the same frame
+ * lapis_gfx_target_get_dirty returns, and all 0 before the first one is
+ * @returns Lapis success code
+ * @param target The target to fetch the statistics of
+ * @param stats Filled in with the statistics
+ */
+LapisReturnCode lapis_gfx_target_get_cull_stats(LapisTarget* target, LapisCullStats* stats);
+
+/**
+ * Meshes, geometry which is uploaded once into the mesh's gpu memory and then drawn as many times as needed.
+ * Vertices are interleaved and indexed, so nothing is duplicated or rearranged when the mesh is drawn
+ */
+
+// Represents geometry which has been uploaded
+typedef LapisStructure LapisMesh;
+
+// How a mesh's vertices are laid out in its gpu memory, w of the position and a of the color are always 1.
+// Every vertex is 16 byte aligned so it can be loaded straight into vector registers
+typedef struct LapisMeshVertex {
+    float position[4];
+    float color[4];
+} LapisMeshVertex;
+
+// Packed vertex, positions are stored as fractions of the mesh's bounds from 0 to 65535 and colors from 0 to
+// 255. Less than half the size of a float vertex, so more of the mesh fits in the cache
+typedef struct LapisMeshPackedVertex {
+    uint16_t position[3];
+    uint16_t padding;
+    uint8_t color[4];
+} LapisMeshPackedVertex;
+
+typedef enum LapisVertexFormat {
+    e_lapis_vertex_float,   // LapisMeshVertex
+    e_lapis_vertex_packed,  // LapisMeshPackedVertex
+} LapisVertexFormat;
+
+typedef enum LapisIndexType {
+    e_lapis_index_none,  // Every 3 vertices in order make a triangle
+    e_lapis_index_16,    // uint16_t indices
+    e_lapis_index_32,    // uint32_t indices
+} LapisIndexType;
+
+// Helper which describes a mesh, the vertex count and index count and type decide how large it is
+typedef struct LapisMeshHelper {
+    uint32_t vertex_count;
+    uint32_t index_count;  // Every 3 indices make a triangle
+    LapisIndexType index_type;
+
+    // Data uploaded when the mesh is created, xyz positions and rgb colors. Null positions keep whatever
+    // is already in the mesh's gpu memory, such as a mesh file mapped straight into memory
+    const float* positions;
+    const float* colors;
+    const void* indices;
+
+    // How the vertices are stored, uploaded positions are packed when the mesh is created
+    LapisVertexFormat vertex_format;
+
+    // Box around every position. Packed vertices are stored relative to it so meshes already in memory need
+    // it, float meshes and uploaded positions find it themselves when it's left as zeros
+    float bounds_min[3];
+    float bounds_max[3];
+} LapisMeshHelper;
+
+// Fetch the size of a mesh
+LapisReturnCode lapis_size_mesh(LapisSize* size, LapisMeshHelper* helper);
+
+/**
+ * @brief Creates a mesh which has been allocated, uploading the helper's data into the mesh's gpu memory
+ * @returns Lapis success code
+ * @param mesh Pointer to the mesh to create
+ * @param helper Pointer to the helper describing the mesh
+ */
+LapisReturnCode lapis_create_mesh(LapisMesh* mesh, LapisMeshHelper* helper);
+
+/**
+ * @brief Draws a mesh. Vertices are transformed by the matrix and divided by w, landing in the same space
+ * immediate mode uses with 0,0 in the centre of the target, z included. Targets which record commands only
+ * record the mesh and the transform, so the mesh has to stay alive until the target is flushed
+ * @returns Lapis success code
+ * @param target The target to draw into
+ * @param mesh The mesh to draw
+ * @param transform A 4x4 column major matrix, null for none
+ */
+LapisReturnCode lapis_gfx_draw_mesh(LapisTarget* target, LapisMesh* mesh, const float* transform);
+
+/**
+ * Mesh files, written by the lapis_mesh offline tool. The data after the header is exactly what the backend
+ * keeps in a mesh's gpu memory and starts on a page boundary, so a file can be mapped into memory and drawn
+ * from where it lies without being parsed or copied
+ */
+
+#define LAPIS_MESH_FILE_MAGIC (0x48534D4Cu)  // "LMSH" when read in the file's byte order
+#define LAPIS_MESH_FILE_VERSION (1)
+#define LAPIS_MESH_FILE_ALIGN (4096)
+
+// Sits at the start of every mesh file
+typedef struct LapisMeshFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    uint32_t index_type;     // LapisIndexType
+    uint32_t vertex_format;  // LapisVertexFormat
+    uint32_t data_offset;    // From the start of the file, a multiple of LAPIS_MESH_FILE_ALIGN
+    uint32_t data_size;      // Matches the gpu size of the mesh
+    float bounds_min[3];
+    float bounds_max[3];
+} LapisMeshFileHeader;
+
+/**
+ * @brief Fills in a mesh helper from a mesh file which is already in memory, and points the mesh's gpu
+ * memory at the file's data. Only the mesh's cpu memory has to be allocated before it's created
+ * @returns Lapis success code, invalid argument if the file is from another version or the wrong byte order
+ * @param file The whole file, at least 16 byte aligned which memory mappings always are
+ * @param file_size Size of the file in bytes
+ * @param helper Helper to fill in
+ * @param mesh The mesh to point at the file
+ */
+LapisReturnCode lapis_mesh_file_fill_helper(const void* file, size_t file_size, LapisMeshHelper* helper,
+                                            LapisMesh* mesh);
+
+/**
+ * Lapis quads, rectangles of a coverage texture copied 1:1 onto a target and blended over it in one color.
+ * They're placed in whole pixels with 0,0 in the top left of the target rather than the centre, which is what
+ * text and other user interface drawing wants. Quads ignore the depth buffer and culling, and are drawn in
+ * order with the triangles drawn into the target
+ */
+
+// 8 bit coverage texture, 255 draws the quad's color and 0 leaves the target as it was
+typedef struct LapisCoverage {
+    const uint8_t* pixels;
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;  // Bytes between rows
+} LapisCoverage;
+
+// A quad, the texture rectangle at u, v is drawn with its top left at x, y
+typedef struct LapisQuad {
+    int32_t x;
+    int32_t y;
+    uint16_t u;
+    uint16_t v;
+    uint16_t width;
+    uint16_t height;
+} LapisQuad;
+
+/**
+ * @brief Draws quads of a coverage texture as a single batch. Targets which record commands copy the quads
+ * but only reference the texture's pixels, so they have to stay unchanged until the target is flushed
+ * @returns Lapis success code
+ * @param target The target to draw into
+ * @param coverage The texture the quads are cut from
+ * @param quads The quads, parts outside of the texture or the target are skipped
+ * @param count Number of quads
+ * @param color An array of 3 floats, the color drawn where the coverage is 255
+ */
+LapisReturnCode lapis_gfx_draw_quads(LapisTarget* target, const LapisCoverage* coverage,
+                                     const LapisQuad* quads, uint32_t count, const float* color);
+
 /**
  * Lapis immediate mode graphics functions. This is where triangles are submitted directly as a series of 9
  * floats, thats 3 floats per vertex each with different properties. These are when the information isn't very
@@ -64,13 +369,37 @@ LapisReturnCode lapis_gfx_target_clear(LapisTarget* target, float* color);
  */
 
 /**
- * @breif Immediatley render triangles which have vertex positions and color information
+ * @breif Immediatley render triangles which have vertex positions and color information. Positions are in
+ * screenspace with 0,0 in the centre of the target, the target is 1 wide and 1 tall with y pointing up
  * @param targget The lapis target to render the triangle list to
- * @param pos An array of vertex positions, in xyz format 3 floats per position
+ * @param pos An array of vertex positions, in xyz format 3 floats per position. z is only used by targets
+ * with a depth buffer
  * @param col An array of colors, in xyz format. 3 floats per color
  * @param tri_count Number of triangles in the list
  */
 LapisReturnCode lapis_gfx_immediate_pos_color(LapisTarget* target, float* pos, float* col,
                                               uint32_t tri_count);
 
+// Separate streams of vertex properties, each holds one float per vertex with 3 vertices per triangle
+typedef struct LapisVertexStreams {
+    const float* x;
+    const float* y;
+    const float* z;  // Only used by targets with a depth buffer, null for all 0
+    const float* r;
+    const float* g;
+    const float* b;
+} LapisVertexStreams;
+
+/**
+ * @brief Immediately render triangles from separate position and color streams, in the same space as
+ * lapis_gfx_immediate_pos_color. Each stream can be loaded straight into vector registers, which makes this
+ * the faster way to submit lots of small triangles such as particles
+ * @returns Lapis success code
+ * @param target The lapis target to render the triangle list to
+ * @param streams The vertex streams, 3 entries per triangle in every stream
+ * @param tri_count Number of triangles in the streams
+ */
+LapisReturnCode lapis_gfx_immediate_streams(LapisTarget* target, const LapisVertexStreams* streams,
+                                            uint32_t tri_count);
+
 #endif
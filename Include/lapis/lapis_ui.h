@@ -1,4 +1,213 @@
+/*************************************************************************************************************
+ * Lapis - UI
+ * User interface drawing on top of lapis gfx, the same on every backend
+ *
+ * Text is drawn from a glyph atlas. Each glyph is rasterized once into a cell of the atlas's coverage
+ * texture, and a whole string becomes a single batch of quads cut out of it. When every cell is taken the
+ * glyph which was used longest ago is replaced, but never one drawn in a frame which could still be in
+ * flight. Targets which record commands only read the atlas when they're flushed, which for a window with
+ * more than one frame in flight happens on its present thread while the next frame is being drawn.
+ *
+ * License   : GPL3
+ * Copyright : 2022 Mesopotamic
+ * Authors   : Lawrence G
+ *************************************************************************************************************/
 #ifndef __LAPIS_UI_HEADER_H__
 #define __LAPIS_UI_HEADER_H__ (1)
+#include "lapis_gfx.h"
+
+// Glyphs rasterized into a coverage texture, everything lives in the atlas's cpu memory
+typedef LapisStructure LapisGlyphAtlas;
+
+// Where a glyph sits and how far it moves the pen, in pixels. The pen starts at the top left of a line
+typedef struct LapisGlyphMetrics {
+    uint32_t width;   // Size of the coverage the glyph wrote, at most the atlas's cell size
+    uint32_t height;
+    int32_t left;     // Offset from the pen to the left of the coverage
+    int32_t top;      // Offset from the pen down to the top of the coverage
+    int32_t advance;  // How far right the pen moves after the glyph
+} LapisGlyphMetrics;
+
+/**
+ * @brief Rasterizes a single glyph into an atlas cell
+ * @returns Lapis success code, anything else leaves the glyph blank and moves the pen by the cell width
+ * @param user The user pointer from the atlas helper
+ * @param codepoint Unicode codepoint of the glyph
+ * @param coverage Top left of the cell to write 8 bit coverage into, already cleared to 0
+ * @param stride Bytes between rows of the cell
+ * @param metrics Filled in with the glyph's metrics, starts out as all 0
+ */
+typedef LapisReturnCode (*LapisGlyphRasterizer)(void* user, uint32_t codepoint, uint8_t* coverage,
+                                                uint32_t stride, LapisGlyphMetrics* metrics);
+
+typedef struct LapisGlyphAtlasHelper {
+    // Size of the coverage texture in pixels, which is split into cells of the cell size. Needs a cell for
+    // every different glyph drawn in the frames in flight
+    uint32_t width;
+    uint32_t height;
+
+    // Room each glyph gets, 0 for the size of the built in font's glyphs
+    uint32_t cell_width;
+    uint32_t cell_height;
+
+    // Pixels between the tops of lines, 0 for one more than the cell height
+    uint32_t line_height;
+
+    // Rasterizes glyphs when they're first drawn, null for the built in 5x7 pixel font which covers
+    // printable ASCII and draws a box for anything else
+    LapisGlyphRasterizer rasterizer;
+    void* user;
+
+    // Most frames in flight of any window drawn into with the atlas, 0 for 1. A glyph can't be replaced
+    // until this many frames have ended since it was last drawn, so the cells need to hold every different
+    // glyph drawn across that many frames
+    uint32_t frames_in_flight;
+} LapisGlyphAtlasHelper;
+
+// How well an atlas has been caching, counted since it was created
+typedef struct LapisGlyphAtlasStats {
+    uint32_t hits;        // Glyphs drawn which were already in the atlas
+    uint32_t rasterized;  // Glyphs which had to be rasterized
+    uint32_t evicted;     // Glyphs thrown out to make room for another
+} LapisGlyphAtlasStats;
+
+// Fetch the size of a glyph atlas
+LapisReturnCode lapis_size_glyph_atlas(LapisSize* size, LapisGlyphAtlasHelper* helper);
+
+/**
+ * @brief Creates a glyph atlas which has been allocated, with every cell empty
+ * @returns Lapis success code
+ * @param atlas The atlas to create
+ * @param helper The helper it was sized with
+ */
+LapisReturnCode lapis_create_glyph_atlas(LapisGlyphAtlas* atlas, LapisGlyphAtlasHelper* helper);
+
+/**
+ * @brief Draws a UTF-8 string as one batch of quads, rasterizing any glyphs the atlas doesn't hold yet. New
+ * lines go back to x and down a line
+ * @returns Lapis success code, out of memory if every cell holds a glyph drawn in a frame still in flight.
+ * Whatever fitted is still drawn
+ * @param target The target to draw into
+ * @param atlas The atlas to draw the glyphs from
+ * @param text Null terminated UTF-8 string
+ * @param x Left of the text in pixels, from the left of the target
+ * @param y Top of the first line in pixels, from the top of the target
+ * @param color An array of 3 floats
+ */
+LapisReturnCode lapis_ui_draw_text(LapisTarget* target, LapisGlyphAtlas* atlas, const char* text, int32_t x,
+                                   int32_t y, const float* color);
+
+/**
+ * @brief Finds the size of the box a string would be drawn in
+ * @returns Lapis success code, out of memory in the same cases as lapis_ui_draw_text
+ * @param atlas The atlas holding the glyphs, any missing are rasterized
+ * @param text Null terminated UTF-8 string
+ * @param width Filled in with the furthest any line moves the pen
+ * @param height Filled in with the line height times the number of lines
+ */
+LapisReturnCode lapis_ui_measure_text(LapisGlyphAtlas* atlas, const char* text, uint32_t* width,
+                                      uint32_t* height);
+
+/**
+ * @brief Ends the atlas's frame. Call it once per frame after the targets drawn into have been scheduled and
+ * their windows swapped. The glyphs drawn in it can be replaced once the helper's frames in flight have ended
+ * @returns Lapis success code
+ * @param atlas The atlas
+ */
+LapisReturnCode lapis_ui_glyph_atlas_end_frame(LapisGlyphAtlas* atlas);
+
+// Fetch how well the atlas has been caching
+LapisReturnCode lapis_ui_glyph_atlas_get_stats(LapisGlyphAtlas* atlas, LapisGlyphAtlasStats* stats);
+
+/**
+ * Widgets are added between lapis_ui_begin and lapis_ui_end, which builds them into a flat list of quads
+ * clipped on the cpu and drawn in as few batches as the order allows. Every widget is given an id which stays
+ * the same across frames, and its inputs are hashed. When a widget's id and hash match the previous frame its
+ * quads are copied from there rather than built again, so a UI which doesn't change costs little more than
+ * the draws themselves
+ */
+
+// Widgets and the draw list they're built into, everything lives in the UI's cpu memory
+typedef LapisStructure LapisUi;
+
+typedef struct LapisUiHelper {
+    // Atlas labels are drawn from, can be null if there aren't any labels
+    LapisGlyphAtlas* atlas;
+
+    // Most widgets in a frame, 0 for 256
+    uint32_t widget_capacity;
+
+    // Most quads in a frame, 0 for 4096. Panels take a quad for every 64x64 pixels and labels one per glyph
+    uint32_t quad_capacity;
+} LapisUiHelper;
+
+// What the last frame to end cost
+typedef struct LapisUiStats {
+    uint32_t widgets;  // Widgets added
+    uint32_t reused;   // Widgets whose quads were copied from the frame before
+    uint32_t quads;    // Quads drawn
+    uint32_t draws;    // Batches the quads were drawn in
+} LapisUiStats;
+
+// Fetch the size of a UI
+LapisReturnCode lapis_size_ui(LapisSize* size, LapisUiHelper* helper);
+
+/**
+ * @brief Creates a UI which has been allocated, with nothing to reuse in its first frame
+ * @returns Lapis success code
+ * @param ui The UI to create
+ * @param helper The helper it was sized with
+ */
+LapisReturnCode lapis_create_ui(LapisUi* ui, LapisUiHelper* helper);
+
+// Starts a new frame of widgets with nothing clipped
+LapisReturnCode lapis_ui_begin(LapisUi* ui);
+
+/**
+ * @brief Clips the widgets added after it to a rectangle, inside of any clip already pushed
+ * @returns Lapis success code, out of memory if 16 clips are already pushed
+ * @param ui The UI
+ * @param rect The rectangle in pixels, from the top left of the target
+ */
+LapisReturnCode lapis_ui_push_clip(LapisUi* ui, const LapisRect* rect);
+
+// Goes back to the clip before the last one pushed
+LapisReturnCode lapis_ui_pop_clip(LapisUi* ui);
+
+/**
+ * @brief Adds a panel, a rectangle filled with a single color
+ * @returns Lapis success code, out of memory if there isn't room for the widget or its quads
+ * @param ui The UI
+ * @param id Identifies the widget from one frame to the next
+ * @param rect The rectangle in pixels, from the top left of the target
+ * @param color An array of 3 floats
+ */
+LapisReturnCode lapis_ui_panel(LapisUi* ui, uint32_t id, const LapisRect* rect, const float* color);
+
+/**
+ * @brief Adds a label, a string drawn from the UI's atlas in the same way as lapis_ui_draw_text
+ * @returns Lapis success code, out of memory if there isn't room for the widget or its quads or the atlas
+ * couldn't fit a glyph
+ * @param ui The UI
+ * @param id Identifies the widget from one frame to the next
+ * @param text Null terminated UTF-8 string
+ * @param x Left of the text in pixels, from the left of the target
+ * @param y Top of the first line in pixels, from the top of the target
+ * @param color An array of 3 floats
+ */
+LapisReturnCode lapis_ui_label(LapisUi* ui, uint32_t id, const char* text, int32_t x, int32_t y,
+                               const float* color);
+
+/**
+ * @brief Ends the frame and draws its widgets in the order they were added. Neighbouring widgets with the
+ * same color and texture are drawn together
+ * @returns Lapis success code
+ * @param ui The UI
+ * @param target The target to draw into
+ */
+LapisReturnCode lapis_ui_end(LapisUi* ui, LapisTarget* target);
+
+// Fetch what the last frame to end cost
+LapisReturnCode lapis_ui_get_stats(LapisUi* ui, LapisUiStats* stats);
 
 #endif  // !__LAPIS_UI_HEADER_H__
@@ -22,8 +22,82 @@ typedef LapisStructure LapisWindow;
 typedef struct LapisWindowHelper {
     uint32_t width;
     uint32_t height;
+
+    // Headless windows have no display to wait on, so swaps are paced by a virtual vsync running at this
+    // many Hz. 0 lets swaps return as fast as frames are made
+    uint32_t refresh_rate;
+
+    // Title of the window. Headless windows publish their framebuffer in posix shared memory under this
+    // name (starting with a /), null keeps it in an anonymous memfd only reachable through the native handle
+    const char* name;
+
+    // Frames which can be in flight at once, counting the one being recorded. 0 or 1 makes every swap run
+    // the frame's deferred work and present it before returning. More hands that to a present thread, so the
+    // next frame is recorded while the last is still being rasterized and waiting for vsync. Each extra frame
+    // evens out uneven frame times but puts the screen another frame behind, up to LAPIS_MAX_FRAMES_IN_FLIGHT
+    uint32_t frames_in_flight;
+
+    // LapisPixelFormat of the framebuffer, 0 for RGBA8. YUYV windows need an even width
+    uint32_t format;
 } LapisWindowHelper;
 
+// Most frames a window can have in flight
+#define LAPIS_MAX_FRAMES_IN_FLIGHT (4)
+
+// A rectangle of pixels
+typedef struct LapisRect {
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+} LapisRect;
+
+// Most rectangles a window or target keeps track of as changed in a frame, any more are merged together
+#define LAPIS_MAX_DIRTY_RECTS (16)
+
+// The memory a window wants the next frame rendered into
+typedef struct LapisFramebuffer {
+    void* pixels;
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;  // Distance between rows in pixels
+    uint32_t format;  // LapisPixelFormat of the pixels
+} LapisFramebuffer;
+
+/**
+ * Headless shared memory
+ * Headless windows present by flipping between buffers inside a shared memory region, so a viewer or encoder
+ * in another process can map the frames without them ever being copied. The region starts with this header
+ * and the buffers follow at buffer_offset, each buffer_size bytes apart.
+ *
+ * To read a frame, read frame, then front, copy or encode buffer front, then read frame again. If frame
+ * changed the buffer might have been reused while reading it. Only the damage rectangle changed since the
+ * previous frame, frames are only presented when something changed.
+ */
+#define LAPIS_SHARED_MAGIC (0x5350414Cu)  // "LAPS"
+#define LAPIS_SHARED_VERSION (2)
+
+typedef struct LapisSharedHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;  // Distance between rows in bytes
+    uint32_t format;  // LapisPixelFormat, 0 for packed RGBA8 with red in the lowest byte
+    uint32_t buffer_count;
+    uint32_t buffer_offset;
+    uint32_t buffer_size;
+    uint32_t front;            // Buffer which is currently on screen
+    uint64_t frame;            // Number of frames presented so far
+    uint64_t present_time;     // Virtual vsync time the front buffer was presented at in nanoseconds
+    uint32_t close_requested;  // Viewers can set this to non zero to ask the application to close
+    LapisRect damage;          // Bounds of everything which changed from the previous frame
+    uint32_t reserved[13];     // Pads the header out to 128 bytes
+} LapisSharedHeader;
+
+// Work which a window runs just before it presents, see lapis_window_defer
+typedef void (*LapisSwapFunc)(void* user);
+
 // Fetch the size of the render target
 LapisReturnCode lapis_size_window(LapisSize* size, LapisWindowHelper* helper);
 
@@ -36,28 +110,201 @@ LapisReturnCode lapis_size_window(LapisSize* size, LapisWindowHelper* helper);
  */
 LapisReturnCode lapis_create_window(LapisContext* context, LapisWindow* window, LapisWindowHelper* helper);
 
+/**
+ * @brief Destroys a window, releasing anything the backend got from the operating system for it. The window's
+ * memory can be freed afterwards
+ * @returns Lapis success code
+ * @param window Pointer to the window to destroy
+ */
+LapisReturnCode lapis_destroy_window(LapisWindow* window);
+
 /**
  * Window manipulation functions
  */
 
 /**
- * @brief Poll the window for what events it has recieved
+ * @brief Fetches the memory the window wants the next frame rendered into. This changes every swap, anything
+ * drawn into it has to be reported with lapis_window_damage to be presented
+ * @returns Lapis success code, unsupported when the backend doesn't render on the cpu
+ * @param window Pointer to the window to fetch the framebuffer of
+ * @param framebuffer Pointer to the framebuffer struct to fill in
+ */
+LapisReturnCode lapis_window_get_framebuffer(LapisWindow* window, LapisFramebuffer* framebuffer);
+
+// Fetch the context the window was created with
+LapisContext* lapis_window_context(LapisWindow* window);
+
+// The backend's own handle for the window. A HWND on win32, and the shared memory file descriptor on
+// headless linux
+intptr_t lapis_window_native_handle(LapisWindow* window);
+
+/**
+ * @brief Poll the window for what events it has recieved. Events pushed since the last poll become visible
+ * to lapis_window_next_event, so each frame handles the events which arrived before it started
  * @returns Lapis Success Code
  * @param window Pointer to the window to pool events for
  */
 LapisReturnCode lapis_window_poll_events(LapisWindow* window);
 
 /**
- * @brief Swaps the onscreen buffer for the offscreen one, this is a thread blocking function until Vsync
- * happens
+ * Input events
+ * Every window has a fixed size queue of input events kept in its cpu memory. One thread pushes events into
+ * it, usually the backend's own input thread, and one thread takes them out. Neither ever blocks or
+ * allocates, when the queue is full new events are dropped and counted instead. Headless windows have no
+ * input devices, so whatever is driving them, like a test harness or a remote viewer, pushes the events
+ */
+typedef enum LapisEventType {
+    e_lapis_event_key_down,      // code is the key
+    e_lapis_event_key_up,        // code is the key
+    e_lapis_event_pointer_move,  // x and y are the pointer's position in window pixels
+    e_lapis_event_button_down,   // code is the button, x and y where the pointer was
+    e_lapis_event_button_up,     // code is the button, x and y where the pointer was
+    e_lapis_event_scroll,        // x and y are how far to scroll
+} LapisEventType;
+
+typedef struct LapisEvent {
+    uint32_t type;
+    uint32_t code;
+    int32_t x;
+    int32_t y;
+    uint64_t time;  // When the event happened on the monotonic clock in nanoseconds
+} LapisEvent;
+
+/**
+ * @brief Adds an event to the back of the window's queue. Only one thread can push events into a window,
+ * it can be a different thread than the one taking them out
+ * @returns Lapis success code, out of memory when the queue was full and the event was dropped
+ * @param window The window the event happened to
+ * @param event The event, a time of 0 is filled in with the time it was pushed
+ */
+LapisReturnCode lapis_window_push_event(LapisWindow* window, const LapisEvent* event);
+
+/**
+ * @brief Takes the next event visible since the last poll off of the window's queue. Runs of pointer moves
+ * come out as the last one, and runs of scrolls as one scroll by their total
+ * @returns 1 if event was filled in, 0 once there are no more events
+ * @param window The window to take an event from
+ * @param event Filled in with the event
+ */
+uint8_t lapis_window_next_event(LapisWindow* window, LapisEvent* event);
+
+// Number of events which have been dropped because the window's queue was full
+uint32_t lapis_window_event_overflow(LapisWindow* window);
+
+/**
+ * @brief Tells the window which parts of the back buffer are about to be drawn. The first call after a swap
+ * brings the rest of the back buffer up to date with the frame on screen, so only what changed ever has to be
+ * drawn. Rectangles are clipped to the window
+ * @returns Lapis success code
+ * @param window The window being drawn into
+ * @param rects Array of the rectangles about to change
+ * @param count Number of rectangles
+ * @param covered Non zero promises every pixel inside of the rectangles is about to be written, like a clear.
+ * The back buffer is only left as it is when a covered rectangle spans the whole window. Bounds of draws
+ * aren't covered, the pixels between what was drawn keep what was there
+ */
+LapisReturnCode lapis_window_damage(LapisWindow* window, const LapisRect* rects, uint32_t count,
+                                    uint32_t covered);
+
+/**
+ * @brief Swaps the onscreen buffer for the offscreen one. With one frame in flight this is a thread blocking
+ * function until Vsync happens. With more the frame is handed to the present thread, and the swap only blocks
+ * while the present thread already has every other frame in flight. Nothing is presented when nothing was
+ * damaged since the last swap, the frame on screen stays
  * @returns Lapis success code
  * @param window The window to swap inscreen buffers for
  */
 LapisReturnCode lapis_window_swap(LapisWindow* window);
 
+/**
+ * @brief Runs func once, the next time the window swaps just before the frame is presented. This is how the
+ * targets drawing into a window get their recorded work done as late as possible, calls run in the order they
+ * were deferred. With more than one frame in flight they run on the present thread. When the window can't
+ * hold any more, func runs straight away once the frames in flight are done
+ * @returns Lapis success code
+ * @param window The window whose next swap should run func
+ * @param func The function to run
+ * @param user Pointer passed to func
+ */
+LapisReturnCode lapis_window_defer(LapisWindow* window, LapisSwapFunc func, void* user);
+
+/**
+ * Frames in flight
+ * Every frame has a fence, which is reached once the swap ending the frame has run its deferred work and
+ * presented it. Anything a frame's deferred work reads, like meshes or glyph atlases drawn by targets which
+ * record, has to stay unchanged until its fence is reached. Fetching the framebuffer or damaging the window
+ * from anywhere but the deferred work waits for every frame in flight first, so drawing straight into a
+ * window works with any number of frames in flight but stops them overlapping
+ */
+
+// Number of frames the window can have in flight
+uint32_t lapis_window_frames_in_flight(LapisWindow* window);
+
+// Fence of the frame being recorded, fences count up from 1 with every swap
+uint64_t lapis_window_get_fence(LapisWindow* window);
+
+// Checks if a frame's fence has been reached, returns 1 if it has and 0 if it's still in flight
+uint8_t lapis_window_fence_reached(LapisWindow* window, uint64_t fence);
+
+/**
+ * @brief Blocks until a frame's fence has been reached
+ * @returns Lapis success code, invalid argument for the frame being recorded or later which would never be
+ * reached
+ * @param window The window
+ * @param fence Fence of the frame to wait for
+ */
+LapisReturnCode lapis_window_wait_fence(LapisWindow* window, uint64_t fence);
+
+/**
+ * Frame capture
+ * A window can stream every frame it presents to a file descriptor, so frames can be checked or recorded
+ * with no display. Presenting only copies the frame into one of two staging buffers, a writer thread
+ * converts it and writes it out. Each swap captures the frame on screen after it, even when nothing changed,
+ * so the stream has one frame per swap
+ */
+typedef enum LapisCaptureFormat {
+    e_lapis_capture_ppm,  // A binary PPM image per frame one after another, which image2pipe readers take
+    e_lapis_capture_y4m,  // A YUV4MPEG2 stream in 4:2:0 with full range BT.601 colors
+} LapisCaptureFormat;
+
+typedef struct LapisCaptureHelper {
+    int fd;  // Where to write the frames, still owned by the caller
+    LapisCaptureFormat format;
+
+    // Frame rate written into the Y4M header, 0 for the window's refresh rate or 60 when it has none
+    uint32_t frame_rate;
+
+    // When the writer has fallen two frames behind, non zero makes presenting wait for it rather than drop
+    // the frame. Tests want every frame, recordings want the render loop never to stall
+    uint32_t lossless;
+} LapisCaptureHelper;
+
+typedef struct LapisCaptureStats {
+    uint64_t written;  // Frames written to the file descriptor
+    uint64_t dropped;  // Frames skipped because both staging buffers were still waiting to be written
+    uint32_t failed;   // Non zero once a write has failed, every frame after is dropped
+} LapisCaptureStats;
+
+/**
+ * @brief Starts capturing the frames the window presents, starting with the next swap
+ * @returns Lapis success code, unsupported on backends which can't read their frames back
+ * @param window The window to capture
+ * @param helper Where and how to write the frames
+ */
+LapisReturnCode lapis_window_start_capture(LapisWindow* window, const LapisCaptureHelper* helper);
+
+/**
+ * @brief Stops capturing once every frame swapped so far has been written. Destroying the window stops
+ * capturing too
+ * @returns Lapis success code
+ * @param window The window being captured
+ * @param stats Filled in with how the capture went, can be null
+ */
+LapisReturnCode lapis_window_stop_capture(LapisWindow* window, LapisCaptureStats* stats);
+
 /**
  * @brief Checks if the lapis window has recieved a shut down event
- * @returns 0 if the window should stay open, 1 if it should close
+ * @returns 1 if the window should stay open, 0 if it should close
  * @param window Pointer to the window to check the status of close
  */
 uint8_t lapis_window_stay_open(LapisWindow* window);
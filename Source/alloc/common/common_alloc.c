@@ -1,8 +1,88 @@
 #include "common_alloc.h"
+#include <stdlib.h>
 
-LapisReturnCode lapis_allocate(LapisStructure* object, LapisType type) { return e_lapis_return_success; }
+#include "lapis/lapis_gfx.h"
+
+void* alloc_aligned_malloc(size_t size, size_t align)
+{
+    // Over allocate, then keep the pointer malloc gave back just in front of the aligned memory
+    uint8_t* raw = (uint8_t*)malloc(size + align + sizeof(void*));
+    uintptr_t aligned;
+    if (!raw) return NULL;
+    aligned = ((uintptr_t)raw + sizeof(void*) + align - 1) & ~(uintptr_t)(align - 1);
+    ((void**)aligned)[-1] = raw;
+    return (void*)aligned;
+}
+
+void alloc_aligned_free(void* memory)
+{
+    if (memory) free(((void**)memory)[-1]);
+}
+
+// Asks the right library how large an object is going to be
+static LapisReturnCode alloc_size_of(LapisSize* size, void* helper, LapisType type)
+{
+    switch (type) {
+        case e_lapis_type_context:
+            return lapis_size_context(size);
+        case e_lapis_type_window:
+            if (!helper) return e_lapis_return_invalid_argument;
+            return lapis_size_window(size, (LapisWindowHelper*)helper);
+        case e_lapis_type_target:
+            if (!helper) return e_lapis_return_invalid_argument;
+            return lapis_size_target(size, (LapisTargetHelper*)helper);
+        case e_lapis_type_mesh:
+            if (!helper) return e_lapis_return_invalid_argument;
+            return lapis_size_mesh(size, (LapisMeshHelper*)helper);
+    }
+    return e_lapis_return_invalid_argument;
+}
+
+static LapisReturnCode alloc_allocate_sized(LapisStructure* object, const LapisSize* size)
+{
+    LapisPool* pool = alloc_find_pool(size);
+    LapisArena* arena;
+
+    // A full pool falls back onto the arena rather than failing
+    if (pool && lapis_allocate_from_pool(pool, object) == e_lapis_return_success) {
+        return e_lapis_return_success;
+    }
+    arena = alloc_current_arena();
+    if (!arena) return e_lapis_return_out_of_memory;
+    return alloc_arena_allocate(arena, size, object);
+}
+
+LapisReturnCode lapis_allocate(LapisStructure* object, LapisType type)
+{
+    return lapis_allocate_dynamic(object, NULL, type);
+}
 
 LapisReturnCode lapis_allocate_dynamic(LapisStructure* object, void* helper, LapisType type)
 {
-    return e_lapis_return_success;
+    LapisSize size;
+    LapisReturnCode code;
+    if (!object) return e_lapis_return_invalid_argument;
+
+    code = alloc_size_of(&size, helper, type);
+    if (code != e_lapis_return_success) return code;
+    return alloc_allocate_sized(object, &size);
+}
+
+LapisReturnCode lapis_free(LapisStructure* object)
+{
+    AllocHeader* header;
+    LapisReturnCode code;
+    if (!object || !object->cpu_mem) return e_lapis_return_invalid_argument;
+
+    header = (AllocHeader*)((uint8_t*)object->cpu_mem - ALLOC_CPU_ALIGN);
+    if (header->magic != ALLOC_MAGIC) return e_lapis_return_invalid_argument;
+
+    if (header->kind == e_alloc_kind_pool) {
+        code = alloc_pool_free((LapisPool*)header->owner, header, object);
+    } else {
+        code = alloc_arena_free((LapisArena*)header->owner, header, object);
+    }
+    object->cpu_mem = NULL;
+    object->gpu_mem = NULL;
+    return code;
 }
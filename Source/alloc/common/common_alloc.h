@@ -2,4 +2,99 @@
 #define __LAPIS_ALLOC_COMMON_INTERNAL_HEADER_H__ (1)
 #include "lapis/lapis_alloc.h"
 
+// Alignment of every cpu allocation, a cache line so objects never share one
+#define ALLOC_CPU_ALIGN (64)
+
+// How much memory the default arena grabs at a time
+#define ALLOC_DEFAULT_CPU_CAPACITY (1024 * 1024)
+#define ALLOC_DEFAULT_GPU_CAPACITY (16 * 1024 * 1024)
+
+// Longest name kept for an arena or pool
+#define ALLOC_MAX_NAME (32)
+
+// Marks memory which was handed out by lapis alloc
+#define ALLOC_MAGIC (0x4C415053u)
+
+// Marks the end of a pool's free list
+#define ALLOC_POOL_NONE (0xFFFFFFFFu)
+
+typedef enum AllocKind {
+    e_alloc_kind_arena,
+    e_alloc_kind_pool,
+} AllocKind;
+
+// Sits in the cache line before every object's cpu memory so lapis_free knows where the object came from
+typedef struct AllocHeader {
+    uint32_t magic;
+    uint32_t kind;
+    void* owner;  // The arena or pool
+
+    // Arena, how far the cpu and gpu blocks were filled before and after this allocation
+    size_t cpu_before;
+    size_t cpu_after;
+    size_t gpu_before;
+    size_t gpu_after;
+
+    // Pool, index of the next free block while this block is free
+    uint32_t next_free;
+} AllocHeader;
+
+// A piece of memory grabbed from the system which an arena fills up front to back
+typedef struct AllocBlock {
+    struct AllocBlock* next;
+    uint8_t* memory;
+    size_t size;
+    size_t used;
+} AllocBlock;
+
+// Chain of blocks for either cpu or gpu memory
+typedef struct AllocChain {
+    AllocBlock* first;
+    AllocBlock* current;
+    size_t capacity;
+    int gpu;
+} AllocChain;
+
+struct LapisArena {
+    struct LapisArena* next;
+    char name[ALLOC_MAX_NAME];
+    AllocChain cpu;
+    AllocChain gpu;
+};
+
+struct LapisPool {
+    struct LapisPool* next;
+    char name[ALLOC_MAX_NAME];
+    LapisSize size;
+    size_t cpu_stride;
+    size_t gpu_stride;
+    uint8_t* cpu;
+    uint8_t* gpu;
+    uint32_t capacity;
+    uint32_t free_head;
+};
+
+// Allocates memory aligned to any power of 2 from the c library, which is enough for most backends
+void* alloc_aligned_malloc(size_t size, size_t align);
+void alloc_aligned_free(void* memory);
+
+// Each backend says where gpu visible memory comes from
+void* alloc_backend_gpu_allocate(size_t size, size_t align);
+void alloc_backend_gpu_free(void* memory);
+
+// Lets pools claim allocations of their size before they reach the arena
+LapisPool* alloc_find_pool(const LapisSize* size);
+
+// Frees an object that came from a pool
+LapisReturnCode alloc_pool_free(LapisPool* pool, AllocHeader* header, LapisStructure* object);
+
+// Allocates an object from an arena
+LapisReturnCode alloc_arena_allocate(LapisArena* arena, const LapisSize* size, LapisStructure* object);
+
+// Frees an object from an arena, only gets the memory back when it was the last allocation
+LapisReturnCode alloc_arena_free(LapisArena* arena, AllocHeader* header, LapisStructure* object);
+
+// The arena lapis_allocate uses, creating the default one if needed
+LapisArena* alloc_current_arena();
+
 #endif  // !__LAPIS_ALLOC_COMMON_INTERNAL_HEADER_H__
@@ -0,0 +1,242 @@
+#include "common_alloc.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Every arena that has been created, the one lapis_allocate uses and the one used when none has been set
+static LapisArena* alloc_arenas = NULL;
+static LapisArena* alloc_current = NULL;
+static LapisArena* alloc_default = NULL;
+
+// Gpu blocks start on a page so most alignments don't need any padding
+#define ALLOC_GPU_BLOCK_ALIGN (4096)
+
+static AllocBlock* alloc_block_create(const AllocChain* chain, size_t size)
+{
+    AllocBlock* block = (AllocBlock*)malloc(sizeof(AllocBlock));
+    if (!block) return NULL;
+    block->memory = chain->gpu ? (uint8_t*)alloc_backend_gpu_allocate(size, ALLOC_GPU_BLOCK_ALIGN)
+                               : (uint8_t*)alloc_aligned_malloc(size, ALLOC_CPU_ALIGN);
+    if (!block->memory) {
+        free(block);
+        return NULL;
+    }
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+static void alloc_chain_destroy(AllocChain* chain)
+{
+    AllocBlock* block = chain->first;
+    while (block) {
+        AllocBlock* next = block->next;
+        if (chain->gpu) {
+            alloc_backend_gpu_free(block->memory);
+        } else {
+            alloc_aligned_free(block->memory);
+        }
+        free(block);
+        block = next;
+    }
+    chain->first = NULL;
+    chain->current = NULL;
+}
+
+/**
+ * @brief Takes memory from the end of the chain's current block, moving onto blocks kept from before the last
+ * reset and finally grabbing a new block from the system
+ * @returns Pointer to the memory or null if the system is out of memory
+ * @param chain Chain to allocate from
+ * @param size Bytes to allocate
+ * @param align Power of 2 alignment of the memory
+ * @param before Filled with how far the block was used before this allocation
+ * @param after Filled with how far the block was used after this allocation
+ */
+static uint8_t* alloc_chain_take(AllocChain* chain, size_t size, size_t align, size_t* before, size_t* after)
+{
+    AllocBlock* block = chain->current;
+    AllocBlock* last = NULL;
+    size_t start;
+
+    for (; block; block = block->next) {
+        uintptr_t base = (uintptr_t)block->memory;
+        start = (size_t)(((base + block->used + align - 1) & ~(uintptr_t)(align - 1)) - base);
+        if (start + size <= block->size) break;
+        last = block;
+    }
+
+    if (!block) {
+        size_t grab = size + align > chain->capacity ? size + align : chain->capacity;
+        block = alloc_block_create(chain, grab);
+        if (!block) return NULL;
+        if (last) {
+            last->next = block;
+        } else {
+            chain->first = block;
+        }
+        start = (size_t)((((uintptr_t)block->memory + align - 1) & ~(uintptr_t)(align - 1)) -
+                         (uintptr_t)block->memory);
+    }
+
+    chain->current = block;
+    *before = block->used;
+    block->used = start + size;
+    *after = block->used;
+    return block->memory + start;
+}
+
+// Checks whether a pointer came from the block a chain is currently filling
+static int alloc_chain_in_current(const AllocChain* chain, const void* memory)
+{
+    const uint8_t* p = (const uint8_t*)memory;
+    return chain->current && p >= chain->current->memory && p < chain->current->memory + chain->current->size;
+}
+
+LapisReturnCode alloc_arena_allocate(LapisArena* arena, const LapisSize* size, LapisStructure* object)
+{
+    AllocHeader* header;
+    size_t cpu_before, cpu_after, gpu_before = 0, gpu_after = 0;
+    uint8_t* cpu;
+    uint8_t* gpu = NULL;
+
+    // The header gets a whole cache line to itself so the object stays aligned
+    cpu = alloc_chain_take(&arena->cpu, ALLOC_CPU_ALIGN + size->cpu_size, ALLOC_CPU_ALIGN, &cpu_before,
+                           &cpu_after);
+    if (!cpu) return e_lapis_return_out_of_memory;
+    if (size->gpu_size) {
+        gpu = alloc_chain_take(&arena->gpu, size->gpu_size, size->gpu_align ? size->gpu_align : 1,
+                               &gpu_before, &gpu_after);
+        if (!gpu) {
+            arena->cpu.current->used = cpu_before;
+            return e_lapis_return_out_of_memory;
+        }
+    }
+
+    header = (AllocHeader*)cpu;
+    header->magic = ALLOC_MAGIC;
+    header->kind = e_alloc_kind_arena;
+    header->owner = arena;
+    header->cpu_before = cpu_before;
+    header->cpu_after = cpu_after;
+    header->gpu_before = gpu_before;
+    header->gpu_after = gpu_after;
+    object->cpu_mem = cpu + ALLOC_CPU_ALIGN;
+    object->gpu_mem = gpu;
+    return e_lapis_return_success;
+}
+
+LapisReturnCode alloc_arena_free(LapisArena* arena, AllocHeader* header, LapisStructure* object)
+{
+    int cpu_last = alloc_chain_in_current(&arena->cpu, header) &&
+                   arena->cpu.current->used == header->cpu_after;
+    int gpu_last = !object->gpu_mem ||
+                   (alloc_chain_in_current(&arena->gpu, object->gpu_mem) &&
+                    arena->gpu.current->used == header->gpu_after);
+
+    // Only the most recent allocation can be handed back, the rest waits for the arena to be reset
+    header->magic = 0;
+    if (cpu_last && gpu_last) {
+        arena->cpu.current->used = header->cpu_before;
+        if (object->gpu_mem) arena->gpu.current->used = header->gpu_before;
+    }
+    return e_lapis_return_success;
+}
+
+LapisReturnCode lapis_create_arena(LapisArena** arena, const char* name, size_t cpu_capacity,
+                                   size_t gpu_capacity)
+{
+    LapisArena* created;
+    if (!arena) return e_lapis_return_invalid_argument;
+
+    created = (LapisArena*)malloc(sizeof(LapisArena));
+    if (!created) return e_lapis_return_out_of_memory;
+    memset(created, 0, sizeof(LapisArena));
+    if (name) strncpy(created->name, name, ALLOC_MAX_NAME - 1);
+    created->cpu.capacity = cpu_capacity;
+    created->gpu.capacity = gpu_capacity;
+    created->gpu.gpu = 1;
+
+    // Reserve the first blocks now so the first frame doesn't pay for them
+    if (cpu_capacity) {
+        created->cpu.first = created->cpu.current = alloc_block_create(&created->cpu, cpu_capacity);
+    }
+    if (gpu_capacity) {
+        created->gpu.first = created->gpu.current = alloc_block_create(&created->gpu, gpu_capacity);
+    }
+    if ((cpu_capacity && !created->cpu.first) || (gpu_capacity && !created->gpu.first)) {
+        alloc_chain_destroy(&created->cpu);
+        alloc_chain_destroy(&created->gpu);
+        free(created);
+        return e_lapis_return_out_of_memory;
+    }
+
+    created->next = alloc_arenas;
+    alloc_arenas = created;
+    *arena = created;
+    return e_lapis_return_success;
+}
+
+LapisArena* lapis_find_arena(const char* name)
+{
+    LapisArena* arena;
+    if (!name) return NULL;
+    for (arena = alloc_arenas; arena; arena = arena->next) {
+        if (strncmp(arena->name, name, ALLOC_MAX_NAME - 1) == 0) return arena;
+    }
+    return NULL;
+}
+
+LapisReturnCode lapis_set_arena(LapisArena* arena)
+{
+    alloc_current = arena;
+    return e_lapis_return_success;
+}
+
+LapisArena* alloc_current_arena()
+{
+    if (alloc_current) return alloc_current;
+    if (!alloc_default &&
+        lapis_create_arena(&alloc_default, "lapis_default", ALLOC_DEFAULT_CPU_CAPACITY,
+                           ALLOC_DEFAULT_GPU_CAPACITY) != e_lapis_return_success) {
+        return NULL;
+    }
+    return alloc_default;
+}
+
+LapisReturnCode lapis_arena_reset(LapisArena* arena)
+{
+    AllocBlock* block;
+    if (!arena) return e_lapis_return_invalid_argument;
+
+    // Blocks are kept so the next frame fills the same memory again
+    for (block = arena->cpu.first; block; block = block->next) {
+        block->used = 0;
+    }
+    for (block = arena->gpu.first; block; block = block->next) {
+        block->used = 0;
+    }
+    arena->cpu.current = arena->cpu.first;
+    arena->gpu.current = arena->gpu.first;
+    return e_lapis_return_success;
+}
+
+LapisReturnCode lapis_destroy_arena(LapisArena* arena)
+{
+    LapisArena** link;
+    if (!arena) return e_lapis_return_invalid_argument;
+
+    for (link = &alloc_arenas; *link; link = &(*link)->next) {
+        if (*link == arena) {
+            *link = arena->next;
+            break;
+        }
+    }
+    if (alloc_current == arena) alloc_current = NULL;
+    if (alloc_default == arena) alloc_default = NULL;
+
+    alloc_chain_destroy(&arena->cpu);
+    alloc_chain_destroy(&arena->gpu);
+    free(arena);
+    return e_lapis_return_success;
+}
@@ -0,0 +1,108 @@
+#include "common_alloc.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Every pool that has been created
+static LapisPool* alloc_pools = NULL;
+
+static size_t alloc_round_up(size_t value, size_t align) { return (value + align - 1) & ~(align - 1); }
+
+LapisReturnCode lapis_create_pool(LapisPool** pool, const char* name, LapisSize* size, uint32_t capacity)
+{
+    LapisPool* created;
+    size_t gpu_align;
+    uint32_t i;
+    if (!pool || !size || !capacity || capacity == ALLOC_POOL_NONE) return e_lapis_return_invalid_argument;
+
+    created = (LapisPool*)malloc(sizeof(LapisPool));
+    if (!created) return e_lapis_return_out_of_memory;
+    memset(created, 0, sizeof(LapisPool));
+    if (name) strncpy(created->name, name, ALLOC_MAX_NAME - 1);
+    created->size = *size;
+    created->capacity = capacity;
+
+    // Every block keeps its header in the cache line in front of it, and the strides keep every block as
+    // aligned as the first
+    gpu_align = size->gpu_align > ALLOC_CPU_ALIGN ? size->gpu_align : ALLOC_CPU_ALIGN;
+    created->cpu_stride = alloc_round_up(ALLOC_CPU_ALIGN + size->cpu_size, ALLOC_CPU_ALIGN);
+    created->gpu_stride = alloc_round_up(size->gpu_size, gpu_align);
+    created->cpu = (uint8_t*)alloc_aligned_malloc(created->cpu_stride * capacity, ALLOC_CPU_ALIGN);
+    if (created->gpu_stride) {
+        created->gpu = (uint8_t*)alloc_backend_gpu_allocate(created->gpu_stride * capacity, gpu_align);
+    }
+    if (!created->cpu || (created->gpu_stride && !created->gpu)) {
+        alloc_aligned_free(created->cpu);
+        alloc_backend_gpu_free(created->gpu);
+        free(created);
+        return e_lapis_return_out_of_memory;
+    }
+
+    for (i = 0; i < capacity; i++) {
+        AllocHeader* header = (AllocHeader*)(created->cpu + created->cpu_stride * i);
+        header->magic = 0;
+        header->next_free = i + 1 < capacity ? i + 1 : ALLOC_POOL_NONE;
+    }
+    created->free_head = 0;
+
+    created->next = alloc_pools;
+    alloc_pools = created;
+    *pool = created;
+    return e_lapis_return_success;
+}
+
+LapisReturnCode lapis_allocate_from_pool(LapisPool* pool, LapisStructure* object)
+{
+    AllocHeader* header;
+    uint32_t index;
+    if (!pool || !object) return e_lapis_return_invalid_argument;
+    if (pool->free_head == ALLOC_POOL_NONE) return e_lapis_return_out_of_memory;
+
+    index = pool->free_head;
+    header = (AllocHeader*)(pool->cpu + pool->cpu_stride * index);
+    pool->free_head = header->next_free;
+
+    header->magic = ALLOC_MAGIC;
+    header->kind = e_alloc_kind_pool;
+    header->owner = pool;
+    object->cpu_mem = (uint8_t*)header + ALLOC_CPU_ALIGN;
+    object->gpu_mem = pool->gpu ? pool->gpu + pool->gpu_stride * index : NULL;
+    return e_lapis_return_success;
+}
+
+LapisReturnCode alloc_pool_free(LapisPool* pool, AllocHeader* header, LapisStructure* object)
+{
+    uint32_t index = (uint32_t)(((uint8_t*)header - pool->cpu) / pool->cpu_stride);
+    header->magic = 0;
+    header->next_free = pool->free_head;
+    pool->free_head = index;
+    return e_lapis_return_success;
+}
+
+LapisPool* alloc_find_pool(const LapisSize* size)
+{
+    LapisPool* pool;
+    for (pool = alloc_pools; pool; pool = pool->next) {
+        if (pool->size.cpu_size == size->cpu_size && pool->size.gpu_size == size->gpu_size &&
+            pool->size.gpu_align == size->gpu_align && pool->free_head != ALLOC_POOL_NONE) {
+            return pool;
+        }
+    }
+    return NULL;
+}
+
+LapisReturnCode lapis_destroy_pool(LapisPool* pool)
+{
+    LapisPool** link;
+    if (!pool) return e_lapis_return_invalid_argument;
+
+    for (link = &alloc_pools; *link; link = &(*link)->next) {
+        if (*link == pool) {
+            *link = pool->next;
+            break;
+        }
+    }
+    alloc_aligned_free(pool->cpu);
+    alloc_backend_gpu_free(pool->gpu);
+    free(pool);
+    return e_lapis_return_success;
+}
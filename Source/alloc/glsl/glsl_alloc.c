@@ -1,3 +1,6 @@
 #include "common_alloc.h"
 
-LapisReturnCode lapis_free(LapisStructure* object) { return e_lapis_return_success; }
+// Gpu memory is staged in system memory and uploaded into buffers by the driver
+void* alloc_backend_gpu_allocate(size_t size, size_t align) { return alloc_aligned_malloc(size, align); }
+
+void alloc_backend_gpu_free(void* memory) { alloc_aligned_free(memory); }
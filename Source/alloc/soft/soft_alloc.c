@@ -0,0 +1,6 @@
+#include "common_alloc.h"
+
+// The cpu rasterizer renders into ordinary system memory
+void* alloc_backend_gpu_allocate(size_t size, size_t align) { return alloc_aligned_malloc(size, align); }
+
+void alloc_backend_gpu_free(void* memory) { alloc_aligned_free(memory); }
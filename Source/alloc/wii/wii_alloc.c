@@ -1,3 +1,11 @@
 #include "common_alloc.h"
 
-LapisReturnCode lapis_free(LapisStructure* object) { return e_lapis_return_success; }
+// Anything GX reads from has to be at least 32 byte aligned
+#define WII_GPU_ALIGN (32)
+
+void* alloc_backend_gpu_allocate(size_t size, size_t align)
+{
+    return alloc_aligned_malloc(size, align > WII_GPU_ALIGN ? align : WII_GPU_ALIGN);
+}
+
+void alloc_backend_gpu_free(void* memory) { alloc_aligned_free(memory); }
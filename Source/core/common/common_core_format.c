@@ -0,0 +1,210 @@
+#include <string.h>
+
+#include "common_core_format.h"
+
+// Pixels converted through rgba8 at a time when neither side is rgba8, even so YUYV pairs never straddle
+#define COMMON_CONVERT_CHUNK (256)
+
+/**
+ * YUYV pixels, the 16 bit formats are packed by common_core_format.h
+ */
+
+// Limited range BT.601 in 8 bit fixed point, offset so the shifts never see a negative number
+static uint32_t common_luma(uint32_t r, uint32_t g, uint32_t b)
+{
+    return ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+}
+
+static uint32_t common_chroma_u(uint32_t r, uint32_t g, uint32_t b)
+{
+    return (112 * b + 32896 - 38 * r - 74 * g) >> 8;
+}
+
+static uint32_t common_chroma_v(uint32_t r, uint32_t g, uint32_t b)
+{
+    return (112 * r + 32896 - 94 * g - 18 * b) >> 8;
+}
+
+// A pair of pixels shares the chroma of their average
+static uint32_t common_pack_yuyv(uint32_t p0, uint32_t p1)
+{
+    uint32_t r = ((p0 & 0xFF) + (p1 & 0xFF) + 1) >> 1;
+    uint32_t g = (((p0 >> 8) & 0xFF) + ((p1 >> 8) & 0xFF) + 1) >> 1;
+    uint32_t b = (((p0 >> 16) & 0xFF) + ((p1 >> 16) & 0xFF) + 1) >> 1;
+    uint32_t y0 = common_luma(p0 & 0xFF, (p0 >> 8) & 0xFF, (p0 >> 16) & 0xFF);
+    uint32_t y1 = common_luma(p1 & 0xFF, (p1 >> 8) & 0xFF, (p1 >> 16) & 0xFF);
+    return y0 | (common_chroma_u(r, g, b) << 8) | (y1 << 16) | (common_chroma_v(r, g, b) << 24);
+}
+
+static uint32_t common_clamp_channel(int32_t value)
+{
+    if (value < 0) return 0;
+    return value > 65535 ? 255 : (uint32_t)value >> 8;
+}
+
+static uint32_t common_unpack_yuv(int32_t y, int32_t u, int32_t v)
+{
+    int32_t c = 298 * (y - 16) + 128;
+    uint32_t r = common_clamp_channel(c + 409 * (v - 128));
+    uint32_t g = common_clamp_channel(c - 100 * (u - 128) - 208 * (v - 128));
+    uint32_t b = common_clamp_channel(c + 516 * (u - 128));
+    return 0xFF000000u | (b << 16) | (g << 8) | r;
+}
+
+/**
+ * Vector kernels, 8 pixels at a time
+ */
+
+#if defined(COMMON_FORMAT_SSE2)
+// Two YUYV pairs from 4 pixels, in lanes 0 and 2
+static __m128i common_yuyv_4(__m128i pixels)
+{
+    const __m128i byte = _mm_set1_epi32(0xFF);
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i offset = _mm_set1_epi32(32896);
+    __m128i r = _mm_and_si128(pixels, byte);
+    __m128i g = _mm_and_si128(_mm_srli_epi32(pixels, 8), byte);
+    __m128i b = _mm_and_si128(_mm_srli_epi32(pixels, 16), byte);
+    __m128i y, u, v, ar, ag, ab;
+
+    y = _mm_add_epi32(_mm_mullo_epi16(r, _mm_set1_epi32(66)), _mm_mullo_epi16(g, _mm_set1_epi32(129)));
+    y = _mm_add_epi32(y, _mm_add_epi32(_mm_mullo_epi16(b, _mm_set1_epi32(25)), _mm_set1_epi32(128)));
+    y = _mm_add_epi32(_mm_srli_epi32(y, 8), _mm_set1_epi32(16));
+
+    // Average each pair, the sums land in the even lanes
+    ar = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(r, _mm_srli_epi64(r, 32)), one), 1);
+    ag = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(g, _mm_srli_epi64(g, 32)), one), 1);
+    ab = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(b, _mm_srli_epi64(b, 32)), one), 1);
+    u = _mm_add_epi32(_mm_mullo_epi16(ab, _mm_set1_epi32(112)), offset);
+    u = _mm_sub_epi32(u, _mm_add_epi32(_mm_mullo_epi16(ar, _mm_set1_epi32(38)),
+                                       _mm_mullo_epi16(ag, _mm_set1_epi32(74))));
+    v = _mm_add_epi32(_mm_mullo_epi16(ar, _mm_set1_epi32(112)), offset);
+    v = _mm_sub_epi32(v, _mm_add_epi32(_mm_mullo_epi16(ag, _mm_set1_epi32(94)),
+                                       _mm_mullo_epi16(ab, _mm_set1_epi32(18))));
+    u = _mm_and_si128(_mm_srli_epi32(u, 8), byte);
+    v = _mm_and_si128(_mm_srli_epi32(v, 8), byte);
+
+    return _mm_or_si128(_mm_or_si128(y, _mm_slli_epi32(u, 8)),
+                        _mm_or_si128(_mm_slli_epi32(_mm_srli_epi64(y, 32), 16), _mm_slli_epi32(v, 24)));
+}
+
+// Every alpha in 8 pixels is at least 0xE0, so they all pack as RGB555
+static int common_opaque_8(__m128i lo, __m128i hi)
+{
+    __m128i alpha = _mm_set1_epi32((int)0xE0000000u);
+    __m128i min = _mm_min_epu8(_mm_and_si128(lo, alpha), _mm_and_si128(hi, alpha));
+    return (_mm_movemask_epi8(_mm_cmpeq_epi8(min, alpha)) & 0x8888) == 0x8888;
+}
+#endif
+
+/**
+ * Rows
+ */
+
+static void common_from_rgba8(void* dst, uint32_t format, const uint32_t* src, uint32_t width)
+{
+    uint16_t* out = (uint16_t*)dst;
+    uint32_t x = 0;
+#if defined(COMMON_FORMAT_SSE2)
+    __m128i lo, hi;
+    for (; x + 8 <= width; x += 8) {
+        lo = _mm_loadu_si128((const __m128i*)(src + x));
+        hi = _mm_loadu_si128((const __m128i*)(src + x + 4));
+        if (format == e_lapis_format_rgb565) {
+            _mm_storeu_si128((__m128i*)(out + x), common_pack16_8(common_rgb565_4(lo), common_rgb565_4(hi)));
+        } else if (format == e_lapis_format_rgb5a3 && common_opaque_8(lo, hi)) {
+            _mm_storeu_si128((__m128i*)(out + x), common_pack16_8(common_rgb555_4(lo), common_rgb555_4(hi)));
+        } else if (format == e_lapis_format_yuyv) {
+            lo = _mm_shuffle_epi32(common_yuyv_4(lo), _MM_SHUFFLE(3, 1, 2, 0));
+            hi = _mm_shuffle_epi32(common_yuyv_4(hi), _MM_SHUFFLE(3, 1, 2, 0));
+            _mm_storeu_si128((__m128i*)(out + x), _mm_unpacklo_epi64(lo, hi));
+        } else {
+            break;
+        }
+    }
+#endif
+    for (; x < width; x++) {
+        if (format == e_lapis_format_rgb565) {
+            out[x] = common_pack_rgb565(src[x]);
+        } else if (format == e_lapis_format_rgb5a3) {
+            out[x] = common_pack_rgb5a3(src[x]);
+        } else {
+            ((uint32_t*)out)[x / 2] = common_pack_yuyv(src[x], src[x + 1]);
+            x++;
+        }
+    }
+}
+
+static void common_to_rgba8(uint32_t* dst, const void* src, uint32_t format, uint32_t width)
+{
+    const uint16_t* in = (const uint16_t*)src;
+    const uint8_t* yuyv = (const uint8_t*)src;
+    uint32_t x = 0;
+#if defined(COMMON_FORMAT_SSE2)
+    __m128i pixels;
+    for (; x + 8 <= width && format != e_lapis_format_yuyv; x += 8) {
+        pixels = _mm_loadu_si128((const __m128i*)(in + x));
+        if (format == e_lapis_format_rgb565) {
+            _mm_storeu_si128((__m128i*)(dst + x), common_unpack_rgb565_4(common_widen_lanes(pixels)));
+            pixels = _mm_srli_si128(pixels, 8);
+            _mm_storeu_si128((__m128i*)(dst + x + 4), common_unpack_rgb565_4(common_widen_lanes(pixels)));
+        } else if ((_mm_movemask_epi8(pixels) & 0xAAAA) == 0xAAAA) {
+            _mm_storeu_si128((__m128i*)(dst + x), common_unpack_rgb555_4(common_widen_lanes(pixels)));
+            pixels = _mm_srli_si128(pixels, 8);
+            _mm_storeu_si128((__m128i*)(dst + x + 4), common_unpack_rgb555_4(common_widen_lanes(pixels)));
+        } else {
+            break;
+        }
+    }
+#endif
+    for (; x < width; x++) {
+        if (format == e_lapis_format_rgb565) {
+            dst[x] = common_unpack_rgb565(in[x]);
+        } else if (format == e_lapis_format_rgb5a3) {
+            dst[x] = common_unpack_rgb5a3(in[x]);
+        } else {
+            dst[x] = common_unpack_yuv(yuyv[x * 2], yuyv[(x & ~1u) * 2 + 1], yuyv[(x & ~1u) * 2 + 3]);
+        }
+    }
+}
+
+uint32_t lapis_format_bytes(uint32_t format)
+{
+    if (format == e_lapis_format_rgba8) return 4;
+    return format < e_lapis_format_count ? 2 : 0;
+}
+
+LapisReturnCode lapis_convert_pixels(void* dst, uint32_t dst_format, size_t dst_stride, const void* src,
+                                     uint32_t src_format, size_t src_stride, uint32_t width, uint32_t height)
+{
+    uint32_t chunk[COMMON_CONVERT_CHUNK];
+    const uint8_t* in = (const uint8_t*)src;
+    uint8_t* out = (uint8_t*)dst;
+    uint32_t x, y, count;
+
+    if (!lapis_format_bytes(dst_format) || !lapis_format_bytes(src_format)) {
+        return e_lapis_return_invalid_argument;
+    }
+    if (!width || !height) return e_lapis_return_success;
+    if (!dst || !src) return e_lapis_return_invalid_argument;
+    if ((width & 1) && (dst_format == e_lapis_format_yuyv || src_format == e_lapis_format_yuyv)) {
+        return e_lapis_return_invalid_argument;
+    }
+
+    for (y = 0; y < height; y++, in += src_stride, out += dst_stride) {
+        if (src_format == dst_format) {
+            memcpy(out, in, (size_t)width * lapis_format_bytes(src_format));
+        } else if (src_format == e_lapis_format_rgba8) {
+            common_from_rgba8(out, dst_format, (const uint32_t*)in, width);
+        } else if (dst_format == e_lapis_format_rgba8) {
+            common_to_rgba8((uint32_t*)out, in, src_format, width);
+        } else {
+            for (x = 0; x < width; x += count) {
+                count = width - x < COMMON_CONVERT_CHUNK ? width - x : COMMON_CONVERT_CHUNK;
+                common_to_rgba8(chunk, in + (size_t)x * 2, src_format, count);
+                common_from_rgba8(out + (size_t)x * 2, dst_format, chunk, count);
+            }
+        }
+    }
+    return e_lapis_return_success;
+}
@@ -0,0 +1,138 @@
+#ifndef __LAPIS_CORE_COMMON_FORMAT_INTERNAL_HEADER_H__
+#define __LAPIS_CORE_COMMON_FORMAT_INTERNAL_HEADER_H__ (1)
+#include "lapis/lapis_core.h"
+
+// Packing and unpacking of the 16 bit formats, shared by lapis_convert_pixels and the soft rasterizer so a
+// target drawn in a 16 bit format matches one drawn in RGBA8 and converted
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define COMMON_FORMAT_SSE2 (1)
+#endif
+
+/**
+ * Single pixels, the vector versions below do exactly the same arithmetic so which one runs never changes a
+ * pixel. Narrowing rounds to the nearest level, (c * 249 + 1014) >> 11 is c * 31 / 255 rounded and
+ * (c * 253 + 505) >> 10 is c * 63 / 255 rounded, both for every c from 0 to 255
+ */
+
+static inline uint32_t common_narrow5(uint32_t c) { return (c * 249 + 1014) >> 11; }
+static inline uint32_t common_narrow6(uint32_t c) { return (c * 253 + 505) >> 10; }
+static inline uint32_t common_widen5(uint32_t c) { return (c << 3) | (c >> 2); }
+static inline uint32_t common_widen6(uint32_t c) { return (c << 2) | (c >> 4); }
+
+static inline uint16_t common_pack_rgb565(uint32_t pixel)
+{
+    uint32_t r = pixel & 0xFF, g = (pixel >> 8) & 0xFF, b = (pixel >> 16) & 0xFF;
+    return (uint16_t)((common_narrow5(r) << 11) | (common_narrow6(g) << 5) | common_narrow5(b));
+}
+
+static inline uint32_t common_unpack_rgb565(uint32_t pixel)
+{
+    uint32_t r = common_widen5(pixel >> 11), g = common_widen6((pixel >> 5) & 0x3F);
+    uint32_t b = common_widen5(pixel & 0x1F);
+    return 0xFF000000u | (b << 16) | (g << 8) | r;
+}
+
+// Alpha of 0xE0 or more is as opaque as 3 bits can say, so it's stored as RGB555
+static inline uint16_t common_pack_rgb5a3(uint32_t pixel)
+{
+    uint32_t r = pixel & 0xFF, g = (pixel >> 8) & 0xFF, b = (pixel >> 16) & 0xFF, a = pixel >> 24;
+    if (a >= 0xE0) {
+        return (uint16_t)(0x8000u | (common_narrow5(r) << 10) | (common_narrow5(g) << 5) | common_narrow5(b));
+    }
+    return (uint16_t)(((a >> 5) << 12) | (((r + 8) / 17) << 8) | (((g + 8) / 17) << 4) | ((b + 8) / 17));
+}
+
+static inline uint32_t common_unpack_rgb5a3(uint32_t pixel)
+{
+    uint32_t a;
+    if (pixel & 0x8000) {
+        return 0xFF000000u | (common_widen5(pixel & 0x1F) << 16) | (common_widen5((pixel >> 5) & 0x1F) << 8) |
+               common_widen5((pixel >> 10) & 0x1F);
+    }
+    a = (pixel >> 12) & 0x7;
+    a = (a << 5) | (a << 2) | (a >> 1);
+    return (a << 24) | ((pixel & 0xF) * 17 << 16) | (((pixel >> 4) & 0xF) * 17 << 8) |
+           ((pixel >> 8) & 0xF) * 17;
+}
+
+/**
+ * 4 pixels at a time, in 32 bit lanes
+ */
+
+#if defined(COMMON_FORMAT_SSE2)
+// Narrows the channel in the bottom byte of each 32 bit lane, products stay under 16 bits so the 16 bit
+// multiply leaves the top half of each lane 0
+static inline __m128i common_narrow5_4(__m128i c)
+{
+    return _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi16(c, _mm_set1_epi32(249)), _mm_set1_epi32(1014)), 11);
+}
+
+static inline __m128i common_narrow6_4(__m128i c)
+{
+    return _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi16(c, _mm_set1_epi32(253)), _mm_set1_epi32(505)), 10);
+}
+
+// Packs 32 bit lanes holding 16 bit values into 16 bit lanes, sign extending first so the saturating pack
+// never clamps
+static inline __m128i common_pack16_8(__m128i lo, __m128i hi)
+{
+    lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+    hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+    return _mm_packs_epi32(lo, hi);
+}
+
+static inline __m128i common_rgb565_4(__m128i pixels)
+{
+    const __m128i byte = _mm_set1_epi32(0xFF);
+    __m128i r = common_narrow5_4(_mm_and_si128(pixels, byte));
+    __m128i g = common_narrow6_4(_mm_and_si128(_mm_srli_epi32(pixels, 8), byte));
+    __m128i b = common_narrow5_4(_mm_and_si128(_mm_srli_epi32(pixels, 16), byte));
+    return _mm_or_si128(_mm_or_si128(_mm_slli_epi32(r, 11), _mm_slli_epi32(g, 5)), b);
+}
+
+static inline __m128i common_rgb555_4(__m128i pixels)
+{
+    const __m128i byte = _mm_set1_epi32(0xFF);
+    __m128i r = common_narrow5_4(_mm_and_si128(pixels, byte));
+    __m128i g = common_narrow5_4(_mm_and_si128(_mm_srli_epi32(pixels, 8), byte));
+    __m128i b = common_narrow5_4(_mm_and_si128(_mm_srli_epi32(pixels, 16), byte));
+    __m128i rgb = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(r, 10), _mm_slli_epi32(g, 5)), b);
+    return _mm_or_si128(rgb, _mm_set1_epi32(0x8000));
+}
+
+// Widens 4 16 bit pixels in the bottom half of a register to 32 bit lanes
+static inline __m128i common_widen_lanes(__m128i pixels)
+{
+    return _mm_unpacklo_epi16(pixels, _mm_setzero_si128());
+}
+
+static inline __m128i common_unpack_rgb565_4(__m128i pixels)
+{
+    const __m128i five = _mm_set1_epi32(0x1F);
+    __m128i r = _mm_srli_epi32(pixels, 11);
+    __m128i g = _mm_and_si128(_mm_srli_epi32(pixels, 5), _mm_set1_epi32(0x3F));
+    __m128i b = _mm_and_si128(pixels, five);
+    r = _mm_or_si128(_mm_slli_epi32(r, 3), _mm_srli_epi32(r, 2));
+    g = _mm_or_si128(_mm_slli_epi32(g, 2), _mm_srli_epi32(g, 4));
+    b = _mm_or_si128(_mm_slli_epi32(b, 3), _mm_srli_epi32(b, 2));
+    return _mm_or_si128(_mm_or_si128(_mm_set1_epi32((int)0xFF000000u), _mm_slli_epi32(b, 16)),
+                        _mm_or_si128(_mm_slli_epi32(g, 8), r));
+}
+
+static inline __m128i common_unpack_rgb555_4(__m128i pixels)
+{
+    const __m128i five = _mm_set1_epi32(0x1F);
+    __m128i r = _mm_and_si128(_mm_srli_epi32(pixels, 10), five);
+    __m128i g = _mm_and_si128(_mm_srli_epi32(pixels, 5), five);
+    __m128i b = _mm_and_si128(pixels, five);
+    r = _mm_or_si128(_mm_slli_epi32(r, 3), _mm_srli_epi32(r, 2));
+    g = _mm_or_si128(_mm_slli_epi32(g, 3), _mm_srli_epi32(g, 2));
+    b = _mm_or_si128(_mm_slli_epi32(b, 3), _mm_srli_epi32(b, 2));
+    return _mm_or_si128(_mm_or_si128(_mm_set1_epi32((int)0xFF000000u), _mm_slli_epi32(b, 16)),
+                        _mm_or_si128(_mm_slli_epi32(g, 8), r));
+}
+#endif
+
+#endif  // !__LAPIS_CORE_COMMON_FORMAT_INTERNAL_HEADER_H__
@@ -0,0 +1,31 @@
+#include "lapis/lapis_core.h"
+
+LapisReturnCode lapis_get_size(LapisSize* size, LapisType type)
+{
+    if (!size) return e_lapis_return_invalid_argument;
+    switch (type) {
+        case e_lapis_type_context:
+            return lapis_size_context(size);
+        default:
+            break;
+    }
+    return e_lapis_return_invalid_argument;
+}
+
+static size_t common_align(size_t value, size_t align) { return (value + align - 1) & ~(align - 1); }
+
+LapisReturnCode lapis_bundle_add(LapisSize* bundle, const LapisSize* object, size_t* cpu_offset,
+                                 size_t* gpu_offset)
+{
+    uint32_t align;
+    if (!bundle || !object || !cpu_offset || !gpu_offset) return e_lapis_return_invalid_argument;
+    align = object->gpu_align ? object->gpu_align : 1;
+    if (align & (align - 1)) return e_lapis_return_invalid_argument;
+
+    *cpu_offset = common_align(bundle->cpu_size, LAPIS_CPU_ALIGN);
+    *gpu_offset = common_align(bundle->gpu_size, align);
+    bundle->cpu_size = *cpu_offset + object->cpu_size;
+    bundle->gpu_size = *gpu_offset + object->gpu_size;
+    if (align > bundle->gpu_align) bundle->gpu_align = align;
+    return e_lapis_return_success;
+}
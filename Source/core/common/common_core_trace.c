@@ -0,0 +1,236 @@
+#include "lapis/lapis_core.h"
+
+#ifndef LAPIS_INSTRUMENTATION
+
+LapisReturnCode lapis_get_frame_stats(LapisFrameStats* stats) { return e_lapis_return_unsupported; }
+
+LapisReturnCode lapis_export_trace(char* json, size_t capacity, size_t* size)
+{
+    return e_lapis_return_unsupported;
+}
+
+#else
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#define COMMON_THREAD_LOCAL __declspec(thread)
+#elif defined(LAPIS_BACKEND_WII)
+#include <ogc/lwp_watchdog.h>
+#define COMMON_THREAD_LOCAL __thread
+#else
+#include <time.h>
+#define COMMON_THREAD_LOCAL __thread
+#endif
+
+#define common_atomic_load(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define common_atomic_store(ptr, value) __atomic_store_n((ptr), (value), __ATOMIC_RELEASE)
+#define common_atomic_add(ptr, value) __atomic_fetch_add((ptr), (value), __ATOMIC_ACQ_REL)
+#define common_atomic_exchange(ptr, value) __atomic_exchange_n((ptr), (value), __ATOMIC_ACQ_REL)
+
+// A stage which ran, frame ends are stored with the stage set to e_lapis_stage_count
+typedef struct CommonTraceEvent {
+    uint64_t start;
+    uint64_t duration;
+    uint32_t stage;
+    uint32_t thread;
+} CommonTraceEvent;
+
+// One frame in the rolling window
+typedef struct CommonTraceFrame {
+    uint64_t length;
+    uint64_t time[e_lapis_stage_count];
+    uint32_t calls[e_lapis_stage_count];
+} CommonTraceFrame;
+
+// Lapis never allocates, and stages run on threads which don't share any lapis object, so the timings live
+// in static memory that only exists in instrumented builds
+static struct {
+    uint64_t time[e_lapis_stage_count];  // The frame so far, added to by every thread
+    uint32_t calls[e_lapis_stage_count];
+    uint64_t frame_end;
+    CommonTraceFrame frames[LAPIS_STATS_FRAMES];
+    uint32_t frame_count;  // Frames ended so far, the newest is at frame_count - 1
+    CommonTraceEvent events[LAPIS_TRACE_EVENTS];
+    uint32_t event_count;  // Events written so far, slots are reused once it passes LAPIS_TRACE_EVENTS
+    uint32_t thread_count;
+} common_trace;
+
+// When each stage started on this thread, and the thread's id in the trace
+static COMMON_THREAD_LOCAL uint64_t common_trace_start[e_lapis_stage_count];
+static COMMON_THREAD_LOCAL uint32_t common_trace_thread;
+
+static const char* common_stage_names[e_lapis_stage_count + 1] = {"clear",   "record", "raster",
+                                                                  "present", "swap",   "frame"};
+
+// Current time in nanoseconds, only ever compared against itself
+static uint64_t common_trace_now()
+{
+#if defined(_WIN32)
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (uint64_t)(counter.QuadPart / frequency.QuadPart * 1000000000 +
+                      counter.QuadPart % frequency.QuadPart * 1000000000 / frequency.QuadPart);
+#elif defined(LAPIS_BACKEND_WII)
+    return ticks_to_nanosecs(gettime());
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#endif
+}
+
+static void common_trace_event(uint32_t stage, uint64_t start, uint64_t duration)
+{
+    CommonTraceEvent* event;
+    if (!common_trace_thread) common_trace_thread = common_atomic_add(&common_trace.thread_count, 1) + 1;
+    event = &common_trace.events[common_atomic_add(&common_trace.event_count, 1) % LAPIS_TRACE_EVENTS];
+    event->start = start;
+    event->duration = duration;
+    event->stage = stage;
+    event->thread = common_trace_thread;
+}
+
+void lapis_trace_begin(LapisStage stage) { common_trace_start[stage] = common_trace_now(); }
+
+void lapis_trace_end(LapisStage stage)
+{
+    uint64_t start = common_trace_start[stage];
+    uint64_t duration = common_trace_now() - start;
+    common_atomic_add(&common_trace.time[stage], duration);
+    common_atomic_add(&common_trace.calls[stage], 1);
+    common_trace_event(stage, start, duration);
+}
+
+void lapis_trace_end_frame()
+{
+    CommonTraceFrame* frame;
+    uint64_t now = common_trace_now();
+    uint32_t i;
+
+    // Stages finishing on other threads while the frame is taken apart land in the next frame
+    frame = &common_trace.frames[common_trace.frame_count % LAPIS_STATS_FRAMES];
+    frame->length = common_trace.frame_end ? now - common_trace.frame_end : 0;
+    for (i = 0; i < e_lapis_stage_count; i++) {
+        frame->time[i] = common_atomic_exchange(&common_trace.time[i], 0);
+        frame->calls[i] = common_atomic_exchange(&common_trace.calls[i], 0);
+    }
+    common_trace.frame_end = now;
+    common_trace_event(e_lapis_stage_count, now, 0);
+    common_atomic_store(&common_trace.frame_count, common_trace.frame_count + 1);
+}
+
+// Sorts a handful of samples then picks out the percentiles and the largest
+static void common_percentiles(uint64_t* samples, uint32_t count, uint64_t* p50, uint64_t* p99, uint64_t* max)
+{
+    uint64_t sample;
+    uint32_t i, j;
+    for (i = 1; i < count; i++) {
+        sample = samples[i];
+        for (j = i; j && samples[j - 1] > sample; j--) samples[j] = samples[j - 1];
+        samples[j] = sample;
+    }
+    *p50 = samples[(count - 1) * 50 / 100];
+    *p99 = samples[(count - 1) * 99 / 100];
+    *max = samples[count - 1];
+}
+
+LapisReturnCode lapis_get_frame_stats(LapisFrameStats* stats)
+{
+    uint64_t samples[LAPIS_STATS_FRAMES];
+    const CommonTraceFrame* last;
+    LapisStageStats* stage;
+    uint32_t ended, first, count, i, s;
+
+    if (!stats) return e_lapis_return_invalid_argument;
+    memset(stats, 0, sizeof(*stats));
+    ended = common_atomic_load(&common_trace.frame_count);
+    if (!ended) return e_lapis_return_success;
+
+    // The first frame has no start to measure its length from
+    count = ended < LAPIS_STATS_FRAMES ? ended : LAPIS_STATS_FRAMES;
+    first = ended - count;
+    if (!first) {
+        first = 1;
+        count--;
+    }
+    stats->frames = count;
+    last = &common_trace.frames[(ended - 1) % LAPIS_STATS_FRAMES];
+    stats->frame_last = last->length;
+    if (!count) return e_lapis_return_success;
+
+    for (i = 0; i < count; i++) samples[i] = common_trace.frames[(first + i) % LAPIS_STATS_FRAMES].length;
+    common_percentiles(samples, count, &stats->frame_p50, &stats->frame_p99, &stats->frame_max);
+    for (s = 0; s < e_lapis_stage_count; s++) {
+        for (i = 0; i < count; i++) {
+            samples[i] = common_trace.frames[(first + i) % LAPIS_STATS_FRAMES].time[s];
+        }
+        stage = &stats->stages[s];
+        common_percentiles(samples, count, &stage->p50, &stage->p99, &stage->max);
+        stage->last = last->time[s];
+        stage->calls = last->calls[s];
+    }
+    return e_lapis_return_success;
+}
+
+// Appends to the JSON, counting what didn't fit so the caller finds out how much room it needs
+static void common_json(char* json, size_t capacity, size_t* size, const char* format, ...)
+{
+    size_t room = json && *size < capacity ? capacity - *size : 0;
+    va_list args;
+    int written;
+    va_start(args, format);
+    written = vsnprintf(room ? json + *size : NULL, room, format, args);
+    va_end(args);
+    if (written > 0) *size += (size_t)written;
+}
+
+LapisReturnCode lapis_export_trace(char* json, size_t capacity, size_t* size)
+{
+    const CommonTraceEvent* event;
+    uint64_t origin, offset;
+    uint32_t written, count, first, i;
+
+    if (!size || (json && !capacity)) return e_lapis_return_invalid_argument;
+    written = common_atomic_load(&common_trace.event_count);
+    count = written < LAPIS_TRACE_EVENTS ? written : LAPIS_TRACE_EVENTS;
+    first = written - count;
+
+    // Events are stored as they end, so the earliest start could be anywhere
+    origin = (uint64_t)-1;
+    for (i = 0; i < count; i++) {
+        event = &common_trace.events[(first + i) % LAPIS_TRACE_EVENTS];
+        if (event->start < origin) origin = event->start;
+    }
+
+    // Timestamps are in microseconds from the oldest event, complete events for stages and instant events
+    // for the ends of frames
+    *size = 0;
+    common_json(json, capacity, size, "{\"traceEvents\":[");
+    for (i = 0; i < count; i++) {
+        event = &common_trace.events[(first + i) % LAPIS_TRACE_EVENTS];
+        common_json(json, capacity, size, "%s{\"name\":\"%s\",\"cat\":\"lapis\",\"ph\":\"%s\",\"pid\":1,",
+                    i ? "," : "", common_stage_names[event->stage],
+                    event->stage == e_lapis_stage_count ? "i" : "X");
+        offset = event->start - origin;
+        common_json(json, capacity, size, "\"tid\":%u,\"ts\":%llu.%03u", event->thread,
+                    (unsigned long long)(offset / 1000), (unsigned)(offset % 1000));
+        if (event->stage == e_lapis_stage_count) {
+            common_json(json, capacity, size, ",\"s\":\"g\"}");
+        } else {
+            common_json(json, capacity, size, ",\"dur\":%llu.%03u}",
+                        (unsigned long long)(event->duration / 1000), (unsigned)(event->duration % 1000));
+        }
+    }
+    common_json(json, capacity, size, "]}\n");
+    if (json && *size >= capacity) {
+        json[capacity - 1] = '\0';
+        return e_lapis_return_out_of_memory;
+    }
+    return e_lapis_return_success;
+}
+
+#endif  // LAPIS_INSTRUMENTATION
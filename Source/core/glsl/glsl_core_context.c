@@ -1,3 +1,29 @@
 #include "glsl_core.h"
 
-LapisReturnCode lapis_create_context(LapisContext* context) { return e_lapis_return_success; }
+LapisReturnCode lapis_size_context(LapisSize* size)
+{
+    size->cpu_size = 0;
+    size->gpu_size = 0;
+    size->gpu_align = 1;
+    return e_lapis_return_success;
+}
+
+LapisReturnCode lapis_create_context(LapisContext* context, LapisContextHelper* helper)
+{
+    return e_lapis_return_success;
+}
+
+LapisReturnCode lapis_destroy_context(LapisContext* context) { return e_lapis_return_success; }
+
+uint32_t lapis_context_worker_count(LapisContext* context) { return 1; }
+
+// No worker threads on this backend, so the tasks all run on the calling thread
+LapisReturnCode lapis_context_parallel_for(LapisContext* context, LapisTaskFunc func, void* user,
+                                           uint32_t count)
+{
+    uint32_t i;
+    for (i = 0; i < count; i++) {
+        func(user, i, 0);
+    }
+    return e_lapis_return_success;
+}
@@ -0,0 +1,58 @@
+#ifndef __LAPIS_CORE_SOFT_INTERNAL_HEADER_H__
+#define __LAPIS_CORE_SOFT_INTERNAL_HEADER_H__ (1)
+#include "lapis/lapis_core.h"
+#include <pthread.h>
+
+// Most threads the context can render with
+#define SOFT_MAX_WORKERS (64)
+
+// Atomics, the soft backend relies on the gcc/clang builtins
+#define soft_atomic_load(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define soft_atomic_store(ptr, value) __atomic_store_n((ptr), (value), __ATOMIC_RELEASE)
+#define soft_atomic_add(ptr, value) __atomic_add_fetch((ptr), (value), __ATOMIC_ACQ_REL)
+#define soft_atomic_cas(ptr, expected, desired) \
+    __atomic_compare_exchange_n((ptr), (expected), (desired), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+
+// Each worker owns a range of task indices packed as begin in the low and end in the high 32 bits. The owner
+// takes tasks from the front of its range and thieves split off the back half, both with a compare exchange
+typedef struct SoftWorker {
+    uint64_t range;
+    struct SoftContext* context;
+    uint32_t index;
+    uint8_t padding[64 - sizeof(uint64_t) - sizeof(void*) - sizeof(uint32_t)];  // One cache line per worker
+} SoftWorker;
+
+// Internal state of the context, lives in the context's cpu memory
+typedef struct SoftContext {
+    uint32_t worker_count;
+    SoftWorker workers[SOFT_MAX_WORKERS];
+    pthread_t threads[SOFT_MAX_WORKERS];
+
+    // The work currently being spread across the workers
+    LapisTaskFunc func;
+    void* user;
+    uint32_t pending;     // Tasks which haven't finished yet
+    uint32_t generation;  // Bumped every time new work is handed out
+    uint32_t shutdown;
+
+    // Threads still inside of a run of tasks, counted under lock. New ranges are only handed out once this is
+    // 0, since a thief from the last run storing its stolen remainder would race the new ranges
+    uint32_t busy;
+
+    // Only one thread at a time can hand out work
+    pthread_mutex_t submit_lock;
+
+    // Sleeping workers wait on wake, the submitting thread waits on done for the tasks to finish and for the
+    // workers to go idle
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+} SoftContext;
+
+// Starts the worker threads, worker 0 is always the calling thread so count - 1 threads are created
+LapisReturnCode soft_workers_start(SoftContext* ctx, uint32_t count);
+
+// Wakes every worker up to exit and waits for them
+void soft_workers_stop(SoftContext* ctx);
+
+#endif  // !__LAPIS_CORE_SOFT_INTERNAL_HEADER_H__
@@ -0,0 +1,37 @@
+#include "soft_core.h"
+
+// Fails to compile when the context outgrows the bound published in lapis_core.h
+typedef char soft_context_fits_static_size[sizeof(SoftContext) <= LAPIS_CONTEXT_CPU_SIZE ? 1 : -1];
+
+LapisReturnCode lapis_size_context(LapisSize* size)
+{
+    if (!size) return e_lapis_return_invalid_argument;
+    size->cpu_size = sizeof(SoftContext);
+    size->gpu_size = 0;
+    size->gpu_align = 1;
+    return e_lapis_return_success;
+}
+
+LapisReturnCode lapis_create_context(LapisContext* context, LapisContextHelper* helper)
+{
+    SoftContext* ctx;
+    uint32_t workers = helper ? helper->worker_count : 1;
+    if (!context || !context->cpu_mem) return e_lapis_return_invalid_argument;
+    if (workers > SOFT_MAX_WORKERS) return e_lapis_return_invalid_argument;
+
+    ctx = (SoftContext*)context->cpu_mem;
+    return soft_workers_start(ctx, workers ? workers : 1);
+}
+
+LapisReturnCode lapis_destroy_context(LapisContext* context)
+{
+    if (!context || !context->cpu_mem) return e_lapis_return_invalid_argument;
+    soft_workers_stop((SoftContext*)context->cpu_mem);
+    return e_lapis_return_success;
+}
+
+uint32_t lapis_context_worker_count(LapisContext* context)
+{
+    if (!context || !context->cpu_mem) return 1;
+    return ((SoftContext*)context->cpu_mem)->worker_count;
+}
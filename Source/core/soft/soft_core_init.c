@@ -0,0 +1,3 @@
+#include "soft_core.h"
+
+LapisReturnCode lapis_connect() { return e_lapis_return_success; }
@@ -0,0 +1,180 @@
+#include "soft_core.h"
+
+#define SOFT_RANGE(begin, end) (((uint64_t)(end) << 32) | (uint64_t)(begin))
+#define SOFT_RANGE_BEGIN(range) ((uint32_t)(range))
+#define SOFT_RANGE_END(range) ((uint32_t)((range) >> 32))
+
+// Takes the next task from the front of a worker's own range
+static int soft_pop(SoftWorker* worker, uint32_t* task)
+{
+    uint64_t range = soft_atomic_load(&worker->range);
+    while (SOFT_RANGE_BEGIN(range) < SOFT_RANGE_END(range)) {
+        uint64_t next = SOFT_RANGE(SOFT_RANGE_BEGIN(range) + 1, SOFT_RANGE_END(range));
+        if (soft_atomic_cas(&worker->range, &range, next)) {
+            *task = SOFT_RANGE_BEGIN(range);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Splits off the back half of another worker's range, the first stolen task is returned and the rest becomes
+// the thief's own range. Only called once the thief's range is empty, and ranges are only handed out while
+// every worker is idle, so nobody else can be touching it
+static int soft_steal(SoftContext* ctx, uint32_t thief, uint32_t* task)
+{
+    uint32_t i;
+    for (i = 1; i < ctx->worker_count; i++) {
+        SoftWorker* victim = &ctx->workers[(thief + i) % ctx->worker_count];
+        uint64_t range = soft_atomic_load(&victim->range);
+        while (SOFT_RANGE_BEGIN(range) < SOFT_RANGE_END(range)) {
+            uint32_t begin = SOFT_RANGE_BEGIN(range);
+            uint32_t end = SOFT_RANGE_END(range);
+            uint32_t middle = begin + (end - begin) / 2;
+            if (soft_atomic_cas(&victim->range, &range, SOFT_RANGE(begin, middle))) {
+                *task = middle;
+                soft_atomic_store(&ctx->workers[thief].range, SOFT_RANGE(middle + 1, end));
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Runs tasks until there is nothing left to take or steal
+static void soft_run_tasks(SoftContext* ctx, uint32_t worker)
+{
+    uint32_t task;
+    while (soft_pop(&ctx->workers[worker], &task) || soft_steal(ctx, worker, &task)) {
+        // The function is published before the ranges, so reading it after taking a task is always current
+        ctx->func(ctx->user, task, worker);
+        if (soft_atomic_add(&ctx->pending, (uint32_t)-1) == 0) {
+            pthread_mutex_lock(&ctx->lock);
+            pthread_cond_broadcast(&ctx->done);
+            pthread_mutex_unlock(&ctx->lock);
+        }
+    }
+}
+
+static void* soft_worker_main(void* arg)
+{
+    SoftWorker* worker = (SoftWorker*)arg;
+    SoftContext* ctx = worker->context;
+    uint32_t seen = 0;
+    uint32_t shutdown;
+
+    for (;;) {
+        pthread_mutex_lock(&ctx->lock);
+        while (ctx->generation == seen && !ctx->shutdown) {
+            pthread_cond_wait(&ctx->wake, &ctx->lock);
+        }
+        seen = ctx->generation;
+        shutdown = ctx->shutdown;
+        if (!shutdown) ctx->busy++;
+        pthread_mutex_unlock(&ctx->lock);
+
+        if (shutdown) return NULL;
+        soft_run_tasks(ctx, worker->index);
+
+        pthread_mutex_lock(&ctx->lock);
+        if (--ctx->busy == 0) pthread_cond_broadcast(&ctx->done);
+        pthread_mutex_unlock(&ctx->lock);
+    }
+}
+
+LapisReturnCode soft_workers_start(SoftContext* ctx, uint32_t count)
+{
+    uint32_t i;
+    ctx->worker_count = 1;
+    ctx->generation = 0;
+    ctx->shutdown = 0;
+    ctx->pending = 0;
+    ctx->busy = 0;
+    pthread_mutex_init(&ctx->submit_lock, NULL);
+    pthread_mutex_init(&ctx->lock, NULL);
+    pthread_cond_init(&ctx->wake, NULL);
+    pthread_cond_init(&ctx->done, NULL);
+
+    for (i = 0; i < count; i++) {
+        ctx->workers[i].range = 0;
+        ctx->workers[i].context = ctx;
+        ctx->workers[i].index = i;
+    }
+
+    // worker_count only grows as threads start, so a failure can stop exactly the threads that exist
+    for (i = 1; i < count; i++) {
+        if (pthread_create(&ctx->threads[i], NULL, soft_worker_main, &ctx->workers[i]) != 0) {
+            soft_workers_stop(ctx);
+            return e_lapis_return_system_error;
+        }
+        ctx->worker_count++;
+    }
+    return e_lapis_return_success;
+}
+
+void soft_workers_stop(SoftContext* ctx)
+{
+    uint32_t i;
+    pthread_mutex_lock(&ctx->lock);
+    ctx->shutdown = 1;
+    pthread_cond_broadcast(&ctx->wake);
+    pthread_mutex_unlock(&ctx->lock);
+
+    for (i = 1; i < ctx->worker_count; i++) {
+        pthread_join(ctx->threads[i], NULL);
+    }
+    ctx->worker_count = 1;
+
+    pthread_cond_destroy(&ctx->done);
+    pthread_cond_destroy(&ctx->wake);
+    pthread_mutex_destroy(&ctx->lock);
+    pthread_mutex_destroy(&ctx->submit_lock);
+}
+
+LapisReturnCode lapis_context_parallel_for(LapisContext* context, LapisTaskFunc func, void* user,
+                                           uint32_t count)
+{
+    SoftContext* ctx;
+    uint32_t i;
+    if (!context || !context->cpu_mem || !func) return e_lapis_return_invalid_argument;
+    if (!count) return e_lapis_return_success;
+
+    ctx = (SoftContext*)context->cpu_mem;
+    if (ctx->worker_count == 1 || count == 1) {
+        for (i = 0; i < count; i++) {
+            func(user, i, 0);
+        }
+        return e_lapis_return_success;
+    }
+
+    // Workers can still be on their way out of the last run after its tasks finished. Holding the lock while
+    // the ranges go out also stops a worker waking late from joining in before they're all there
+    pthread_mutex_lock(&ctx->submit_lock);
+    pthread_mutex_lock(&ctx->lock);
+    while (ctx->busy) {
+        pthread_cond_wait(&ctx->done, &ctx->lock);
+    }
+    ctx->func = func;
+    ctx->user = user;
+    soft_atomic_store(&ctx->pending, count);
+
+    // Hand every worker a contiguous slice, neighbouring tasks tend to touch neighbouring memory
+    for (i = 0; i < ctx->worker_count; i++) {
+        uint32_t begin = (uint32_t)((uint64_t)count * i / ctx->worker_count);
+        uint32_t end = (uint32_t)((uint64_t)count * (i + 1) / ctx->worker_count);
+        soft_atomic_store(&ctx->workers[i].range, SOFT_RANGE(begin, end));
+    }
+    ctx->generation++;
+    pthread_cond_broadcast(&ctx->wake);
+    pthread_mutex_unlock(&ctx->lock);
+
+    soft_run_tasks(ctx, 0);
+
+    pthread_mutex_lock(&ctx->lock);
+    while (soft_atomic_load(&ctx->pending) != 0) {
+        pthread_cond_wait(&ctx->done, &ctx->lock);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+    pthread_mutex_unlock(&ctx->submit_lock);
+    return e_lapis_return_success;
+}
@@ -0,0 +1,22 @@
+#include "glsl_gfx.h"
+
+LapisReturnCode lapis_size_mesh(LapisSize* size, LapisMeshHelper* helper)
+{
+    return e_lapis_return_unsupported;
+}
+
+LapisReturnCode lapis_create_mesh(LapisMesh* mesh, LapisMeshHelper* helper)
+{
+    return e_lapis_return_unsupported;
+}
+
+LapisReturnCode lapis_gfx_draw_mesh(LapisTarget* target, LapisMesh* mesh, const float* transform)
+{
+    return e_lapis_return_unsupported;
+}
+
+LapisReturnCode lapis_mesh_file_fill_helper(const void* file, size_t file_size, LapisMeshHelper* helper,
+                                            LapisMesh* mesh)
+{
+    return e_lapis_return_unsupported;
+}
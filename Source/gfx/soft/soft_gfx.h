@@ -0,0 +1,508 @@
+#ifndef __LAPIS_GFX_SOFT_INTERNAL_HEADER_H__
+#define __LAPIS_GFX_SOFT_INTERNAL_HEADER_H__ (1)
+#include "lapis/lapis_gfx.h"
+
+/*************************************************************************************************************
+ * Soft backend
+ * Everything is rasterized on the cpu in the target's own LapisPixelFormat, 4 bytes a pixel for RGBA8 with
+ * red in the lowest byte or 2 for the 16 bit formats. Colors are worked out as RGBA8 and narrowed as they're
+ * stored. Offscreen targets draw into their gpu memory. Window targets in the window's format draw straight
+ * into its framebuffer, so presenting never copies. Ones in a different format draw into their own gpu
+ * memory instead, and the rectangles they changed are converted into the window's back buffer when the frame
+ * ends, just before it's presented. Views draw into their parent's pixels either way.
+ *
+ * Vertices are snapped to a 1/16th pixel grid and the edge functions are evaluated with integers, so the
+ * coverage of a pixel never depends on which order or which block the pixel was visited in. Triangles are
+ * walked in 8x8 pixel blocks, blocks that are entirely inside the triangle skip the edge tests, and blocks
+ * which straddle an edge evaluate it 4 pixels at a time.
+ *
+ * Targets with a depth buffer keep the nearest and furthest depth of every block and every tile. A triangle
+ * which is behind the furthest depth of a tile is never binned into it, and blocks it's behind are skipped
+ * before any pixels are read.
+ *
+ * When the target's context has more than one worker, triangles are set up as they're submitted and binned
+ * into screen tiles. Scheduling the target rasterizes the tiles in parallel, every tile draws its triangles
+ * in submission order and blocks never cross tiles, so the result is identical to drawing immediately.
+ *************************************************************************************************************/
+
+// Number of fractional bits vertices are snapped to
+#define SOFT_SUBPIXEL_BITS (4)
+#define SOFT_SUBPIXEL_ONE (1 << SOFT_SUBPIXEL_BITS)
+
+// Size of the blocks triangles are walked in, must be a power of 2
+#define SOFT_BLOCK_SIZE (8)
+
+// Vertices further than this many pixels from the target are clipped or rejected, keeps the edge functions in
+// range
+#define SOFT_GUARD_BAND (16384)
+
+// Depth buffers are cleared to this, the furthest depth
+#define SOFT_DEPTH_FAR (1.0f)
+
+// Alignment of the pixel memory, one cache line
+#define SOFT_PIXEL_ALIGN (64)
+
+// Size of the screen tiles triangles are binned into, must be a multiple of the block size
+#define SOFT_TILE_SIZE (32)
+
+// Triangle indices stored per bin chunk, sized so a chunk is 128 bytes
+#define SOFT_BIN_CHUNK (30)
+
+// Triangles binned before flushing when the helper doesn't say
+#define SOFT_DEFAULT_BIN_TRIANGLES (16384)
+
+// Marks the end of a chunk list
+#define SOFT_BIN_NONE (0xFFFFFFFFu)
+
+// Bytes of commands window targets record when filled in from the window
+#define SOFT_DEFAULT_COMMAND_BYTES (64 * 1024)
+
+// Marks that the last command recorded can't be added to
+#define SOFT_COMMAND_NONE (0xFFFFFFFFu)
+
+// Triangles mapped and set up together by the kernels, a multiple of every kernel's width
+#define SOFT_BATCH (64)
+
+// Vector kernels which can be built for the cpu being compiled for, x86 picks between them when it runs
+#if defined(__SSE2__) || defined(_M_X64)
+#define SOFT_KERNELS_X86 (1)
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define SOFT_KERNELS_NEON (1)
+#endif
+
+// Rectangle of pixels, min inclusive and max exclusive
+typedef struct SoftRect {
+    int32_t min_x;
+    int32_t min_y;
+    int32_t max_x;
+    int32_t max_y;
+} SoftRect;
+
+// A vertex after it has been mapped into pixel coordinates
+typedef struct SoftVertex {
+    float x;
+    float y;
+    float z;  // Depth, 0 is nearest and SOFT_DEPTH_FAR furthest
+    float color[3];
+} SoftVertex;
+
+// Everything the rasterizer needs to know about a triangle, filled in by soft_finish_triangle
+typedef struct SoftTriangle {
+    // Edge functions, stepping one pixel right adds dx, one pixel down adds dy. c is the value at the centre
+    // of pixel 0,0 with the fill rule bias already applied
+    int64_t edge_dx[3];
+    int64_t edge_dy[3];
+    int64_t edge_c[3];
+
+    // Color plane equations, the value at a pixel is c + dx * x + dy * y
+    float color_dx[3];
+    float color_dy[3];
+    float color_c[3];
+
+    // Depth plane equation, worked out the same way as the colors
+    float z_dx;
+    float z_dy;
+    float z_c;
+
+    // Pixel bounds of the triangle
+    SoftRect bounds;
+} SoftTriangle;
+
+// Why setup threw a triangle away, checked in this order
+typedef enum SoftCull {
+    e_soft_cull_none,        // Drawn
+    e_soft_cull_guard_band,  // A corner is past the guard band, or NaN
+    e_soft_cull_degenerate,
+    e_soft_cull_facing,
+    e_soft_cull_small,      // The bounds don't hold a pixel centre
+    e_soft_cull_offscreen,  // The bounds are outside of the clip rectangle
+    e_soft_cull_occluded,   // Behind the depth of every tile it touches, found when it's binned
+} SoftCull;
+
+// Triangles on their way through the kernels, stored a lane per triangle so the kernels can work on a whole
+// vector of triangles at once. Arrays are indexed by corner, then channel, then lane
+typedef struct SoftBatch {
+    // Corners already mapped into pixels
+    float x[3][SOFT_BATCH];
+    float y[3][SOFT_BATCH];
+    float color[3][3][SOFT_BATCH];
+    float z[3][SOFT_BATCH];
+
+    // Filled in by setup, corners are swapped so the area is always positive and the bounds are clipped
+    int32_t snap_x[3][SOFT_BATCH];
+    int32_t snap_y[3][SOFT_BATCH];
+    int32_t min_x[SOFT_BATCH];
+    int32_t min_y[SOFT_BATCH];
+    int32_t max_x[SOFT_BATCH];
+    int32_t max_y[SOFT_BATCH];
+    float color_dx[3][SOFT_BATCH];
+    float color_dy[3][SOFT_BATCH];
+    float color_c[3][SOFT_BATCH];
+    int32_t cull[SOFT_BATCH];  // SoftCull, corners past the guard band leave everything else unset
+} SoftBatch;
+
+// Vertex mapping and triangle setup, picked when a target is created from what the cpu supports. Every set
+// does exactly the same arithmetic in the same order, so which one runs never changes a pixel
+typedef struct SoftKernels {
+    const char* name;
+    uint32_t width;  // Triangles worked on at once
+
+    // Map triangles of immediate mode positions and colors into pixels, filling lanes from 0
+    void (*load_aos)(SoftBatch* batch, const float* pos, const float* col, uint32_t count, float width,
+                     float height);
+    void (*load_soa)(SoftBatch* batch, const LapisVertexStreams* streams, uint32_t first, uint32_t count,
+                     float width, float height);
+
+    // Sets up lanes from 0 to count, which is a multiple of the width. facing holds the target's
+    // e_lapis_cull_back and e_lapis_cull_front flags
+    void (*setup)(SoftBatch* batch, uint32_t count, const SoftRect* clip, uint32_t facing);
+} SoftKernels;
+
+// Part of a tile's list of triangles
+typedef struct SoftBinChunk {
+    uint32_t next;
+    uint32_t count;
+    uint32_t triangles[SOFT_BIN_CHUNK];
+} SoftBinChunk;
+
+// A tile's list of triangles in submission order, as indices into the chunks
+typedef struct SoftBin {
+    uint32_t head;
+    uint32_t tail;
+} SoftBin;
+
+typedef enum SoftCommandType {
+    e_soft_command_clear,
+    e_soft_command_draw,
+    e_soft_command_mesh,
+    e_soft_command_quads,
+} SoftCommandType;
+
+// Start of every recorded command, draws are followed by 3 vertices per triangle already in pixels, meshes
+// by a SoftMeshCommand and quads by a SoftQuadCommand then the quads
+typedef struct SoftCommand {
+    uint32_t type;
+    uint32_t count;  // Triangles in a draw, or quads
+    uint32_t color;  // Packed clear color
+    SoftRect bounds;  // Pixels the command can change
+    uint32_t bytes;   // Size of whatever follows the command
+} SoftCommand;
+
+// Internal state of a mesh, lives in the mesh's cpu memory. The vertices and indices live in its gpu memory,
+// the indices after the vertices at the next 16 byte boundary
+typedef struct SoftMesh {
+    uint32_t vertex_count;
+    uint32_t triangle_count;
+    uint32_t index_type;
+    uint32_t vertex_format;
+    const void* vertices;
+    const void* indices;
+
+    // Object space box around every vertex, lets a draw know what it touches without transforming them all
+    float bounds_min[3];
+    float bounds_max[3];
+} SoftMesh;
+
+// Recorded mesh draw, only the mesh is referenced so it has to outlive the recording
+typedef struct SoftMeshCommand {
+    const SoftMesh* mesh;
+    float transform[16];
+} SoftMeshCommand;
+
+// Nearest and furthest depth stored inside of a block or a tile
+typedef struct SoftDepthRange {
+    float min;
+    float max;
+} SoftDepthRange;
+
+// Recorded quad draw, only the texture's pixels are referenced
+typedef struct SoftQuadCommand {
+    LapisCoverage coverage;
+    uint32_t color;
+} SoftQuadCommand;
+
+// Results of frames a target kept, enough that the newest frame whose fence has been reached is never reused
+// while every other frame is in flight
+#define SOFT_FRAME_RESULTS (LAPIS_MAX_FRAMES_IN_FLIGHT + 1)
+
+// What one scheduled frame of a target changed and culled. Claimed on the thread scheduling the target, and
+// written by whichever thread runs the frame. Nothing reads it until the frame's fence has been reached
+typedef struct SoftFrameResult {
+    uint64_t fence;  // Fence of the frame, 0 if nothing has been written. Offscreen targets always use 1
+    LapisRect dirty[LAPIS_MAX_DIRTY_RECTS];
+    uint32_t dirty_count;
+    LapisCullStats cull_stats;
+} SoftFrameResult;
+
+// A buffer of recorded commands. Targets drawing into a window with frames in flight have one for each, so a
+// frame can be recorded while the window is still running the ones before it
+typedef struct SoftCommandBuffer {
+    struct SoftTarget* target;
+    uint8_t* commands;
+    uint32_t used;
+    uint32_t draw;            // Offset of the last command if it's a draw more triangles can join
+    uint64_t fence;           // Window fence of the frame the buffer was scheduled in, 0 if it hasn't been
+    SoftFrameResult* result;  // Where the scheduled frame leaves what it did
+} SoftCommandBuffer;
+
+// A clear which hasn't been written into a tile's pixels yet
+typedef struct SoftTileClear {
+    uint32_t pending;
+    uint32_t color;
+} SoftTileClear;
+
+// Internal state of a target, lives in the target's cpu memory followed by the binning storage
+typedef struct SoftTarget {
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;  // Distance between rows in pixels
+    uint8_t* pixels;  // Points into the gpu memory of the target, or the window's framebuffer
+
+    // LapisPixelFormat of the pixels and the bytes each takes. Colors are always packed RGBA8 until they're
+    // stored. Convert is non zero when the target, or the target it's a view of, has pixels of its own in a
+    // different format to its window, and has what changed converted into the window as it presents
+    uint32_t format;
+    uint32_t pixel_bytes;
+    uint32_t convert;
+
+    // Window the target draws into, cpu_mem is null for offscreen targets
+    LapisWindow window;
+
+    // Kernels used to map vertices and set up triangles
+    const SoftKernels* kernels;
+
+    // Views draw into their parent's pixels at x, y. origin is where pixel 0,0 is in the outermost target,
+    // which is where the window sees it
+    struct SoftTarget* parent;
+    uint32_t x;
+    uint32_t y;
+    uint32_t origin_x;
+    uint32_t origin_y;
+
+    // Clears only mark tiles, a tile is filled when something is first drawn over it or when the target is
+    // flushed, and never when a triangle covers all of it. Views fill their tiles as soon as they're cleared
+    SoftTileClear* tile_clears;
+    uint32_t clear_pending;  // At least one tile has a clear waiting
+
+    // Depth buffer, null when the target doesn't have one. Rows are width floats apart even for views.
+    // Clearing resets the ranges of every tile and block straight away, and the depth along with the pixels
+    SoftDepthRange* tile_depth;
+    SoftDepthRange* block_depth;
+    uint32_t blocks_x;
+    float* depth;
+
+    // Binning state, context.cpu_mem is null when the target draws immediately
+    LapisContext context;
+    uint32_t tiles_x;
+    uint32_t tiles_y;
+    SoftBin* bins;
+    SoftTriangle* triangles;
+    uint32_t triangle_count;
+    uint32_t triangle_capacity;
+    SoftBinChunk* chunks;
+    uint32_t chunk_count;
+    uint32_t chunk_capacity;
+
+    // Recorded commands, a capacity of 0 runs every call as it's made. Everything recorded runs at once, so
+    // recording always starts again from the front of the buffer. Commands go into record, which moves on to
+    // the next buffer once the frame it was scheduled in has been swapped
+    SoftCommandBuffer buffers[LAPIS_MAX_FRAMES_IN_FLIGHT];
+    SoftCommandBuffer* record;
+    uint32_t buffer_count;
+    uint32_t command_capacity;  // Bytes in each buffer
+
+    // Pixels changed and what culling did since the target was last scheduled
+    SoftRect dirty[LAPIS_MAX_DIRTY_RECTS];
+    uint32_t dirty_count;
+    uint32_t cull_flags;  // LapisCullFlags
+    LapisCullStats cull_stats;
+
+    // What recent scheduled frames did, the queries read the newest one whose fence has been reached
+    SoftFrameResult results[SOFT_FRAME_RESULTS];
+} SoftTarget;
+
+// Sizes a target as if its context had this many workers and its window had this format, which lets bundles
+// size targets up front
+LapisReturnCode soft_size_target(LapisSize* size, const LapisTargetHelper* helper, uint32_t workers,
+                                 uint32_t window_format);
+
+// Converts a float color into the packed pixel format
+uint32_t soft_pack_color(const float* color);
+
+// Converts a packed color into a target's format and back with the helpers lapis_convert_pixels uses. Lapis
+// only draws opaque pixels, so RGB5A3 is always packed as RGB555
+uint32_t soft_pack_format(uint32_t format, uint32_t color);
+uint32_t soft_unpack_format(uint32_t format, uint32_t pixel);
+
+// Best kernels the cpu running this supports
+const SoftKernels* soft_select_kernels();
+
+// Every set of kernels, the scalar ones work everywhere
+extern const SoftKernels soft_kernels_scalar;
+#if defined(SOFT_KERNELS_X86)
+extern const SoftKernels soft_kernels_sse2;
+extern const SoftKernels soft_kernels_avx2;
+
+// Asks the cpu and the os whether avx2 can be used
+int soft_x86_has_avx2();
+#elif defined(SOFT_KERNELS_NEON)
+extern const SoftKernels soft_kernels_neon;
+#endif
+
+// Kernels hand the lanes which don't fill a whole vector to these, so the result is the same either way
+void soft_load_aos_lane(SoftBatch* batch, uint32_t lane, const float* pos, const float* col, float width,
+                        float height);
+void soft_load_soa_lane(SoftBatch* batch, uint32_t lane, const LapisVertexStreams* streams, uint32_t vertex,
+                        float width, float height);
+void soft_setup_lane(SoftBatch* batch, uint32_t lane, const SoftRect* clip, uint32_t facing);
+
+// Copies triangles which are already in pixels into a batch
+void soft_load_vertices(SoftBatch* batch, const SoftVertex* v, uint32_t count);
+
+// The other way round, so recorded draws are mapped by the same kernels as ones drawn straight away
+void soft_store_vertices(SoftVertex* v, const SoftBatch* batch, uint32_t count);
+
+// Fills in a triangle from a lane of a batch which has been set up
+void soft_finish_triangle(SoftTriangle* tri, const SoftBatch* batch, uint32_t lane);
+
+// Returns 1 if every pixel in the rectangle is inside of the triangle
+int soft_triangle_covers(const SoftTriangle* tri, const SoftRect* rect);
+
+/**
+ * @brief Finds the nearest and furthest depth of a triangle's plane at any pixel of a rectangle. The plane is
+ * evaluated the same way the rasterizer does, which only ever grows towards the corners, so the range holds
+ * every depth the triangle can write there exactly
+ * @param tri The triangle
+ * @param rect Pixels to look at, can't be empty
+ * @param range Filled in with the range
+ */
+void soft_triangle_depth(const SoftTriangle* tri, const SoftRect* rect, SoftDepthRange* range);
+
+/**
+ * @brief Rasterizes a triangle which has been through soft_finish_triangle
+ * @param tri The triangle to rasterize
+ * @param target The target to draw into
+ * @param clip Only pixels inside of this rectangle are touched
+ */
+void soft_raster_triangle(const SoftTriangle* tri, SoftTarget* target, const SoftRect* clip);
+
+// Fills a rectangle of the target with a packed color
+void soft_fill_rect(SoftTarget* target, const SoftRect* rect, uint32_t color);
+
+// Fills a rectangle of the depth buffer with the far depth, the block and tile ranges are left alone
+void soft_clear_depth(SoftTarget* target, const SoftRect* rect);
+
+// Points a window target or a view of one at the window's current back buffer, which moves every swap. Views
+// flush their parent first so nothing the parent drew earlier lands on top of the view later
+void soft_bind_target(SoftTarget* target);
+
+// Sets up the triangles in a batch which has been loaded then draws them, either straight away or into the
+// bins
+void soft_submit_batch(SoftTarget* target, SoftBatch* batch, uint32_t count);
+
+// Draws triangles in pixel coordinates, 3 vertices each
+void soft_submit_triangles(SoftTarget* target, const SoftVertex* v, uint32_t count);
+
+// Most pieces clipping a triangle to the guard band can split it into, each of the 4 sides adds a corner
+#define SOFT_CLIP_TRIANGLES (5)
+
+/**
+ * @brief Clips a triangle which reaches past the guard band into pieces which fit inside of it
+ * @returns e_soft_cull_none if there are pieces to draw, otherwise why the whole triangle was thrown away
+ * @param target Target the triangle is being drawn into
+ * @param batch Batch holding the triangle
+ * @param lane Lane of the triangle
+ * @param out Filled in with 3 vertices per piece, room for SOFT_CLIP_TRIANGLES pieces
+ * @param count Filled in with the number of pieces
+ */
+SoftCull soft_clip_lane(const SoftTarget* target, const SoftBatch* batch, uint32_t lane, SoftVertex* out,
+                        uint32_t* count);
+
+// Returns 1 if a triangle which has been set up is only a few pixels across and misses every pixel centre
+int soft_lane_misses(const SoftBatch* batch, uint32_t lane);
+
+// Adds whether a triangle was drawn, or why it was thrown away, to the statistics
+void soft_count_cull(LapisCullStats* stats, SoftCull cull);
+
+// Rasterizes everything that has been binned and empties the bins, then fills any tiles still waiting on a
+// clear
+void soft_flush(SoftTarget* target);
+
+// Marks every tile to be cleared to a packed color
+void soft_clear(SoftTarget* target, uint32_t color);
+
+// Fills every tile still waiting on a clear, without drawing anything binned
+void soft_resolve_clears(SoftTarget* target);
+
+// Records a clear, anything recorded before it would be painted over so it's thrown away
+void soft_record_clear(SoftTarget* target, uint32_t color);
+
+/**
+ * @brief Makes room for triangles at the end of the current draw batch, running what's been recorded so far
+ * if the buffer is full
+ * @returns Where to write 3 vertices per triangle
+ * @param target The target to record into
+ * @param count Number of triangles wanted, reduced to how many there was room for
+ */
+SoftVertex* soft_record_triangles(SoftTarget* target, uint32_t* count);
+
+// Grows the bounds of the draw being recorded to cover triangles written by soft_record_triangles
+void soft_record_bounds(SoftTarget* target, const SoftVertex* v, uint32_t count);
+
+// Records a mesh draw, which ends the current draw batch
+void soft_record_mesh(SoftTarget* target, const SoftMesh* mesh, const float* transform);
+
+/**
+ * @brief Records quads as a command of their own, running what's been recorded so far if the buffer is full
+ * @param target The target to record into
+ * @param coverage Texture the quads are cut from
+ * @param quads The quads to copy into the command
+ * @param count Number of quads wanted, reduced to how many there was room for
+ * @param color Packed color of the quads
+ */
+void soft_record_quads(SoftTarget* target, const LapisCoverage* coverage, const LapisQuad* quads,
+                       uint32_t* count, uint32_t color);
+
+// Grows a rectangle to cover the pixels quads draw into
+void soft_quad_bounds(const SoftTarget* target, const LapisCoverage* coverage, const LapisQuad* quads,
+                      uint32_t count, SoftRect* bounds);
+
+// Blends quads into the target on the calling thread once everything drawn before them has landed, the
+// target has to be bound first
+void soft_draw_quads(SoftTarget* target, const LapisCoverage* coverage, const LapisQuad* quads,
+                     uint32_t count, uint32_t color);
+
+// Buffer the next command should be recorded into, moving on from the current one if it's been swapped
+SoftCommandBuffer* soft_record_buffer(SoftTarget* target);
+
+// Runs every command recorded into a buffer then rasterizes whatever that binned, the buffer is left empty
+void soft_execute(SoftTarget* target, SoftCommandBuffer* buffer);
+
+// Grows a rectangle to cover vertices in pixel coordinates, clamped to the target
+void soft_vertex_bounds(const SoftTarget* target, const SoftVertex* v, uint32_t count, SoftRect* bounds);
+
+// Grows a rectangle to cover the triangles loaded into a batch
+void soft_batch_bounds(const SoftTarget* target, const SoftBatch* batch, uint32_t count, SoftRect* bounds);
+
+// Rectangle covering the whole target
+void soft_full_rect(const SoftTarget* target, SoftRect* rect);
+
+// Grows a rectangle to cover a mesh once it's been transformed
+void soft_mesh_bounds(const SoftTarget* target, const SoftMesh* mesh, const float* transform,
+                      SoftRect* bounds);
+
+// Transforms and draws every triangle of a mesh, the target has to be bound first
+void soft_draw_mesh(SoftTarget* target, const SoftMesh* mesh, const float* transform);
+
+// Adds a rectangle to the pixels changed this frame, and tells the window the target draws into. Covered is
+// non zero only when every pixel of the rectangle is written, which is only true of clears
+void soft_mark_dirty(SoftTarget* target, const SoftRect* rect, uint32_t covered);
+
+// Called once the target has been scheduled, the changed pixels and culling become the frame's result and
+// targets which convert copy the changed pixels into the window
+void soft_end_frame(SoftTarget* target, SoftFrameResult* result);
+
+// Newest result of a frame whose fence has been reached, null before any has been
+const SoftFrameResult* soft_reached_result(SoftTarget* target);
+
+#endif  // !__LAPIS_GFX_SOFT_INTERNAL_HEADER_H__
@@ -0,0 +1,369 @@
+#include <math.h>
+
+#include "soft_gfx.h"
+
+// Pixel rectangle covered by a tile, clamped to the target
+static void soft_tile_rect(const SoftTarget* target, uint32_t tile, SoftRect* rect)
+{
+    uint32_t tx = tile % target->tiles_x;
+    uint32_t ty = tile / target->tiles_x;
+    rect->min_x = (int32_t)(tx * SOFT_TILE_SIZE);
+    rect->min_y = (int32_t)(ty * SOFT_TILE_SIZE);
+    rect->max_x = rect->min_x + SOFT_TILE_SIZE;
+    rect->max_y = rect->min_y + SOFT_TILE_SIZE;
+    if (rect->max_x > (int32_t)target->width) rect->max_x = (int32_t)target->width;
+    if (rect->max_y > (int32_t)target->height) rect->max_y = (int32_t)target->height;
+}
+
+void soft_full_rect(const SoftTarget* target, SoftRect* rect)
+{
+    rect->min_x = 0;
+    rect->min_y = 0;
+    rect->max_x = (int32_t)target->width;
+    rect->max_y = (int32_t)target->height;
+}
+
+// Appends a triangle to the end of a tile's list, the caller makes sure there is a free chunk
+static void soft_bin_append(SoftTarget* target, SoftBin* bin, uint32_t triangle)
+{
+    SoftBinChunk* tail = bin->tail != SOFT_BIN_NONE ? &target->chunks[bin->tail] : NULL;
+    if (!tail || tail->count == SOFT_BIN_CHUNK) {
+        uint32_t index = target->chunk_count++;
+        SoftBinChunk* chunk = &target->chunks[index];
+        chunk->next = SOFT_BIN_NONE;
+        chunk->count = 0;
+        if (tail) {
+            tail->next = index;
+        } else {
+            bin->head = index;
+        }
+        bin->tail = index;
+        tail = chunk;
+    }
+    tail->triangles[tail->count++] = triangle;
+}
+
+// Empties every bin without drawing anything
+static void soft_reset_bins(SoftTarget* target)
+{
+    uint32_t i;
+    for (i = 0; i < target->tiles_x * target->tiles_y; i++) {
+        target->bins[i].head = SOFT_BIN_NONE;
+        target->bins[i].tail = SOFT_BIN_NONE;
+    }
+    target->triangle_count = 0;
+    target->chunk_count = 0;
+}
+
+// Returns 1 if drawing the triangle is going to write every pixel in a freshly cleared rectangle. With a
+// depth buffer it also has to pass the depth test everywhere
+static int soft_triangle_hides(const SoftTarget* target, const SoftTriangle* tri, const SoftRect* rect)
+{
+    SoftDepthRange range;
+    if (!soft_triangle_covers(tri, rect)) return 0;
+    if (!target->depth) return 1;
+    soft_triangle_depth(tri, rect, &range);
+    return range.max <= SOFT_DEPTH_FAR;
+}
+
+// Writes a tile's waiting clear into its pixels, unless the triangle is going to hide the whole tile anyway.
+// The depth is always cleared, since triangles drawn before the one hiding the tile are tested against it
+static void soft_resolve_tile(SoftTarget* target, uint32_t tile, const SoftRect* rect,
+                              const SoftTriangle* tri)
+{
+    SoftTileClear* clear = &target->tile_clears[tile];
+    if (!clear->pending) return;
+    clear->pending = 0;
+    if (target->depth) soft_clear_depth(target, rect);
+    if (!tri || !soft_triangle_hides(target, tri, rect)) soft_fill_rect(target, rect, clear->color);
+}
+
+// Returns 1 if a triangle could pass the depth test somewhere inside of a tile. The tile's range is only
+// ever further than the depth really is, since depth only gets nearer until the next clear
+static int soft_tile_visible(const SoftTarget* target, const SoftTriangle* tri, uint32_t tile)
+{
+    SoftDepthRange range;
+    SoftRect rect;
+    if (!target->depth) return 1;
+    soft_tile_rect(target, tile, &rect);
+    if (rect.min_x < tri->bounds.min_x) rect.min_x = tri->bounds.min_x;
+    if (rect.min_y < tri->bounds.min_y) rect.min_y = tri->bounds.min_y;
+    if (rect.max_x > tri->bounds.max_x) rect.max_x = tri->bounds.max_x;
+    if (rect.max_y > tri->bounds.max_y) rect.max_y = tri->bounds.max_y;
+    soft_triangle_depth(tri, &rect, &range);
+    return range.min <= target->tile_depth[tile].max;
+}
+
+// Depth planes which aren't finite can't be tested against, so those triangles are treated as hidden
+static int soft_depth_finite(const SoftTarget* target, const SoftTriangle* tri)
+{
+    if (!target->depth) return 1;
+    return tri->z_c - tri->z_c == 0.0f && tri->z_dx - tri->z_dx == 0.0f && tri->z_dy - tri->z_dy == 0.0f;
+}
+
+// Resolves the clears of every tile a triangle touches before it's drawn straight away
+static void soft_resolve_triangle(SoftTarget* target, const SoftTriangle* tri)
+{
+    uint32_t tx0 = (uint32_t)tri->bounds.min_x / SOFT_TILE_SIZE;
+    uint32_t ty0 = (uint32_t)tri->bounds.min_y / SOFT_TILE_SIZE;
+    uint32_t tx1 = (uint32_t)(tri->bounds.max_x - 1) / SOFT_TILE_SIZE;
+    uint32_t ty1 = (uint32_t)(tri->bounds.max_y - 1) / SOFT_TILE_SIZE;
+    uint32_t tx, ty, tile;
+    SoftRect rect;
+
+    for (ty = ty0; ty <= ty1; ty++) {
+        for (tx = tx0; tx <= tx1; tx++) {
+            tile = ty * target->tiles_x + tx;
+            soft_tile_rect(target, tile, &rect);
+            soft_resolve_tile(target, tile, &rect, tri);
+        }
+    }
+}
+
+// Returns 1 if a triangle could pass the depth test in any of the tiles it touches
+static int soft_triangle_visible(const SoftTarget* target, const SoftTriangle* tri)
+{
+    uint32_t tx0 = (uint32_t)tri->bounds.min_x / SOFT_TILE_SIZE;
+    uint32_t ty0 = (uint32_t)tri->bounds.min_y / SOFT_TILE_SIZE;
+    uint32_t tx1 = (uint32_t)(tri->bounds.max_x - 1) / SOFT_TILE_SIZE;
+    uint32_t ty1 = (uint32_t)(tri->bounds.max_y - 1) / SOFT_TILE_SIZE;
+    uint32_t tx, ty;
+
+    if (!target->depth) return 1;
+    if (!soft_depth_finite(target, tri)) return 0;
+    for (ty = ty0; ty <= ty1; ty++) {
+        for (tx = tx0; tx <= tx1; tx++) {
+            if (soft_tile_visible(target, tri, ty * target->tiles_x + tx)) return 1;
+        }
+    }
+    return 0;
+}
+
+// Draws a triangle which has been set up straight away, or bins it into the tiles where it could be seen.
+// Returns e_soft_cull_occluded if it's behind the depth of every tile it touches
+static SoftCull soft_submit_lane(SoftTarget* target, const SoftBatch* batch, uint32_t lane)
+{
+    SoftTriangle* tri;
+    uint32_t tx0, ty0, tx1, ty1, tx, ty, tiles, tile, binned = 0;
+
+    if (!target->context.cpu_mem) {
+        SoftTriangle immediate;
+        SoftRect clip;
+        soft_finish_triangle(&immediate, batch, lane);
+        if (!soft_triangle_visible(target, &immediate)) return e_soft_cull_occluded;
+        soft_full_rect(target, &clip);
+        if (target->clear_pending) soft_resolve_triangle(target, &immediate);
+        soft_raster_triangle(&immediate, target, &clip);
+        return e_soft_cull_none;
+    }
+
+    if (target->triangle_count == target->triangle_capacity) soft_flush(target);
+    tri = &target->triangles[target->triangle_count];
+    soft_finish_triangle(tri, batch, lane);
+    if (!soft_depth_finite(target, tri)) return e_soft_cull_occluded;
+
+    tx0 = (uint32_t)tri->bounds.min_x / SOFT_TILE_SIZE;
+    ty0 = (uint32_t)tri->bounds.min_y / SOFT_TILE_SIZE;
+    tx1 = (uint32_t)(tri->bounds.max_x - 1) / SOFT_TILE_SIZE;
+    ty1 = (uint32_t)(tri->bounds.max_y - 1) / SOFT_TILE_SIZE;
+
+    // Every tile could need a fresh chunk, if there isn't room then draw what's binned so far first. The
+    // triangle has to be moved to the front of the now empty triangle list
+    tiles = (tx1 - tx0 + 1) * (ty1 - ty0 + 1);
+    if (target->chunk_count + tiles > target->chunk_capacity) {
+        SoftTriangle moved = *tri;
+        soft_flush(target);
+        tri = &target->triangles[0];
+        *tri = moved;
+    }
+
+    // The depth ranges were worked out by the last flush, anything binned since can only have made them
+    // nearer so they're safe to test against
+    for (ty = ty0; ty <= ty1; ty++) {
+        for (tx = tx0; tx <= tx1; tx++) {
+            tile = ty * target->tiles_x + tx;
+            if (!soft_tile_visible(target, tri, tile)) continue;
+            soft_bin_append(target, &target->bins[tile], target->triangle_count);
+            binned = 1;
+        }
+    }
+    if (!binned) return e_soft_cull_occluded;
+    target->triangle_count++;
+    return e_soft_cull_none;
+}
+
+static void soft_draw_batch(SoftTarget* target, SoftBatch* batch, uint32_t count);
+
+// Draws the pieces of a triangle which reaches past the guard band
+static void soft_draw_clipped(SoftTarget* target, const SoftBatch* batch, uint32_t lane)
+{
+    SoftVertex pieces[SOFT_CLIP_TRIANGLES * 3];
+    SoftBatch clipped;
+    uint32_t count;
+    SoftCull cull = soft_clip_lane(target, batch, lane, pieces, &count);
+    if (cull != e_soft_cull_none) {
+        soft_count_cull(&target->cull_stats, cull);
+        return;
+    }
+
+    target->cull_stats.clipped++;
+    soft_load_vertices(&clipped, pieces, count);
+    soft_draw_batch(target, &clipped, count);
+}
+
+// Sets up, culls and draws a batch which has been loaded
+static void soft_draw_batch(SoftTarget* target, SoftBatch* batch, uint32_t count)
+{
+    const uint32_t width = target->kernels->width;
+    const uint32_t flags = target->cull_flags;
+    uint32_t padded = (count + width - 1) / width * width;
+    uint32_t lane, k;
+    SoftCull cull;
+    SoftRect clip;
+
+    // Lanes past the end are filled with NaNs, which setup always rejects
+    for (lane = count; lane < padded; lane++) {
+        for (k = 0; k < 3; k++) {
+            batch->x[k][lane] = NAN;
+            batch->y[k][lane] = NAN;
+            batch->z[k][lane] = 0.0f;
+            batch->color[k][0][lane] = batch->color[k][1][lane] = batch->color[k][2][lane] = 0.0f;
+        }
+    }
+
+    soft_full_rect(target, &clip);
+    target->kernels->setup(batch, padded, &clip, flags & (e_lapis_cull_back | e_lapis_cull_front));
+    for (lane = 0; lane < count; lane++) {
+        cull = (SoftCull)batch->cull[lane];
+        if (cull == e_soft_cull_guard_band && (flags & e_lapis_cull_clip)) {
+            soft_draw_clipped(target, batch, lane);
+            continue;
+        }
+        if (cull == e_soft_cull_none && (flags & e_lapis_cull_small) && soft_lane_misses(batch, lane)) {
+            cull = e_soft_cull_small;
+        }
+        if (cull == e_soft_cull_none) cull = soft_submit_lane(target, batch, lane);
+        soft_count_cull(&target->cull_stats, cull);
+    }
+}
+
+void soft_submit_batch(SoftTarget* target, SoftBatch* batch, uint32_t count)
+{
+    target->cull_stats.submitted += count;
+    soft_draw_batch(target, batch, count);
+}
+
+void soft_submit_triangles(SoftTarget* target, const SoftVertex* v, uint32_t count)
+{
+    SoftBatch batch;
+    uint32_t first, batch_count;
+    for (first = 0; first < count; first += batch_count) {
+        batch_count = count - first < SOFT_BATCH ? count - first : SOFT_BATCH;
+        soft_load_vertices(&batch, v + first * 3, batch_count);
+        soft_submit_batch(target, &batch, batch_count);
+    }
+}
+
+// Finds a triangle binned into a tile which hides all of it
+static const SoftTriangle* soft_find_cover(const SoftTarget* target, const SoftBin* bin, const SoftRect* rect)
+{
+    const SoftTriangle* tri;
+    uint32_t chunk, i;
+    for (chunk = bin->head; chunk != SOFT_BIN_NONE; chunk = target->chunks[chunk].next) {
+        const SoftBinChunk* c = &target->chunks[chunk];
+        for (i = 0; i < c->count; i++) {
+            tri = &target->triangles[c->triangles[i]];
+            if (soft_triangle_hides(target, tri, rect)) return tri;
+        }
+    }
+    return NULL;
+}
+
+// Worker task, resolves the tile's clear then rasterizes every triangle binned into it. The clear and the
+// triangles all land while the tile is still in cache
+static void soft_flush_tile(void* user, uint32_t tile, uint32_t worker)
+{
+    SoftTarget* target = (SoftTarget*)user;
+    SoftBin* bin = &target->bins[tile];
+    SoftRect rect;
+    uint32_t chunk, i;
+
+    soft_tile_rect(target, tile, &rect);
+    if (target->tile_clears[tile].pending) {
+        soft_resolve_tile(target, tile, &rect, soft_find_cover(target, bin, &rect));
+    }
+    for (chunk = bin->head; chunk != SOFT_BIN_NONE; chunk = target->chunks[chunk].next) {
+        const SoftBinChunk* c = &target->chunks[chunk];
+        for (i = 0; i < c->count; i++) {
+            soft_raster_triangle(&target->triangles[c->triangles[i]], target, &rect);
+        }
+    }
+    bin->head = SOFT_BIN_NONE;
+    bin->tail = SOFT_BIN_NONE;
+}
+
+void soft_flush(SoftTarget* target)
+{
+    if (!target->context.cpu_mem) {
+        soft_resolve_clears(target);
+        return;
+    }
+    if (!target->triangle_count && !target->clear_pending) return;
+    lapis_context_parallel_for(&target->context, soft_flush_tile, target, target->tiles_x * target->tiles_y);
+    target->triangle_count = 0;
+    target->chunk_count = 0;
+    target->clear_pending = 0;
+}
+
+// Worker task, fills one tile if it's still waiting on a clear
+static void soft_clear_tile(void* user, uint32_t tile, uint32_t worker)
+{
+    SoftTarget* target = (SoftTarget*)user;
+    SoftRect rect;
+    soft_tile_rect(target, tile, &rect);
+    soft_resolve_tile(target, tile, &rect, NULL);
+}
+
+void soft_resolve_clears(SoftTarget* target)
+{
+    uint32_t tiles = target->tiles_x * target->tiles_y;
+    uint32_t i;
+    if (!target->clear_pending) return;
+    if (target->context.cpu_mem) {
+        lapis_context_parallel_for(&target->context, soft_clear_tile, target, tiles);
+    } else {
+        for (i = 0; i < tiles; i++) {
+            soft_clear_tile(target, i, 0);
+        }
+    }
+    target->clear_pending = 0;
+}
+
+void soft_clear(SoftTarget* target, uint32_t color)
+{
+    uint32_t i, blocks;
+
+    // Anything binned before the clear would be completely overwritten, so it's dropped rather than drawn
+    if (target->context.cpu_mem) soft_reset_bins(target);
+    for (i = 0; i < target->tiles_x * target->tiles_y; i++) {
+        target->tile_clears[i].pending = 1;
+        target->tile_clears[i].color = color;
+    }
+
+    // The depth ranges are reset now so triangles drawn before the tiles are filled are tested against the
+    // cleared depth
+    if (target->depth) {
+        for (i = 0; i < target->tiles_x * target->tiles_y; i++) {
+            target->tile_depth[i].min = target->tile_depth[i].max = SOFT_DEPTH_FAR;
+        }
+        blocks = target->blocks_x * ((target->height + SOFT_BLOCK_SIZE - 1) / SOFT_BLOCK_SIZE);
+        for (i = 0; i < blocks; i++) {
+            target->block_depth[i].min = target->block_depth[i].max = SOFT_DEPTH_FAR;
+        }
+    }
+    target->clear_pending = 1;
+
+    // A view's tiles are its parent's pixels, and the parent has no way to know they're waiting on a clear
+    // before drawing over them. Views fill straight away so whatever the parent draws next lands on top
+    if (target->parent) soft_resolve_clears(target);
+}
@@ -0,0 +1,116 @@
+#include "soft_gfx.h"
+
+// Points an object at its part of the bundle's memory
+static void soft_bundle_place(LapisStructure* bundle, const LapisSize* size, size_t cpu_offset,
+                              size_t gpu_offset, LapisStructure* object)
+{
+    object->cpu_mem = (uint8_t*)bundle->cpu_mem + cpu_offset;
+    object->gpu_mem = size->gpu_size ? (uint8_t*)bundle->gpu_mem + gpu_offset : NULL;
+}
+
+// Walks through the bundle in creation order. Without memory the bundle is only sized, with memory every
+// object is placed and created as it's reached. Window targets are always laid out at the size the window
+// asked for so both walks agree on where everything lives
+static LapisReturnCode soft_bundle_walk(LapisSize* total, LapisBundleHelper* helper, LapisStructure* bundle,
+                                        LapisContext* context, LapisWindow* window, LapisTarget* targets)
+{
+    LapisContextHelper defaults = {1};
+    LapisContextHelper* context_helper = helper->context ? helper->context : &defaults;
+    uint32_t workers = context_helper->worker_count ? context_helper->worker_count : 1;
+    LapisTargetHelper target_helper;
+    LapisFramebuffer framebuffer;
+    LapisSize size, created;
+    size_t cpu_offset, gpu_offset;
+    LapisReturnCode code;
+    int window_created = 0;
+    uint32_t i;
+
+    total->cpu_size = 0;
+    total->gpu_size = 0;
+    total->gpu_align = 1;
+
+    lapis_size_context(&size);
+    lapis_bundle_add(total, &size, &cpu_offset, &gpu_offset);
+    if (bundle) {
+        soft_bundle_place(bundle, &size, cpu_offset, gpu_offset, context);
+        code = lapis_create_context(context, context_helper);
+        if (code != e_lapis_return_success) return code;
+    }
+
+    if (helper->window) {
+        code = lapis_size_window(&size, helper->window);
+        if (code == e_lapis_return_success) code = lapis_bundle_add(total, &size, &cpu_offset, &gpu_offset);
+        if (code == e_lapis_return_success && bundle) {
+            soft_bundle_place(bundle, &size, cpu_offset, gpu_offset, window);
+            code = lapis_create_window(context, window, helper->window);
+            window_created = code == e_lapis_return_success;
+        }
+        if (code != e_lapis_return_success) goto failed;
+    }
+
+    for (i = 0; i < helper->target_count; i++) {
+        target_helper = helper->targets[i];
+        target_helper.context = context;
+        target_helper.window = NULL;
+        target_helper.parent = NULL;
+        if (helper->window && !target_helper.width && !target_helper.height) {
+            target_helper.width = helper->window->width;
+            target_helper.height = helper->window->height;
+            target_helper.window = window;
+            if (!target_helper.command_buffers) {
+                target_helper.command_buffers = helper->window->frames_in_flight;
+            }
+        }
+        soft_size_target(&size, &target_helper, workers,
+                         target_helper.window ? helper->window->format : e_lapis_format_rgba8);
+        lapis_bundle_add(total, &size, &cpu_offset, &gpu_offset);
+        if (!bundle) continue;
+
+        // The window might not have been given the size it asked for
+        if (target_helper.window) {
+            code = lapis_window_get_framebuffer(window, &framebuffer);
+            if (code != e_lapis_return_success) goto failed;
+            target_helper.width = framebuffer.width;
+            target_helper.height = framebuffer.height;
+            lapis_size_target(&created, &target_helper);
+            if (created.cpu_size > size.cpu_size || created.gpu_size > size.gpu_size) {
+                code = e_lapis_return_out_of_memory;
+                goto failed;
+            }
+        }
+        soft_bundle_place(bundle, &size, cpu_offset, gpu_offset, &targets[i]);
+        code = lapis_create_gfx_target(&targets[i], &target_helper);
+        if (code != e_lapis_return_success) goto failed;
+        helper->targets[i] = target_helper;
+    }
+    return e_lapis_return_success;
+
+failed:
+    if (bundle) {
+        if (window_created) lapis_destroy_window(window);
+        lapis_destroy_context(context);
+    }
+    return code;
+}
+
+LapisReturnCode lapis_size_bundle(LapisSize* size, LapisBundleHelper* helper)
+{
+    // Targets only check the context and window are there while being sized, neither has to exist yet
+    LapisContext context;
+    LapisWindow window;
+    if (!size || !helper) return e_lapis_return_invalid_argument;
+    if (helper->target_count && !helper->targets) return e_lapis_return_invalid_argument;
+    return soft_bundle_walk(size, helper, NULL, &context, &window, NULL);
+}
+
+LapisReturnCode lapis_create_bundle(LapisStructure* bundle, LapisBundleHelper* helper, LapisContext* context,
+                                    LapisWindow* window, LapisTarget* targets)
+{
+    LapisSize size;
+    if (!bundle || !helper || !context || !bundle->cpu_mem) return e_lapis_return_invalid_argument;
+    if ((helper->window && !window) || (helper->target_count && (!helper->targets || !targets))) {
+        return e_lapis_return_invalid_argument;
+    }
+    if ((uintptr_t)bundle->cpu_mem & (LAPIS_CPU_ALIGN - 1)) return e_lapis_return_invalid_argument;
+    return soft_bundle_walk(&size, helper, bundle, context, window, targets);
+}
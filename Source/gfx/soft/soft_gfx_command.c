@@ -0,0 +1,193 @@
+#include <string.h>
+
+#include "soft_gfx.h"
+
+#define SOFT_TRIANGLE_BYTES (3 * sizeof(SoftVertex))
+
+SoftCommandBuffer* soft_record_buffer(SoftTarget* target)
+{
+    SoftCommandBuffer* next;
+
+    // Only a buffer whose frame has been swapped is done with, it might still be scheduled again until then
+    if (!target->record->fence || target->record->fence == lapis_window_get_fence(&target->window)) {
+        return target->record;
+    }
+
+    // The window may still be running the last frame recorded into the next buffer
+    next = &target->buffers[(target->record - target->buffers + 1) % target->buffer_count];
+    if (next->fence) lapis_window_wait_fence(&target->window, next->fence);
+    next->used = 0;
+    next->draw = SOFT_COMMAND_NONE;
+    next->fence = 0;
+    target->record = next;
+    return next;
+}
+
+// Runs what's been recorded so far to make room for more. Frames still in flight draw into the same pixels
+// and bins, so the window has to finish them first
+static void soft_record_flush(SoftTarget* target)
+{
+    uint64_t fence = lapis_window_get_fence(&target->window);
+    if (fence > 1) lapis_window_wait_fence(&target->window, fence - 1);
+    soft_execute(target, target->record);
+}
+
+void soft_record_clear(SoftTarget* target, uint32_t color)
+{
+    SoftCommandBuffer* buffer = soft_record_buffer(target);
+    SoftCommand* command = (SoftCommand*)buffer->commands;
+    command->type = e_soft_command_clear;
+    command->count = 0;
+    command->color = color;
+    command->bytes = 0;
+    soft_full_rect(target, &command->bounds);
+    buffer->used = sizeof(SoftCommand);
+    buffer->draw = SOFT_COMMAND_NONE;
+}
+
+SoftVertex* soft_record_triangles(SoftTarget* target, uint32_t* count)
+{
+    SoftCommandBuffer* buffer = soft_record_buffer(target);
+    SoftCommand* draw;
+    SoftVertex* vertices;
+    uint32_t room;
+
+    // Start a new batch unless the last command was a draw
+    if (buffer->draw == SOFT_COMMAND_NONE) {
+        if (buffer->used + sizeof(SoftCommand) + SOFT_TRIANGLE_BYTES > target->command_capacity) {
+            soft_record_flush(target);
+        }
+        draw = (SoftCommand*)(buffer->commands + buffer->used);
+        draw->type = e_soft_command_draw;
+        draw->count = 0;
+        draw->bytes = 0;
+        draw->bounds.min_x = draw->bounds.min_y = 0x7FFFFFFF;
+        draw->bounds.max_x = draw->bounds.max_y = 0;
+        buffer->draw = buffer->used;
+        buffer->used += sizeof(SoftCommand);
+    }
+
+    room = (target->command_capacity - buffer->used) / SOFT_TRIANGLE_BYTES;
+    if (!room) {
+        soft_record_flush(target);
+        return soft_record_triangles(target, count);
+    }
+    if (*count > room) *count = room;
+
+    draw = (SoftCommand*)(buffer->commands + buffer->draw);
+    vertices = (SoftVertex*)(buffer->commands + buffer->used);
+    draw->count += *count;
+    draw->bytes += *count * SOFT_TRIANGLE_BYTES;
+    buffer->used += *count * SOFT_TRIANGLE_BYTES;
+    return vertices;
+}
+
+void soft_record_bounds(SoftTarget* target, const SoftVertex* v, uint32_t count)
+{
+    const SoftCommandBuffer* buffer = target->record;
+    SoftCommand* draw = (SoftCommand*)(buffer->commands + buffer->draw);
+    soft_vertex_bounds(target, v, count * 3, &draw->bounds);
+}
+
+void soft_record_mesh(SoftTarget* target, const SoftMesh* mesh, const float* transform)
+{
+    SoftCommandBuffer* buffer = soft_record_buffer(target);
+    const uint32_t bytes = sizeof(SoftCommand) + sizeof(SoftMeshCommand);
+    SoftCommand* command;
+    SoftMeshCommand draw;
+    if (buffer->used + bytes > target->command_capacity) soft_record_flush(target);
+
+    command = (SoftCommand*)(buffer->commands + buffer->used);
+    command->type = e_soft_command_mesh;
+    command->count = mesh->triangle_count;
+    command->bytes = sizeof(SoftMeshCommand);
+    command->bounds.min_x = command->bounds.min_y = 0x7FFFFFFF;
+    command->bounds.max_x = command->bounds.max_y = 0;
+    soft_mesh_bounds(target, mesh, transform, &command->bounds);
+
+    // Triangles before it leave commands only 4 byte aligned, so the payload is copied rather than written
+    draw.mesh = mesh;
+    memcpy(draw.transform, transform, sizeof(draw.transform));
+    memcpy(command + 1, &draw, sizeof(draw));
+
+    // Triangles drawn after the mesh have to stay after it
+    buffer->used += bytes;
+    buffer->draw = SOFT_COMMAND_NONE;
+}
+
+void soft_record_quads(SoftTarget* target, const LapisCoverage* coverage, const LapisQuad* quads,
+                       uint32_t* count, uint32_t color)
+{
+    SoftCommandBuffer* buffer = soft_record_buffer(target);
+    const uint32_t header = sizeof(SoftCommand) + sizeof(SoftQuadCommand);
+    SoftCommand* command;
+    SoftQuadCommand draw;
+    uint32_t room;
+    if (buffer->used + header + sizeof(LapisQuad) > target->command_capacity) soft_record_flush(target);
+
+    room = (target->command_capacity - buffer->used - header) / sizeof(LapisQuad);
+    if (*count > room) *count = room;
+    command = (SoftCommand*)(buffer->commands + buffer->used);
+    command->type = e_soft_command_quads;
+    command->count = *count;
+    command->bytes = sizeof(SoftQuadCommand) + *count * sizeof(LapisQuad);
+    command->bounds.min_x = command->bounds.min_y = 0x7FFFFFFF;
+    command->bounds.max_x = command->bounds.max_y = 0;
+    soft_quad_bounds(target, coverage, quads, *count, &command->bounds);
+
+    draw.coverage = *coverage;
+    draw.color = color;
+    memcpy(command + 1, &draw, sizeof(draw));
+    memcpy((uint8_t*)(command + 1) + sizeof(draw), quads, *count * sizeof(LapisQuad));
+    buffer->used += sizeof(SoftCommand) + command->bytes;
+    buffer->draw = SOFT_COMMAND_NONE;
+}
+
+void soft_execute(SoftTarget* target, SoftCommandBuffer* buffer)
+{
+    const SoftCommand* command;
+    const SoftVertex* vertices;
+    SoftMeshCommand mesh;
+    SoftQuadCommand quads;
+    uint32_t offset;
+
+    // Everything is marked dirty before anything is drawn so the window can prepare its back buffer
+    LAPIS_TRACE_BEGIN(e_lapis_stage_raster);
+    offset = 0;
+    while (offset < buffer->used) {
+        command = (const SoftCommand*)(buffer->commands + offset);
+        soft_mark_dirty(target, &command->bounds, command->type == e_soft_command_clear);
+        offset += sizeof(SoftCommand) + command->bytes;
+    }
+
+    soft_bind_target(target);
+    offset = 0;
+    while (offset < buffer->used) {
+        command = (const SoftCommand*)(buffer->commands + offset);
+        offset += sizeof(SoftCommand);
+        switch (command->type) {
+            case e_soft_command_clear:
+                soft_clear(target, command->color);
+                break;
+            case e_soft_command_draw:
+                vertices = (const SoftVertex*)(buffer->commands + offset);
+                soft_submit_triangles(target, vertices, command->count);
+                break;
+            case e_soft_command_mesh:
+                memcpy(&mesh, buffer->commands + offset, sizeof(mesh));
+                soft_draw_mesh(target, mesh.mesh, mesh.transform);
+                break;
+            case e_soft_command_quads:
+                memcpy(&quads, buffer->commands + offset, sizeof(quads));
+                soft_draw_quads(target, &quads.coverage,
+                                (const LapisQuad*)(buffer->commands + offset + sizeof(quads)), command->count,
+                                quads.color);
+                break;
+        }
+        offset += command->bytes;
+    }
+    buffer->used = 0;
+    buffer->draw = SOFT_COMMAND_NONE;
+    soft_flush(target);
+    LAPIS_TRACE_END(e_lapis_stage_raster);
+}
@@ -0,0 +1,153 @@
+#include <string.h>
+
+#include "soft_gfx.h"
+
+// Pieces of clipped triangles stay this far inside of the guard band, so setup always takes them
+#define SOFT_CLIP_BAND ((float)(SOFT_GUARD_BAND - 1))
+
+// Triangles with bounds of at most this many pixels are tested against each pixel centre
+#define SOFT_SMALL_PIXELS (4)
+
+// Most corners a triangle can have once it's been clipped by all 4 sides of the guard band
+#define SOFT_CLIP_CORNERS (7)
+
+// Clips a polygon to one side of the guard band, side is 1 or -1 and axis picks x or y
+static uint32_t soft_clip_side(const SoftVertex* in, uint32_t count, SoftVertex* out, int axis, float side)
+{
+    const SoftVertex* a;
+    const SoftVertex* b;
+    float da, db, t;
+    uint32_t i, k, written = 0;
+
+    for (i = 0; i < count; i++) {
+        a = &in[i];
+        b = &in[(i + 1) % count];
+        da = side * (axis ? a->y : a->x) - SOFT_CLIP_BAND;
+        db = side * (axis ? b->y : b->x) - SOFT_CLIP_BAND;
+        if (da <= 0.0f) out[written++] = *a;
+        if ((da <= 0.0f) == (db <= 0.0f)) continue;
+
+        // The edge crosses the side, the new corner is put exactly on it
+        t = da / (da - db);
+        out[written].x = a->x + (b->x - a->x) * t;
+        out[written].y = a->y + (b->y - a->y) * t;
+        out[written].z = a->z + (b->z - a->z) * t;
+        for (k = 0; k < 3; k++) out[written].color[k] = a->color[k] + (b->color[k] - a->color[k]) * t;
+        if (axis) out[written].y = side * SOFT_CLIP_BAND;
+        else out[written].x = side * SOFT_CLIP_BAND;
+        written++;
+    }
+    return written;
+}
+
+SoftCull soft_clip_lane(const SoftTarget* target, const SoftBatch* batch, uint32_t lane, SoftVertex* out,
+                        uint32_t* count)
+{
+    SoftVertex poly[2][SOFT_CLIP_CORNERS];
+    uint32_t corners = 3, side, i, k, left = 0, right = 0, above = 0, below = 0;
+    *count = 0;
+
+    for (k = 0; k < 3; k++) {
+        poly[0][k].x = batch->x[k][lane];
+        poly[0][k].y = batch->y[k][lane];
+        poly[0][k].z = batch->z[k][lane];
+        for (i = 0; i < 3; i++) poly[0][k].color[i] = batch->color[k][i][lane];
+
+        // Infinities and NaNs can't be clipped
+        if (!(poly[0][k].x - poly[0][k].x == 0.0f && poly[0][k].y - poly[0][k].y == 0.0f)) {
+            return e_soft_cull_guard_band;
+        }
+        left += poly[0][k].x < 0.0f;
+        right += poly[0][k].x > (float)target->width;
+        above += poly[0][k].y < 0.0f;
+        below += poly[0][k].y > (float)target->height;
+    }
+
+    // Most triangles which reach that far out are entirely past one side of the target
+    if (left == 3 || right == 3 || above == 3 || below == 3) return e_soft_cull_offscreen;
+
+    for (side = 0; side < 4 && corners; side++) {
+        corners = soft_clip_side(poly[side & 1], corners, poly[(side & 1) ^ 1], side >> 1,
+                                 side & 1 ? -1.0f : 1.0f);
+    }
+    if (corners < 3) return e_soft_cull_offscreen;
+
+    // Clipping keeps the polygon convex and in the same order, so it's drawn as a fan
+    for (i = 1; i + 1 < corners; i++) {
+        out[*count * 3] = poly[0][0];
+        out[*count * 3 + 1] = poly[0][i];
+        out[*count * 3 + 2] = poly[0][i + 1];
+        (*count)++;
+    }
+    return e_soft_cull_none;
+}
+
+int soft_lane_misses(const SoftBatch* batch, uint32_t lane)
+{
+    SoftTriangle tri;
+    SoftRect pixel;
+    int32_t x, y;
+    if ((batch->max_x[lane] - batch->min_x[lane]) * (batch->max_y[lane] - batch->min_y[lane]) >
+        SOFT_SMALL_PIXELS) {
+        return 0;
+    }
+
+    soft_finish_triangle(&tri, batch, lane);
+    for (y = tri.bounds.min_y; y < tri.bounds.max_y; y++) {
+        for (x = tri.bounds.min_x; x < tri.bounds.max_x; x++) {
+            pixel.min_x = x;
+            pixel.min_y = y;
+            pixel.max_x = x + 1;
+            pixel.max_y = y + 1;
+            if (soft_triangle_covers(&tri, &pixel)) return 0;
+        }
+    }
+    return 1;
+}
+
+void soft_count_cull(LapisCullStats* stats, SoftCull cull)
+{
+    switch (cull) {
+        case e_soft_cull_none:
+            stats->drawn++;
+            break;
+        case e_soft_cull_guard_band:
+            stats->guard_band++;
+            break;
+        case e_soft_cull_degenerate:
+            stats->degenerate++;
+            break;
+        case e_soft_cull_facing:
+            stats->facing++;
+            break;
+        case e_soft_cull_small:
+            stats->small++;
+            break;
+        case e_soft_cull_offscreen:
+            stats->offscreen++;
+            break;
+        case e_soft_cull_occluded:
+            stats->occluded++;
+            break;
+    }
+}
+
+LapisReturnCode lapis_gfx_target_set_cull(LapisTarget* target, uint32_t flags)
+{
+    if (!target || !target->cpu_mem) return e_lapis_return_invalid_argument;
+    ((SoftTarget*)target->cpu_mem)->cull_flags = flags;
+    return e_lapis_return_success;
+}
+
+LapisReturnCode lapis_gfx_target_get_cull_stats(LapisTarget* target, LapisCullStats* stats)
+{
+    const SoftFrameResult* result;
+    if (!target || !target->cpu_mem || !stats) return e_lapis_return_invalid_argument;
+    result = soft_reached_result((SoftTarget*)target->cpu_mem);
+    if (result) {
+        *stats = result->cull_stats;
+    } else {
+        memset(stats, 0, sizeof(*stats));
+    }
+    return e_lapis_return_success;
+}
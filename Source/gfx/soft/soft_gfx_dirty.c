@@ -0,0 +1,183 @@
+#include <string.h>
+
+#include "soft_gfx.h"
+
+// Clamps a pixel coordinate into 0 to limit, rounding down or up
+static int32_t soft_clamp_floor(float value, int32_t limit)
+{
+    if (!(value > 0.0f)) return 0;
+    if (value >= (float)limit) return limit;
+    return (int32_t)value;
+}
+
+static int32_t soft_clamp_ceil(float value, int32_t limit)
+{
+    int32_t whole;
+    if (!(value > 0.0f)) return 0;
+    if (value >= (float)limit) return limit;
+    whole = (int32_t)value;
+    return whole + ((float)whole < value);
+}
+
+// Grows bounds to cover a box in pixels, clamped to the target
+static void soft_grow_bounds(const SoftTarget* target, float min_x, float min_y, float max_x, float max_y,
+                             SoftRect* bounds)
+{
+    int32_t x0 = soft_clamp_floor(min_x, (int32_t)target->width);
+    int32_t y0 = soft_clamp_floor(min_y, (int32_t)target->height);
+    int32_t x1 = soft_clamp_ceil(max_x, (int32_t)target->width);
+    int32_t y1 = soft_clamp_ceil(max_y, (int32_t)target->height);
+
+    // An empty bounds has its min past its max
+    if (x0 < bounds->min_x) bounds->min_x = x0;
+    if (y0 < bounds->min_y) bounds->min_y = y0;
+    if (x1 > bounds->max_x) bounds->max_x = x1;
+    if (y1 > bounds->max_y) bounds->max_y = y1;
+}
+
+void soft_vertex_bounds(const SoftTarget* target, const SoftVertex* v, uint32_t count, SoftRect* bounds)
+{
+    float min_x, min_y, max_x, max_y;
+    uint32_t i;
+    if (!count) return;
+
+    min_x = max_x = v[0].x;
+    min_y = max_y = v[0].y;
+    for (i = 1; i < count; i++) {
+        if (v[i].x < min_x) min_x = v[i].x;
+        if (v[i].x > max_x) max_x = v[i].x;
+        if (v[i].y < min_y) min_y = v[i].y;
+        if (v[i].y > max_y) max_y = v[i].y;
+    }
+    soft_grow_bounds(target, min_x, min_y, max_x, max_y, bounds);
+}
+
+void soft_batch_bounds(const SoftTarget* target, const SoftBatch* batch, uint32_t count, SoftRect* bounds)
+{
+    float min_x, min_y, max_x, max_y;
+    uint32_t lane, k;
+    if (!count) return;
+
+    min_x = max_x = batch->x[0][0];
+    min_y = max_y = batch->y[0][0];
+    for (k = 0; k < 3; k++) {
+        for (lane = 0; lane < count; lane++) {
+            if (batch->x[k][lane] < min_x) min_x = batch->x[k][lane];
+            if (batch->x[k][lane] > max_x) max_x = batch->x[k][lane];
+            if (batch->y[k][lane] < min_y) min_y = batch->y[k][lane];
+            if (batch->y[k][lane] > max_y) max_y = batch->y[k][lane];
+        }
+    }
+    soft_grow_bounds(target, min_x, min_y, max_x, max_y, bounds);
+}
+
+static uint64_t soft_rect_area(const SoftRect* rect)
+{
+    return (uint64_t)(rect->max_x - rect->min_x) * (uint64_t)(rect->max_y - rect->min_y);
+}
+
+static void soft_rect_union(const SoftRect* a, const SoftRect* b, SoftRect* out)
+{
+    out->min_x = a->min_x < b->min_x ? a->min_x : b->min_x;
+    out->min_y = a->min_y < b->min_y ? a->min_y : b->min_y;
+    out->max_x = a->max_x > b->max_x ? a->max_x : b->max_x;
+    out->max_y = a->max_y > b->max_y ? a->max_y : b->max_y;
+}
+
+void soft_mark_dirty(SoftTarget* target, const SoftRect* rect, uint32_t covered)
+{
+    LapisRect damage;
+    SoftRect merged;
+    uint64_t growth, best_growth = ~(uint64_t)0;
+    uint32_t i, best = 0;
+    if (rect->max_x <= rect->min_x || rect->max_y <= rect->min_y) return;
+
+    // The window needs to know before anything is drawn so it can bring its back buffer up to date first
+    if (target->window.cpu_mem) {
+        damage.x = (uint32_t)rect->min_x + target->origin_x;
+        damage.y = (uint32_t)rect->min_y + target->origin_y;
+        damage.width = (uint32_t)(rect->max_x - rect->min_x);
+        damage.height = (uint32_t)(rect->max_y - rect->min_y);
+        lapis_window_damage(&target->window, &damage, 1, covered);
+    }
+
+    // Once the list is full, grow whichever rectangle grows the least
+    for (i = 0; i < target->dirty_count; i++) {
+        soft_rect_union(&target->dirty[i], rect, &merged);
+        growth = soft_rect_area(&merged) - soft_rect_area(&target->dirty[i]);
+        if (!growth) return;
+        if (growth < best_growth) {
+            best_growth = growth;
+            best = i;
+        }
+    }
+    if (target->dirty_count < LAPIS_MAX_DIRTY_RECTS) {
+        target->dirty[target->dirty_count++] = *rect;
+        return;
+    }
+    soft_rect_union(&target->dirty[best], rect, &target->dirty[best]);
+}
+
+// Converts the changed pixels of a target which has its own into the window's back buffer. Rectangles are
+// moved into the outermost target, whose pixels views point into, and widened to whole YUYV pairs there
+static void soft_convert_dirty(SoftTarget* target)
+{
+    LapisFramebuffer framebuffer;
+    const SoftTarget* root = target;
+    const SoftRect* rect;
+    const uint8_t* src;
+    uint8_t* dst;
+    size_t dst_stride;
+    uint32_t i, x0, x1, y0, bytes;
+
+    while (root->parent) root = root->parent;
+    if (lapis_window_get_framebuffer(&target->window, &framebuffer) != e_lapis_return_success) return;
+    bytes = lapis_format_bytes(framebuffer.format);
+    dst_stride = (size_t)framebuffer.stride * bytes;
+    for (i = 0; i < target->dirty_count; i++) {
+        rect = &target->dirty[i];
+        x0 = (uint32_t)rect->min_x + target->origin_x;
+        x1 = (uint32_t)rect->max_x + target->origin_x;
+        y0 = (uint32_t)rect->min_y + target->origin_y;
+        if (framebuffer.format == e_lapis_format_yuyv) {
+            x0 &= ~1u;
+            x1 = (x1 + 1) & ~1u;
+        }
+        src = root->pixels + ((size_t)y0 * root->stride + x0) * root->pixel_bytes;
+        dst = (uint8_t*)framebuffer.pixels + (size_t)y0 * dst_stride + (size_t)x0 * bytes;
+        lapis_convert_pixels(dst, framebuffer.format, dst_stride, src, root->format,
+                             (size_t)root->stride * root->pixel_bytes, x1 - x0,
+                             (uint32_t)(rect->max_y - rect->min_y));
+    }
+}
+
+void soft_end_frame(SoftTarget* target, SoftFrameResult* result)
+{
+    uint32_t i;
+    if (target->convert && target->window.cpu_mem) soft_convert_dirty(target);
+    for (i = 0; i < target->dirty_count; i++) {
+        result->dirty[i].x = (uint32_t)target->dirty[i].min_x;
+        result->dirty[i].y = (uint32_t)target->dirty[i].min_y;
+        result->dirty[i].width = (uint32_t)(target->dirty[i].max_x - target->dirty[i].min_x);
+        result->dirty[i].height = (uint32_t)(target->dirty[i].max_y - target->dirty[i].min_y);
+    }
+    result->dirty_count = target->dirty_count;
+    target->dirty_count = 0;
+    result->cull_stats = target->cull_stats;
+    memset(&target->cull_stats, 0, sizeof(target->cull_stats));
+}
+
+const SoftFrameResult* soft_reached_result(SoftTarget* target)
+{
+    const SoftFrameResult* newest = NULL;
+    uint32_t i;
+
+    // A frame's fence is reached only after its deferred work wrote the result, so reading it is safe
+    for (i = 0; i < SOFT_FRAME_RESULTS; i++) {
+        if (!target->results[i].fence || (newest && newest->fence >= target->results[i].fence)) continue;
+        if (lapis_window_fence_reached(&target->window, target->results[i].fence)) {
+            newest = &target->results[i];
+        }
+    }
+    return newest;
+}
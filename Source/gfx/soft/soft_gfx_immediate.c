@@ -0,0 +1,112 @@
+#include "soft_gfx.h"
+
+LapisReturnCode lapis_gfx_immediate_pos_color(LapisTarget* target, float* pos, float* col, uint32_t tri_count)
+{
+    SoftTarget* soft;
+    SoftBatch batch;
+    SoftVertex* out;
+    SoftRect bounds;
+    float width, height;
+    uint32_t t, count, step;
+
+    if (!target || !target->cpu_mem) return e_lapis_return_invalid_argument;
+    if (tri_count && (!pos || !col)) return e_lapis_return_invalid_argument;
+
+    soft = (SoftTarget*)target->cpu_mem;
+    width = (float)soft->width;
+    height = (float)soft->height;
+    LAPIS_TRACE_BEGIN(e_lapis_stage_record);
+
+    // Recording targets map the vertices with the same kernels and store them straight into the command
+    // buffer, joining the last draw's batch
+    if (soft->command_capacity) {
+        while (tri_count) {
+            count = tri_count;
+            out = soft_record_triangles(soft, &count);
+            for (t = 0; t < count; t += step) {
+                step = count - t < SOFT_BATCH ? count - t : SOFT_BATCH;
+                soft->kernels->load_aos(&batch, pos + t * 9, col + t * 9, step, width, height);
+                soft_store_vertices(out + t * 3, &batch, step);
+            }
+            soft_record_bounds(soft, out, count);
+            pos += count * 9;
+            col += count * 9;
+            tri_count -= count;
+        }
+        LAPIS_TRACE_END(e_lapis_stage_record);
+        return e_lapis_return_success;
+    }
+
+    // Find everything the draw touches first so the window can prepare before any of it is drawn
+    bounds.min_x = bounds.min_y = 0x7FFFFFFF;
+    bounds.max_x = bounds.max_y = 0;
+    for (t = 0; t < tri_count; t += count) {
+        count = tri_count - t < SOFT_BATCH ? tri_count - t : SOFT_BATCH;
+        soft->kernels->load_aos(&batch, pos + t * 9, col + t * 9, count, width, height);
+        soft_batch_bounds(soft, &batch, count, &bounds);
+    }
+    soft_mark_dirty(soft, &bounds, 0);
+
+    soft_bind_target(soft);
+    for (t = 0; t < tri_count; t += count) {
+        count = tri_count - t < SOFT_BATCH ? tri_count - t : SOFT_BATCH;
+        soft->kernels->load_aos(&batch, pos + t * 9, col + t * 9, count, width, height);
+        soft_submit_batch(soft, &batch, count);
+    }
+    LAPIS_TRACE_END(e_lapis_stage_record);
+    return e_lapis_return_success;
+}
+
+LapisReturnCode lapis_gfx_immediate_streams(LapisTarget* target, const LapisVertexStreams* streams,
+                                            uint32_t tri_count)
+{
+    SoftTarget* soft;
+    SoftBatch batch;
+    SoftVertex* out;
+    SoftRect bounds;
+    float width, height;
+    uint32_t t, i, count, step;
+
+    if (!target || !target->cpu_mem || !streams) return e_lapis_return_invalid_argument;
+    if (tri_count && (!streams->x || !streams->y || !streams->r || !streams->g || !streams->b)) {
+        return e_lapis_return_invalid_argument;
+    }
+
+    soft = (SoftTarget*)target->cpu_mem;
+    width = (float)soft->width;
+    height = (float)soft->height;
+    LAPIS_TRACE_BEGIN(e_lapis_stage_record);
+
+    if (soft->command_capacity) {
+        for (t = 0; t < tri_count; t += count) {
+            count = tri_count - t;
+            out = soft_record_triangles(soft, &count);
+            for (i = 0; i < count; i += step) {
+                step = count - i < SOFT_BATCH ? count - i : SOFT_BATCH;
+                soft->kernels->load_soa(&batch, streams, (t + i) * 3, step, width, height);
+                soft_store_vertices(out + i * 3, &batch, step);
+            }
+            soft_record_bounds(soft, out, count);
+        }
+        LAPIS_TRACE_END(e_lapis_stage_record);
+        return e_lapis_return_success;
+    }
+
+    bounds.min_x = bounds.min_y = 0x7FFFFFFF;
+    bounds.max_x = bounds.max_y = 0;
+    for (t = 0; t < tri_count; t += count) {
+        count = tri_count - t < SOFT_BATCH ? tri_count - t : SOFT_BATCH;
+        soft->kernels->load_soa(&batch, streams, t * 3, count, width, height);
+        soft_batch_bounds(soft, &batch, count, &bounds);
+    }
+    soft_mark_dirty(soft, &bounds, 0);
+
+    soft_bind_target(soft);
+    for (t = 0; t < tri_count; t += count) {
+        count = tri_count - t < SOFT_BATCH ? tri_count - t : SOFT_BATCH;
+        soft->kernels->load_soa(&batch, streams, t * 3, count, width, height);
+        soft_submit_batch(soft, &batch, count);
+    }
+    LAPIS_TRACE_END(e_lapis_stage_record);
+    return e_lapis_return_success;
+}
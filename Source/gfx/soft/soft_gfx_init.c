@@ -0,0 +1 @@
+#include "soft_gfx.h"
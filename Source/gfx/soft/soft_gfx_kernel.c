@@ -0,0 +1,228 @@
+#include "soft_gfx.h"
+
+// Rounds a pixel coordinate onto the subpixel grid, the guard band keeps it in range
+static int32_t soft_snap(float v)
+{
+    float scaled = v * (float)SOFT_SUBPIXEL_ONE;
+    return (int32_t)(scaled >= 0.0f ? scaled + 0.5f : scaled - 0.5f);
+}
+
+void soft_load_aos_lane(SoftBatch* batch, uint32_t lane, const float* pos, const float* col, float width,
+                        float height)
+{
+    uint32_t k, c;
+    for (k = 0; k < 3; k++) {
+        batch->x[k][lane] = (pos[k * 3] + 0.5f) * width;
+        batch->y[k][lane] = (0.5f - pos[k * 3 + 1]) * height;
+        batch->z[k][lane] = pos[k * 3 + 2] + 0.5f;
+        for (c = 0; c < 3; c++) batch->color[k][c][lane] = col[k * 3 + c];
+    }
+}
+
+void soft_load_soa_lane(SoftBatch* batch, uint32_t lane, const LapisVertexStreams* streams, uint32_t vertex,
+                        float width, float height)
+{
+    uint32_t k;
+    for (k = 0; k < 3; k++) {
+        batch->x[k][lane] = (streams->x[vertex + k] + 0.5f) * width;
+        batch->y[k][lane] = (0.5f - streams->y[vertex + k]) * height;
+        batch->z[k][lane] = (streams->z ? streams->z[vertex + k] : 0.0f) + 0.5f;
+        batch->color[k][0][lane] = streams->r[vertex + k];
+        batch->color[k][1][lane] = streams->g[vertex + k];
+        batch->color[k][2][lane] = streams->b[vertex + k];
+    }
+}
+
+void soft_load_vertices(SoftBatch* batch, const SoftVertex* v, uint32_t count)
+{
+    uint32_t t, k, c;
+    for (t = 0; t < count; t++) {
+        for (k = 0; k < 3; k++) {
+            batch->x[k][t] = v[t * 3 + k].x;
+            batch->y[k][t] = v[t * 3 + k].y;
+            batch->z[k][t] = v[t * 3 + k].z;
+            for (c = 0; c < 3; c++) batch->color[k][c][t] = v[t * 3 + k].color[c];
+        }
+    }
+}
+
+void soft_store_vertices(SoftVertex* v, const SoftBatch* batch, uint32_t count)
+{
+    uint32_t t, k, c;
+    for (t = 0; t < count; t++) {
+        for (k = 0; k < 3; k++) {
+            v[t * 3 + k].x = batch->x[k][t];
+            v[t * 3 + k].y = batch->y[k][t];
+            v[t * 3 + k].z = batch->z[k][t];
+            for (c = 0; c < 3; c++) v[t * 3 + k].color[c] = batch->color[k][c][t];
+        }
+    }
+}
+
+void soft_setup_lane(SoftBatch* batch, uint32_t lane, const SoftRect* clip, uint32_t facing)
+{
+    const int32_t half = SOFT_SUBPIXEL_ONE / 2;
+    const float to_pixels = 1.0f / (float)SOFT_SUBPIXEL_ONE;
+    int32_t x[3], y[3], min_x, min_y, max_x, max_y, swap;
+    float fx[3], fy[3], c[3][3], inv_area, d1, d2, swap_c;
+    int64_t area;
+    uint32_t i, k;
+
+    // Written so that NaNs are also rejected
+    batch->cull[lane] = e_soft_cull_guard_band;
+    for (k = 0; k < 3; k++) {
+        if (!(batch->x[k][lane] > -SOFT_GUARD_BAND && batch->x[k][lane] < SOFT_GUARD_BAND &&
+              batch->y[k][lane] > -SOFT_GUARD_BAND && batch->y[k][lane] < SOFT_GUARD_BAND)) {
+            return;
+        }
+    }
+    for (k = 0; k < 3; k++) {
+        x[k] = soft_snap(batch->x[k][lane]);
+        y[k] = soft_snap(batch->y[k][lane]);
+        for (i = 0; i < 3; i++) c[k][i] = batch->color[k][i][lane];
+    }
+
+    // Always walk the triangle with a positive area so the inside of every edge is positive. y points down
+    // in pixels, so clockwise triangles have a positive area
+    area = (int64_t)(x[1] - x[0]) * (y[2] - y[0]) - (int64_t)(y[1] - y[0]) * (x[2] - x[0]);
+    batch->cull[lane] = e_soft_cull_degenerate;
+    if (area == 0) return;
+    batch->cull[lane] = e_soft_cull_facing;
+    if (area > 0 && (facing & e_lapis_cull_back)) return;
+    if (area < 0 && (facing & e_lapis_cull_front)) return;
+    if (area < 0) {
+        swap = x[1], x[1] = x[2], x[2] = swap;
+        swap = y[1], y[1] = y[2], y[2] = swap;
+        for (i = 0; i < 3; i++) swap_c = c[1][i], c[1][i] = c[2][i], c[2][i] = swap_c;
+        area = -area;
+    }
+
+    // A pixel is covered when its centre is inside, so find the range of pixel centres inside the bounds
+    min_x = x[0] < x[1] ? (x[0] < x[2] ? x[0] : x[2]) : (x[1] < x[2] ? x[1] : x[2]);
+    min_y = y[0] < y[1] ? (y[0] < y[2] ? y[0] : y[2]) : (y[1] < y[2] ? y[1] : y[2]);
+    max_x = x[0] > x[1] ? (x[0] > x[2] ? x[0] : x[2]) : (x[1] > x[2] ? x[1] : x[2]);
+    max_y = y[0] > y[1] ? (y[0] > y[2] ? y[0] : y[2]) : (y[1] > y[2] ? y[1] : y[2]);
+    min_x = (min_x - half + SOFT_SUBPIXEL_ONE - 1) >> SOFT_SUBPIXEL_BITS;
+    min_y = (min_y - half + SOFT_SUBPIXEL_ONE - 1) >> SOFT_SUBPIXEL_BITS;
+    max_x = ((max_x - half) >> SOFT_SUBPIXEL_BITS) + 1;
+    max_y = ((max_y - half) >> SOFT_SUBPIXEL_BITS) + 1;
+    batch->cull[lane] = e_soft_cull_small;
+    if (min_x >= max_x || min_y >= max_y) return;
+    batch->min_x[lane] = min_x > clip->min_x ? min_x : clip->min_x;
+    batch->min_y[lane] = min_y > clip->min_y ? min_y : clip->min_y;
+    batch->max_x[lane] = max_x < clip->max_x ? max_x : clip->max_x;
+    batch->max_y[lane] = max_y < clip->max_y ? max_y : clip->max_y;
+    batch->cull[lane] = e_soft_cull_offscreen;
+    if (batch->min_x[lane] >= batch->max_x[lane] || batch->min_y[lane] >= batch->max_y[lane]) return;
+
+    // Color plane equations, use the snapped positions so color lines up with coverage
+    for (k = 0; k < 3; k++) {
+        batch->snap_x[k][lane] = x[k];
+        batch->snap_y[k][lane] = y[k];
+        fx[k] = (float)x[k] * to_pixels;
+        fy[k] = (float)y[k] * to_pixels;
+    }
+    inv_area = (float)(SOFT_SUBPIXEL_ONE * SOFT_SUBPIXEL_ONE) / (float)area;
+    for (i = 0; i < 3; i++) {
+        d1 = c[1][i] - c[0][i];
+        d2 = c[2][i] - c[0][i];
+        batch->color_dx[i][lane] = (d1 * (fy[2] - fy[0]) - d2 * (fy[1] - fy[0])) * inv_area;
+        batch->color_dy[i][lane] = (d2 * (fx[1] - fx[0]) - d1 * (fx[2] - fx[0])) * inv_area;
+        batch->color_c[i][lane] = c[0][i] - batch->color_dx[i][lane] * (fx[0] - 0.5f) -
+                                  batch->color_dy[i][lane] * (fy[0] - 0.5f);
+    }
+    batch->cull[lane] = e_soft_cull_none;
+}
+
+// Works out the depth plane from the corners as they were loaded, before setup swapped any of them. The
+// plane is the same whichever way round the corners go, so only the sign of the area matters
+static void soft_finish_depth(SoftTriangle* tri, const SoftBatch* batch, uint32_t lane)
+{
+    const float to_pixels = 1.0f / (float)SOFT_SUBPIXEL_ONE;
+    int32_t x[3], y[3];
+    float fx[3], fy[3], inv_area, d1, d2;
+    int64_t area;
+    uint32_t k;
+
+    for (k = 0; k < 3; k++) {
+        x[k] = soft_snap(batch->x[k][lane]);
+        y[k] = soft_snap(batch->y[k][lane]);
+        fx[k] = (float)x[k] * to_pixels;
+        fy[k] = (float)y[k] * to_pixels;
+    }
+    area = (int64_t)(x[1] - x[0]) * (y[2] - y[0]) - (int64_t)(y[1] - y[0]) * (x[2] - x[0]);
+    inv_area = (float)(SOFT_SUBPIXEL_ONE * SOFT_SUBPIXEL_ONE) / (float)area;
+    d1 = batch->z[1][lane] - batch->z[0][lane];
+    d2 = batch->z[2][lane] - batch->z[0][lane];
+    tri->z_dx = (d1 * (fy[2] - fy[0]) - d2 * (fy[1] - fy[0])) * inv_area;
+    tri->z_dy = (d2 * (fx[1] - fx[0]) - d1 * (fx[2] - fx[0])) * inv_area;
+    tri->z_c = batch->z[0][lane] - tri->z_dx * (fx[0] - 0.5f) - tri->z_dy * (fy[0] - 0.5f);
+}
+
+void soft_finish_triangle(SoftTriangle* tri, const SoftBatch* batch, uint32_t lane)
+{
+    const int64_t half = SOFT_SUBPIXEL_ONE / 2;
+    int64_t edge_a, edge_b;
+    uint32_t i, a, b;
+
+    // Edge a -> b is A * (px - xa) + B * (py - ya). Pixels exactly on an edge belong to the triangle when the
+    // edge is a top or left edge, otherwise the edge is biased so that it has to be strictly positive
+    for (i = 0; i < 3; i++) {
+        a = i;
+        b = (i + 1) % 3;
+        edge_a = (int64_t)batch->snap_y[a][lane] - batch->snap_y[b][lane];
+        edge_b = (int64_t)batch->snap_x[b][lane] - batch->snap_x[a][lane];
+        tri->edge_dx[i] = edge_a * SOFT_SUBPIXEL_ONE;
+        tri->edge_dy[i] = edge_b * SOFT_SUBPIXEL_ONE;
+        tri->edge_c[i] = edge_a * (half - batch->snap_x[a][lane]) + edge_b * (half - batch->snap_y[a][lane]);
+        if (!(edge_a > 0 || (edge_a == 0 && edge_b > 0))) tri->edge_c[i] -= 1;
+
+        tri->color_dx[i] = batch->color_dx[i][lane];
+        tri->color_dy[i] = batch->color_dy[i][lane];
+        tri->color_c[i] = batch->color_c[i][lane];
+    }
+    tri->bounds.min_x = batch->min_x[lane];
+    tri->bounds.min_y = batch->min_y[lane];
+    tri->bounds.max_x = batch->max_x[lane];
+    tri->bounds.max_y = batch->max_y[lane];
+    soft_finish_depth(tri, batch, lane);
+}
+
+/**
+ * Scalar kernels, one triangle at a time. Used on cpus without vector kernels
+ */
+
+static void soft_scalar_load_aos(SoftBatch* batch, const float* pos, const float* col, uint32_t count,
+                                 float width, float height)
+{
+    uint32_t t;
+    for (t = 0; t < count; t++) soft_load_aos_lane(batch, t, pos + t * 9, col + t * 9, width, height);
+}
+
+static void soft_scalar_load_soa(SoftBatch* batch, const LapisVertexStreams* streams, uint32_t first,
+                                 uint32_t count, float width, float height)
+{
+    uint32_t t;
+    for (t = 0; t < count; t++) soft_load_soa_lane(batch, t, streams, first + t * 3, width, height);
+}
+
+static void soft_scalar_setup(SoftBatch* batch, uint32_t count, const SoftRect* clip, uint32_t facing)
+{
+    uint32_t t;
+    for (t = 0; t < count; t++) soft_setup_lane(batch, t, clip, facing);
+}
+
+const SoftKernels soft_kernels_scalar = {
+    "scalar", 1, soft_scalar_load_aos, soft_scalar_load_soa, soft_scalar_setup,
+};
+
+const SoftKernels* soft_select_kernels()
+{
+#if defined(SOFT_KERNELS_X86)
+    return soft_x86_has_avx2() ? &soft_kernels_avx2 : &soft_kernels_sse2;
+#elif defined(SOFT_KERNELS_NEON)
+    return &soft_kernels_neon;
+#else
+    return &soft_kernels_scalar;
+#endif
+}
@@ -0,0 +1,208 @@
+#include "soft_gfx.h"
+
+#if defined(SOFT_KERNELS_NEON)
+#include <arm_neon.h>
+
+/*************************************************************************************************************
+ * NEON kernels
+ * 4 triangles at a time, for 64 bit arm where NEON is always there. Laid out the same as the SSE2 kernels so
+ * they give the same results, the areas of triangles are worked out with doubles which hold them exactly.
+ *************************************************************************************************************/
+
+static void soft_neon_store_position(SoftBatch* batch, uint32_t t, uint32_t k, float32x4_t x, float32x4_t y,
+                                     float32x4_t z, float width, float height)
+{
+    const float32x4_t half = vdupq_n_f32(0.5f);
+    vst1q_f32(batch->x[k] + t, vmulq_n_f32(vaddq_f32(x, half), width));
+    vst1q_f32(batch->y[k] + t, vmulq_n_f32(vsubq_f32(half, y), height));
+    vst1q_f32(batch->z[k] + t, vaddq_f32(z, half));
+}
+
+static void soft_neon_load_aos(SoftBatch* batch, const float* pos, const float* col, uint32_t count,
+                               float width, float height)
+{
+    float gather[6][4];
+    uint32_t t, k, i;
+
+    // Triangles are 9 floats apart so their corners can't be split with a vld3, gather them instead
+    for (t = 0; t + 4 <= count; t += 4) {
+        for (k = 0; k < 3; k++) {
+            for (i = 0; i < 4; i++) {
+                gather[0][i] = pos[(t + i) * 9 + k * 3];
+                gather[1][i] = pos[(t + i) * 9 + k * 3 + 1];
+                gather[2][i] = pos[(t + i) * 9 + k * 3 + 2];
+                gather[3][i] = col[(t + i) * 9 + k * 3];
+                gather[4][i] = col[(t + i) * 9 + k * 3 + 1];
+                gather[5][i] = col[(t + i) * 9 + k * 3 + 2];
+            }
+            soft_neon_store_position(batch, t, k, vld1q_f32(gather[0]), vld1q_f32(gather[1]),
+                                     vld1q_f32(gather[2]), width, height);
+            for (i = 0; i < 3; i++) vst1q_f32(batch->color[k][i] + t, vld1q_f32(gather[3 + i]));
+        }
+    }
+    for (; t < count; t++) soft_load_aos_lane(batch, t, pos + t * 9, col + t * 9, width, height);
+}
+
+static void soft_neon_load_soa(SoftBatch* batch, const LapisVertexStreams* streams, uint32_t first,
+                               uint32_t count, float width, float height)
+{
+    float32x4x3_t x, y, z, r, g, b;
+    uint32_t t, k, v;
+
+    z.val[0] = z.val[1] = z.val[2] = vdupq_n_f32(0.0f);
+
+    // The streams hold 3 corners per triangle, so vld3 splits them straight into corners
+    for (t = 0; t + 4 <= count; t += 4) {
+        v = first + t * 3;
+        x = vld3q_f32(streams->x + v);
+        y = vld3q_f32(streams->y + v);
+        if (streams->z) z = vld3q_f32(streams->z + v);
+        r = vld3q_f32(streams->r + v);
+        g = vld3q_f32(streams->g + v);
+        b = vld3q_f32(streams->b + v);
+        for (k = 0; k < 3; k++) {
+            soft_neon_store_position(batch, t, k, x.val[k], y.val[k], z.val[k], width, height);
+            vst1q_f32(batch->color[k][0] + t, r.val[k]);
+            vst1q_f32(batch->color[k][1] + t, g.val[k]);
+            vst1q_f32(batch->color[k][2] + t, b.val[k]);
+        }
+    }
+    for (; t < count; t++) soft_load_soa_lane(batch, t, streams, first + t * 3, width, height);
+}
+
+// Rounds pixel coordinates onto the subpixel grid, halves away from 0
+static int32x4_t soft_neon_snap(float32x4_t v)
+{
+    float32x4_t scaled = vmulq_n_f32(v, (float)SOFT_SUBPIXEL_ONE);
+    uint32x4_t positive = vcgeq_f32(scaled, vdupq_n_f32(0.0f));
+    float32x4_t round = vbslq_f32(positive, vdupq_n_f32(0.5f), vdupq_n_f32(-0.5f));
+    return vcvtq_s32_f32(vaddq_f32(scaled, round));
+}
+
+static float32x2_t soft_neon_area_half(int32x2_t ax, int32x2_t ay, int32x2_t bx, int32x2_t by)
+{
+    float64x2_t area = vsubq_f64(vmulq_f64(vcvtq_f64_s64(vmovl_s32(ax)), vcvtq_f64_s64(vmovl_s32(by))),
+                                 vmulq_f64(vcvtq_f64_s64(vmovl_s32(ay)), vcvtq_f64_s64(vmovl_s32(bx))));
+    return vcvt_f32_f64(area);
+}
+
+// Twice the signed area of each triangle in subpixels squared, rounded to a float
+static float32x4_t soft_neon_area(const int32x4_t* x, const int32x4_t* y)
+{
+    int32x4_t ax = vsubq_s32(x[1], x[0]);
+    int32x4_t ay = vsubq_s32(y[1], y[0]);
+    int32x4_t bx = vsubq_s32(x[2], x[0]);
+    int32x4_t by = vsubq_s32(y[2], y[0]);
+    return vcombine_f32(soft_neon_area_half(vget_low_s32(ax), vget_low_s32(ay), vget_low_s32(bx),
+                                            vget_low_s32(by)),
+                        soft_neon_area_half(vget_high_s32(ax), vget_high_s32(ay), vget_high_s32(bx),
+                                            vget_high_s32(by)));
+}
+
+static void soft_neon_setup(SoftBatch* batch, uint32_t count, const SoftRect* clip, uint32_t facing)
+{
+    const float32x4_t band = vdupq_n_f32((float)SOFT_GUARD_BAND);
+    const float32x4_t negative_band = vdupq_n_f32(-(float)SOFT_GUARD_BAND);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t half = vdupq_n_f32(0.5f);
+    const float32x4_t area_scale = vdupq_n_f32((float)(SOFT_SUBPIXEL_ONE * SOFT_SUBPIXEL_ONE));
+    const float to_pixels = 1.0f / (float)SOFT_SUBPIXEL_ONE;
+    const int32x4_t round_up = vdupq_n_s32(SOFT_SUBPIXEL_ONE / 2 - 1);
+    const int32x4_t round_down = vdupq_n_s32(SOFT_SUBPIXEL_ONE / 2);
+    const int32x4_t one = vdupq_n_s32(1);
+    float32x4_t px, py, area, inv_area, d1, d2, dx, dy, fx[3], fy[3], c[3][3], swap;
+    float32x4_t edge_x[2], edge_y[2], centre_x, centre_y;
+    int32x4_t x[3], y[3], min_x, min_y, max_x, max_y, swap_int;
+    const uint32x4_t cull_back = vdupq_n_u32(facing & e_lapis_cull_back ? 0xFFFFFFFFu : 0);
+    const uint32x4_t cull_front = vdupq_n_u32(facing & e_lapis_cull_front ? 0xFFFFFFFFu : 0);
+    uint32x4_t inside, negative, culled, filled, cull;
+    uint32_t t, k, i;
+
+    for (t = 0; t < count; t += 4) {
+        inside = vdupq_n_u32(0xFFFFFFFFu);
+        for (k = 0; k < 3; k++) {
+            px = vld1q_f32(batch->x[k] + t);
+            py = vld1q_f32(batch->y[k] + t);
+            inside = vandq_u32(inside, vandq_u32(vcgtq_f32(px, negative_band), vcltq_f32(px, band)));
+            inside = vandq_u32(inside, vandq_u32(vcgtq_f32(py, negative_band), vcltq_f32(py, band)));
+            x[k] = soft_neon_snap(px);
+            y[k] = soft_neon_snap(py);
+            for (i = 0; i < 3; i++) c[k][i] = vld1q_f32(batch->color[k][i] + t);
+        }
+
+        // Corners 1 and 2 swap where the area is negative. Reasons for culling are picked from the last
+        // checked to the first, so the first one which applies is the one left
+        area = soft_neon_area(x, y);
+        negative = vcltq_f32(area, zero);
+        culled = vorrq_u32(vandq_u32(vcgtq_f32(area, zero), cull_back), vandq_u32(negative, cull_front));
+        area = vabsq_f32(area);
+        swap_int = x[1];
+        x[1] = vbslq_s32(negative, x[2], x[1]);
+        x[2] = vbslq_s32(negative, swap_int, x[2]);
+        swap_int = y[1];
+        y[1] = vbslq_s32(negative, y[2], y[1]);
+        y[2] = vbslq_s32(negative, swap_int, y[2]);
+        for (i = 0; i < 3; i++) {
+            swap = c[1][i];
+            c[1][i] = vbslq_f32(negative, c[2][i], c[1][i]);
+            c[2][i] = vbslq_f32(negative, swap, c[2][i]);
+        }
+
+        min_x = vminq_s32(vminq_s32(x[0], x[1]), x[2]);
+        min_y = vminq_s32(vminq_s32(y[0], y[1]), y[2]);
+        max_x = vmaxq_s32(vmaxq_s32(x[0], x[1]), x[2]);
+        max_y = vmaxq_s32(vmaxq_s32(y[0], y[1]), y[2]);
+        min_x = vshrq_n_s32(vaddq_s32(min_x, round_up), SOFT_SUBPIXEL_BITS);
+        min_y = vshrq_n_s32(vaddq_s32(min_y, round_up), SOFT_SUBPIXEL_BITS);
+        max_x = vaddq_s32(vshrq_n_s32(vsubq_s32(max_x, round_down), SOFT_SUBPIXEL_BITS), one);
+        max_y = vaddq_s32(vshrq_n_s32(vsubq_s32(max_y, round_down), SOFT_SUBPIXEL_BITS), one);
+        filled = vandq_u32(vcltq_s32(min_x, max_x), vcltq_s32(min_y, max_y));
+        min_x = vmaxq_s32(min_x, vdupq_n_s32(clip->min_x));
+        min_y = vmaxq_s32(min_y, vdupq_n_s32(clip->min_y));
+        max_x = vminq_s32(max_x, vdupq_n_s32(clip->max_x));
+        max_y = vminq_s32(max_y, vdupq_n_s32(clip->max_y));
+        cull = vandq_u32(vcltq_s32(min_x, max_x), vcltq_s32(min_y, max_y));
+        cull = vbicq_u32(vdupq_n_u32(e_soft_cull_offscreen), cull);
+        cull = vbslq_u32(filled, cull, vdupq_n_u32(e_soft_cull_small));
+        cull = vbslq_u32(culled, vdupq_n_u32(e_soft_cull_facing), cull);
+        cull = vbslq_u32(vceqq_f32(area, zero), vdupq_n_u32(e_soft_cull_degenerate), cull);
+        cull = vbslq_u32(inside, cull, vdupq_n_u32(e_soft_cull_guard_band));
+        vst1q_s32(batch->min_x + t, min_x);
+        vst1q_s32(batch->min_y + t, min_y);
+        vst1q_s32(batch->max_x + t, max_x);
+        vst1q_s32(batch->max_y + t, max_y);
+        vst1q_s32(batch->cull + t, vreinterpretq_s32_u32(cull));
+
+        for (k = 0; k < 3; k++) {
+            vst1q_s32(batch->snap_x[k] + t, x[k]);
+            vst1q_s32(batch->snap_y[k] + t, y[k]);
+            fx[k] = vmulq_n_f32(vcvtq_f32_s32(x[k]), to_pixels);
+            fy[k] = vmulq_n_f32(vcvtq_f32_s32(y[k]), to_pixels);
+        }
+        inv_area = vdivq_f32(area_scale, area);
+        edge_x[0] = vsubq_f32(fx[1], fx[0]);
+        edge_x[1] = vsubq_f32(fx[2], fx[0]);
+        edge_y[0] = vsubq_f32(fy[1], fy[0]);
+        edge_y[1] = vsubq_f32(fy[2], fy[0]);
+        centre_x = vsubq_f32(fx[0], half);
+        centre_y = vsubq_f32(fy[0], half);
+        for (i = 0; i < 3; i++) {
+            d1 = vsubq_f32(c[1][i], c[0][i]);
+            d2 = vsubq_f32(c[2][i], c[0][i]);
+            dx = vsubq_f32(vmulq_f32(d1, edge_y[1]), vmulq_f32(d2, edge_y[0]));
+            dy = vsubq_f32(vmulq_f32(d2, edge_x[0]), vmulq_f32(d1, edge_x[1]));
+            dx = vmulq_f32(dx, inv_area);
+            dy = vmulq_f32(dy, inv_area);
+            vst1q_f32(batch->color_dx[i] + t, dx);
+            vst1q_f32(batch->color_dy[i] + t, dy);
+            vst1q_f32(batch->color_c[i] + t,
+                      vsubq_f32(vsubq_f32(c[0][i], vmulq_f32(dx, centre_x)), vmulq_f32(dy, centre_y)));
+        }
+    }
+}
+
+const SoftKernels soft_kernels_neon = {
+    "neon", 4, soft_neon_load_aos, soft_neon_load_soa, soft_neon_setup,
+};
+
+#endif  // SOFT_KERNELS_NEON
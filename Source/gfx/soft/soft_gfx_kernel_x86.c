@@ -0,0 +1,473 @@
+#include "soft_gfx.h"
+
+#if defined(SOFT_KERNELS_X86)
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define SOFT_TARGET_AVX2
+#else
+#define SOFT_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+/*************************************************************************************************************
+ * x86 kernels
+ * SSE2 is always there on the cpus this is built for, AVX2 is checked for when a target is created. Only
+ * AVX2 itself is enabled and not FMA, so the compiler can't fuse a multiply and an add which the scalar
+ * kernels round separately. The areas of triangles need more than 32 bits, they're worked out with doubles
+ * which hold every one of them exactly.
+ *************************************************************************************************************/
+
+int soft_x86_has_avx2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return 0;
+
+    // The os has to save the upper halves of the registers as well
+    __cpuid(info, 1);
+    if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6) return 0;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+/**
+ * SSE2, 4 triangles at a time
+ */
+
+static __m128 soft_sse2_select(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static __m128i soft_sse2_select_int(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// SSE2 has no 32 bit integer min and max
+static __m128i soft_sse2_min(__m128i a, __m128i b)
+{
+    return soft_sse2_select_int(_mm_cmplt_epi32(a, b), a, b);
+}
+
+static __m128i soft_sse2_max(__m128i a, __m128i b)
+{
+    return soft_sse2_select_int(_mm_cmpgt_epi32(a, b), a, b);
+}
+
+// Splits 12 floats, 3 per triangle, into a vector per corner
+static void soft_sse2_split(const float* p, __m128* k)
+{
+    __m128 a = _mm_loadu_ps(p);
+    __m128 b = _mm_loadu_ps(p + 4);
+    __m128 c = _mm_loadu_ps(p + 8);
+    __m128 t = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2));
+    k[0] = _mm_shuffle_ps(a, t, _MM_SHUFFLE(2, 0, 3, 0));
+    k[1] = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+                          _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+    k[2] = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)),
+                          _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+static void soft_sse2_store_position(SoftBatch* batch, uint32_t t, uint32_t k, __m128 x, __m128 y, __m128 z,
+                                     float width, float height)
+{
+    const __m128 half = _mm_set1_ps(0.5f);
+    _mm_storeu_ps(batch->x[k] + t, _mm_mul_ps(_mm_add_ps(x, half), _mm_set1_ps(width)));
+    _mm_storeu_ps(batch->y[k] + t, _mm_mul_ps(_mm_sub_ps(half, y), _mm_set1_ps(height)));
+    _mm_storeu_ps(batch->z[k] + t, _mm_add_ps(z, half));
+}
+
+static void soft_sse2_load_aos(SoftBatch* batch, const float* pos, const float* col, uint32_t count,
+                               float width, float height)
+{
+    const float* p;
+    const float* c;
+    uint32_t t, k, i;
+
+    // Triangles are 9 floats apart, corner k of the 4 triangles is gathered from each of them
+    for (t = 0; t + 4 <= count; t += 4) {
+        for (k = 0; k < 3; k++) {
+            p = pos + t * 9 + k * 3;
+            c = col + t * 9 + k * 3;
+            soft_sse2_store_position(batch, t, k, _mm_set_ps(p[27], p[18], p[9], p[0]),
+                                     _mm_set_ps(p[28], p[19], p[10], p[1]),
+                                     _mm_set_ps(p[29], p[20], p[11], p[2]), width, height);
+            for (i = 0; i < 3; i++) {
+                _mm_storeu_ps(batch->color[k][i] + t, _mm_set_ps(c[27 + i], c[18 + i], c[9 + i], c[i]));
+            }
+        }
+    }
+    for (; t < count; t++) soft_load_aos_lane(batch, t, pos + t * 9, col + t * 9, width, height);
+}
+
+static void soft_sse2_load_soa(SoftBatch* batch, const LapisVertexStreams* streams, uint32_t first,
+                               uint32_t count, float width, float height)
+{
+    __m128 x[3], y[3], z[3], r[3], g[3], b[3];
+    uint32_t t, k, v;
+
+    z[0] = z[1] = z[2] = _mm_setzero_ps();
+    for (t = 0; t + 4 <= count; t += 4) {
+        v = first + t * 3;
+        soft_sse2_split(streams->x + v, x);
+        soft_sse2_split(streams->y + v, y);
+        if (streams->z) soft_sse2_split(streams->z + v, z);
+        soft_sse2_split(streams->r + v, r);
+        soft_sse2_split(streams->g + v, g);
+        soft_sse2_split(streams->b + v, b);
+        for (k = 0; k < 3; k++) {
+            soft_sse2_store_position(batch, t, k, x[k], y[k], z[k], width, height);
+            _mm_storeu_ps(batch->color[k][0] + t, r[k]);
+            _mm_storeu_ps(batch->color[k][1] + t, g[k]);
+            _mm_storeu_ps(batch->color[k][2] + t, b[k]);
+        }
+    }
+    for (; t < count; t++) soft_load_soa_lane(batch, t, streams, first + t * 3, width, height);
+}
+
+// Rounds pixel coordinates onto the subpixel grid, halves away from 0
+static __m128i soft_sse2_snap(__m128 v)
+{
+    __m128 scaled = _mm_mul_ps(v, _mm_set1_ps((float)SOFT_SUBPIXEL_ONE));
+    __m128 round = soft_sse2_select(_mm_cmpge_ps(scaled, _mm_setzero_ps()), _mm_set1_ps(0.5f),
+                                    _mm_set1_ps(-0.5f));
+    return _mm_cvttps_epi32(_mm_add_ps(scaled, round));
+}
+
+// Twice the signed area of each triangle in subpixels squared, rounded to a float
+static __m128 soft_sse2_area(const __m128i* x, const __m128i* y)
+{
+    __m128i ax = _mm_sub_epi32(x[1], x[0]);
+    __m128i ay = _mm_sub_epi32(y[1], y[0]);
+    __m128i bx = _mm_sub_epi32(x[2], x[0]);
+    __m128i by = _mm_sub_epi32(y[2], y[0]);
+    __m128d lo = _mm_sub_pd(_mm_mul_pd(_mm_cvtepi32_pd(ax), _mm_cvtepi32_pd(by)),
+                            _mm_mul_pd(_mm_cvtepi32_pd(ay), _mm_cvtepi32_pd(bx)));
+    __m128d hi;
+    ax = _mm_shuffle_epi32(ax, _MM_SHUFFLE(3, 2, 3, 2));
+    ay = _mm_shuffle_epi32(ay, _MM_SHUFFLE(3, 2, 3, 2));
+    bx = _mm_shuffle_epi32(bx, _MM_SHUFFLE(3, 2, 3, 2));
+    by = _mm_shuffle_epi32(by, _MM_SHUFFLE(3, 2, 3, 2));
+    hi = _mm_sub_pd(_mm_mul_pd(_mm_cvtepi32_pd(ax), _mm_cvtepi32_pd(by)),
+                    _mm_mul_pd(_mm_cvtepi32_pd(ay), _mm_cvtepi32_pd(bx)));
+    return _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi));
+}
+
+static void soft_sse2_setup(SoftBatch* batch, uint32_t count, const SoftRect* clip, uint32_t facing)
+{
+    const __m128 band = _mm_set1_ps((float)SOFT_GUARD_BAND);
+    const __m128 negative_band = _mm_set1_ps(-(float)SOFT_GUARD_BAND);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 to_pixels = _mm_set1_ps(1.0f / (float)SOFT_SUBPIXEL_ONE);
+    const __m128 area_scale = _mm_set1_ps((float)(SOFT_SUBPIXEL_ONE * SOFT_SUBPIXEL_ONE));
+    const __m128i round_up = _mm_set1_epi32(SOFT_SUBPIXEL_ONE / 2 - 1);
+    const __m128i round_down = _mm_set1_epi32(SOFT_SUBPIXEL_ONE / 2);
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128 cull_back = _mm_castsi128_ps(_mm_set1_epi32(facing & e_lapis_cull_back ? -1 : 0));
+    const __m128 cull_front = _mm_castsi128_ps(_mm_set1_epi32(facing & e_lapis_cull_front ? -1 : 0));
+    __m128 px, py, inside, area, negative, culled, inv_area, d1, d2, dx, dy, fx[3], fy[3], c[3][3], swap;
+    __m128 edge_x[2], edge_y[2], centre_x, centre_y;
+    __m128i x[3], y[3], min_x, min_y, max_x, max_y, flip, swap_int, cull, empty;
+    uint32_t t, k, i;
+
+    for (t = 0; t < count; t += 4) {
+        inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (k = 0; k < 3; k++) {
+            px = _mm_loadu_ps(batch->x[k] + t);
+            py = _mm_loadu_ps(batch->y[k] + t);
+            inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmpgt_ps(px, negative_band), _mm_cmplt_ps(px, band)));
+            inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmpgt_ps(py, negative_band), _mm_cmplt_ps(py, band)));
+            x[k] = soft_sse2_snap(px);
+            y[k] = soft_sse2_snap(py);
+            for (i = 0; i < 3; i++) c[k][i] = _mm_loadu_ps(batch->color[k][i] + t);
+        }
+
+        // Corners 1 and 2 swap where the area is negative. Reasons for culling are picked from the last
+        // checked to the first, so the first one which applies is the one left
+        area = soft_sse2_area(x, y);
+        negative = _mm_cmplt_ps(area, _mm_setzero_ps());
+        culled = _mm_or_ps(_mm_and_ps(_mm_cmpgt_ps(area, _mm_setzero_ps()), cull_back),
+                           _mm_and_ps(negative, cull_front));
+        flip = _mm_castps_si128(negative);
+        area = _mm_andnot_ps(sign, area);
+        swap_int = x[1];
+        x[1] = soft_sse2_select_int(flip, x[2], x[1]);
+        x[2] = soft_sse2_select_int(flip, swap_int, x[2]);
+        swap_int = y[1];
+        y[1] = soft_sse2_select_int(flip, y[2], y[1]);
+        y[2] = soft_sse2_select_int(flip, swap_int, y[2]);
+        for (i = 0; i < 3; i++) {
+            swap = c[1][i];
+            c[1][i] = soft_sse2_select(negative, c[2][i], c[1][i]);
+            c[2][i] = soft_sse2_select(negative, swap, c[2][i]);
+        }
+
+        min_x = soft_sse2_min(soft_sse2_min(x[0], x[1]), x[2]);
+        min_y = soft_sse2_min(soft_sse2_min(y[0], y[1]), y[2]);
+        max_x = soft_sse2_max(soft_sse2_max(x[0], x[1]), x[2]);
+        max_y = soft_sse2_max(soft_sse2_max(y[0], y[1]), y[2]);
+        min_x = _mm_srai_epi32(_mm_add_epi32(min_x, round_up), SOFT_SUBPIXEL_BITS);
+        min_y = _mm_srai_epi32(_mm_add_epi32(min_y, round_up), SOFT_SUBPIXEL_BITS);
+        max_x = _mm_add_epi32(_mm_srai_epi32(_mm_sub_epi32(max_x, round_down), SOFT_SUBPIXEL_BITS), one);
+        max_y = _mm_add_epi32(_mm_srai_epi32(_mm_sub_epi32(max_y, round_down), SOFT_SUBPIXEL_BITS), one);
+        empty = _mm_andnot_si128(_mm_and_si128(_mm_cmplt_epi32(min_x, max_x), _mm_cmplt_epi32(min_y, max_y)),
+                                 _mm_set1_epi32(-1));
+        min_x = soft_sse2_max(min_x, _mm_set1_epi32(clip->min_x));
+        min_y = soft_sse2_max(min_y, _mm_set1_epi32(clip->min_y));
+        max_x = soft_sse2_min(max_x, _mm_set1_epi32(clip->max_x));
+        max_y = soft_sse2_min(max_y, _mm_set1_epi32(clip->max_y));
+        cull = _mm_andnot_si128(_mm_and_si128(_mm_cmplt_epi32(min_x, max_x), _mm_cmplt_epi32(min_y, max_y)),
+                                _mm_set1_epi32(e_soft_cull_offscreen));
+        cull = soft_sse2_select_int(empty, _mm_set1_epi32(e_soft_cull_small), cull);
+        cull = soft_sse2_select_int(_mm_castps_si128(culled), _mm_set1_epi32(e_soft_cull_facing), cull);
+        cull = soft_sse2_select_int(_mm_castps_si128(_mm_cmpeq_ps(area, _mm_setzero_ps())),
+                                    _mm_set1_epi32(e_soft_cull_degenerate), cull);
+        cull = soft_sse2_select_int(_mm_castps_si128(inside), cull, _mm_set1_epi32(e_soft_cull_guard_band));
+        _mm_storeu_si128((__m128i*)(batch->min_x + t), min_x);
+        _mm_storeu_si128((__m128i*)(batch->min_y + t), min_y);
+        _mm_storeu_si128((__m128i*)(batch->max_x + t), max_x);
+        _mm_storeu_si128((__m128i*)(batch->max_y + t), max_y);
+        _mm_storeu_si128((__m128i*)(batch->cull + t), cull);
+
+        for (k = 0; k < 3; k++) {
+            _mm_storeu_si128((__m128i*)(batch->snap_x[k] + t), x[k]);
+            _mm_storeu_si128((__m128i*)(batch->snap_y[k] + t), y[k]);
+            fx[k] = _mm_mul_ps(_mm_cvtepi32_ps(x[k]), to_pixels);
+            fy[k] = _mm_mul_ps(_mm_cvtepi32_ps(y[k]), to_pixels);
+        }
+        inv_area = _mm_div_ps(area_scale, area);
+        edge_x[0] = _mm_sub_ps(fx[1], fx[0]);
+        edge_x[1] = _mm_sub_ps(fx[2], fx[0]);
+        edge_y[0] = _mm_sub_ps(fy[1], fy[0]);
+        edge_y[1] = _mm_sub_ps(fy[2], fy[0]);
+        centre_x = _mm_sub_ps(fx[0], half);
+        centre_y = _mm_sub_ps(fy[0], half);
+        for (i = 0; i < 3; i++) {
+            d1 = _mm_sub_ps(c[1][i], c[0][i]);
+            d2 = _mm_sub_ps(c[2][i], c[0][i]);
+            dx = _mm_sub_ps(_mm_mul_ps(d1, edge_y[1]), _mm_mul_ps(d2, edge_y[0]));
+            dy = _mm_sub_ps(_mm_mul_ps(d2, edge_x[0]), _mm_mul_ps(d1, edge_x[1]));
+            dx = _mm_mul_ps(dx, inv_area);
+            dy = _mm_mul_ps(dy, inv_area);
+            _mm_storeu_ps(batch->color_dx[i] + t, dx);
+            _mm_storeu_ps(batch->color_dy[i] + t, dy);
+            d1 = _mm_sub_ps(c[0][i], _mm_mul_ps(dx, centre_x));
+            _mm_storeu_ps(batch->color_c[i] + t, _mm_sub_ps(d1, _mm_mul_ps(dy, centre_y)));
+        }
+    }
+}
+
+const SoftKernels soft_kernels_sse2 = {
+    "sse2", 4, soft_sse2_load_aos, soft_sse2_load_soa, soft_sse2_setup,
+};
+
+/**
+ * AVX2, 8 triangles at a time
+ */
+
+SOFT_TARGET_AVX2 static void soft_avx2_store_position(SoftBatch* batch, uint32_t t, uint32_t k, __m256 x,
+                                                      __m256 y, __m256 z, float width, float height)
+{
+    const __m256 half = _mm256_set1_ps(0.5f);
+    _mm256_storeu_ps(batch->x[k] + t, _mm256_mul_ps(_mm256_add_ps(x, half), _mm256_set1_ps(width)));
+    _mm256_storeu_ps(batch->y[k] + t, _mm256_mul_ps(_mm256_sub_ps(half, y), _mm256_set1_ps(height)));
+    _mm256_storeu_ps(batch->z[k] + t, _mm256_add_ps(z, half));
+}
+
+// Every 8th triangle's corner, stride is how many floats there are per triangle
+SOFT_TARGET_AVX2 static __m256 soft_avx2_gather(const float* p, int32_t stride)
+{
+    const __m256i lanes = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    return _mm256_i32gather_ps(p, _mm256_mullo_epi32(lanes, _mm256_set1_epi32(stride)), 4);
+}
+
+SOFT_TARGET_AVX2 static void soft_avx2_load_aos(SoftBatch* batch, const float* pos, const float* col,
+                                                uint32_t count, float width, float height)
+{
+    const float* p;
+    uint32_t t, k, i;
+    for (t = 0; t + 8 <= count; t += 8) {
+        for (k = 0; k < 3; k++) {
+            p = pos + t * 9 + k * 3;
+            soft_avx2_store_position(batch, t, k, soft_avx2_gather(p, 9), soft_avx2_gather(p + 1, 9),
+                                     soft_avx2_gather(p + 2, 9), width, height);
+            for (i = 0; i < 3; i++) {
+                _mm256_storeu_ps(batch->color[k][i] + t, soft_avx2_gather(col + t * 9 + k * 3 + i, 9));
+            }
+        }
+    }
+    for (; t < count; t++) soft_load_aos_lane(batch, t, pos + t * 9, col + t * 9, width, height);
+}
+
+SOFT_TARGET_AVX2 static void soft_avx2_load_soa(SoftBatch* batch, const LapisVertexStreams* streams,
+                                                uint32_t first, uint32_t count, float width, float height)
+{
+    __m256 z = _mm256_setzero_ps();
+    uint32_t t, k, v;
+    for (t = 0; t + 8 <= count; t += 8) {
+        v = first + t * 3;
+        for (k = 0; k < 3; k++) {
+            if (streams->z) z = soft_avx2_gather(streams->z + v + k, 3);
+            soft_avx2_store_position(batch, t, k, soft_avx2_gather(streams->x + v + k, 3),
+                                     soft_avx2_gather(streams->y + v + k, 3), z, width, height);
+            _mm256_storeu_ps(batch->color[k][0] + t, soft_avx2_gather(streams->r + v + k, 3));
+            _mm256_storeu_ps(batch->color[k][1] + t, soft_avx2_gather(streams->g + v + k, 3));
+            _mm256_storeu_ps(batch->color[k][2] + t, soft_avx2_gather(streams->b + v + k, 3));
+        }
+    }
+    for (; t < count; t++) soft_load_soa_lane(batch, t, streams, first + t * 3, width, height);
+}
+
+SOFT_TARGET_AVX2 static __m256i soft_avx2_snap(__m256 v)
+{
+    __m256 scaled = _mm256_mul_ps(v, _mm256_set1_ps((float)SOFT_SUBPIXEL_ONE));
+    __m256 round = _mm256_blendv_ps(_mm256_set1_ps(-0.5f), _mm256_set1_ps(0.5f),
+                                    _mm256_cmp_ps(scaled, _mm256_setzero_ps(), _CMP_GE_OQ));
+    return _mm256_cvttps_epi32(_mm256_add_ps(scaled, round));
+}
+
+// Twice the signed area of 4 triangles, from the low or high half of the corners
+SOFT_TARGET_AVX2 static __m128 soft_avx2_area_half(__m128i ax, __m128i ay, __m128i bx, __m128i by)
+{
+    __m256d area = _mm256_sub_pd(_mm256_mul_pd(_mm256_cvtepi32_pd(ax), _mm256_cvtepi32_pd(by)),
+                                 _mm256_mul_pd(_mm256_cvtepi32_pd(ay), _mm256_cvtepi32_pd(bx)));
+    return _mm256_cvtpd_ps(area);
+}
+
+SOFT_TARGET_AVX2 static __m256 soft_avx2_area(const __m256i* x, const __m256i* y)
+{
+    __m256i ax = _mm256_sub_epi32(x[1], x[0]);
+    __m256i ay = _mm256_sub_epi32(y[1], y[0]);
+    __m256i bx = _mm256_sub_epi32(x[2], x[0]);
+    __m256i by = _mm256_sub_epi32(y[2], y[0]);
+    __m128 lo = soft_avx2_area_half(_mm256_castsi256_si128(ax), _mm256_castsi256_si128(ay),
+                                    _mm256_castsi256_si128(bx), _mm256_castsi256_si128(by));
+    __m128 hi = soft_avx2_area_half(_mm256_extracti128_si256(ax, 1), _mm256_extracti128_si256(ay, 1),
+                                    _mm256_extracti128_si256(bx, 1), _mm256_extracti128_si256(by, 1));
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+}
+
+SOFT_TARGET_AVX2 static void soft_avx2_setup(SoftBatch* batch, uint32_t count, const SoftRect* clip,
+                                             uint32_t facing)
+{
+    const __m256 band = _mm256_set1_ps((float)SOFT_GUARD_BAND);
+    const __m256 negative_band = _mm256_set1_ps(-(float)SOFT_GUARD_BAND);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 to_pixels = _mm256_set1_ps(1.0f / (float)SOFT_SUBPIXEL_ONE);
+    const __m256 area_scale = _mm256_set1_ps((float)(SOFT_SUBPIXEL_ONE * SOFT_SUBPIXEL_ONE));
+    const __m256i round_up = _mm256_set1_epi32(SOFT_SUBPIXEL_ONE / 2 - 1);
+    const __m256i round_down = _mm256_set1_epi32(SOFT_SUBPIXEL_ONE / 2);
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256 cull_back = _mm256_castsi256_ps(_mm256_set1_epi32(facing & e_lapis_cull_back ? -1 : 0));
+    const __m256 cull_front = _mm256_castsi256_ps(_mm256_set1_epi32(facing & e_lapis_cull_front ? -1 : 0));
+    __m256 px, py, inside, area, negative, culled, inv_area, d1, d2, dx, dy, fx[3], fy[3], c[3][3], swap;
+    __m256 edge_x[2], edge_y[2], centre_x, centre_y;
+    __m256i x[3], y[3], min_x, min_y, max_x, max_y, flip, swap_int, cull, filled, visible;
+    uint32_t t, k, i;
+
+    for (t = 0; t < count; t += 8) {
+        inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (k = 0; k < 3; k++) {
+            px = _mm256_loadu_ps(batch->x[k] + t);
+            py = _mm256_loadu_ps(batch->y[k] + t);
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(px, negative_band, _CMP_GT_OQ));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(px, band, _CMP_LT_OQ));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(py, negative_band, _CMP_GT_OQ));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(py, band, _CMP_LT_OQ));
+            x[k] = soft_avx2_snap(px);
+            y[k] = soft_avx2_snap(py);
+            for (i = 0; i < 3; i++) c[k][i] = _mm256_loadu_ps(batch->color[k][i] + t);
+        }
+
+        // Corners 1 and 2 swap where the area is negative. Reasons for culling are picked from the last
+        // checked to the first, so the first one which applies is the one left
+        area = soft_avx2_area(x, y);
+        negative = _mm256_cmp_ps(area, _mm256_setzero_ps(), _CMP_LT_OQ);
+        culled = _mm256_or_ps(_mm256_and_ps(_mm256_cmp_ps(area, _mm256_setzero_ps(), _CMP_GT_OQ), cull_back),
+                              _mm256_and_ps(negative, cull_front));
+        flip = _mm256_castps_si256(negative);
+        area = _mm256_andnot_ps(sign, area);
+        swap_int = x[1];
+        x[1] = _mm256_blendv_epi8(x[1], x[2], flip);
+        x[2] = _mm256_blendv_epi8(x[2], swap_int, flip);
+        swap_int = y[1];
+        y[1] = _mm256_blendv_epi8(y[1], y[2], flip);
+        y[2] = _mm256_blendv_epi8(y[2], swap_int, flip);
+        for (i = 0; i < 3; i++) {
+            swap = c[1][i];
+            c[1][i] = _mm256_blendv_ps(c[1][i], c[2][i], negative);
+            c[2][i] = _mm256_blendv_ps(c[2][i], swap, negative);
+        }
+
+        min_x = _mm256_min_epi32(_mm256_min_epi32(x[0], x[1]), x[2]);
+        min_y = _mm256_min_epi32(_mm256_min_epi32(y[0], y[1]), y[2]);
+        max_x = _mm256_max_epi32(_mm256_max_epi32(x[0], x[1]), x[2]);
+        max_y = _mm256_max_epi32(_mm256_max_epi32(y[0], y[1]), y[2]);
+        min_x = _mm256_srai_epi32(_mm256_add_epi32(min_x, round_up), SOFT_SUBPIXEL_BITS);
+        min_y = _mm256_srai_epi32(_mm256_add_epi32(min_y, round_up), SOFT_SUBPIXEL_BITS);
+        max_x = _mm256_srai_epi32(_mm256_sub_epi32(max_x, round_down), SOFT_SUBPIXEL_BITS);
+        max_y = _mm256_srai_epi32(_mm256_sub_epi32(max_y, round_down), SOFT_SUBPIXEL_BITS);
+        max_x = _mm256_add_epi32(max_x, one);
+        max_y = _mm256_add_epi32(max_y, one);
+        filled = _mm256_and_si256(_mm256_cmpgt_epi32(max_x, min_x), _mm256_cmpgt_epi32(max_y, min_y));
+        min_x = _mm256_max_epi32(min_x, _mm256_set1_epi32(clip->min_x));
+        min_y = _mm256_max_epi32(min_y, _mm256_set1_epi32(clip->min_y));
+        max_x = _mm256_min_epi32(max_x, _mm256_set1_epi32(clip->max_x));
+        max_y = _mm256_min_epi32(max_y, _mm256_set1_epi32(clip->max_y));
+        visible = _mm256_and_si256(_mm256_cmpgt_epi32(max_x, min_x), _mm256_cmpgt_epi32(max_y, min_y));
+        cull = _mm256_andnot_si256(visible, _mm256_set1_epi32(e_soft_cull_offscreen));
+        cull = _mm256_blendv_epi8(_mm256_set1_epi32(e_soft_cull_small), cull, filled);
+        cull = _mm256_blendv_epi8(cull, _mm256_set1_epi32(e_soft_cull_facing), _mm256_castps_si256(culled));
+        cull = _mm256_blendv_epi8(cull, _mm256_set1_epi32(e_soft_cull_degenerate),
+                                  _mm256_castps_si256(_mm256_cmp_ps(area, _mm256_setzero_ps(), _CMP_EQ_OQ)));
+        cull = _mm256_blendv_epi8(_mm256_set1_epi32(e_soft_cull_guard_band), cull,
+                                  _mm256_castps_si256(inside));
+        _mm256_storeu_si256((__m256i*)(batch->min_x + t), min_x);
+        _mm256_storeu_si256((__m256i*)(batch->min_y + t), min_y);
+        _mm256_storeu_si256((__m256i*)(batch->max_x + t), max_x);
+        _mm256_storeu_si256((__m256i*)(batch->max_y + t), max_y);
+        _mm256_storeu_si256((__m256i*)(batch->cull + t), cull);
+
+        for (k = 0; k < 3; k++) {
+            _mm256_storeu_si256((__m256i*)(batch->snap_x[k] + t), x[k]);
+            _mm256_storeu_si256((__m256i*)(batch->snap_y[k] + t), y[k]);
+            fx[k] = _mm256_mul_ps(_mm256_cvtepi32_ps(x[k]), to_pixels);
+            fy[k] = _mm256_mul_ps(_mm256_cvtepi32_ps(y[k]), to_pixels);
+        }
+        inv_area = _mm256_div_ps(area_scale, area);
+        edge_x[0] = _mm256_sub_ps(fx[1], fx[0]);
+        edge_x[1] = _mm256_sub_ps(fx[2], fx[0]);
+        edge_y[0] = _mm256_sub_ps(fy[1], fy[0]);
+        edge_y[1] = _mm256_sub_ps(fy[2], fy[0]);
+        centre_x = _mm256_sub_ps(fx[0], half);
+        centre_y = _mm256_sub_ps(fy[0], half);
+        for (i = 0; i < 3; i++) {
+            d1 = _mm256_sub_ps(c[1][i], c[0][i]);
+            d2 = _mm256_sub_ps(c[2][i], c[0][i]);
+            dx = _mm256_sub_ps(_mm256_mul_ps(d1, edge_y[1]), _mm256_mul_ps(d2, edge_y[0]));
+            dy = _mm256_sub_ps(_mm256_mul_ps(d2, edge_x[0]), _mm256_mul_ps(d1, edge_x[1]));
+            dx = _mm256_mul_ps(dx, inv_area);
+            dy = _mm256_mul_ps(dy, inv_area);
+            _mm256_storeu_ps(batch->color_dx[i] + t, dx);
+            _mm256_storeu_ps(batch->color_dy[i] + t, dy);
+            d1 = _mm256_sub_ps(c[0][i], _mm256_mul_ps(dx, centre_x));
+            _mm256_storeu_ps(batch->color_c[i] + t, _mm256_sub_ps(d1, _mm256_mul_ps(dy, centre_y)));
+        }
+    }
+}
+
+const SoftKernels soft_kernels_avx2 = {
+    "avx2", 8, soft_avx2_load_aos, soft_avx2_load_soa, soft_avx2_setup,
+};
+
+#endif  // SOFT_KERNELS_X86
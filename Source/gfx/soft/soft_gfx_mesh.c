@@ -0,0 +1,359 @@
+#include <math.h>
+#include <string.h>
+
+#include "soft_gfx.h"
+
+// Alignment of the vertices and of the indices which follow them
+#define SOFT_MESH_ALIGN (16)
+
+// Transformed vertices kept around while a mesh is drawn, must be a power of 2. Indexed meshes reuse most
+// vertices in neighbouring triangles, so a small direct mapped cache skips most of the transforms
+#define SOFT_VERTEX_CACHE (32)
+
+static const float soft_identity[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+
+static size_t soft_index_size(uint32_t index_type)
+{
+    switch (index_type) {
+        case e_lapis_index_16:
+            return sizeof(uint16_t);
+        case e_lapis_index_32:
+            return sizeof(uint32_t);
+    }
+    return 0;
+}
+
+static size_t soft_vertex_size(uint32_t vertex_format)
+{
+    return vertex_format == e_lapis_vertex_packed ? sizeof(LapisMeshPackedVertex) : sizeof(LapisMeshVertex);
+}
+
+// Offset of the indices in the mesh's gpu memory
+static size_t soft_index_offset(uint32_t vertex_count, uint32_t vertex_format)
+{
+    size_t offset = (size_t)vertex_count * soft_vertex_size(vertex_format);
+    return (offset + SOFT_MESH_ALIGN - 1) & ~(size_t)(SOFT_MESH_ALIGN - 1);
+}
+
+static int soft_mesh_helper_valid(const LapisMeshHelper* helper)
+{
+    return helper->index_type <= e_lapis_index_32 && helper->vertex_format <= e_lapis_vertex_packed;
+}
+
+LapisReturnCode lapis_size_mesh(LapisSize* size, LapisMeshHelper* helper)
+{
+    if (!size || !helper || !soft_mesh_helper_valid(helper)) return e_lapis_return_invalid_argument;
+
+    size->cpu_size = sizeof(SoftMesh);
+    size->gpu_size = soft_index_offset(helper->vertex_count, helper->vertex_format);
+    size->gpu_size += (size_t)helper->index_count * soft_index_size(helper->index_type);
+    size->gpu_align = SOFT_MESH_ALIGN;
+    return e_lapis_return_success;
+}
+
+// Grows a box to cover a position, the first position starts it
+static void soft_grow_bounds(SoftMesh* soft, const float* p, uint32_t first)
+{
+    uint32_t k;
+    for (k = 0; k < 3; k++) {
+        if (first || p[k] < soft->bounds_min[k]) soft->bounds_min[k] = p[k];
+        if (first || p[k] > soft->bounds_max[k]) soft->bounds_max[k] = p[k];
+    }
+}
+
+// Rounds a value from 0 to 1 to an integer from 0 to max
+static uint32_t soft_quantize(float value, float max)
+{
+    if (!(value > 0.0f)) return 0;
+    if (value >= 1.0f) return (uint32_t)max;
+    return (uint32_t)(value * max + 0.5f);
+}
+
+// Uploads positions and colors into the mesh's gpu memory
+static void soft_upload_vertices(SoftMesh* soft, void* vertices, const LapisMeshHelper* helper)
+{
+    LapisMeshVertex* out = (LapisMeshVertex*)vertices;
+    LapisMeshPackedVertex* packed = (LapisMeshPackedVertex*)vertices;
+    const float* p;
+    float range;
+    uint32_t i, k, q;
+
+    for (i = 0; i < helper->vertex_count; i++) {
+        p = helper->positions + i * 3;
+        if (helper->vertex_format == e_lapis_vertex_float) {
+            for (k = 0; k < 3; k++) {
+                out[i].position[k] = p[k];
+                out[i].color[k] = helper->colors[i * 3 + k];
+            }
+            out[i].position[3] = 1.0f;
+            out[i].color[3] = 1.0f;
+            continue;
+        }
+
+        for (k = 0; k < 3; k++) {
+            range = soft->bounds_max[k] - soft->bounds_min[k];
+            q = range > 0.0f ? soft_quantize((p[k] - soft->bounds_min[k]) / range, 65535.0f) : 0;
+            packed[i].position[k] = (uint16_t)q;
+            packed[i].color[k] = (uint8_t)soft_quantize(helper->colors[i * 3 + k], 255.0f);
+        }
+        packed[i].padding = 0;
+        packed[i].color[3] = 255;
+    }
+}
+
+LapisReturnCode lapis_create_mesh(LapisMesh* mesh, LapisMeshHelper* helper)
+{
+    SoftMesh* soft;
+    uint8_t* indices;
+    uint32_t i, k, given = 0;
+
+    if (!mesh || !helper || !mesh->cpu_mem || !soft_mesh_helper_valid(helper)) {
+        return e_lapis_return_invalid_argument;
+    }
+    if (helper->vertex_count && !mesh->gpu_mem) return e_lapis_return_invalid_argument;
+    if ((uintptr_t)mesh->gpu_mem & (SOFT_MESH_ALIGN - 1)) return e_lapis_return_invalid_argument;
+    if (helper->positions && !helper->colors) return e_lapis_return_invalid_argument;
+    if (helper->positions && helper->index_type != e_lapis_index_none && helper->index_count &&
+        !helper->indices) {
+        return e_lapis_return_invalid_argument;
+    }
+
+    soft = (SoftMesh*)mesh->cpu_mem;
+    soft->vertex_count = helper->vertex_count;
+    soft->index_type = helper->index_type;
+    soft->vertex_format = helper->vertex_format;
+    soft->vertices = mesh->gpu_mem;
+    indices = (uint8_t*)mesh->gpu_mem + soft_index_offset(helper->vertex_count, helper->vertex_format);
+    soft->indices = helper->index_type == e_lapis_index_none ? NULL : indices;
+    soft->triangle_count = (helper->index_type ? helper->index_count : helper->vertex_count) / 3;
+
+    for (k = 0; k < 3; k++) {
+        soft->bounds_min[k] = helper->bounds_min[k];
+        soft->bounds_max[k] = helper->bounds_max[k];
+        given |= helper->bounds_min[k] != 0.0f || helper->bounds_max[k] != 0.0f;
+    }
+
+    // Uploaded positions are what the box has to cover, packing them needs it first
+    if (helper->positions) {
+        for (i = 0; i < helper->vertex_count; i++) soft_grow_bounds(soft, helper->positions + i * 3, !i);
+        soft_upload_vertices(soft, mesh->gpu_mem, helper);
+        if (helper->index_type != e_lapis_index_none && helper->index_count) {
+            memcpy(indices, helper->indices, helper->index_count * soft_index_size(helper->index_type));
+        }
+    } else if (!given && helper->vertex_format == e_lapis_vertex_float) {
+        for (i = 0; i < helper->vertex_count; i++) {
+            soft_grow_bounds(soft, ((const LapisMeshVertex*)soft->vertices)[i].position, !i);
+        }
+    }
+    return e_lapis_return_success;
+}
+
+LapisReturnCode lapis_mesh_file_fill_helper(const void* file, size_t file_size, LapisMeshHelper* helper,
+                                            LapisMesh* mesh)
+{
+    const LapisMeshFileHeader* header = (const LapisMeshFileHeader*)file;
+    LapisSize size;
+    uint32_t k;
+
+    if (!file || !helper || !mesh || file_size < sizeof(LapisMeshFileHeader)) {
+        return e_lapis_return_invalid_argument;
+    }
+    if (header->magic != LAPIS_MESH_FILE_MAGIC || header->version != LAPIS_MESH_FILE_VERSION) {
+        return e_lapis_return_invalid_argument;
+    }
+    if (header->data_offset % LAPIS_MESH_FILE_ALIGN || header->data_offset > file_size ||
+        header->data_size > file_size - header->data_offset) {
+        return e_lapis_return_invalid_argument;
+    }
+
+    helper->vertex_count = header->vertex_count;
+    helper->index_count = header->index_count;
+    helper->index_type = (LapisIndexType)header->index_type;
+    helper->vertex_format = (LapisVertexFormat)header->vertex_format;
+    helper->positions = NULL;
+    helper->colors = NULL;
+    helper->indices = NULL;
+    for (k = 0; k < 3; k++) {
+        helper->bounds_min[k] = header->bounds_min[k];
+        helper->bounds_max[k] = header->bounds_max[k];
+    }
+
+    // The data has to be laid out exactly how this backend would have laid it out
+    if (lapis_size_mesh(&size, helper) != e_lapis_return_success || size.gpu_size != header->data_size) {
+        return e_lapis_return_invalid_argument;
+    }
+    mesh->gpu_mem = (uint8_t*)file + header->data_offset;
+    return e_lapis_return_success;
+}
+
+/**
+ * @brief Transforms a position and maps it into pixels the same way immediate mode does
+ * @returns The transformed w, vertices with a w of 0 or less are behind the viewer and can't be mapped
+ * @param out Vertex to fill in, only the position
+ * @param m Column major transform
+ * @param p Object space position
+ * @param width Width of the target in pixels
+ * @param height Height of the target in pixels
+ */
+static float soft_transform_position(SoftVertex* out, const float* m, const float* p, float width,
+                                     float height)
+{
+    float x = m[0] * p[0] + m[4] * p[1] + m[8] * p[2] + m[12];
+    float y = m[1] * p[0] + m[5] * p[1] + m[9] * p[2] + m[13];
+    float z = m[2] * p[0] + m[6] * p[1] + m[10] * p[2] + m[14];
+    float w = m[3] * p[0] + m[7] * p[1] + m[11] * p[2] + m[15];
+    if (!(w > 0.0f)) {
+        // NaN can't be clipped, so any triangle using it is skipped
+        out->x = out->y = out->z = NAN;
+        return w;
+    }
+    out->x = (x / w + 0.5f) * width;
+    out->y = (0.5f - y / w) * height;
+    out->z = z / w + 0.5f;
+    return w;
+}
+
+void soft_mesh_bounds(const SoftTarget* target, const SoftMesh* mesh, const float* transform,
+                      SoftRect* bounds)
+{
+    SoftVertex corners[8];
+    float p[3];
+    uint32_t i;
+    if (!mesh->triangle_count) return;
+
+    for (i = 0; i < 8; i++) {
+        p[0] = i & 1 ? mesh->bounds_max[0] : mesh->bounds_min[0];
+        p[1] = i & 2 ? mesh->bounds_max[1] : mesh->bounds_min[1];
+        p[2] = i & 4 ? mesh->bounds_max[2] : mesh->bounds_min[2];
+
+        // Part of the box is behind the viewer, so where the rest lands says nothing useful
+        if (!(soft_transform_position(&corners[i], transform, p, (float)target->width,
+                                      (float)target->height) > 0.0f)) {
+            soft_full_rect(target, bounds);
+            return;
+        }
+    }
+    soft_vertex_bounds(target, corners, 8, bounds);
+}
+
+static uint32_t soft_mesh_index(const SoftMesh* mesh, uint32_t i)
+{
+    switch (mesh->index_type) {
+        case e_lapis_index_16:
+            return ((const uint16_t*)mesh->indices)[i];
+        case e_lapis_index_32:
+            return ((const uint32_t*)mesh->indices)[i];
+    }
+    return i;
+}
+
+// Fetches a vertex, packed positions are left as they are for the transform to unpack
+static void soft_mesh_fetch(const SoftMesh* mesh, uint32_t index, float* position, float* color)
+{
+    const LapisMeshVertex* vertex;
+    const LapisMeshPackedVertex* packed;
+    uint32_t k;
+
+    if (mesh->vertex_format == e_lapis_vertex_float) {
+        vertex = (const LapisMeshVertex*)mesh->vertices + index;
+        for (k = 0; k < 3; k++) {
+            position[k] = vertex->position[k];
+            color[k] = vertex->color[k];
+        }
+        return;
+    }
+
+    packed = (const LapisMeshPackedVertex*)mesh->vertices + index;
+    for (k = 0; k < 3; k++) {
+        position[k] = (float)packed->position[k];
+        color[k] = (float)packed->color[k] * (1.0f / 255.0f);
+    }
+}
+
+// Folds unpacking a packed position, scaling and then moving it into the bounds, into the transform
+static void soft_unpack_transform(const SoftMesh* mesh, const float* m, float* out)
+{
+    float scale;
+    uint32_t r, k;
+
+    for (r = 0; r < 4; r++) {
+        out[12 + r] = m[12 + r];
+        for (k = 0; k < 3; k++) {
+            scale = (mesh->bounds_max[k] - mesh->bounds_min[k]) * (1.0f / 65535.0f);
+            out[k * 4 + r] = m[k * 4 + r] * scale;
+            out[12 + r] += m[k * 4 + r] * mesh->bounds_min[k];
+        }
+    }
+}
+
+void soft_draw_mesh(SoftTarget* target, const SoftMesh* mesh, const float* transform)
+{
+    SoftVertex cache[SOFT_VERTEX_CACHE];
+    uint32_t tags[SOFT_VERTEX_CACHE];
+    SoftBatch batch;
+    float unpack[16];
+    float position[3];
+    float width = (float)target->width;
+    float height = (float)target->height;
+    uint32_t t, k, c, index, slot, lane = 0;
+
+    if (mesh->vertex_format == e_lapis_vertex_packed) {
+        soft_unpack_transform(mesh, transform, unpack);
+        transform = unpack;
+    }
+    for (k = 0; k < SOFT_VERTEX_CACHE; k++) tags[k] = 0xFFFFFFFFu;
+
+    for (t = 0; t < mesh->triangle_count; t++) {
+        for (k = 0; k < 3; k++) {
+            index = soft_mesh_index(mesh, t * 3 + k);
+            if (index >= mesh->vertex_count) break;
+
+            slot = index & (SOFT_VERTEX_CACHE - 1);
+            if (tags[slot] != index) {
+                soft_mesh_fetch(mesh, index, position, cache[slot].color);
+                soft_transform_position(&cache[slot], transform, position, width, height);
+                tags[slot] = index;
+            }
+            batch.x[k][lane] = cache[slot].x;
+            batch.y[k][lane] = cache[slot].y;
+            batch.z[k][lane] = cache[slot].z;
+            for (c = 0; c < 3; c++) batch.color[k][c][lane] = cache[slot].color[c];
+        }
+
+        // Triangles with an index past the end of the vertices are skipped
+        if (k == 3 && ++lane == SOFT_BATCH) {
+            soft_submit_batch(target, &batch, lane);
+            lane = 0;
+        }
+    }
+    if (lane) soft_submit_batch(target, &batch, lane);
+}
+
+LapisReturnCode lapis_gfx_draw_mesh(LapisTarget* target, LapisMesh* mesh, const float* transform)
+{
+    SoftTarget* soft;
+    SoftMesh* soft_mesh;
+    SoftRect bounds;
+
+    if (!target || !target->cpu_mem || !mesh || !mesh->cpu_mem) return e_lapis_return_invalid_argument;
+    soft = (SoftTarget*)target->cpu_mem;
+    soft_mesh = (SoftMesh*)mesh->cpu_mem;
+    if (!transform) transform = soft_identity;
+
+    LAPIS_TRACE_BEGIN(e_lapis_stage_record);
+    if (soft->command_capacity) {
+        soft_record_mesh(soft, soft_mesh, transform);
+        LAPIS_TRACE_END(e_lapis_stage_record);
+        return e_lapis_return_success;
+    }
+
+    bounds.min_x = bounds.min_y = 0x7FFFFFFF;
+    bounds.max_x = bounds.max_y = 0;
+    soft_mesh_bounds(soft, soft_mesh, transform, &bounds);
+    soft_mark_dirty(soft, &bounds, 0);
+
+    soft_bind_target(soft);
+    soft_draw_mesh(soft, soft_mesh, transform);
+    LAPIS_TRACE_END(e_lapis_stage_record);
+    return e_lapis_return_success;
+}
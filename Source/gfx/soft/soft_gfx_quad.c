@@ -0,0 +1,131 @@
+#include "soft_gfx.h"
+
+// Clips a quad to its texture then to the target. Returns 0 if nothing is left, otherwise fills in the pixels
+// it draws and where the top left of them is in the texture
+static int soft_clip_quad(const SoftTarget* target, const LapisCoverage* coverage, const LapisQuad* quad,
+                          SoftRect* rect, int32_t* u, int32_t* v)
+{
+    int64_t width = quad->width;
+    int64_t height = quad->height;
+    int64_t min_x, min_y, max_x, max_y;
+
+    if (quad->u >= coverage->width || quad->v >= coverage->height) return 0;
+    if (width > coverage->width - quad->u) width = coverage->width - quad->u;
+    if (height > coverage->height - quad->v) height = coverage->height - quad->v;
+
+    min_x = quad->x > 0 ? quad->x : 0;
+    min_y = quad->y > 0 ? quad->y : 0;
+    max_x = quad->x + width < target->width ? quad->x + width : target->width;
+    max_y = quad->y + height < target->height ? quad->y + height : target->height;
+    if (min_x >= max_x || min_y >= max_y) return 0;
+
+    rect->min_x = (int32_t)min_x;
+    rect->min_y = (int32_t)min_y;
+    rect->max_x = (int32_t)max_x;
+    rect->max_y = (int32_t)max_y;
+    *u = quad->u + (int32_t)(min_x - quad->x);
+    *v = quad->v + (int32_t)(min_y - quad->y);
+    return 1;
+}
+
+// Blends a packed color over a pixel, coverage runs from 0 to 255
+static uint32_t soft_blend(uint32_t pixel, uint32_t color, uint32_t coverage)
+{
+    uint32_t packed = 0xFF000000u;
+    uint32_t shift, src, dst;
+    for (shift = 0; shift < 24; shift += 8) {
+        src = (color >> shift) & 0xFF;
+        dst = (pixel >> shift) & 0xFF;
+        packed |= ((src * coverage + dst * (255 - coverage) + 127) / 255) << shift;
+    }
+    return packed;
+}
+
+void soft_quad_bounds(const SoftTarget* target, const LapisCoverage* coverage, const LapisQuad* quads,
+                      uint32_t count, SoftRect* bounds)
+{
+    SoftRect rect;
+    int32_t u, v;
+    uint32_t i;
+    for (i = 0; i < count; i++) {
+        if (!soft_clip_quad(target, coverage, &quads[i], &rect, &u, &v)) continue;
+        if (rect.min_x < bounds->min_x) bounds->min_x = rect.min_x;
+        if (rect.min_y < bounds->min_y) bounds->min_y = rect.min_y;
+        if (rect.max_x > bounds->max_x) bounds->max_x = rect.max_x;
+        if (rect.max_y > bounds->max_y) bounds->max_y = rect.max_y;
+    }
+}
+
+void soft_draw_quads(SoftTarget* target, const LapisCoverage* coverage, const LapisQuad* quads,
+                     uint32_t count, uint32_t color)
+{
+    const uint8_t* src;
+    uint8_t* row;
+    SoftRect rect;
+    int32_t u, v, x, y;
+    uint32_t i, c, pixel;
+
+    // Quads aren't binned, so triangles binned before them and any waiting clears have to land first
+    soft_flush(target);
+    for (i = 0; i < count; i++) {
+        if (!soft_clip_quad(target, coverage, &quads[i], &rect, &u, &v)) continue;
+        for (y = rect.min_y; y < rect.max_y; y++) {
+            row = target->pixels + (size_t)y * target->stride * target->pixel_bytes;
+            src = coverage->pixels + (size_t)(v + y - rect.min_y) * coverage->stride + u;
+            if (target->format == e_lapis_format_rgba8) {
+                for (x = rect.min_x; x < rect.max_x; x++) {
+                    c = src[x - rect.min_x];
+                    if (c == 255) {
+                        ((uint32_t*)row)[x] = color;
+                    } else if (c) {
+                        ((uint32_t*)row)[x] = soft_blend(((uint32_t*)row)[x], color, c);
+                    }
+                }
+                continue;
+            }
+
+            // 16 bit pixels are blended in RGBA8 and narrowed again, the same as drawing in RGBA8 then
+            // converting
+            for (x = rect.min_x; x < rect.max_x; x++) {
+                c = src[x - rect.min_x];
+                if (!c) continue;
+                pixel = c == 255 ? color : soft_blend(soft_unpack_format(target->format, ((uint16_t*)row)[x]),
+                                                      color, c);
+                ((uint16_t*)row)[x] = (uint16_t)soft_pack_format(target->format, pixel);
+            }
+        }
+    }
+}
+
+LapisReturnCode lapis_gfx_draw_quads(LapisTarget* target, const LapisCoverage* coverage,
+                                     const LapisQuad* quads, uint32_t count, const float* color)
+{
+    SoftTarget* soft;
+    SoftRect bounds;
+    uint32_t packed, first, recorded;
+
+    if (!target || !target->cpu_mem || !coverage || !color) return e_lapis_return_invalid_argument;
+    if (count && (!quads || !coverage->pixels)) return e_lapis_return_invalid_argument;
+
+    soft = (SoftTarget*)target->cpu_mem;
+    packed = soft_pack_color(color);
+    LAPIS_TRACE_BEGIN(e_lapis_stage_record);
+    if (soft->command_capacity) {
+        for (first = 0; first < count; first += recorded) {
+            recorded = count - first;
+            soft_record_quads(soft, coverage, quads + first, &recorded, packed);
+        }
+        LAPIS_TRACE_END(e_lapis_stage_record);
+        return e_lapis_return_success;
+    }
+
+    bounds.min_x = bounds.min_y = 0x7FFFFFFF;
+    bounds.max_x = bounds.max_y = 0;
+    soft_quad_bounds(soft, coverage, quads, count, &bounds);
+    soft_mark_dirty(soft, &bounds, 0);
+
+    soft_bind_target(soft);
+    soft_draw_quads(soft, coverage, quads, count, packed);
+    LAPIS_TRACE_END(e_lapis_stage_record);
+    return e_lapis_return_success;
+}
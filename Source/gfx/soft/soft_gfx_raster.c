@@ -0,0 +1,469 @@
+#include "common_core_format.h"
+#include "soft_gfx.h"
+
+uint32_t soft_pack_color(const float* color)
+{
+    uint32_t packed = 0xFF000000u;
+    uint32_t i;
+    for (i = 0; i < 3; i++) {
+        float c = color[i];
+        c = c < 0.0f ? 0.0f : (c > 1.0f ? 1.0f : c);
+        packed |= ((uint32_t)(c * 255.0f + 0.5f)) << (i * 8);
+    }
+    return packed;
+}
+
+uint32_t soft_pack_format(uint32_t format, uint32_t color)
+{
+    if (format == e_lapis_format_rgb565) return common_pack_rgb565(color);
+    if (format == e_lapis_format_rgb5a3) return common_pack_rgb5a3(color);
+    return color;
+}
+
+uint32_t soft_unpack_format(uint32_t format, uint32_t pixel)
+{
+    if (format == e_lapis_format_rgb565) return common_unpack_rgb565(pixel);
+    if (format == e_lapis_format_rgb5a3) return common_unpack_rgb5a3(pixel);
+    return pixel;
+}
+
+// Stores a packed color into pixel x of a row
+static void soft_store_pixel(uint8_t* row, uint32_t format, int32_t x, uint32_t color)
+{
+    if (format == e_lapis_format_rgba8) {
+        ((uint32_t*)row)[x] = color;
+    } else {
+        ((uint16_t*)row)[x] = (uint16_t)soft_pack_format(format, color);
+    }
+}
+
+#if defined(__SSE2__)
+// Packs 4 colors into a 16 bit format in the bottom half of the register
+static __m128i soft_pack16_4(uint32_t format, __m128i color)
+{
+    color = format == e_lapis_format_rgb565 ? common_rgb565_4(color) : common_rgb555_4(color);
+    return common_pack16_8(color, color);
+}
+
+// Stores 4 colors starting at pixel x of a row, only in the lanes where mask is set
+static void soft_store_4(uint8_t* row, uint32_t format, int32_t x, __m128i color, __m128i mask)
+{
+    __m128i* dst;
+    __m128i old;
+    if (format == e_lapis_format_rgba8) {
+        dst = (__m128i*)(row + (size_t)x * 4);
+        old = _mm_loadu_si128(dst);
+        _mm_storeu_si128(dst, _mm_or_si128(_mm_and_si128(mask, color), _mm_andnot_si128(mask, old)));
+        return;
+    }
+    dst = (__m128i*)(row + (size_t)x * 2);
+    mask = _mm_packs_epi32(mask, mask);
+    old = _mm_loadl_epi64(dst);
+    color = soft_pack16_4(format, color);
+    _mm_storel_epi64(dst, _mm_or_si128(_mm_and_si128(mask, color), _mm_andnot_si128(mask, old)));
+}
+#endif
+
+static void soft_intersect_rect(SoftRect* out, const SoftRect* a, const SoftRect* b)
+{
+    out->min_x = a->min_x > b->min_x ? a->min_x : b->min_x;
+    out->min_y = a->min_y > b->min_y ? a->min_y : b->min_y;
+    out->max_x = a->max_x < b->max_x ? a->max_x : b->max_x;
+    out->max_y = a->max_y < b->max_y ? a->max_y : b->max_y;
+}
+
+/**
+ * Span shading, both the full block and the partial block paths go through the same arithmetic so a pixel
+ * always ends up with exactly the same color no matter how it was reached
+ */
+
+// Color of a single pixel, base is the color plane already evaluated for the row
+static uint32_t soft_shade_pixel(const float* base, const float* dx, int32_t px)
+{
+    uint32_t packed = 0xFF000000u;
+    uint32_t i;
+    for (i = 0; i < 3; i++) {
+        float c = base[i] + dx[i] * (float)px;
+        c = c < 0.0f ? 0.0f : (c > 1.0f ? 1.0f : c);
+        packed |= ((uint32_t)(c * 255.0f + 0.5f)) << (i * 8);
+    }
+    return packed;
+}
+
+#if defined(__SSE2__)
+// Color of 4 neighbouring pixels starting at px
+static __m128i soft_shade_4(const float* base, const float* dx, int32_t px)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(255.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    __m128 x = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(px), _mm_set_epi32(3, 2, 1, 0)));
+    __m128i packed = _mm_set1_epi32((int)0xFF000000u);
+    int i;
+    for (i = 0; i < 3; i++) {
+        __m128 c = _mm_add_ps(_mm_set1_ps(base[i]), _mm_mul_ps(_mm_set1_ps(dx[i]), x));
+        c = _mm_min_ps(_mm_max_ps(c, zero), one);
+        c = _mm_add_ps(_mm_mul_ps(c, scale), half);
+        packed = _mm_or_si128(packed, _mm_slli_epi32(_mm_cvttps_epi32(c), i * 8));
+    }
+    return packed;
+}
+#endif
+
+// Shades every pixel in [x0, x1) on a row
+static void soft_span_full(uint8_t* row, uint32_t format, const float* base, const float* dx, int32_t x0,
+                           int32_t x1)
+{
+    int32_t x = x0;
+#if defined(__SSE2__)
+    for (; x + 4 <= x1; x += 4) {
+        if (format == e_lapis_format_rgba8) {
+            _mm_storeu_si128((__m128i*)(row + (size_t)x * 4), soft_shade_4(base, dx, x));
+        } else {
+            _mm_storel_epi64((__m128i*)(row + (size_t)x * 2),
+                             soft_pack16_4(format, soft_shade_4(base, dx, x)));
+        }
+    }
+#endif
+    for (; x < x1; x++) {
+        soft_store_pixel(row, format, x, soft_shade_pixel(base, dx, x));
+    }
+}
+
+// Shades the pixels in [x0, x1) on a row which pass all 3 edge tests, e holds the edge values at x0
+static void soft_span_edges(uint8_t* row, uint32_t format, const float* base, const float* dx, int32_t x0,
+                            int32_t x1, const int32_t* e, const int32_t* step)
+{
+    int32_t e0 = e[0], e1 = e[1], e2 = e[2];
+    int32_t x = x0;
+#if defined(__SSE2__)
+    const __m128i all = _mm_set1_epi32(-1);
+    __m128i v0 = _mm_set_epi32(e0 + 3 * step[0], e0 + 2 * step[0], e0 + step[0], e0);
+    __m128i v1 = _mm_set_epi32(e1 + 3 * step[1], e1 + 2 * step[1], e1 + step[1], e1);
+    __m128i v2 = _mm_set_epi32(e2 + 3 * step[2], e2 + 2 * step[2], e2 + step[2], e2);
+    __m128i s0 = _mm_set1_epi32(step[0] * 4);
+    __m128i s1 = _mm_set1_epi32(step[1] * 4);
+    __m128i s2 = _mm_set1_epi32(step[2] * 4);
+    for (; x + 4 <= x1; x += 4) {
+        __m128i inside = _mm_cmpgt_epi32(_mm_or_si128(_mm_or_si128(v0, v1), v2), all);
+        if (_mm_movemask_epi8(inside) != 0) soft_store_4(row, format, x, soft_shade_4(base, dx, x), inside);
+        v0 = _mm_add_epi32(v0, s0);
+        v1 = _mm_add_epi32(v1, s1);
+        v2 = _mm_add_epi32(v2, s2);
+    }
+    e0 += (x - x0) * step[0];
+    e1 += (x - x0) * step[1];
+    e2 += (x - x0) * step[2];
+#endif
+    for (; x < x1; x++) {
+        if ((e0 | e1 | e2) >= 0) soft_store_pixel(row, format, x, soft_shade_pixel(base, dx, x));
+        e0 += step[0];
+        e1 += step[1];
+        e2 += step[2];
+    }
+}
+
+// Same as soft_span_edges but only shades the pixels which also pass the depth test, writing their depth.
+// When test is 0 the triangle is known to be in front of every pixel so the depth isn't compared. Returns
+// non zero if anything was written
+static int soft_span_depth(uint8_t* row, uint32_t format, float* depth, const float* base, const float* dx,
+                           float z_base, float z_dx, int32_t x0, int32_t x1, const int32_t* e,
+                           const int32_t* step, int test)
+{
+    int32_t e0 = e[0], e1 = e[1], e2 = e[2];
+    int32_t x = x0;
+    int written = 0;
+    float z;
+#if defined(__SSE2__)
+    const __m128i all = _mm_set1_epi32(-1);
+    __m128i v0 = _mm_set_epi32(e0 + 3 * step[0], e0 + 2 * step[0], e0 + step[0], e0);
+    __m128i v1 = _mm_set_epi32(e1 + 3 * step[1], e1 + 2 * step[1], e1 + step[1], e1);
+    __m128i v2 = _mm_set_epi32(e2 + 3 * step[2], e2 + 2 * step[2], e2 + step[2], e2);
+    __m128i s0 = _mm_set1_epi32(step[0] * 4);
+    __m128i s1 = _mm_set1_epi32(step[1] * 4);
+    __m128i s2 = _mm_set1_epi32(step[2] * 4);
+    for (; x + 4 <= x1; x += 4) {
+        __m128i pass = _mm_cmpgt_epi32(_mm_or_si128(_mm_or_si128(v0, v1), v2), all);
+        __m128 xs = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(x), _mm_set_epi32(3, 2, 1, 0)));
+        __m128 zs = _mm_add_ps(_mm_set1_ps(z_base), _mm_mul_ps(_mm_set1_ps(z_dx), xs));
+        __m128 old_z = _mm_loadu_ps(depth + x);
+        if (test) pass = _mm_and_si128(pass, _mm_castps_si128(_mm_cmple_ps(zs, old_z)));
+        if (_mm_movemask_epi8(pass) != 0) {
+            __m128 mask = _mm_castsi128_ps(pass);
+            soft_store_4(row, format, x, soft_shade_4(base, dx, x), pass);
+            _mm_storeu_ps(depth + x, _mm_or_ps(_mm_and_ps(mask, zs), _mm_andnot_ps(mask, old_z)));
+            written = 1;
+        }
+        v0 = _mm_add_epi32(v0, s0);
+        v1 = _mm_add_epi32(v1, s1);
+        v2 = _mm_add_epi32(v2, s2);
+    }
+    e0 += (x - x0) * step[0];
+    e1 += (x - x0) * step[1];
+    e2 += (x - x0) * step[2];
+#endif
+    for (; x < x1; x++) {
+        z = z_base + z_dx * (float)x;
+        if ((e0 | e1 | e2) >= 0 && (!test || z <= depth[x])) {
+            soft_store_pixel(row, format, x, soft_shade_pixel(base, dx, x));
+            depth[x] = z;
+            written = 1;
+        }
+        e0 += step[0];
+        e1 += step[1];
+        e2 += step[2];
+    }
+    return written;
+}
+
+int soft_triangle_covers(const SoftTriangle* tri, const SoftRect* rect)
+{
+    int64_t e, w, h;
+    uint32_t i;
+    if (rect->min_x < tri->bounds.min_x || rect->min_y < tri->bounds.min_y ||
+        rect->max_x > tri->bounds.max_x || rect->max_y > tri->bounds.max_y) {
+        return 0;
+    }
+
+    // Same corner test as the blocks use, the rectangle is covered if no edge can go negative inside of it
+    for (i = 0; i < 3; i++) {
+        e = tri->edge_c[i] + tri->edge_dx[i] * rect->min_x + tri->edge_dy[i] * rect->min_y;
+        w = tri->edge_dx[i] * (rect->max_x - 1 - rect->min_x);
+        h = tri->edge_dy[i] * (rect->max_y - 1 - rect->min_y);
+        if (e + (w < 0 ? w : 0) + (h < 0 ? h : 0) < 0) return 0;
+    }
+    return 1;
+}
+
+void soft_triangle_depth(const SoftTriangle* tri, const SoftRect* rect, SoftDepthRange* range)
+{
+    float top = tri->z_c + tri->z_dy * (float)rect->min_y;
+    float bottom = tri->z_c + tri->z_dy * (float)(rect->max_y - 1);
+    float left = tri->z_dx * (float)rect->min_x;
+    float right = tri->z_dx * (float)(rect->max_x - 1);
+    float corners[4];
+    uint32_t i;
+
+    corners[0] = top + left;
+    corners[1] = top + right;
+    corners[2] = bottom + left;
+    corners[3] = bottom + right;
+    range->min = range->max = corners[0];
+    for (i = 1; i < 4; i++) {
+        if (corners[i] < range->min) range->min = corners[i];
+        if (corners[i] > range->max) range->max = corners[i];
+    }
+}
+
+/**
+ * @brief Tests the corners of a block against each edge of a triangle. Edges the block is entirely inside of
+ * can be ignored, edges that pass through the block are small enough here to fit in 32 bits
+ * @returns -1 if the block is outside of an edge, otherwise non zero if any edge passes through it
+ * @param tri The triangle
+ * @param x0, y0, x1, y1 Pixels of the block the triangle's bounds overlap
+ * @param crossing Filled in with whether each edge passes through the block
+ * @param e_block Filled in with each crossing edge's value at x0, y0, 0 for the others
+ * @param step Filled in with how much each crossing edge steps by per pixel along a row, 0 for the others
+ */
+static int soft_block_edges(const SoftTriangle* tri, int32_t x0, int32_t y0, int32_t x1, int32_t y1,
+                            int* crossing, int64_t* e_block, int32_t* step)
+{
+    int any_crossing = 0;
+    int outside = 0;
+    uint32_t i;
+
+    for (i = 0; i < 3; i++) {
+        int64_t e = tri->edge_c[i] + tri->edge_dx[i] * x0 + tri->edge_dy[i] * y0;
+        int64_t w = tri->edge_dx[i] * (x1 - 1 - x0);
+        int64_t h = tri->edge_dy[i] * (y1 - 1 - y0);
+        int64_t lo = e + (w < 0 ? w : 0) + (h < 0 ? h : 0);
+        int64_t hi = e + (w > 0 ? w : 0) + (h > 0 ? h : 0);
+        if (hi < 0) outside = 1;
+        crossing[i] = lo < 0;
+        any_crossing |= crossing[i];
+        e_block[i] = crossing[i] ? e : 0;
+        step[i] = crossing[i] ? (int32_t)tri->edge_dx[i] : 0;
+    }
+    return outside ? -1 : any_crossing;
+}
+
+// Works out the depth range of a block again after a triangle has written into it
+static void soft_update_block(SoftTarget* target, int32_t bx, int32_t by, SoftDepthRange* range)
+{
+    int32_t width = (int32_t)target->width;
+    int32_t height = (int32_t)target->height;
+    int32_t x1 = bx + SOFT_BLOCK_SIZE < width ? bx + SOFT_BLOCK_SIZE : width;
+    int32_t y1 = by + SOFT_BLOCK_SIZE < height ? by + SOFT_BLOCK_SIZE : height;
+    const float* depth;
+    int32_t x, y;
+
+    range->min = range->max = target->depth[(size_t)by * target->width + bx];
+    for (y = by; y < y1; y++) {
+        depth = target->depth + (size_t)y * target->width;
+        for (x = bx; x < x1; x++) {
+            if (depth[x] < range->min) range->min = depth[x];
+            if (depth[x] > range->max) range->max = depth[x];
+        }
+    }
+}
+
+// Works out the depth ranges of every tile a rectangle touches again from their blocks
+static void soft_update_tiles(SoftTarget* target, const SoftRect* rect)
+{
+    const int32_t blocks_per_tile = SOFT_TILE_SIZE / SOFT_BLOCK_SIZE;
+    int32_t blocks_y = ((int32_t)target->height + SOFT_BLOCK_SIZE - 1) / SOFT_BLOCK_SIZE;
+    int32_t tx, ty, bx, by, bx1, by1;
+    const SoftDepthRange* block;
+    SoftDepthRange* tile;
+
+    for (ty = rect->min_y / SOFT_TILE_SIZE; ty <= (rect->max_y - 1) / SOFT_TILE_SIZE; ty++) {
+        for (tx = rect->min_x / SOFT_TILE_SIZE; tx <= (rect->max_x - 1) / SOFT_TILE_SIZE; tx++) {
+            tile = &target->tile_depth[ty * (int32_t)target->tiles_x + tx];
+            by1 = (ty + 1) * blocks_per_tile < blocks_y ? (ty + 1) * blocks_per_tile : blocks_y;
+            bx1 = (tx + 1) * blocks_per_tile < (int32_t)target->blocks_x ? (tx + 1) * blocks_per_tile
+                                                                          : (int32_t)target->blocks_x;
+            tile->min = tile->max = target->block_depth[ty * blocks_per_tile * target->blocks_x +
+                                                        tx * blocks_per_tile].min;
+            for (by = ty * blocks_per_tile; by < by1; by++) {
+                for (bx = tx * blocks_per_tile; bx < bx1; bx++) {
+                    block = &target->block_depth[by * target->blocks_x + bx];
+                    if (block->min < tile->min) tile->min = block->min;
+                    if (block->max > tile->max) tile->max = block->max;
+                }
+            }
+        }
+    }
+}
+
+// Rasterizes a triangle into a target with a depth buffer, walking the blocks the same way as
+// soft_raster_triangle. Blocks the triangle is entirely behind are skipped without reading any depth, and
+// blocks it's entirely in front of only write the depth
+static void soft_raster_depth(const SoftTriangle* tri, SoftTarget* target, const SoftRect* rect)
+{
+    const int32_t last = SOFT_BLOCK_SIZE - 1;
+    SoftDepthRange range;
+    SoftDepthRange* block;
+    SoftRect pixels;
+    int32_t bx, by, y, i;
+    int any_written = 0;
+
+    for (by = rect->min_y & ~last; by < rect->max_y; by += SOFT_BLOCK_SIZE) {
+        int32_t y0 = by > rect->min_y ? by : rect->min_y;
+        int32_t y1 = by + SOFT_BLOCK_SIZE < rect->max_y ? by + SOFT_BLOCK_SIZE : rect->max_y;
+
+        for (bx = rect->min_x & ~last; bx < rect->max_x; bx += SOFT_BLOCK_SIZE) {
+            int32_t x0 = bx > rect->min_x ? bx : rect->min_x;
+            int32_t x1 = bx + SOFT_BLOCK_SIZE < rect->max_x ? bx + SOFT_BLOCK_SIZE : rect->max_x;
+            int32_t e_row[3], step[3];
+            int64_t e_block[3];
+            int crossing[3];
+            int test, written = 0;
+
+            if (soft_block_edges(tri, x0, y0, x1, y1, crossing, e_block, step) < 0) continue;
+            pixels.min_x = x0;
+            pixels.min_y = y0;
+            pixels.max_x = x1;
+            pixels.max_y = y1;
+            soft_triangle_depth(tri, &pixels, &range);
+            block = &target->block_depth[(by / SOFT_BLOCK_SIZE) * target->blocks_x + bx / SOFT_BLOCK_SIZE];
+            if (range.min > block->max) continue;
+            test = range.max > block->min;
+
+            for (y = y0; y < y1; y++) {
+                uint8_t* row = target->pixels + (size_t)y * target->stride * target->pixel_bytes;
+                float* depth = target->depth + (size_t)y * target->width;
+                float base[3];
+                for (i = 0; i < 3; i++) {
+                    base[i] = tri->color_c[i] + tri->color_dy[i] * (float)y;
+                    e_row[i] = crossing[i] ? (int32_t)(e_block[i] + tri->edge_dy[i] * (y - y0)) : 0;
+                }
+                written |= soft_span_depth(row, target->format, depth, base, tri->color_dx,
+                                           tri->z_c + tri->z_dy * (float)y, tri->z_dx, x0, x1, e_row, step,
+                                           test);
+            }
+            if (written) {
+                soft_update_block(target, bx, by, block);
+                any_written = 1;
+            }
+        }
+    }
+    if (any_written) soft_update_tiles(target, rect);
+}
+
+void soft_raster_triangle(const SoftTriangle* tri, SoftTarget* target, const SoftRect* clip)
+{
+    const int32_t last = SOFT_BLOCK_SIZE - 1;
+    SoftRect rect;
+    int32_t bx, by, y, i;
+
+    soft_intersect_rect(&rect, &tri->bounds, clip);
+    if (rect.min_x >= rect.max_x || rect.min_y >= rect.max_y) return;
+    if (target->depth) {
+        soft_raster_depth(tri, target, &rect);
+        return;
+    }
+
+    // Blocks are aligned to the block grid rather than the triangle, so any rectangle split along the grid
+    // visits the pixels in exactly the same way
+    for (by = rect.min_y & ~last; by < rect.max_y; by += SOFT_BLOCK_SIZE) {
+        int32_t y0 = by > rect.min_y ? by : rect.min_y;
+        int32_t y1 = by + SOFT_BLOCK_SIZE < rect.max_y ? by + SOFT_BLOCK_SIZE : rect.max_y;
+
+        for (bx = rect.min_x & ~last; bx < rect.max_x; bx += SOFT_BLOCK_SIZE) {
+            int32_t x0 = bx > rect.min_x ? bx : rect.min_x;
+            int32_t x1 = bx + SOFT_BLOCK_SIZE < rect.max_x ? bx + SOFT_BLOCK_SIZE : rect.max_x;
+            int32_t e_row[3], step[3];
+            int64_t e_block[3];
+            int crossing[3];
+            int any_crossing = soft_block_edges(tri, x0, y0, x1, y1, crossing, e_block, step);
+            if (any_crossing < 0) continue;
+
+            for (y = y0; y < y1; y++) {
+                uint8_t* row = target->pixels + (size_t)y * target->stride * target->pixel_bytes;
+                float base[3];
+                for (i = 0; i < 3; i++) {
+                    base[i] = tri->color_c[i] + tri->color_dy[i] * (float)y;
+                }
+
+                if (!any_crossing) {
+                    soft_span_full(row, target->format, base, tri->color_dx, x0, x1);
+                    continue;
+                }
+                for (i = 0; i < 3; i++) {
+                    e_row[i] = crossing[i] ? (int32_t)(e_block[i] + tri->edge_dy[i] * (y - y0)) : 0;
+                }
+                soft_span_edges(row, target->format, base, tri->color_dx, x0, x1, e_row, step);
+            }
+        }
+    }
+}
+
+void soft_fill_rect(SoftTarget* target, const SoftRect* rect, uint32_t color)
+{
+    uint32_t pixel = soft_pack_format(target->format, color);
+    int32_t x, y;
+    for (y = rect->min_y; y < rect->max_y; y++) {
+        uint8_t* row = target->pixels + (size_t)y * target->stride * target->pixel_bytes;
+        if (target->pixel_bytes == 4) {
+            for (x = rect->min_x; x < rect->max_x; x++) {
+                ((uint32_t*)row)[x] = pixel;
+            }
+            continue;
+        }
+        for (x = rect->min_x; x < rect->max_x; x++) {
+            ((uint16_t*)row)[x] = (uint16_t)pixel;
+        }
+    }
+}
+
+void soft_clear_depth(SoftTarget* target, const SoftRect* rect)
+{
+    int32_t x, y;
+    for (y = rect->min_y; y < rect->max_y; y++) {
+        float* depth = target->depth + (size_t)y * target->width;
+        for (x = rect->min_x; x < rect->max_x; x++) {
+            depth[x] = SOFT_DEPTH_FAR;
+        }
+    }
+}
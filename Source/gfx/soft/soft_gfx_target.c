@@ -0,0 +1,378 @@
+#include <string.h>
+
+#include "soft_gfx.h"
+
+// Where everything lives inside of a target's cpu memory
+typedef struct SoftTargetLayout {
+    uint32_t tiles_x;
+    uint32_t tiles_y;
+    uint32_t triangle_capacity;
+    uint32_t chunk_capacity;
+    uint32_t blocks_x;
+    uint32_t blocks_y;
+    size_t tile_clears_offset;
+    size_t tile_depth_offset;
+    size_t block_depth_offset;
+    size_t depth_offset;
+    size_t bins_offset;
+    size_t triangles_offset;
+    size_t chunks_offset;
+    size_t commands_offset;
+    size_t size;
+} SoftTargetLayout;
+
+static size_t soft_align(size_t value, size_t align) { return (value + align - 1) & ~(align - 1); }
+
+static uint32_t soft_command_buffers(const LapisTargetHelper* helper)
+{
+    if (!helper->command_buffers) return 1;
+    return helper->command_buffers < LAPIS_MAX_FRAMES_IN_FLIGHT ? helper->command_buffers
+                                                                : LAPIS_MAX_FRAMES_IN_FLIGHT;
+}
+
+// Workers is how many the helper's context has, passed separately so bundles can size targets before the
+// context exists
+static void soft_target_layout(const LapisTargetHelper* helper, uint32_t workers, SoftTargetLayout* layout)
+{
+    uint32_t tiles, blocks;
+    int binned = helper->context && workers > 1;
+    int depth = helper->depth != 0;
+
+    layout->tiles_x = (helper->width + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE;
+    layout->tiles_y = (helper->height + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE;
+    tiles = layout->tiles_x * layout->tiles_y;
+    layout->blocks_x = (helper->width + SOFT_BLOCK_SIZE - 1) / SOFT_BLOCK_SIZE;
+    layout->blocks_y = (helper->height + SOFT_BLOCK_SIZE - 1) / SOFT_BLOCK_SIZE;
+    blocks = depth ? layout->blocks_x * layout->blocks_y : 0;
+    layout->triangle_capacity = binned ? (helper->bin_triangles ? helper->bin_triangles
+                                                                : SOFT_DEFAULT_BIN_TRIANGLES)
+                                       : 0;
+
+    // Enough chunks for a triangle to touch every tile, plus room for most triangles to touch a few
+    layout->chunk_capacity = binned ? tiles + layout->triangle_capacity / 4 : 0;
+
+    layout->tile_clears_offset = soft_align(sizeof(SoftTarget), 16);
+    layout->tile_depth_offset = soft_align(layout->tile_clears_offset + tiles * sizeof(SoftTileClear), 16);
+    layout->block_depth_offset =
+        soft_align(layout->tile_depth_offset + (depth ? tiles * sizeof(SoftDepthRange) : 0), 16);
+    layout->depth_offset =
+        soft_align(layout->block_depth_offset + blocks * sizeof(SoftDepthRange), SOFT_PIXEL_ALIGN);
+    layout->bins_offset = soft_align(
+        layout->depth_offset + (depth ? (size_t)helper->width * helper->height * sizeof(float) : 0), 16);
+    layout->triangles_offset = soft_align(layout->bins_offset + (binned ? tiles * sizeof(SoftBin) : 0), 16);
+    layout->chunks_offset =
+        soft_align(layout->triangles_offset + layout->triangle_capacity * sizeof(SoftTriangle), 16);
+    layout->commands_offset =
+        soft_align(layout->chunks_offset + layout->chunk_capacity * sizeof(SoftBinChunk), 16);
+    layout->size = layout->commands_offset + (size_t)helper->command_bytes * soft_command_buffers(helper);
+}
+
+static uint32_t soft_target_workers(const LapisTargetHelper* helper)
+{
+    return helper->context ? lapis_context_worker_count(helper->context) : 1;
+}
+
+// Format of the framebuffer of the helper's window, RGBA8 when there isn't one
+static uint32_t soft_window_format(const LapisTargetHelper* helper)
+{
+    LapisFramebuffer framebuffer;
+    if (!helper->window) return e_lapis_format_rgba8;
+    if (lapis_window_get_framebuffer(helper->window, &framebuffer) != e_lapis_return_success) {
+        return e_lapis_format_rgba8;
+    }
+    return framebuffer.format;
+}
+
+LapisReturnCode soft_size_target(LapisSize* size, const LapisTargetHelper* helper, uint32_t workers,
+                                 uint32_t window_format)
+{
+    SoftTargetLayout layout;
+    soft_target_layout(helper, workers, &layout);
+    size->cpu_size = layout.size;
+    size->gpu_size = (size_t)helper->width * helper->height * lapis_format_bytes(helper->format);
+    if (helper->parent || (helper->window && helper->format == window_format)) size->gpu_size = 0;
+    size->gpu_align = SOFT_PIXEL_ALIGN;
+    return e_lapis_return_success;
+}
+
+LapisReturnCode lapis_size_target(LapisSize* size, LapisTargetHelper* helper)
+{
+    if (!size || !helper) return e_lapis_return_invalid_argument;
+    return soft_size_target(size, helper, soft_target_workers(helper), soft_window_format(helper));
+}
+
+LapisReturnCode lapis_window_fill_target_helper(LapisWindow* window, LapisTargetHelper* helper)
+{
+    LapisFramebuffer framebuffer;
+    LapisReturnCode code;
+    if (!window || !helper) return e_lapis_return_invalid_argument;
+
+    code = lapis_window_get_framebuffer(window, &framebuffer);
+    if (code != e_lapis_return_success) return code;
+    helper->width = framebuffer.width;
+    helper->height = framebuffer.height;
+    helper->context = lapis_window_context(window);
+    helper->bin_triangles = 0;
+    helper->window = window;
+    helper->command_bytes = SOFT_DEFAULT_COMMAND_BYTES;
+    helper->parent = NULL;
+    helper->x = 0;
+    helper->y = 0;
+    helper->depth = 0;
+    helper->command_buffers = lapis_window_frames_in_flight(window);
+    helper->format = framebuffer.format == e_lapis_format_yuyv ? e_lapis_format_rgb565 : framebuffer.format;
+    return e_lapis_return_success;
+}
+
+LapisReturnCode lapis_target_fill_view_helper(LapisTarget* parent, LapisTargetHelper* parent_helper,
+                                              LapisTargetHelper* helper, uint32_t x, uint32_t y,
+                                              uint32_t width, uint32_t height)
+{
+    if (!parent || !parent_helper || !helper) return e_lapis_return_invalid_argument;
+    helper->width = width;
+    helper->height = height;
+    helper->context = parent_helper->context;
+    helper->bin_triangles = parent_helper->bin_triangles;
+    helper->window = NULL;
+    helper->command_bytes = parent_helper->command_bytes;
+    helper->parent = parent;
+    helper->x = x;
+    helper->y = y;
+    helper->depth = parent_helper->depth;
+    helper->command_buffers = parent_helper->command_buffers;
+    helper->format = parent_helper->format;
+    return e_lapis_return_success;
+}
+
+void soft_bind_target(SoftTarget* target)
+{
+    LapisFramebuffer framebuffer;
+    if (target->parent) {
+        // Whatever the parent has cleared or binned so far has to land before the view draws over it
+        soft_bind_target(target->parent);
+        soft_flush(target->parent);
+        target->pixels = target->parent->pixels +
+                         ((size_t)target->y * target->parent->stride + target->x) * target->pixel_bytes;
+        target->stride = target->parent->stride;
+        return;
+    }
+
+    // Targets which convert keep drawing into their own pixels
+    if (!target->window.cpu_mem || target->convert) return;
+    if (lapis_window_get_framebuffer(&target->window, &framebuffer) != e_lapis_return_success) return;
+    target->pixels = (uint8_t*)framebuffer.pixels;
+    target->stride = framebuffer.stride;
+}
+
+LapisReturnCode lapis_create_gfx_target(LapisTarget* target, LapisTargetHelper* helper)
+{
+    SoftTargetLayout layout;
+    LapisFramebuffer framebuffer;
+    SoftTarget* parent = NULL;
+    SoftTarget* soft;
+    uint8_t* mem;
+    uint32_t i, convert = 0;
+
+    if (!target || !helper || !target->cpu_mem) return e_lapis_return_invalid_argument;
+    if (helper->width >= SOFT_GUARD_BAND || helper->height >= SOFT_GUARD_BAND) {
+        return e_lapis_return_invalid_argument;
+    }
+
+    // YUYV shares chroma between pairs of pixels, so nothing can be rasterized into it
+    if (!lapis_format_bytes(helper->format) || helper->format == e_lapis_format_yuyv) {
+        return e_lapis_return_invalid_argument;
+    }
+    if (helper->parent) {
+        if (helper->window || !helper->parent->cpu_mem) return e_lapis_return_invalid_argument;
+        parent = (SoftTarget*)helper->parent->cpu_mem;
+        if (helper->x > parent->width || helper->width > parent->width - helper->x ||
+            helper->y > parent->height || helper->height > parent->height - helper->y) {
+            return e_lapis_return_invalid_argument;
+        }
+        if (helper->format != parent->format) return e_lapis_return_invalid_argument;
+        convert = parent->convert;
+    } else if (helper->window) {
+        if (lapis_window_get_framebuffer(helper->window, &framebuffer) != e_lapis_return_success) {
+            return e_lapis_return_unsupported;
+        }
+        if (helper->width > framebuffer.width || helper->height > framebuffer.height) {
+            return e_lapis_return_invalid_argument;
+        }
+        convert = helper->format != framebuffer.format;
+
+        // Pairs of pixels are converted into YUYV together, and the last pair can't hang off the target
+        if (convert && framebuffer.format == e_lapis_format_yuyv && (helper->width & 1)) {
+            return e_lapis_return_invalid_argument;
+        }
+        if (convert && !target->gpu_mem && helper->width && helper->height) {
+            return e_lapis_return_invalid_argument;
+        }
+    } else if (!target->gpu_mem && helper->width && helper->height) {
+        return e_lapis_return_invalid_argument;
+    }
+
+    // Recording needs room for the largest command, a mesh draw
+    if (helper->command_bytes && helper->command_bytes < sizeof(SoftCommand) + sizeof(SoftMeshCommand)) {
+        return e_lapis_return_invalid_argument;
+    }
+    if (helper->command_buffers > LAPIS_MAX_FRAMES_IN_FLIGHT) return e_lapis_return_invalid_argument;
+
+    soft_target_layout(helper, soft_target_workers(helper), &layout);
+    mem = (uint8_t*)target->cpu_mem;
+    soft = (SoftTarget*)mem;
+    soft->width = helper->width;
+    soft->height = helper->height;
+    soft->stride = helper->width;
+    soft->pixels = (uint8_t*)target->gpu_mem;
+    soft->format = helper->format;
+    soft->pixel_bytes = lapis_format_bytes(helper->format);
+    soft->convert = convert;
+    soft->window.cpu_mem = helper->window ? helper->window->cpu_mem : NULL;
+    soft->window.gpu_mem = helper->window ? helper->window->gpu_mem : NULL;
+    soft->parent = parent;
+    soft->x = parent ? helper->x : 0;
+    soft->y = parent ? helper->y : 0;
+    soft->origin_x = parent ? parent->origin_x + helper->x : 0;
+    soft->origin_y = parent ? parent->origin_y + helper->y : 0;
+    if (parent) soft->window = parent->window;
+    soft->kernels = soft_select_kernels();
+    soft_bind_target(soft);
+
+    soft->context.cpu_mem = NULL;
+    soft->context.gpu_mem = NULL;
+    if (layout.triangle_capacity) soft->context = *helper->context;
+    soft->tiles_x = layout.tiles_x;
+    soft->tiles_y = layout.tiles_y;
+    soft->tile_clears = (SoftTileClear*)(mem + layout.tile_clears_offset);
+    soft->clear_pending = 0;
+    for (i = 0; i < soft->tiles_x * soft->tiles_y; i++) {
+        soft->tile_clears[i].pending = 0;
+    }
+    soft->tile_depth = (SoftDepthRange*)(mem + layout.tile_depth_offset);
+    soft->block_depth = (SoftDepthRange*)(mem + layout.block_depth_offset);
+    soft->blocks_x = layout.blocks_x;
+    soft->depth = helper->depth ? (float*)(mem + layout.depth_offset) : NULL;
+    if (soft->depth) {
+        for (i = 0; i < soft->tiles_x * soft->tiles_y; i++) {
+            soft->tile_depth[i].min = soft->tile_depth[i].max = SOFT_DEPTH_FAR;
+        }
+        for (i = 0; i < layout.blocks_x * layout.blocks_y; i++) {
+            soft->block_depth[i].min = soft->block_depth[i].max = SOFT_DEPTH_FAR;
+        }
+        for (i = 0; i < soft->width * soft->height; i++) {
+            soft->depth[i] = SOFT_DEPTH_FAR;
+        }
+    }
+    soft->bins = (SoftBin*)(mem + layout.bins_offset);
+    soft->triangles = (SoftTriangle*)(mem + layout.triangles_offset);
+    soft->triangle_count = 0;
+    soft->triangle_capacity = layout.triangle_capacity;
+    soft->chunks = (SoftBinChunk*)(mem + layout.chunks_offset);
+    soft->chunk_count = 0;
+    soft->chunk_capacity = layout.chunk_capacity;
+    soft->buffer_count = soft_command_buffers(helper);
+    soft->command_capacity = helper->command_bytes;
+    for (i = 0; i < soft->buffer_count; i++) {
+        soft->buffers[i].target = soft;
+        soft->buffers[i].commands = mem + layout.commands_offset + (size_t)i * helper->command_bytes;
+        soft->buffers[i].used = 0;
+        soft->buffers[i].draw = SOFT_COMMAND_NONE;
+        soft->buffers[i].fence = 0;
+        soft->buffers[i].result = NULL;
+    }
+    soft->record = &soft->buffers[0];
+    soft->dirty_count = 0;
+    soft->cull_flags = e_lapis_cull_default;
+    memset(&soft->cull_stats, 0, sizeof(soft->cull_stats));
+    memset(soft->results, 0, sizeof(soft->results));
+    if (soft->context.cpu_mem) {
+        for (i = 0; i < soft->tiles_x * soft->tiles_y; i++) {
+            soft->bins[i].head = SOFT_BIN_NONE;
+            soft->bins[i].tail = SOFT_BIN_NONE;
+        }
+    }
+    return e_lapis_return_success;
+}
+
+// Runs when the window the target draws into swaps, which is on the window's present thread when it has
+// more than one frame in flight
+static void soft_target_swap(void* user)
+{
+    SoftCommandBuffer* buffer = (SoftCommandBuffer*)user;
+    soft_execute(buffer->target, buffer);
+    soft_end_frame(buffer->target, buffer->result);
+}
+
+// Picks the result with the oldest fence for a frame about to be scheduled. At most every other frame is in
+// flight, so that's never one still being written nor the newest one the queries can read
+static SoftFrameResult* soft_claim_result(SoftTarget* target, uint64_t fence)
+{
+    SoftFrameResult* oldest = &target->results[0];
+    uint32_t i;
+    for (i = 1; i < SOFT_FRAME_RESULTS; i++) {
+        if (target->results[i].fence < oldest->fence) oldest = &target->results[i];
+    }
+    oldest->fence = fence;
+    return oldest;
+}
+
+LapisReturnCode lapis_gfx_target_schedule(LapisTarget* target)
+{
+    SoftCommandBuffer* buffer;
+    SoftTarget* soft;
+    uint64_t fence;
+    if (!target || !target->cpu_mem) return e_lapis_return_invalid_argument;
+    soft = (SoftTarget*)target->cpu_mem;
+    if (!soft->window.cpu_mem) {
+        soft_execute(soft, soft->record);
+        soft_end_frame(soft, &soft->results[0]);
+        soft->results[0].fence = 1;
+        return e_lapis_return_success;
+    }
+
+    // The buffer remembers which frame it was scheduled in, so scheduling twice before a swap runs it once
+    buffer = soft_record_buffer(soft);
+    fence = lapis_window_get_fence(&soft->window);
+    if (fence && buffer->fence == fence) return e_lapis_return_success;
+    buffer->fence = fence;
+    buffer->result = soft_claim_result(soft, fence);
+    return lapis_window_defer(&soft->window, soft_target_swap, buffer);
+}
+
+LapisReturnCode lapis_gfx_target_clear(LapisTarget* target, float* color)
+{
+    SoftTarget* soft;
+    SoftRect rect;
+    if (!target || !target->cpu_mem || !color) return e_lapis_return_invalid_argument;
+    soft = (SoftTarget*)target->cpu_mem;
+    LAPIS_TRACE_BEGIN(e_lapis_stage_clear);
+    if (soft->command_capacity) {
+        soft_record_clear(soft, soft_pack_color(color));
+        LAPIS_TRACE_END(e_lapis_stage_clear);
+        return e_lapis_return_success;
+    }
+    soft_full_rect(soft, &rect);
+    soft_mark_dirty(soft, &rect, 1);
+    soft_bind_target(soft);
+    soft_clear(soft, soft_pack_color(color));
+    LAPIS_TRACE_END(e_lapis_stage_clear);
+    return e_lapis_return_success;
+}
+
+LapisReturnCode lapis_gfx_target_get_dirty(LapisTarget* target, LapisRect* rects, uint32_t* count)
+{
+    const SoftFrameResult* result;
+    uint32_t i;
+    if (!target || !target->cpu_mem || !count || (*count && !rects)) return e_lapis_return_invalid_argument;
+
+    result = soft_reached_result((SoftTarget*)target->cpu_mem);
+    if (!result) {
+        *count = 0;
+        return e_lapis_return_success;
+    }
+    for (i = 0; i < result->dirty_count && i < *count; i++) {
+        rects[i] = result->dirty[i];
+    }
+    *count = result->dirty_count;
+    return e_lapis_return_success;
+}
@@ -4,3 +4,15 @@ LapisReturnCode lapis_gfx_immediate_pos_color(LapisTarget* target, float* pos, f
 {
     return e_lapis_return_success;
 }
+
+LapisReturnCode lapis_gfx_immediate_streams(LapisTarget* target, const LapisVertexStreams* streams,
+                                            uint32_t tri_count)
+{
+    return e_lapis_return_unsupported;
+}
+
+LapisReturnCode lapis_gfx_draw_quads(LapisTarget* target, const LapisCoverage* coverage,
+                                     const LapisQuad* quads, uint32_t count, const float* color)
+{
+    return e_lapis_return_unsupported;
+}
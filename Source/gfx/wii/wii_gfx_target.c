@@ -1,12 +1,19 @@
 #include "wii_gfx.h"
 
-LapisReturnCode lapis_size_target(LapisSize* size, LapisWindowHelper* helper)
+LapisReturnCode lapis_size_target(LapisSize* size, LapisTargetHelper* helper)
 {
     return e_lapis_return_success;
 }
 
 LapisReturnCode lapis_window_fill_target_helper(LapisWindow* window, LapisTargetHelper* helper) {}
 
+LapisReturnCode lapis_target_fill_view_helper(LapisTarget* parent, LapisTargetHelper* parent_helper,
+                                              LapisTargetHelper* helper, uint32_t x, uint32_t y,
+                                              uint32_t width, uint32_t height)
+{
+    return e_lapis_return_unsupported;
+}
+
 LapisReturnCode lapis_create_gfx_target(LapisTarget* target, LapisTargetHelper* helper)
 {
     return e_lapis_return_success;
@@ -15,3 +22,29 @@ LapisReturnCode lapis_create_gfx_target(LapisTarget* target, LapisTargetHelper*
 LapisReturnCode lapis_gfx_target_schedule(LapisTarget* target) { return e_lapis_return_success; }
 
 LapisReturnCode lapis_gfx_target_clear(LapisTarget* target, float* color) { return e_lapis_return_success; }
+
+LapisReturnCode lapis_size_bundle(LapisSize* size, LapisBundleHelper* helper)
+{
+    return e_lapis_return_unsupported;
+}
+
+LapisReturnCode lapis_create_bundle(LapisStructure* bundle, LapisBundleHelper* helper, LapisContext* context,
+                                    LapisWindow* window, LapisTarget* targets)
+{
+    return e_lapis_return_unsupported;
+}
+
+LapisReturnCode lapis_gfx_target_get_dirty(LapisTarget* target, LapisRect* rects, uint32_t* count)
+{
+    return e_lapis_return_unsupported;
+}
+
+LapisReturnCode lapis_gfx_target_set_cull(LapisTarget* target, uint32_t flags)
+{
+    return e_lapis_return_unsupported;
+}
+
+LapisReturnCode lapis_gfx_target_get_cull_stats(LapisTarget* target, LapisCullStats* stats)
+{
+    return e_lapis_return_unsupported;
+}
@@ -0,0 +1,74 @@
+#ifndef __LAPIS_OFFLINE_MESH_INTERNAL_HEADER_H__
+#define __LAPIS_OFFLINE_MESH_INTERNAL_HEADER_H__ (1)
+#include "lapis/lapis_gfx.h"
+
+/*************************************************************************************************************
+ * Lapis Mesh
+ * Offline tool which turns meshes into files lapis_mesh_file_fill_helper can use straight out of memory.
+ * Unlike the runtime libraries this allocates whatever it needs, it only ever runs while building assets.
+ *
+ * Meshes are loaded as triangle lists, packed if asked to, welded so every vertex which is identical after
+ * packing is only stored once, then reordered. Triangles are ordered so neighbouring triangles share
+ * vertices while they're still in the post transform cache, and vertices are ordered by when they're first
+ * used so the cache's slots fill in order and fetching the vertices walks forwards through memory.
+ *
+ * Without a depth test whichever overlapping triangle is drawn last ends up on top, so meshes which rely on
+ * the order of their triangles can keep it and only have their vertices reordered.
+ *************************************************************************************************************/
+
+// Vertices the runtime keeps transformed, matches the soft backend's cache
+#define OFFLINE_VERTEX_CACHE (32)
+
+// A mesh while it's being worked on, always a triangle list
+typedef struct OfflineMesh {
+    float* positions;  // xyz per vertex
+    float* colors;     // rgb per vertex
+    uint32_t vertex_count;
+    uint32_t vertex_capacity;
+
+    uint32_t* indices;
+    uint32_t index_count;
+    uint32_t index_capacity;
+
+    // Box around the positions, and whether the positions and colors have been packed
+    float bounds_min[3];
+    float bounds_max[3];
+    int packed;
+} OfflineMesh;
+
+// Frees everything the mesh holds
+void offline_mesh_free(OfflineMesh* mesh);
+
+// Loads positions, vertex colors and faces from a wavefront obj, faces with more than 3 sides become fans.
+// Returns 0 on failure after printing why
+int offline_mesh_load_obj(OfflineMesh* mesh, const char* path);
+
+// Finds the box around the positions
+void offline_mesh_bounds(OfflineMesh* mesh);
+
+// Rounds positions and colors to what the packed vertex format can store, in place. Positions become 0 to
+// 65535 across the box and colors 0 to 255
+void offline_mesh_pack(OfflineMesh* mesh);
+
+// Merges vertices which are exactly the same, returns 0 if out of memory
+int offline_mesh_weld(OfflineMesh* mesh);
+
+// Orders the triangles for the post transform cache, returns 0 if out of memory
+int offline_mesh_order_triangles(OfflineMesh* mesh);
+
+// Orders the vertices by when the triangles first use them and drops unused ones, returns 0 if out of memory
+int offline_mesh_order_vertices(OfflineMesh* mesh);
+
+// Number of vertices the runtime would transform to draw the mesh
+uint32_t offline_mesh_transforms(const OfflineMesh* mesh);
+
+/**
+ * @brief Writes the mesh out as a lapis mesh file
+ * @returns 0 on failure after printing why
+ * @param mesh The mesh to write
+ * @param path Where to write it
+ * @param big_endian Writes the file for big endian machines like the Wii
+ */
+int offline_mesh_write(const OfflineMesh* mesh, const char* path, int big_endian);
+
+#endif  // !__LAPIS_OFFLINE_MESH_INTERNAL_HEADER_H__
@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "offline_mesh.h"
+
+static void offline_usage()
+{
+    fprintf(stderr,
+            "usage: lapis_mesh [options] input.obj output.lmsh\n"
+            "  -p  pack positions into 16 bits and colors into 8 bits\n"
+            "  -b  write the file big endian, for the Wii\n"
+            "  -k  keep the triangle order, for meshes drawn without a depth test\n"
+            "  -q  don't print what the optimisation did\n");
+}
+
+int main(int argc, char** argv)
+{
+    const char* input = NULL;
+    const char* output = NULL;
+    int pack = 0, big_endian = 0, keep_order = 0, quiet = 0;
+    uint32_t loaded_vertices, loaded_triangles, loaded_transforms;
+    OfflineMesh mesh;
+    int i, ok;
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-p")) pack = 1;
+        else if (!strcmp(argv[i], "-b")) big_endian = 1;
+        else if (!strcmp(argv[i], "-k")) keep_order = 1;
+        else if (!strcmp(argv[i], "-q")) quiet = 1;
+        else if (argv[i][0] == '-') break;
+        else if (!input) input = argv[i];
+        else if (!output) output = argv[i];
+        else break;
+    }
+    if (i != argc || !input || !output) {
+        offline_usage();
+        return 1;
+    }
+
+    if (!offline_mesh_load_obj(&mesh, input)) return 1;
+    loaded_vertices = mesh.vertex_count;
+    loaded_triangles = mesh.index_count / 3;
+    loaded_transforms = offline_mesh_transforms(&mesh);
+
+    // Packing first lets vertices which only differed by less than the packing can store be welded
+    if (pack) offline_mesh_pack(&mesh);
+    else offline_mesh_bounds(&mesh);
+
+    ok = offline_mesh_weld(&mesh);
+    if (ok && !mesh.index_count) {
+        fprintf(stderr, "lapis_mesh: every triangle in %s is degenerate\n", input);
+        offline_mesh_free(&mesh);
+        return 1;
+    }
+    ok = ok && (keep_order || offline_mesh_order_triangles(&mesh)) && offline_mesh_order_vertices(&mesh);
+    if (!ok) {
+        fprintf(stderr, "lapis_mesh: out of memory optimising %s\n", input);
+        offline_mesh_free(&mesh);
+        return 1;
+    }
+
+    if (!quiet) {
+        printf("%s: %u triangles, %u vertices welded to %u\n", input, mesh.index_count / 3, loaded_vertices,
+               mesh.vertex_count);
+        printf("transforms per triangle %.3f before, %.3f after\n",
+               (double)loaded_transforms / (double)loaded_triangles,
+               (double)offline_mesh_transforms(&mesh) / (double)(mesh.index_count / 3));
+    }
+
+    ok = offline_mesh_write(&mesh, output, big_endian);
+    offline_mesh_free(&mesh);
+    return !ok;
+}
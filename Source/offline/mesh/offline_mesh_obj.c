@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "offline_mesh.h"
+
+// Longest line read from an obj, files with longer lines are rejected rather than read in pieces
+#define OFFLINE_MAX_LINE (4096)
+
+void offline_mesh_free(OfflineMesh* mesh)
+{
+    free(mesh->positions);
+    free(mesh->colors);
+    free(mesh->indices);
+    memset(mesh, 0, sizeof(OfflineMesh));
+}
+
+static int offline_add_vertex(OfflineMesh* mesh, const float* position, const float* color)
+{
+    float* positions;
+    float* colors;
+    uint32_t capacity;
+
+    if (mesh->vertex_count == mesh->vertex_capacity) {
+        capacity = mesh->vertex_capacity ? mesh->vertex_capacity * 2 : 1024;
+        positions = (float*)realloc(mesh->positions, capacity * 3 * sizeof(float));
+        if (positions) mesh->positions = positions;
+        colors = (float*)realloc(mesh->colors, capacity * 3 * sizeof(float));
+        if (colors) mesh->colors = colors;
+        if (!positions || !colors) return 0;
+        mesh->vertex_capacity = capacity;
+    }
+    memcpy(mesh->positions + mesh->vertex_count * 3, position, 3 * sizeof(float));
+    memcpy(mesh->colors + mesh->vertex_count * 3, color, 3 * sizeof(float));
+    mesh->vertex_count++;
+    return 1;
+}
+
+static int offline_add_triangle(OfflineMesh* mesh, uint32_t a, uint32_t b, uint32_t c)
+{
+    uint32_t* indices;
+    uint32_t capacity;
+
+    if (mesh->index_count + 3 > mesh->index_capacity) {
+        capacity = mesh->index_capacity ? mesh->index_capacity * 2 : 3072;
+        indices = (uint32_t*)realloc(mesh->indices, capacity * sizeof(uint32_t));
+        if (!indices) return 0;
+        mesh->indices = indices;
+        mesh->index_capacity = capacity;
+    }
+    mesh->indices[mesh->index_count++] = a;
+    mesh->indices[mesh->index_count++] = b;
+    mesh->indices[mesh->index_count++] = c;
+    return 1;
+}
+
+/**
+ * @brief Reads the position index of one corner of a face, which can be followed by texture and normal
+ * indices
+ * @returns 0 if the corner doesn't refer to a vertex that has been read
+ * @param token The corner, like 3, 3/1, 3//2 or 3/1/2. Negative indices count back from the last vertex
+ * @param vertex_count Vertices read so far
+ * @param index Where to write the index from 0
+ */
+static int offline_face_index(const char* token, uint32_t vertex_count, uint32_t* index)
+{
+    long value = strtol(token, NULL, 10);
+    if (value < 0) value += (long)vertex_count + 1;
+    if (value < 1 || value > (long)vertex_count) return 0;
+    *index = (uint32_t)(value - 1);
+    return 1;
+}
+
+int offline_mesh_load_obj(OfflineMesh* mesh, const char* path)
+{
+    static const char* separators = " \t\r\n";
+    char line[OFFLINE_MAX_LINE];
+    float position[3];
+    float color[3];
+    uint32_t first, previous, index, corners, line_number = 0;
+    char* token;
+    FILE* file;
+    int read;
+
+    memset(mesh, 0, sizeof(OfflineMesh));
+    file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "lapis_mesh: can't open %s\n", path);
+        return 0;
+    }
+
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+        // A full buffer without the newline means the rest of the line would come back as the next one
+        if (!strchr(line, '\n') && !feof(file)) {
+            fprintf(stderr, "lapis_mesh: %s:%u is longer than %d characters\n", path, line_number,
+                    OFFLINE_MAX_LINE - 2);
+            fclose(file);
+            offline_mesh_free(mesh);
+            return 0;
+        }
+        token = strtok(line, separators);
+        if (!token) continue;
+
+        // Positions can be followed by a color, which some exporters write for vertex painted meshes
+        if (!strcmp(token, "v")) {
+            color[0] = color[1] = color[2] = 1.0f;
+            for (read = 0; read < 6 && (token = strtok(NULL, separators)) != NULL; read++) {
+                if (read < 3) position[read] = (float)atof(token);
+                else color[read - 3] = (float)atof(token);
+            }
+            if (read < 3) goto malformed;
+            if (!offline_add_vertex(mesh, position, color)) goto out_of_memory;
+            continue;
+        }
+        if (strcmp(token, "f")) continue;
+
+        corners = 0;
+        first = previous = 0;
+        while ((token = strtok(NULL, separators)) != NULL) {
+            if (!offline_face_index(token, mesh->vertex_count, &index)) goto malformed;
+            if (corners >= 2 && !offline_add_triangle(mesh, first, previous, index)) goto out_of_memory;
+            if (!corners) first = index;
+            previous = index;
+            corners++;
+        }
+        if (corners < 3) goto malformed;
+    }
+    fclose(file);
+
+    if (!mesh->index_count) {
+        fprintf(stderr, "lapis_mesh: %s has no faces\n", path);
+        offline_mesh_free(mesh);
+        return 0;
+    }
+    return 1;
+
+malformed:
+    fprintf(stderr, "lapis_mesh: %s:%u is malformed\n", path, line_number);
+    fclose(file);
+    offline_mesh_free(mesh);
+    return 0;
+
+out_of_memory:
+    fprintf(stderr, "lapis_mesh: out of memory reading %s\n", path);
+    fclose(file);
+    offline_mesh_free(mesh);
+    return 0;
+}
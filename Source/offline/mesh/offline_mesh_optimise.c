@@ -0,0 +1,306 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "offline_mesh.h"
+
+// Marks an empty slot in the weld table, or a vertex which isn't in the cache
+#define OFFLINE_NONE (0xFFFFFFFFu)
+
+// Tuning of the triangle ordering, from Tom Forsyth's linear speed vertex cache optimisation. The scores
+// favour vertices near the front of the cache and vertices with few triangles left, so isolated triangles
+// are finished off before they leave the cache
+#define OFFLINE_CACHE_DECAY_POWER (1.5f)
+#define OFFLINE_LAST_TRIANGLE_SCORE (0.75f)
+#define OFFLINE_VALENCE_BOOST_SCALE (2.0f)
+#define OFFLINE_VALENCE_BOOST_POWER (0.5f)
+
+void offline_mesh_bounds(OfflineMesh* mesh)
+{
+    const float* p;
+    uint32_t i, k;
+
+    for (i = 0; i < mesh->vertex_count; i++) {
+        p = mesh->positions + i * 3;
+        for (k = 0; k < 3; k++) {
+            if (!i || p[k] < mesh->bounds_min[k]) mesh->bounds_min[k] = p[k];
+            if (!i || p[k] > mesh->bounds_max[k]) mesh->bounds_max[k] = p[k];
+        }
+    }
+}
+
+// Same rounding the runtime uses when it packs uploaded positions
+static float offline_quantize(float value, float max)
+{
+    if (!(value > 0.0f)) return 0.0f;
+    if (value >= 1.0f) return max;
+    return (float)(uint32_t)(value * max + 0.5f);
+}
+
+void offline_mesh_pack(OfflineMesh* mesh)
+{
+    float range, value;
+    uint32_t i, k;
+
+    offline_mesh_bounds(mesh);
+    for (i = 0; i < mesh->vertex_count; i++) {
+        for (k = 0; k < 3; k++) {
+            range = mesh->bounds_max[k] - mesh->bounds_min[k];
+            value = (mesh->positions[i * 3 + k] - mesh->bounds_min[k]) / range;
+            mesh->positions[i * 3 + k] = range > 0.0f ? offline_quantize(value, 65535.0f) : 0.0f;
+            mesh->colors[i * 3 + k] = offline_quantize(mesh->colors[i * 3 + k], 255.0f);
+        }
+    }
+    mesh->packed = 1;
+}
+
+static uint32_t offline_hash_vertex(const OfflineMesh* mesh, uint32_t vertex)
+{
+    uint32_t hash = 2166136261u;
+    uint32_t bits, k;
+    float value;
+
+    for (k = 0; k < 6; k++) {
+        // Adding 0 turns -0 into 0 so both hash the same, as they compare the same
+        value = (k < 3 ? mesh->positions[vertex * 3 + k] : mesh->colors[vertex * 3 + k - 3]) + 0.0f;
+        memcpy(&bits, &value, sizeof(bits));
+        hash = (hash ^ bits) * 16777619u;
+    }
+    return hash ^ (hash >> 15);
+}
+
+static int offline_same_vertex(const OfflineMesh* mesh, uint32_t a, uint32_t b)
+{
+    uint32_t k;
+    for (k = 0; k < 3; k++) {
+        if (mesh->positions[a * 3 + k] != mesh->positions[b * 3 + k]) return 0;
+        if (mesh->colors[a * 3 + k] != mesh->colors[b * 3 + k]) return 0;
+    }
+    return 1;
+}
+
+int offline_mesh_weld(OfflineMesh* mesh)
+{
+    uint32_t* table;
+    uint32_t* remap;
+    uint32_t size = 1, mask, slot, i, a, b, c, count = 0, count_indices;
+
+    while (size < mesh->vertex_count * 2) size *= 2;
+    mask = size - 1;
+    table = (uint32_t*)malloc(size * sizeof(uint32_t));
+    remap = (uint32_t*)malloc(mesh->vertex_count * sizeof(uint32_t));
+    if (!table || !remap) {
+        free(table);
+        free(remap);
+        return 0;
+    }
+    memset(table, 0xFF, size * sizeof(uint32_t));
+
+    // Vertices are moved down over the ones merged away, so the first copy of each vertex is kept
+    for (i = 0; i < mesh->vertex_count; i++) {
+        slot = offline_hash_vertex(mesh, i) & mask;
+        while (table[slot] != OFFLINE_NONE && !offline_same_vertex(mesh, table[slot], i)) {
+            slot = (slot + 1) & mask;
+        }
+        if (table[slot] != OFFLINE_NONE) {
+            remap[i] = table[slot];
+            continue;
+        }
+        memmove(mesh->positions + count * 3, mesh->positions + i * 3, 3 * sizeof(float));
+        memmove(mesh->colors + count * 3, mesh->colors + i * 3, 3 * sizeof(float));
+        table[slot] = count;
+        remap[i] = count++;
+    }
+
+    // Triangles which collapsed onto a line or a point can't cover anything
+    count_indices = 0;
+    for (i = 0; i < mesh->index_count; i += 3) {
+        a = remap[mesh->indices[i]];
+        b = remap[mesh->indices[i + 1]];
+        c = remap[mesh->indices[i + 2]];
+        if (a == b || b == c || c == a) continue;
+        mesh->indices[count_indices++] = a;
+        mesh->indices[count_indices++] = b;
+        mesh->indices[count_indices++] = c;
+    }
+    mesh->index_count = count_indices;
+    mesh->vertex_count = count;
+    free(table);
+    free(remap);
+    return 1;
+}
+
+// How much a vertex wants its triangles drawn next, from where it is in the cache and how many are left
+static float offline_vertex_score(uint32_t cache_position, uint32_t remaining)
+{
+    const float cache_scale = 1.0f / (float)(OFFLINE_VERTEX_CACHE - 3);
+    float score = 0.0f;
+    if (!remaining) return -1.0f;
+
+    // The last triangle's vertices get a fixed score, so the next triangle doesn't strictly have to share
+    // an edge with it
+    if (cache_position < 3) {
+        score = OFFLINE_LAST_TRIANGLE_SCORE;
+    } else if (cache_position < OFFLINE_VERTEX_CACHE) {
+        score = powf(1.0f - (float)(cache_position - 3) * cache_scale, OFFLINE_CACHE_DECAY_POWER);
+    }
+    return score + OFFLINE_VALENCE_BOOST_SCALE * powf((float)remaining, -OFFLINE_VALENCE_BOOST_POWER);
+}
+
+int offline_mesh_order_triangles(OfflineMesh* mesh)
+{
+    const uint32_t triangle_count = mesh->index_count / 3;
+    uint32_t cache[OFFLINE_VERTEX_CACHE + 3];
+    uint32_t next_cache[OFFLINE_VERTEX_CACHE + 3];
+    uint32_t *offsets, *remaining, *adjacent, *position, *ordered;
+    float *vertex_score, *triangle_score;
+    uint8_t* drawn;
+    uint32_t cache_count = 0, next_count, scan = 0;
+    uint32_t t, i, k, v, a, best, tri, emitted;
+    float best_score;
+
+    offsets = (uint32_t*)calloc(mesh->vertex_count + 1, sizeof(uint32_t));
+    remaining = (uint32_t*)calloc(mesh->vertex_count, sizeof(uint32_t));
+    position = (uint32_t*)malloc(mesh->vertex_count * sizeof(uint32_t));
+    vertex_score = (float*)malloc(mesh->vertex_count * sizeof(float));
+    adjacent = (uint32_t*)malloc(mesh->index_count * sizeof(uint32_t));
+    ordered = (uint32_t*)malloc(mesh->index_count * sizeof(uint32_t));
+    triangle_score = (float*)malloc(triangle_count * sizeof(float));
+    drawn = (uint8_t*)calloc(triangle_count, 1);
+    if (!offsets || !remaining || !position || !vertex_score || !adjacent || !ordered || !triangle_score ||
+        !drawn) {
+        emitted = 0;
+        goto done;
+    }
+
+    // Lists of triangles using each vertex, triangles are swapped out of the list once they're drawn
+    for (i = 0; i < mesh->index_count; i++) remaining[mesh->indices[i]]++;
+    for (v = 0; v < mesh->vertex_count; v++) offsets[v + 1] = offsets[v] + remaining[v];
+    memset(remaining, 0, mesh->vertex_count * sizeof(uint32_t));
+    for (i = 0; i < mesh->index_count; i++) {
+        v = mesh->indices[i];
+        adjacent[offsets[v] + remaining[v]++] = i / 3;
+    }
+    for (v = 0; v < mesh->vertex_count; v++) {
+        position[v] = OFFLINE_NONE;
+        vertex_score[v] = offline_vertex_score(OFFLINE_NONE, remaining[v]);
+    }
+    for (t = 0; t < triangle_count; t++) {
+        triangle_score[t] = 0.0f;
+        for (k = 0; k < 3; k++) triangle_score[t] += vertex_score[mesh->indices[t * 3 + k]];
+    }
+
+    best = OFFLINE_NONE;
+    for (emitted = 0; emitted < triangle_count; emitted++) {
+        // Nothing in the cache has triangles left, carry on from the first triangle not drawn yet
+        if (best == OFFLINE_NONE) {
+            while (drawn[scan]) scan++;
+            best = scan;
+        }
+        drawn[best] = 1;
+        memcpy(ordered + emitted * 3, mesh->indices + best * 3, 3 * sizeof(uint32_t));
+
+        // The triangle's vertices go to the front of the cache, everything else moves back
+        next_count = 0;
+        for (k = 0; k < 3; k++) {
+            v = mesh->indices[best * 3 + k];
+            next_cache[next_count++] = v;
+            a = offsets[v];
+            while (adjacent[a] != best) a++;
+            adjacent[a] = adjacent[offsets[v] + --remaining[v]];
+        }
+        for (i = 0; i < cache_count; i++) {
+            v = cache[i];
+            if (v == next_cache[0] || v == next_cache[1] || v == next_cache[2]) continue;
+            next_cache[next_count++] = v;
+        }
+
+        // Rescore whatever is in the cache, the vertices pushed past the end score as if they were gone
+        for (i = 0; i < next_count; i++) {
+            v = next_cache[i];
+            position[v] = i < OFFLINE_VERTEX_CACHE ? i : OFFLINE_NONE;
+            vertex_score[v] = offline_vertex_score(position[v], remaining[v]);
+        }
+        best = OFFLINE_NONE;
+        best_score = -1.0f;
+        for (i = 0; i < next_count; i++) {
+            v = next_cache[i];
+            for (a = offsets[v]; a < offsets[v] + remaining[v]; a++) {
+                tri = adjacent[a];
+                triangle_score[tri] = vertex_score[mesh->indices[tri * 3]] +
+                                      vertex_score[mesh->indices[tri * 3 + 1]] +
+                                      vertex_score[mesh->indices[tri * 3 + 2]];
+                if (triangle_score[tri] > best_score) {
+                    best_score = triangle_score[tri];
+                    best = tri;
+                }
+            }
+        }
+        memcpy(cache, next_cache, next_count * sizeof(uint32_t));
+        cache_count = next_count < OFFLINE_VERTEX_CACHE ? next_count : OFFLINE_VERTEX_CACHE;
+    }
+    memcpy(mesh->indices, ordered, mesh->index_count * sizeof(uint32_t));
+
+done:
+    free(offsets);
+    free(remaining);
+    free(position);
+    free(vertex_score);
+    free(adjacent);
+    free(ordered);
+    free(triangle_score);
+    free(drawn);
+    return emitted == triangle_count;
+}
+
+int offline_mesh_order_vertices(OfflineMesh* mesh)
+{
+    float* positions = (float*)malloc(mesh->vertex_count * 3 * sizeof(float));
+    float* colors = (float*)malloc(mesh->vertex_count * 3 * sizeof(float));
+    uint32_t* remap = (uint32_t*)malloc(mesh->vertex_count * sizeof(uint32_t));
+    uint32_t i, v, count = 0;
+
+    if (!positions || !colors || !remap) {
+        free(positions);
+        free(colors);
+        free(remap);
+        return 0;
+    }
+    memset(remap, 0xFF, mesh->vertex_count * sizeof(uint32_t));
+
+    for (i = 0; i < mesh->index_count; i++) {
+        v = mesh->indices[i];
+        if (remap[v] == OFFLINE_NONE) {
+            memcpy(positions + count * 3, mesh->positions + v * 3, 3 * sizeof(float));
+            memcpy(colors + count * 3, mesh->colors + v * 3, 3 * sizeof(float));
+            remap[v] = count++;
+        }
+        mesh->indices[i] = remap[v];
+    }
+
+    free(mesh->positions);
+    free(mesh->colors);
+    free(remap);
+    mesh->positions = positions;
+    mesh->colors = colors;
+    mesh->vertex_count = count;
+    mesh->vertex_capacity = count;
+    return 1;
+}
+
+uint32_t offline_mesh_transforms(const OfflineMesh* mesh)
+{
+    uint32_t tags[OFFLINE_VERTEX_CACHE];
+    uint32_t i, v, transforms = 0;
+
+    // The runtime's cache is direct mapped, each vertex can only be in the slot its index picks
+    memset(tags, 0xFF, sizeof(tags));
+    for (i = 0; i < mesh->index_count; i++) {
+        v = mesh->indices[i];
+        if (tags[v & (OFFLINE_VERTEX_CACHE - 1)] != v) {
+            tags[v & (OFFLINE_VERTEX_CACHE - 1)] = v;
+            transforms++;
+        }
+    }
+    return transforms;
+}
@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "offline_mesh.h"
+
+// Vertices and indices start 16 byte aligned, the same as the runtime lays them out
+#define OFFLINE_DATA_ALIGN (16)
+
+// Writes values in the byte order the file is for
+typedef struct OfflineWriter {
+    FILE* file;
+    int swap;
+    size_t written;
+} OfflineWriter;
+
+static int offline_host_big_endian()
+{
+    const uint16_t one = 1;
+    return *(const uint8_t*)&one == 0;
+}
+
+static void offline_write_bytes(OfflineWriter* writer, const void* bytes, size_t size)
+{
+    fwrite(bytes, 1, size, writer->file);
+    writer->written += size;
+}
+
+static void offline_write_swapped(OfflineWriter* writer, const void* value, size_t size)
+{
+    uint8_t bytes[4];
+    size_t i;
+    for (i = 0; i < size; i++) {
+        bytes[i] = ((const uint8_t*)value)[writer->swap ? size - 1 - i : i];
+    }
+    offline_write_bytes(writer, bytes, size);
+}
+
+static void offline_write_u8(OfflineWriter* writer, uint8_t value) { offline_write_bytes(writer, &value, 1); }
+
+static void offline_write_u16(OfflineWriter* writer, uint16_t value)
+{
+    offline_write_swapped(writer, &value, sizeof(value));
+}
+
+static void offline_write_u32(OfflineWriter* writer, uint32_t value)
+{
+    offline_write_swapped(writer, &value, sizeof(value));
+}
+
+static void offline_write_float(OfflineWriter* writer, float value)
+{
+    offline_write_swapped(writer, &value, sizeof(value));
+}
+
+// Pads with zeros up to the next multiple of align
+static void offline_write_pad(OfflineWriter* writer, size_t align)
+{
+    while (writer->written % align) offline_write_u8(writer, 0);
+}
+
+static void offline_write_vertices(OfflineWriter* writer, const OfflineMesh* mesh)
+{
+    uint32_t i, k;
+    for (i = 0; i < mesh->vertex_count; i++) {
+        if (mesh->packed) {
+            for (k = 0; k < 3; k++) offline_write_u16(writer, (uint16_t)mesh->positions[i * 3 + k]);
+            offline_write_u16(writer, 0);
+            for (k = 0; k < 3; k++) offline_write_u8(writer, (uint8_t)mesh->colors[i * 3 + k]);
+            offline_write_u8(writer, 255);
+            continue;
+        }
+
+        for (k = 0; k < 3; k++) offline_write_float(writer, mesh->positions[i * 3 + k]);
+        offline_write_float(writer, 1.0f);
+        for (k = 0; k < 3; k++) offline_write_float(writer, mesh->colors[i * 3 + k]);
+        offline_write_float(writer, 1.0f);
+    }
+}
+
+int offline_mesh_write(const OfflineMesh* mesh, const char* path, int big_endian)
+{
+    LapisMeshFileHeader header;
+    OfflineWriter writer;
+    size_t vertex_size, index_size, index_offset;
+    uint32_t i, k;
+
+    memset(&header, 0, sizeof(header));
+    header.magic = LAPIS_MESH_FILE_MAGIC;
+    header.version = LAPIS_MESH_FILE_VERSION;
+    header.vertex_count = mesh->vertex_count;
+    header.index_count = mesh->index_count;
+    header.index_type = mesh->vertex_count <= 0x10000 ? e_lapis_index_16 : e_lapis_index_32;
+    header.vertex_format = mesh->packed ? e_lapis_vertex_packed : e_lapis_vertex_float;
+    header.data_offset = LAPIS_MESH_FILE_ALIGN;
+    memcpy(header.bounds_min, mesh->bounds_min, sizeof(header.bounds_min));
+    memcpy(header.bounds_max, mesh->bounds_max, sizeof(header.bounds_max));
+
+    vertex_size = mesh->packed ? sizeof(LapisMeshPackedVertex) : sizeof(LapisMeshVertex);
+    index_size = header.index_type == e_lapis_index_16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    index_offset = mesh->vertex_count * vertex_size;
+    index_offset = (index_offset + OFFLINE_DATA_ALIGN - 1) & ~(size_t)(OFFLINE_DATA_ALIGN - 1);
+    header.data_size = (uint32_t)(index_offset + mesh->index_count * index_size);
+
+    writer.file = fopen(path, "wb");
+    writer.swap = big_endian != offline_host_big_endian();
+    writer.written = 0;
+    if (!writer.file) {
+        fprintf(stderr, "lapis_mesh: can't open %s for writing\n", path);
+        return 0;
+    }
+
+    // Written field by field so the byte order can be changed
+    offline_write_u32(&writer, header.magic);
+    offline_write_u32(&writer, header.version);
+    offline_write_u32(&writer, header.vertex_count);
+    offline_write_u32(&writer, header.index_count);
+    offline_write_u32(&writer, header.index_type);
+    offline_write_u32(&writer, header.vertex_format);
+    offline_write_u32(&writer, header.data_offset);
+    offline_write_u32(&writer, header.data_size);
+    for (k = 0; k < 3; k++) offline_write_float(&writer, header.bounds_min[k]);
+    for (k = 0; k < 3; k++) offline_write_float(&writer, header.bounds_max[k]);
+    offline_write_pad(&writer, LAPIS_MESH_FILE_ALIGN);
+
+    offline_write_vertices(&writer, mesh);
+    offline_write_pad(&writer, OFFLINE_DATA_ALIGN);
+    for (i = 0; i < mesh->index_count; i++) {
+        if (index_size == sizeof(uint16_t)) offline_write_u16(&writer, (uint16_t)mesh->indices[i]);
+        else offline_write_u32(&writer, mesh->indices[i]);
+    }
+
+    if (ferror(writer.file) | fclose(writer.file)) {
+        fprintf(stderr, "lapis_mesh: failed writing %s\n", path);
+        return 0;
+    }
+    return 1;
+}
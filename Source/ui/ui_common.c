@@ -0,0 +1,232 @@
+#include <string.h>
+
+#include "ui_common.h"
+
+// Where everything lives inside of an atlas's cpu memory
+typedef struct UiAtlasLayout {
+    uint32_t cell_width;
+    uint32_t cell_height;
+    uint32_t cells_x;
+    uint32_t cell_count;
+    uint32_t bucket_count;
+    size_t glyphs_offset;
+    size_t buckets_offset;
+    size_t pixels_offset;
+    size_t size;
+} UiAtlasLayout;
+
+static size_t ui_align(size_t value, size_t align) { return (value + align - 1) & ~(align - 1); }
+
+static LapisReturnCode ui_atlas_layout(const LapisGlyphAtlasHelper* helper, UiAtlasLayout* layout)
+{
+    uint32_t cells_y;
+
+    // Custom rasterizers have to say how big their glyphs get
+    layout->cell_width = helper->cell_width ? helper->cell_width : (helper->rasterizer ? 0 : UI_FONT_WIDTH);
+    layout->cell_height = helper->cell_height ? helper->cell_height
+                                              : (helper->rasterizer ? 0 : UI_FONT_HEIGHT);
+    if (!layout->cell_width || !layout->cell_height) return e_lapis_return_invalid_argument;
+    if (!helper->rasterizer && (layout->cell_width < UI_FONT_WIDTH || layout->cell_height < UI_FONT_HEIGHT)) {
+        return e_lapis_return_invalid_argument;
+    }
+
+    // Cells are addressed with 16 bit texture coordinates
+    if (helper->width > 0xFFFF || helper->height > 0xFFFF) return e_lapis_return_invalid_argument;
+    layout->cells_x = helper->width / layout->cell_width;
+    cells_y = helper->height / layout->cell_height;
+    layout->cell_count = layout->cells_x * cells_y;
+    if (!layout->cell_count) return e_lapis_return_invalid_argument;
+    if (helper->frames_in_flight > LAPIS_MAX_FRAMES_IN_FLIGHT) return e_lapis_return_invalid_argument;
+
+    layout->bucket_count = 1;
+    while (layout->bucket_count < layout->cell_count) layout->bucket_count <<= 1;
+
+    layout->glyphs_offset = ui_align(sizeof(UiAtlas), 16);
+    layout->buckets_offset = ui_align(layout->glyphs_offset + layout->cell_count * sizeof(UiGlyph), 16);
+    layout->pixels_offset = ui_align(layout->buckets_offset + layout->bucket_count * sizeof(uint32_t), 16);
+    layout->size = layout->pixels_offset + (size_t)helper->width * helper->height;
+    return e_lapis_return_success;
+}
+
+LapisReturnCode lapis_size_glyph_atlas(LapisSize* size, LapisGlyphAtlasHelper* helper)
+{
+    UiAtlasLayout layout;
+    LapisReturnCode code;
+    if (!size || !helper) return e_lapis_return_invalid_argument;
+
+    code = ui_atlas_layout(helper, &layout);
+    if (code != e_lapis_return_success) return code;
+    size->cpu_size = layout.size;
+    size->gpu_size = 0;
+    size->gpu_align = 0;
+    return e_lapis_return_success;
+}
+
+LapisReturnCode lapis_create_glyph_atlas(LapisGlyphAtlas* atlas, LapisGlyphAtlasHelper* helper)
+{
+    UiAtlasLayout layout;
+    LapisReturnCode code;
+    UiAtlas* ui;
+    uint8_t* mem;
+    uint32_t i;
+
+    if (!atlas || !helper || !atlas->cpu_mem) return e_lapis_return_invalid_argument;
+    code = ui_atlas_layout(helper, &layout);
+    if (code != e_lapis_return_success) return code;
+
+    mem = (uint8_t*)atlas->cpu_mem;
+    ui = (UiAtlas*)mem;
+    ui->width = helper->width;
+    ui->height = helper->height;
+    ui->cell_width = layout.cell_width;
+    ui->cell_height = layout.cell_height;
+    ui->cells_x = layout.cells_x;
+    ui->line_height = helper->line_height ? helper->line_height : layout.cell_height + 1;
+    ui->rasterizer = helper->rasterizer ? helper->rasterizer : ui_font_rasterize;
+    ui->user = helper->user;
+    ui->frames_in_flight = helper->frames_in_flight ? helper->frames_in_flight : 1;
+
+    ui->glyphs = (UiGlyph*)(mem + layout.glyphs_offset);
+    ui->cell_count = layout.cell_count;
+    ui->used = 0;
+    for (i = 0; i < layout.cell_count; i++) {
+        ui->glyphs[i].u = (uint16_t)(i % layout.cells_x * layout.cell_width);
+        ui->glyphs[i].v = (uint16_t)(i / layout.cells_x * layout.cell_height);
+    }
+    ui->buckets = (uint32_t*)(mem + layout.buckets_offset);
+    ui->bucket_mask = layout.bucket_count - 1;
+    for (i = 0; i < layout.bucket_count; i++) {
+        ui->buckets[i] = UI_GLYPH_NONE;
+    }
+    ui->newest = UI_GLYPH_NONE;
+    ui->oldest = UI_GLYPH_NONE;
+    ui->frame = 1;
+    memset(&ui->stats, 0, sizeof(ui->stats));
+    ui->pixels = mem + layout.pixels_offset;
+    return e_lapis_return_success;
+}
+
+static uint32_t ui_bucket(const UiAtlas* atlas, uint32_t codepoint)
+{
+    uint32_t hash = codepoint * 0x9E3779B1u;
+    return (hash ^ (hash >> 16)) & atlas->bucket_mask;
+}
+
+// Takes a glyph out of the recently used list
+static void ui_unlink(UiAtlas* atlas, uint32_t index)
+{
+    UiGlyph* glyph = &atlas->glyphs[index];
+    if (glyph->newer != UI_GLYPH_NONE) {
+        atlas->glyphs[glyph->newer].older = glyph->older;
+    } else {
+        atlas->newest = glyph->older;
+    }
+    if (glyph->older != UI_GLYPH_NONE) {
+        atlas->glyphs[glyph->older].newer = glyph->newer;
+    } else {
+        atlas->oldest = glyph->newer;
+    }
+}
+
+// Puts a glyph which isn't in the recently used list at the newest end
+static void ui_link_newest(UiAtlas* atlas, uint32_t index)
+{
+    UiGlyph* glyph = &atlas->glyphs[index];
+    glyph->newer = UI_GLYPH_NONE;
+    glyph->older = atlas->newest;
+    if (atlas->newest != UI_GLYPH_NONE) {
+        atlas->glyphs[atlas->newest].newer = index;
+    } else {
+        atlas->oldest = index;
+    }
+    atlas->newest = index;
+}
+
+// Takes a glyph out of its hash chain
+static void ui_unhash(UiAtlas* atlas, uint32_t index)
+{
+    uint32_t* link = &atlas->buckets[ui_bucket(atlas, atlas->glyphs[index].codepoint)];
+    while (*link != index) link = &atlas->glyphs[*link].hash_next;
+    *link = atlas->glyphs[index].hash_next;
+}
+
+// Clears a glyph's cell then rasterizes its codepoint into it
+static void ui_rasterize(UiAtlas* atlas, UiGlyph* glyph)
+{
+    uint8_t* cell = atlas->pixels + (size_t)glyph->v * atlas->width + glyph->u;
+    uint32_t y;
+
+    for (y = 0; y < atlas->cell_height; y++) memset(cell + (size_t)y * atlas->width, 0, atlas->cell_width);
+    memset(&glyph->metrics, 0, sizeof(glyph->metrics));
+    if (atlas->rasterizer(atlas->user, glyph->codepoint, cell, atlas->width, &glyph->metrics) !=
+        e_lapis_return_success) {
+        for (y = 0; y < atlas->cell_height; y++) {
+            memset(cell + (size_t)y * atlas->width, 0, atlas->cell_width);
+        }
+        memset(&glyph->metrics, 0, sizeof(glyph->metrics));
+        glyph->metrics.advance = (int32_t)atlas->cell_width;
+    }
+    if (glyph->metrics.width > atlas->cell_width) glyph->metrics.width = atlas->cell_width;
+    if (glyph->metrics.height > atlas->cell_height) glyph->metrics.height = atlas->cell_height;
+    atlas->stats.rasterized++;
+}
+
+const UiGlyph* ui_atlas_glyph(UiAtlas* atlas, uint32_t codepoint)
+{
+    uint32_t bucket = ui_bucket(atlas, codepoint);
+    uint32_t index;
+    UiGlyph* glyph;
+
+    for (index = atlas->buckets[bucket]; index != UI_GLYPH_NONE; index = atlas->glyphs[index].hash_next) {
+        glyph = &atlas->glyphs[index];
+        if (glyph->codepoint != codepoint) continue;
+        ui_unlink(atlas, index);
+        ui_link_newest(atlas, index);
+        glyph->frame = atlas->frame;
+        atlas->stats.hits++;
+        return glyph;
+    }
+
+    // Cells which have never held a glyph go first. After that the oldest glyph is replaced, unless a frame
+    // which could still be in flight used it, in which case every glyph was
+    if (atlas->used < atlas->cell_count) {
+        index = atlas->used++;
+    } else {
+        index = atlas->oldest;
+        if (atlas->frame - atlas->glyphs[index].frame < atlas->frames_in_flight) return NULL;
+        ui_unlink(atlas, index);
+        ui_unhash(atlas, index);
+        atlas->stats.evicted++;
+    }
+
+    glyph = &atlas->glyphs[index];
+    glyph->codepoint = codepoint;
+    glyph->hash_next = atlas->buckets[bucket];
+    atlas->buckets[bucket] = index;
+    ui_link_newest(atlas, index);
+    glyph->frame = atlas->frame;
+    ui_rasterize(atlas, glyph);
+    return glyph;
+}
+
+void ui_atlas_touch(UiAtlas* atlas, const LapisQuad* quad)
+{
+    uint32_t index = quad->v / atlas->cell_height * atlas->cells_x + quad->u / atlas->cell_width;
+    ui_unlink(atlas, index);
+    ui_link_newest(atlas, index);
+    atlas->glyphs[index].frame = atlas->frame;
+}
+
+LapisReturnCode lapis_ui_glyph_atlas_end_frame(LapisGlyphAtlas* atlas)
+{
+    if (!atlas || !atlas->cpu_mem) return e_lapis_return_invalid_argument;
+    ((UiAtlas*)atlas->cpu_mem)->frame++;
+    return e_lapis_return_success;
+}
+
+LapisReturnCode lapis_ui_glyph_atlas_get_stats(LapisGlyphAtlas* atlas, LapisGlyphAtlasStats* stats)
+{
+    if (!atlas || !atlas->cpu_mem || !stats) return e_lapis_return_invalid_argument;
+    *stats = ((UiAtlas*)atlas->cpu_mem)->stats;
+    return e_lapis_return_success;
+}
@@ -0,0 +1,168 @@
+#ifndef __LAPIS_UI_COMMON_INTERNAL_HEADER_H__
+#define __LAPIS_UI_COMMON_INTERNAL_HEADER_H__ (1)
+#include "lapis/lapis_ui.h"
+
+// Size of the built in font's glyphs, and how far it moves the pen
+#define UI_FONT_WIDTH (5)
+#define UI_FONT_HEIGHT (7)
+#define UI_FONT_ADVANCE (6)
+
+// Quads built up on the stack before they're drawn, strings shorter than this are a single draw
+#define UI_TEXT_BATCH (256)
+
+// Marks the end of a hash chain or of the recently used list
+#define UI_GLYPH_NONE (0xFFFFFFFFu)
+
+// Marks an empty slot in a frame's widget table
+#define UI_WIDGET_NONE (0xFFFFFFFFu)
+
+// Defaults for the UI helper
+#define UI_DEFAULT_WIDGETS (256)
+#define UI_DEFAULT_QUADS (4096)
+
+// Size of the square of full coverage panels are cut from
+#define UI_SOLID_SIZE (64)
+
+// Most clips which can be pushed at once
+#define UI_CLIP_DEPTH (16)
+
+// Codepoint drawn in place of bytes which aren't valid UTF-8
+#define UI_REPLACEMENT (0xFFFDu)
+
+// A cell of the atlas and the glyph it holds
+typedef struct UiGlyph {
+    uint32_t codepoint;
+    uint32_t hash_next;  // Next glyph whose codepoint lands in the same bucket
+    uint32_t newer;      // Neighbours in the recently used list
+    uint32_t older;
+    uint32_t frame;  // Frame the glyph was last used in
+    uint16_t u;      // Top left of the cell in the texture
+    uint16_t v;
+    LapisGlyphMetrics metrics;
+} UiGlyph;
+
+// Internal state of an atlas, lives in the atlas's cpu memory followed by the glyphs, the hash buckets and
+// the coverage texture
+typedef struct UiAtlas {
+    uint32_t width;
+    uint32_t height;
+    uint32_t cell_width;
+    uint32_t cell_height;
+    uint32_t cells_x;
+    uint32_t line_height;
+    LapisGlyphRasterizer rasterizer;
+    void* user;
+
+    // One glyph per cell, cells past used have never held one
+    UiGlyph* glyphs;
+    uint32_t cell_count;
+    uint32_t used;
+
+    // Hash table from codepoint to glyph, the bucket count is a power of 2
+    uint32_t* buckets;
+    uint32_t bucket_mask;
+
+    // Recently used list, newest is the last glyph drawn and oldest is the next to be replaced
+    uint32_t newest;
+    uint32_t oldest;
+
+    // Frame being drawn, a glyph can be replaced once frames_in_flight frames have ended since it was used
+    uint32_t frame;
+    uint32_t frames_in_flight;
+    LapisGlyphAtlasStats stats;
+    uint8_t* pixels;
+} UiAtlas;
+
+/**
+ * @brief Finds a glyph in the atlas, rasterizing it into a free cell or the oldest glyph's cell if it isn't
+ * there. The glyph becomes the newest and is marked as used this frame
+ * @returns The glyph, or null if every cell holds a glyph used in a frame which could still be in flight
+ * @param atlas The atlas
+ * @param codepoint Codepoint of the glyph
+ */
+const UiGlyph* ui_atlas_glyph(UiAtlas* atlas, uint32_t codepoint);
+
+// Marks a glyph whose quad was reused as the newest and used this frame, so it can't be replaced while the
+// quad is still waiting to be drawn
+void ui_atlas_touch(UiAtlas* atlas, const LapisQuad* quad);
+
+// Where the next glyph of a string goes
+typedef struct UiPen {
+    int32_t left;  // Where new lines start
+    int32_t x;
+    int32_t y;
+} UiPen;
+
+/**
+ * @brief Lays out a string as quads of the atlas's texture until it ends or the quads are full, glyphs with
+ * nothing to draw don't take a quad
+ * @returns Lapis success code, out of memory if a glyph didn't fit in the atlas. Its quad is left out and
+ * the rest of the string is still laid out
+ * @param atlas The atlas
+ * @param text The string, moved past everything laid out
+ * @param pen Where the next glyph goes, moved along with the string
+ * @param quads Filled in with the quads
+ * @param capacity Most quads to fill in
+ * @param count Filled in with the number of quads
+ */
+LapisReturnCode ui_layout_text(UiAtlas* atlas, const char** text, UiPen* pen, LapisQuad* quads,
+                               uint32_t capacity, uint32_t* count);
+
+// Rasterizer for the built in font
+LapisReturnCode ui_font_rasterize(void* user, uint32_t codepoint, uint8_t* coverage, uint32_t stride,
+                                  LapisGlyphMetrics* metrics);
+
+// Which texture a widget's quads are cut from
+typedef enum UiSource {
+    e_ui_source_solid,
+    e_ui_source_atlas,
+} UiSource;
+
+// The quads a widget added to a frame, all cut from the same texture and drawn in the same color
+typedef struct UiWidget {
+    uint32_t id;
+    uint32_t source;
+    uint64_t hash;     // Hash of everything the quads were built from
+    uint32_t evicted;  // Atlas evictions when the quads were built, text is built again after any more
+    uint32_t reusable; // Whether the quads are complete, so the next frame can copy them
+    uint32_t first;    // First of the frame's quads
+    uint32_t count;
+    float color[3];
+} UiWidget;
+
+// Everything a frame built, the UI keeps the current one and the one before
+typedef struct UiFrame {
+    UiWidget* widgets;
+    uint32_t widget_count;
+    uint32_t* table;  // Open addressed table from widget id to widget
+    LapisQuad* quads;
+    uint32_t quad_count;
+} UiFrame;
+
+// Clip rectangle, min is inside and max is outside
+typedef struct UiRect {
+    int32_t min_x;
+    int32_t min_y;
+    int32_t max_x;
+    int32_t max_y;
+} UiRect;
+
+// Internal state of a UI, lives in the UI's cpu memory followed by the solid coverage then both frames
+typedef struct UiList {
+    UiAtlas* atlas;
+    uint8_t* solid;
+    uint32_t widget_capacity;
+    uint32_t quad_capacity;
+    uint32_t table_mask;
+    UiFrame frames[2];
+    uint32_t current;
+    UiRect clips[UI_CLIP_DEPTH];
+    uint32_t clip_depth;
+    LapisUiStats stats;  // Counted for the current frame, copied to last_stats when it ends
+    LapisUiStats last_stats;
+} UiList;
+
+// Decodes the next codepoint of a UTF-8 string and moves past it, invalid bytes become UI_REPLACEMENT
+uint32_t ui_utf8_next(const char** text);
+
+#endif  // !__LAPIS_UI_COMMON_INTERNAL_HEADER_H__
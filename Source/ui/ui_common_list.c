@@ -0,0 +1,440 @@
+#include <string.h>
+
+#include "ui_common.h"
+
+// Where everything lives inside of a UI's cpu memory
+typedef struct UiListLayout {
+    uint32_t widget_capacity;
+    uint32_t quad_capacity;
+    uint32_t table_size;
+    size_t solid_offset;
+    size_t widgets_offset[2];
+    size_t table_offset[2];
+    size_t quads_offset[2];
+    size_t size;
+} UiListLayout;
+
+static size_t ui_list_align(size_t value, size_t align) { return (value + align - 1) & ~(align - 1); }
+
+static void ui_list_layout(const LapisUiHelper* helper, UiListLayout* layout)
+{
+    size_t offset;
+    uint32_t i;
+
+    layout->widget_capacity = helper->widget_capacity ? helper->widget_capacity : UI_DEFAULT_WIDGETS;
+    layout->quad_capacity = helper->quad_capacity ? helper->quad_capacity : UI_DEFAULT_QUADS;
+
+    // At most half full so probes stay short
+    layout->table_size = 1;
+    while (layout->table_size < layout->widget_capacity * 2) layout->table_size <<= 1;
+
+    layout->solid_offset = ui_list_align(sizeof(UiList), 16);
+    offset = layout->solid_offset + UI_SOLID_SIZE * UI_SOLID_SIZE;
+    for (i = 0; i < 2; i++) {
+        layout->widgets_offset[i] = ui_list_align(offset, 16);
+        layout->table_offset[i] =
+            ui_list_align(layout->widgets_offset[i] + layout->widget_capacity * sizeof(UiWidget), 16);
+        layout->quads_offset[i] =
+            ui_list_align(layout->table_offset[i] + layout->table_size * sizeof(uint32_t), 16);
+        offset = layout->quads_offset[i] + layout->quad_capacity * sizeof(LapisQuad);
+    }
+    layout->size = offset;
+}
+
+LapisReturnCode lapis_size_ui(LapisSize* size, LapisUiHelper* helper)
+{
+    UiListLayout layout;
+    if (!size || !helper) return e_lapis_return_invalid_argument;
+    ui_list_layout(helper, &layout);
+    size->cpu_size = layout.size;
+    size->gpu_size = 0;
+    size->gpu_align = 0;
+    return e_lapis_return_success;
+}
+
+LapisReturnCode lapis_create_ui(LapisUi* ui, LapisUiHelper* helper)
+{
+    UiListLayout layout;
+    UiList* list;
+    uint8_t* mem;
+    uint32_t i;
+
+    if (!ui || !helper || !ui->cpu_mem) return e_lapis_return_invalid_argument;
+    if (helper->atlas && !helper->atlas->cpu_mem) return e_lapis_return_invalid_argument;
+
+    ui_list_layout(helper, &layout);
+    mem = (uint8_t*)ui->cpu_mem;
+    list = (UiList*)mem;
+    list->atlas = helper->atlas ? (UiAtlas*)helper->atlas->cpu_mem : NULL;
+    list->solid = mem + layout.solid_offset;
+    memset(list->solid, 0xFF, UI_SOLID_SIZE * UI_SOLID_SIZE);
+    list->widget_capacity = layout.widget_capacity;
+    list->quad_capacity = layout.quad_capacity;
+    list->table_mask = layout.table_size - 1;
+    for (i = 0; i < 2; i++) {
+        list->frames[i].widgets = (UiWidget*)(mem + layout.widgets_offset[i]);
+        list->frames[i].widget_count = 0;
+        list->frames[i].table = (uint32_t*)(mem + layout.table_offset[i]);
+        memset(list->frames[i].table, 0xFF, layout.table_size * sizeof(uint32_t));
+        list->frames[i].quads = (LapisQuad*)(mem + layout.quads_offset[i]);
+        list->frames[i].quad_count = 0;
+    }
+    list->current = 0;
+
+    // No clip until the first frame begins, widgets can only be added between begin and end
+    list->clip_depth = 0;
+    memset(&list->stats, 0, sizeof(list->stats));
+    memset(&list->last_stats, 0, sizeof(list->last_stats));
+    return e_lapis_return_success;
+}
+
+// 64 bit FNV-1a, widgets are only rebuilt when this changes so it has to be unlikely to collide
+#define UI_HASH_SEED (0xCBF29CE484222325ull)
+
+static uint64_t ui_hash_bytes(uint64_t hash, const void* data, size_t size)
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+    size_t i;
+    for (i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+static uint64_t ui_hash_u32(uint64_t hash, uint32_t value)
+{
+    return ui_hash_bytes(hash, &value, sizeof(value));
+}
+
+static uint64_t ui_hash_color(uint64_t hash, const float* color)
+{
+    uint32_t bits[3];
+    memcpy(bits, color, sizeof(bits));
+    hash = ui_hash_u32(hash, bits[0]);
+    hash = ui_hash_u32(hash, bits[1]);
+    return ui_hash_u32(hash, bits[2]);
+}
+
+static uint32_t ui_table_slot(const UiList* list, uint32_t id)
+{
+    uint32_t hash = id * 0x9E3779B1u;
+    return (hash ^ (hash >> 16)) & list->table_mask;
+}
+
+static const UiWidget* ui_find_widget(const UiList* list, const UiFrame* frame, uint32_t id)
+{
+    uint32_t slot = ui_table_slot(list, id);
+    while (frame->table[slot] != UI_WIDGET_NONE) {
+        if (frame->widgets[frame->table[slot]].id == id) return &frame->widgets[frame->table[slot]];
+        slot = (slot + 1) & list->table_mask;
+    }
+    return NULL;
+}
+
+// Only the first widget with an id is found, later ones are always built
+static void ui_insert_widget(const UiList* list, UiFrame* frame, uint32_t index)
+{
+    uint32_t id = frame->widgets[index].id;
+    uint32_t slot = ui_table_slot(list, id);
+    while (frame->table[slot] != UI_WIDGET_NONE) {
+        if (frame->widgets[frame->table[slot]].id == id) return;
+        slot = (slot + 1) & list->table_mask;
+    }
+    frame->table[slot] = index;
+}
+
+static uint32_t ui_atlas_evictions(const UiList* list, uint32_t source)
+{
+    return source == e_ui_source_atlas ? list->atlas->stats.evicted : 0;
+}
+
+/**
+ * @brief Adds a widget to the current frame, copying its quads from the frame before if they were built from
+ * the same inputs
+ * @returns The widget, or null if the frame is full of widgets
+ * @param list The UI
+ * @param id The widget's id
+ * @param hash Hash of the widget's inputs
+ * @param source Texture the quads are cut from
+ * @param color Color the quads are drawn in
+ * @param reused Filled in with whether the quads were copied, if not the caller builds them
+ */
+static UiWidget* ui_add_widget(UiList* list, uint32_t id, uint64_t hash, uint32_t source, const float* color,
+                               int* reused)
+{
+    UiFrame* frame = &list->frames[list->current];
+    const UiFrame* previous = &list->frames[list->current ^ 1];
+    const UiWidget* old;
+    UiWidget* widget;
+    uint32_t i;
+
+    *reused = 0;
+    if (frame->widget_count == list->widget_capacity) return NULL;
+    widget = &frame->widgets[frame->widget_count];
+    widget->id = id;
+    widget->source = source;
+    widget->hash = hash;
+    widget->evicted = ui_atlas_evictions(list, source);
+    widget->reusable = 0;
+    widget->first = frame->quad_count;
+    widget->count = 0;
+    memcpy(widget->color, color, sizeof(widget->color));
+    ui_insert_widget(list, frame, frame->widget_count++);
+    list->stats.widgets++;
+
+    // Glyphs can only have moved if the atlas evicted something since the quads were built
+    old = ui_find_widget(list, previous, id);
+    if (!old || !old->reusable || old->hash != hash || old->source != source) return widget;
+    if (old->evicted != widget->evicted) return widget;
+    if (old->count > list->quad_capacity - frame->quad_count) return widget;
+
+    memcpy(&frame->quads[frame->quad_count], &previous->quads[old->first], old->count * sizeof(LapisQuad));
+    if (source == e_ui_source_atlas) {
+        for (i = 0; i < old->count; i++) ui_atlas_touch(list->atlas, &frame->quads[frame->quad_count + i]);
+    }
+    frame->quad_count += old->count;
+    widget->count = old->count;
+    widget->reusable = 1;
+    list->stats.reused++;
+    *reused = 1;
+    return widget;
+}
+
+// Clips a quad to a rectangle, returns 0 if nothing is left
+static int ui_clip_quad(const UiRect* clip, LapisQuad* quad)
+{
+    int64_t min_x = quad->x > clip->min_x ? quad->x : clip->min_x;
+    int64_t min_y = quad->y > clip->min_y ? quad->y : clip->min_y;
+    int64_t max_x = (int64_t)quad->x + quad->width;
+    int64_t max_y = (int64_t)quad->y + quad->height;
+    if (max_x > clip->max_x) max_x = clip->max_x;
+    if (max_y > clip->max_y) max_y = clip->max_y;
+    if (min_x >= max_x || min_y >= max_y) return 0;
+
+    quad->u = (uint16_t)(quad->u + (min_x - quad->x));
+    quad->v = (uint16_t)(quad->v + (min_y - quad->y));
+    quad->x = (int32_t)min_x;
+    quad->y = (int32_t)min_y;
+    quad->width = (uint16_t)(max_x - min_x);
+    quad->height = (uint16_t)(max_y - min_y);
+    return 1;
+}
+
+LapisReturnCode lapis_ui_begin(LapisUi* ui)
+{
+    UiList* list;
+    UiFrame* frame;
+    if (!ui || !ui->cpu_mem) return e_lapis_return_invalid_argument;
+
+    // The frame built last time is kept to reuse from, the one before it is written over
+    list = (UiList*)ui->cpu_mem;
+    list->current ^= 1;
+    frame = &list->frames[list->current];
+    frame->widget_count = 0;
+    frame->quad_count = 0;
+    memset(frame->table, 0xFF, (list->table_mask + 1) * sizeof(uint32_t));
+
+    list->clips[0].min_x = 0;
+    list->clips[0].min_y = 0;
+    list->clips[0].max_x = 0x7FFFFFFF;
+    list->clips[0].max_y = 0x7FFFFFFF;
+    list->clip_depth = 1;
+    memset(&list->stats, 0, sizeof(list->stats));
+    return e_lapis_return_success;
+}
+
+LapisReturnCode lapis_ui_push_clip(LapisUi* ui, const LapisRect* rect)
+{
+    UiList* list;
+    const UiRect* outer;
+    UiRect* clip;
+    int64_t max_x, max_y;
+
+    if (!ui || !ui->cpu_mem || !rect) return e_lapis_return_invalid_argument;
+    list = (UiList*)ui->cpu_mem;
+    if (!list->clip_depth) return e_lapis_return_invalid_argument;
+    if (list->clip_depth == UI_CLIP_DEPTH) return e_lapis_return_out_of_memory;
+
+    outer = &list->clips[list->clip_depth - 1];
+    clip = &list->clips[list->clip_depth++];
+    max_x = (int64_t)rect->x + rect->width;
+    max_y = (int64_t)rect->y + rect->height;
+    clip->min_x = (int64_t)rect->x > outer->min_x ? (int32_t)rect->x : outer->min_x;
+    clip->min_y = (int64_t)rect->y > outer->min_y ? (int32_t)rect->y : outer->min_y;
+    clip->max_x = max_x < outer->max_x ? (int32_t)max_x : outer->max_x;
+    clip->max_y = max_y < outer->max_y ? (int32_t)max_y : outer->max_y;
+    return e_lapis_return_success;
+}
+
+LapisReturnCode lapis_ui_pop_clip(LapisUi* ui)
+{
+    UiList* list;
+    if (!ui || !ui->cpu_mem) return e_lapis_return_invalid_argument;
+    list = (UiList*)ui->cpu_mem;
+    if (list->clip_depth < 2) return e_lapis_return_invalid_argument;
+    list->clip_depth--;
+    return e_lapis_return_success;
+}
+
+LapisReturnCode lapis_ui_panel(LapisUi* ui, uint32_t id, const LapisRect* rect, const float* color)
+{
+    UiList* list;
+    UiFrame* frame;
+    UiWidget* widget;
+    LapisQuad quad;
+    UiRect fill;
+    uint64_t hash;
+    int64_t max_x, max_y;
+    int32_t x, y;
+    int reused;
+
+    if (!ui || !ui->cpu_mem || !rect || !color) return e_lapis_return_invalid_argument;
+    list = (UiList*)ui->cpu_mem;
+    if (!list->clip_depth) return e_lapis_return_invalid_argument;
+    frame = &list->frames[list->current];
+
+    // The clipped rectangle is all the quads depend on
+    fill = list->clips[list->clip_depth - 1];
+    max_x = (int64_t)rect->x + rect->width;
+    max_y = (int64_t)rect->y + rect->height;
+    if ((int64_t)rect->x > fill.min_x) fill.min_x = (int32_t)rect->x;
+    if ((int64_t)rect->y > fill.min_y) fill.min_y = (int32_t)rect->y;
+    if (max_x < fill.max_x) fill.max_x = (int32_t)max_x;
+    if (max_y < fill.max_y) fill.max_y = (int32_t)max_y;
+    if (fill.min_x >= fill.max_x || fill.min_y >= fill.max_y) {
+        fill.min_x = fill.min_y = fill.max_x = fill.max_y = 0;
+    }
+
+    hash = ui_hash_u32(UI_HASH_SEED, e_ui_source_solid);
+    hash = ui_hash_bytes(hash, &fill, sizeof(fill));
+    hash = ui_hash_color(hash, color);
+    widget = ui_add_widget(list, id, hash, e_ui_source_solid, color, &reused);
+    if (!widget) return e_lapis_return_out_of_memory;
+    if (reused) return e_lapis_return_success;
+
+    // Tiled with quads cut from the solid coverage
+    quad.u = 0;
+    quad.v = 0;
+    for (y = fill.min_y; y < fill.max_y; y += UI_SOLID_SIZE) {
+        for (x = fill.min_x; x < fill.max_x; x += UI_SOLID_SIZE) {
+            if (frame->quad_count == list->quad_capacity) return e_lapis_return_out_of_memory;
+            quad.x = x;
+            quad.y = y;
+            quad.width = (uint16_t)(fill.max_x - x < UI_SOLID_SIZE ? fill.max_x - x : UI_SOLID_SIZE);
+            quad.height = (uint16_t)(fill.max_y - y < UI_SOLID_SIZE ? fill.max_y - y : UI_SOLID_SIZE);
+            frame->quads[frame->quad_count++] = quad;
+            widget->count++;
+        }
+    }
+    widget->reusable = 1;
+    return e_lapis_return_success;
+}
+
+LapisReturnCode lapis_ui_label(LapisUi* ui, uint32_t id, const char* text, int32_t x, int32_t y,
+                               const float* color)
+{
+    LapisReturnCode code;
+    const UiRect* clip;
+    UiList* list;
+    UiFrame* frame;
+    UiWidget* widget;
+    UiPen pen;
+    uint64_t hash;
+    uint32_t count, i;
+    int reused;
+
+    if (!ui || !ui->cpu_mem || !text || !color) return e_lapis_return_invalid_argument;
+    list = (UiList*)ui->cpu_mem;
+    if (!list->atlas || !list->clip_depth) return e_lapis_return_invalid_argument;
+    frame = &list->frames[list->current];
+    clip = &list->clips[list->clip_depth - 1];
+
+    hash = ui_hash_u32(UI_HASH_SEED, e_ui_source_atlas);
+    hash = ui_hash_u32(hash, (uint32_t)x);
+    hash = ui_hash_u32(hash, (uint32_t)y);
+    hash = ui_hash_bytes(hash, clip, sizeof(*clip));
+    hash = ui_hash_color(hash, color);
+    hash = ui_hash_bytes(hash, text, strlen(text));
+    widget = ui_add_widget(list, id, hash, e_ui_source_atlas, color, &reused);
+    if (!widget) return e_lapis_return_out_of_memory;
+    if (reused) return e_lapis_return_success;
+
+    pen.left = pen.x = x;
+    pen.y = y;
+    code = ui_layout_text(list->atlas, &text, &pen, &frame->quads[frame->quad_count],
+                          list->quad_capacity - frame->quad_count, &count);
+    if (*text) code = e_lapis_return_out_of_memory;
+
+    // Clipped in place, dropping glyphs which are clipped away entirely
+    for (i = 0; i < count; i++) {
+        frame->quads[frame->quad_count] = frame->quads[widget->first + i];
+        if (ui_clip_quad(clip, &frame->quads[frame->quad_count])) {
+            frame->quad_count++;
+            widget->count++;
+        }
+    }
+
+    // Rasterizing can evict glyphs, which only makes the quads stale if it happened before they were built
+    widget->evicted = list->atlas->stats.evicted;
+    widget->reusable = code == e_lapis_return_success;
+    return code;
+}
+
+LapisReturnCode lapis_ui_end(LapisUi* ui, LapisTarget* target)
+{
+    LapisReturnCode code;
+    LapisCoverage solid, atlas;
+    const LapisCoverage* coverage;
+    const UiWidget* widget;
+    const UiWidget* next;
+    UiList* list;
+    UiFrame* frame;
+    uint32_t i, j, count;
+
+    if (!ui || !ui->cpu_mem || !target) return e_lapis_return_invalid_argument;
+    list = (UiList*)ui->cpu_mem;
+    if (!list->clip_depth) return e_lapis_return_invalid_argument;
+    frame = &list->frames[list->current];
+    list->clip_depth = 0;
+
+    solid.pixels = list->solid;
+    solid.width = UI_SOLID_SIZE;
+    solid.height = UI_SOLID_SIZE;
+    solid.stride = UI_SOLID_SIZE;
+    if (list->atlas) {
+        atlas.pixels = list->atlas->pixels;
+        atlas.width = list->atlas->width;
+        atlas.height = list->atlas->height;
+        atlas.stride = list->atlas->width;
+    }
+
+    // Widgets' quads are stored in the order they were added, so runs of widgets drawn alike are one batch
+    for (i = 0; i < frame->widget_count; i = j) {
+        widget = &frame->widgets[i];
+        count = widget->count;
+        for (j = i + 1; j < frame->widget_count; j++) {
+            next = &frame->widgets[j];
+            if (!next->count) continue;
+            if (next->source != widget->source) break;
+            if (memcmp(next->color, widget->color, sizeof(next->color))) break;
+            count += next->count;
+        }
+        if (!count) continue;
+
+        coverage = widget->source == e_ui_source_atlas ? &atlas : &solid;
+        code = lapis_gfx_draw_quads(target, coverage, &frame->quads[widget->first], count, widget->color);
+        if (code != e_lapis_return_success) return code;
+        list->stats.quads += count;
+        list->stats.draws++;
+    }
+
+    list->last_stats = list->stats;
+    return e_lapis_return_success;
+}
+
+LapisReturnCode lapis_ui_get_stats(LapisUi* ui, LapisUiStats* stats)
+{
+    if (!ui || !ui->cpu_mem || !stats) return e_lapis_return_invalid_argument;
+    *stats = ((UiList*)ui->cpu_mem)->last_stats;
+    return e_lapis_return_success;
+}
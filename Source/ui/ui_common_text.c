@@ -0,0 +1,147 @@
+#include "ui_common.h"
+
+uint32_t ui_utf8_next(const char** text)
+{
+    const uint8_t* bytes = (const uint8_t*)*text;
+    uint32_t codepoint, length, smallest, i;
+
+    if (bytes[0] < 0x80) {
+        *text += 1;
+        return bytes[0];
+    }
+    if ((bytes[0] & 0xE0) == 0xC0) {
+        codepoint = bytes[0] & 0x1F;
+        length = 2;
+        smallest = 0x80;
+    } else if ((bytes[0] & 0xF0) == 0xE0) {
+        codepoint = bytes[0] & 0x0F;
+        length = 3;
+        smallest = 0x800;
+    } else if ((bytes[0] & 0xF8) == 0xF0) {
+        codepoint = bytes[0] & 0x07;
+        length = 4;
+        smallest = 0x10000;
+    } else {
+        *text += 1;
+        return UI_REPLACEMENT;
+    }
+
+    // A sequence cut short only skips the bytes it had, which never includes the terminator
+    for (i = 1; i < length; i++) {
+        if ((bytes[i] & 0xC0) != 0x80) {
+            *text += i;
+            return UI_REPLACEMENT;
+        }
+        codepoint = (codepoint << 6) | (bytes[i] & 0x3F);
+    }
+    *text += length;
+
+    // Overlong encodings and surrogates aren't valid
+    if (codepoint < smallest || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF)) {
+        return UI_REPLACEMENT;
+    }
+    return codepoint;
+}
+
+LapisReturnCode ui_layout_text(UiAtlas* atlas, const char** text, UiPen* pen, LapisQuad* quads,
+                               uint32_t capacity, uint32_t* count)
+{
+    LapisReturnCode code = e_lapis_return_success;
+    const UiGlyph* glyph;
+    uint32_t codepoint;
+
+    *count = 0;
+    while (**text && *count < capacity) {
+        codepoint = ui_utf8_next(text);
+        if (codepoint == '\n') {
+            pen->x = pen->left;
+            pen->y += (int32_t)atlas->line_height;
+            continue;
+        }
+
+        // Glyphs which don't fit leave a gap the width of a cell
+        glyph = ui_atlas_glyph(atlas, codepoint);
+        if (!glyph) {
+            code = e_lapis_return_out_of_memory;
+            pen->x += (int32_t)atlas->cell_width;
+            continue;
+        }
+
+        if (glyph->metrics.width && glyph->metrics.height) {
+            quads[*count].x = pen->x + glyph->metrics.left;
+            quads[*count].y = pen->y + glyph->metrics.top;
+            quads[*count].u = glyph->u;
+            quads[*count].v = glyph->v;
+            quads[*count].width = (uint16_t)glyph->metrics.width;
+            quads[*count].height = (uint16_t)glyph->metrics.height;
+            (*count)++;
+        }
+        pen->x += glyph->metrics.advance;
+    }
+    return code;
+}
+
+LapisReturnCode lapis_ui_draw_text(LapisTarget* target, LapisGlyphAtlas* atlas, const char* text, int32_t x,
+                                   int32_t y, const float* color)
+{
+    LapisQuad quads[UI_TEXT_BATCH];
+    LapisCoverage coverage;
+    LapisReturnCode code = e_lapis_return_success;
+    LapisReturnCode drawn;
+    UiAtlas* ui;
+    UiPen pen;
+    uint32_t count;
+
+    if (!target || !atlas || !atlas->cpu_mem || !text || !color) return e_lapis_return_invalid_argument;
+    ui = (UiAtlas*)atlas->cpu_mem;
+    coverage.pixels = ui->pixels;
+    coverage.width = ui->width;
+    coverage.height = ui->height;
+    coverage.stride = ui->width;
+
+    pen.left = pen.x = x;
+    pen.y = y;
+    while (*text) {
+        if (ui_layout_text(ui, &text, &pen, quads, UI_TEXT_BATCH, &count) != e_lapis_return_success) {
+            code = e_lapis_return_out_of_memory;
+        }
+        if (!count) continue;
+        drawn = lapis_gfx_draw_quads(target, &coverage, quads, count, color);
+        if (drawn != e_lapis_return_success) return drawn;
+    }
+    return code;
+}
+
+LapisReturnCode lapis_ui_measure_text(LapisGlyphAtlas* atlas, const char* text, uint32_t* width,
+                                      uint32_t* height)
+{
+    LapisReturnCode code = e_lapis_return_success;
+    const UiGlyph* glyph;
+    UiAtlas* ui;
+    uint32_t codepoint, lines = 1;
+    int32_t pen = 0, widest = 0;
+
+    if (!atlas || !atlas->cpu_mem || !text || !width || !height) return e_lapis_return_invalid_argument;
+    ui = (UiAtlas*)atlas->cpu_mem;
+
+    while (*text) {
+        codepoint = ui_utf8_next(&text);
+        if (codepoint == '\n') {
+            pen = 0;
+            lines++;
+            continue;
+        }
+        glyph = ui_atlas_glyph(ui, codepoint);
+        if (glyph) {
+            pen += glyph->metrics.advance;
+        } else {
+            code = e_lapis_return_out_of_memory;
+            pen += (int32_t)ui->cell_width;
+        }
+        if (pen > widest) widest = pen;
+    }
+
+    *width = (uint32_t)widest;
+    *height = lines * ui->line_height;
+    return code;
+}
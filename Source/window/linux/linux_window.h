@@ -0,0 +1,157 @@
+#ifndef __LAPIS_WINDOW_LINUX_INTERNAL_HEADER_H__
+#define __LAPIS_WINDOW_LINUX_INTERNAL_HEADER_H__ (1)
+#include "lapis/lapis_window.h"
+#include <pthread.h>
+
+// Number of buffers the window flips between
+#define LINUX_BUFFER_COUNT (2)
+
+// Buffers start on a page boundary so viewers can map them on their own
+#define LINUX_PAGE_SIZE (4096)
+
+// Longest shared memory name which is kept around to unlink on destruction
+#define LINUX_MAX_NAME (256)
+
+// Most functions which can be waiting for the next swap
+#define LINUX_MAX_DEFERRED (32)
+
+// Most input events waiting to be taken, a power of two so the ring indices can wrap
+#define LINUX_MAX_EVENTS (256)
+
+// Frames a capture can have copied and waiting for the writer
+#define LINUX_CAPTURE_STAGING (2)
+
+#define linux_atomic_load(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define linux_atomic_store(ptr, value) __atomic_store_n((ptr), (value), __ATOMIC_RELEASE)
+
+// A function waiting for the next swap
+typedef struct LinuxDeferred {
+    LapisSwapFunc func;
+    void* user;
+} LinuxDeferred;
+
+// A swapped frame waiting for the present thread
+typedef struct LinuxFrame {
+    LinuxDeferred deferred[LINUX_MAX_DEFERRED];
+    uint32_t deferred_count;
+} LinuxFrame;
+
+// Streams presented frames out to a file descriptor. Staged is only written by whichever thread presents
+// and taken only by the writer thread, both count up forever and only change with the lock held
+typedef struct LinuxCapture {
+    uint32_t running;  // Read by the presenting thread, so it's set last and cleared first
+    int fd;
+    uint32_t format;
+    uint32_t frame_rate;
+    uint32_t lossless;
+
+    // Staging buffers of raw frames then the writer's converted frame, all in one anonymous mapping. Windows
+    // in other formats also have the frame being written converted to RGBA8 in pixels, otherwise it's null
+    uint8_t* memory;
+    size_t memory_size;
+    uint8_t* staging[LINUX_CAPTURE_STAGING];
+    uint8_t* pixels;
+    uint8_t* output;
+    size_t output_size;
+
+    uint64_t staged;
+    uint64_t taken;
+    uint64_t written;
+    uint64_t dropped;
+    uint32_t failed;
+    uint32_t stopping;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;    // Signalled when a frame is staged or the writer should stop
+    pthread_cond_t drained;  // Signalled when the writer is done with a frame
+} LinuxCapture;
+
+// Internal state of the window, lives in the window's cpu memory
+typedef struct LinuxWindow {
+    LapisContext context;
+    uint32_t width;
+    uint32_t height;
+    uint32_t open;
+
+    // The shared memory the frames are presented in
+    int fd;
+    char name[LINUX_MAX_NAME];
+    uint8_t* memory;
+    size_t memory_size;
+    LapisSharedHeader* header;
+    uint32_t back;  // Buffer the next frame is rendered into
+
+    // Virtual vsync, a period of 0 means swaps aren't paced
+    uint64_t period;
+    uint64_t next_vsync;
+
+    // Run at the start of the next swap
+    LinuxDeferred deferred[LINUX_MAX_DEFERRED];
+    uint32_t deferred_count;
+
+    // Frames are numbered from 1 by the swap ending them. Submitted is only written by the swapping thread,
+    // completed only by whichever thread presents, and both only change with the lock held
+    uint32_t frames_in_flight;
+    uint64_t submitted;
+    uint64_t completed;
+
+    // Present thread, only running with more than one frame in flight. It owns the back buffer, the damage
+    // and the virtual vsync while frames are queued, anywhere else waits for the queue to empty before
+    // touching them
+    pthread_t thread;
+    uint32_t threaded;
+    uint32_t stopping;
+    LinuxFrame queue[LAPIS_MAX_FRAMES_IN_FLIGHT];
+    pthread_mutex_t lock;
+    pthread_cond_t queued;   // Signalled when a frame is submitted or the thread should stop
+    pthread_cond_t retired;  // Signalled when a frame is completed
+
+    // What's been drawn into the back buffer, and what changed in the frame on screen. With two buffers the
+    // back buffer is one frame behind, so the frame on screen's damage is all it's missing
+    LapisRect damage[LAPIS_MAX_DIRTY_RECTS];
+    uint32_t damage_count;
+    LapisRect presented[LAPIS_MAX_DIRTY_RECTS];
+    uint32_t presented_count;
+    uint32_t repair_pending;  // The back buffer hasn't been brought up to date since the last swap
+
+    // Input events, a ring with one thread pushing and one taking. Head and overflow are only written by the
+    // pushing thread and tail only by the taking thread, visible is the head as of the last poll. The
+    // indices count up forever and are wrapped when used
+    LapisEvent events[LINUX_MAX_EVENTS];
+    uint32_t event_head;
+    uint32_t event_tail;
+    uint32_t event_visible;
+    uint32_t event_overflow;
+
+    LinuxCapture capture;
+} LinuxWindow;
+
+// Pointer to the start of one of the window's buffers
+uint8_t* linux_window_buffer(LinuxWindow* window, uint32_t index);
+
+// Moves the back buffer's damage over to the frame on screen, returns the bounds of it all
+void linux_window_present_damage(LinuxWindow* window, LapisRect* bounds);
+
+// Current time on the monotonic clock in nanoseconds
+uint64_t linux_time_now();
+
+// Runs a frame's deferred work then waits for vsync and presents it
+void linux_window_present(LinuxWindow* window, const LinuxDeferred* deferred, uint32_t count);
+
+// Starts the present thread, and stops it once every queued frame has been presented
+LapisReturnCode linux_window_start_thread(LinuxWindow* window);
+void linux_window_stop_thread(LinuxWindow* window);
+
+// Stages the frame on screen for the capture's writer, called by whichever thread presents
+void linux_window_capture(LinuxWindow* window);
+
+// Stops the capture's writer once everything staged has been written, does nothing if it isn't running
+void linux_window_stop_capture(LinuxWindow* window);
+
+// Hands a frame to the present thread, blocking while it already has every other frame in flight
+void linux_window_submit(LinuxWindow* window);
+
+// Waits for every queued frame to be presented, unless called from the present thread itself
+void linux_window_wait_idle(LinuxWindow* window);
+
+#endif  // !__LAPIS_WINDOW_LINUX_INTERNAL_HEADER_H__
@@ -0,0 +1,285 @@
+#include "linux_window.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Room for the text at the start of a PPM image or a Y4M frame
+#define LINUX_CAPTURE_HEADER (64)
+
+// Writes everything, pipes and sockets can take less than they're given
+static int linux_write_all(int fd, const uint8_t* data, size_t size)
+{
+    ssize_t written;
+    while (size) {
+        written = write(fd, data, size);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return 0;
+        data += written;
+        size -= (size_t)written;
+    }
+    return 1;
+}
+
+static size_t linux_capture_ppm(const LinuxWindow* window, const uint8_t* frame, size_t stride, uint8_t* out)
+{
+    const uint8_t* row;
+    size_t size;
+    uint32_t x, y;
+
+    size = (size_t)sprintf((char*)out, "P6\n%u %u\n255\n", window->width, window->height);
+    for (y = 0; y < window->height; y++) {
+        row = frame + (size_t)y * stride;
+        for (x = 0; x < window->width; x++) {
+            out[size++] = row[x * 4 + 0];
+            out[size++] = row[x * 4 + 1];
+            out[size++] = row[x * 4 + 2];
+        }
+    }
+    return size;
+}
+
+// Full range BT.601 in 8 bit fixed point. The chroma is offset so the shift never sees a negative number,
+// which can land one past the top of the range
+static uint8_t linux_luma(uint32_t r, uint32_t g, uint32_t b)
+{
+    return (uint8_t)((77 * r + 150 * g + 29 * b + 128) >> 8);
+}
+
+static uint8_t linux_chroma(int32_t r, int32_t g, int32_t b, int32_t wr, int32_t wg, int32_t wb)
+{
+    int32_t value = (wr * r + wg * g + wb * b + 32768 + 128) >> 8;
+    return (uint8_t)(value > 255 ? 255 : value);
+}
+
+static size_t linux_capture_y4m(const LinuxWindow* window, const uint8_t* frame, size_t stride, uint8_t* out)
+{
+    uint32_t chroma_width = (window->width + 1) / 2;
+    uint32_t chroma_height = (window->height + 1) / 2;
+    const uint8_t* pixel;
+    uint8_t* luma;
+    uint8_t* cb;
+    uint8_t* cr;
+    uint32_t x, y, dx, dy, count, r, g, b;
+
+    memcpy(out, "FRAME\n", 6);
+    luma = out + 6;
+    cb = luma + (size_t)window->width * window->height;
+    cr = cb + (size_t)chroma_width * chroma_height;
+    for (y = 0; y < window->height; y++) {
+        for (x = 0; x < window->width; x++) {
+            pixel = frame + (size_t)y * stride + x * 4;
+            luma[(size_t)y * window->width + x] = linux_luma(pixel[0], pixel[1], pixel[2]);
+        }
+    }
+
+    // Chroma is the average of each 2x2 block, blocks hanging off the edge average what's left of them
+    for (y = 0; y < chroma_height; y++) {
+        for (x = 0; x < chroma_width; x++) {
+            r = g = b = count = 0;
+            for (dy = y * 2; dy < y * 2 + 2 && dy < window->height; dy++) {
+                for (dx = x * 2; dx < x * 2 + 2 && dx < window->width; dx++) {
+                    pixel = frame + (size_t)dy * stride + dx * 4;
+                    r += pixel[0];
+                    g += pixel[1];
+                    b += pixel[2];
+                    count++;
+                }
+            }
+            r = (r + count / 2) / count;
+            g = (g + count / 2) / count;
+            b = (b + count / 2) / count;
+            cb[(size_t)y * chroma_width + x] = linux_chroma(r, g, b, -43, -85, 128);
+            cr[(size_t)y * chroma_width + x] = linux_chroma(r, g, b, 128, -107, -21);
+        }
+    }
+    return 6 + (size_t)window->width * window->height + (size_t)chroma_width * chroma_height * 2;
+}
+
+static void* linux_capture_main(void* arg)
+{
+    LinuxWindow* window = (LinuxWindow*)arg;
+    LinuxCapture* capture = &window->capture;
+    const uint8_t* frame;
+    char header[LINUX_CAPTURE_HEADER];
+    sigset_t signals;
+    size_t size, stride;
+    int length, ok = 1;
+
+    // A reader going away mid stream should fail the capture rather than kill the application, and a pipe's
+    // SIGPIPE goes to the thread which wrote to it
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    if (capture->format == e_lapis_capture_y4m) {
+        length = snprintf(header, sizeof(header), "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", window->width,
+                          window->height, capture->frame_rate);
+        ok = linux_write_all(capture->fd, (const uint8_t*)header, (size_t)length);
+    }
+
+    pthread_mutex_lock(&capture->lock);
+    if (!ok) capture->failed = 1;
+    for (;;) {
+        while (capture->taken == capture->staged && !capture->stopping) {
+            pthread_cond_wait(&capture->ready, &capture->lock);
+        }
+
+        // Stopping still writes everything which was staged
+        if (capture->taken == capture->staged) break;
+        frame = capture->staging[capture->taken % LINUX_CAPTURE_STAGING];
+        ok = !capture->failed;
+        pthread_mutex_unlock(&capture->lock);
+
+        if (ok) {
+            stride = window->header->stride;
+            if (capture->pixels) {
+                stride = (size_t)window->width * sizeof(uint32_t);
+                lapis_convert_pixels(capture->pixels, e_lapis_format_rgba8, stride, frame,
+                                     window->header->format, window->header->stride, window->width,
+                                     window->height);
+                frame = capture->pixels;
+            }
+            if (capture->format == e_lapis_capture_y4m) {
+                size = linux_capture_y4m(window, frame, stride, capture->output);
+            } else {
+                size = linux_capture_ppm(window, frame, stride, capture->output);
+            }
+            ok = linux_write_all(capture->fd, capture->output, size);
+        }
+
+        pthread_mutex_lock(&capture->lock);
+        if (ok) {
+            capture->written++;
+        } else {
+            capture->failed = 1;
+            capture->dropped++;
+        }
+        capture->taken++;
+        pthread_cond_broadcast(&capture->drained);
+    }
+    pthread_mutex_unlock(&capture->lock);
+    return NULL;
+}
+
+LapisReturnCode lapis_window_start_capture(LapisWindow* window, const LapisCaptureHelper* helper)
+{
+    LinuxWindow* lw;
+    LinuxCapture* capture;
+    size_t frame_size, pixels_size, ppm_size, y4m_size;
+    uint32_t i;
+
+    if (!window || !window->cpu_mem || !helper || helper->fd < 0) return e_lapis_return_invalid_argument;
+    if (helper->format != e_lapis_capture_ppm && helper->format != e_lapis_capture_y4m) {
+        return e_lapis_return_invalid_argument;
+    }
+    lw = (LinuxWindow*)window->cpu_mem;
+    capture = &lw->capture;
+    if (capture->running) return e_lapis_return_invalid_argument;
+
+    // The writer converts from one staging buffer into the output while the next frame is copied into the
+    // other, so presenting only ever costs a copy
+    frame_size = (size_t)lw->header->stride * lw->height;
+    ppm_size = LINUX_CAPTURE_HEADER + (size_t)lw->width * lw->height * 3;
+    y4m_size = LINUX_CAPTURE_HEADER + (size_t)lw->width * lw->height +
+               (size_t)((lw->width + 1) / 2) * ((lw->height + 1) / 2) * 2;
+    pixels_size = lw->header->format != e_lapis_format_rgba8 ? (size_t)lw->width * lw->height * 4 : 0;
+    capture->output_size = helper->format == e_lapis_capture_y4m ? y4m_size : ppm_size;
+    capture->memory_size = frame_size * LINUX_CAPTURE_STAGING + pixels_size + capture->output_size;
+    capture->memory =
+        mmap(NULL, capture->memory_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (capture->memory == MAP_FAILED) return e_lapis_return_out_of_memory;
+    for (i = 0; i < LINUX_CAPTURE_STAGING; i++) capture->staging[i] = capture->memory + frame_size * i;
+    capture->pixels = pixels_size ? capture->memory + frame_size * LINUX_CAPTURE_STAGING : NULL;
+    capture->output = capture->memory + frame_size * LINUX_CAPTURE_STAGING + pixels_size;
+
+    capture->fd = helper->fd;
+    capture->format = helper->format;
+    capture->frame_rate = helper->frame_rate;
+    if (!capture->frame_rate) capture->frame_rate = lw->period ? (uint32_t)(1000000000u / lw->period) : 60;
+    capture->lossless = helper->lossless;
+    capture->staged = 0;
+    capture->taken = 0;
+    capture->written = 0;
+    capture->dropped = 0;
+    capture->failed = 0;
+    capture->stopping = 0;
+    pthread_mutex_init(&capture->lock, NULL);
+    pthread_cond_init(&capture->ready, NULL);
+    pthread_cond_init(&capture->drained, NULL);
+    if (pthread_create(&capture->thread, NULL, linux_capture_main, lw) != 0) {
+        pthread_cond_destroy(&capture->drained);
+        pthread_cond_destroy(&capture->ready);
+        pthread_mutex_destroy(&capture->lock);
+        munmap(capture->memory, capture->memory_size);
+        return e_lapis_return_system_error;
+    }
+
+    // Whichever thread presents only looks at the capture once it's running
+    linux_atomic_store(&capture->running, 1);
+    return e_lapis_return_success;
+}
+
+void linux_window_capture(LinuxWindow* window)
+{
+    LinuxCapture* capture = &window->capture;
+    uint8_t* staging;
+
+    pthread_mutex_lock(&capture->lock);
+    while (capture->lossless && capture->staged - capture->taken == LINUX_CAPTURE_STAGING) {
+        pthread_cond_wait(&capture->drained, &capture->lock);
+    }
+    if (capture->failed || capture->staged - capture->taken == LINUX_CAPTURE_STAGING) {
+        capture->dropped++;
+        pthread_mutex_unlock(&capture->lock);
+        return;
+    }
+    staging = capture->staging[capture->staged % LINUX_CAPTURE_STAGING];
+    pthread_mutex_unlock(&capture->lock);
+
+    // The writer never touches a buffer past the ones staged, so the copy can happen without the lock
+    memcpy(staging, linux_window_buffer(window, window->header->front),
+           (size_t)window->header->stride * window->height);
+
+    pthread_mutex_lock(&capture->lock);
+    capture->staged++;
+    pthread_cond_signal(&capture->ready);
+    pthread_mutex_unlock(&capture->lock);
+}
+
+void linux_window_stop_capture(LinuxWindow* window)
+{
+    LinuxCapture* capture = &window->capture;
+    if (!capture->running) return;
+    linux_atomic_store(&capture->running, 0);
+
+    pthread_mutex_lock(&capture->lock);
+    capture->stopping = 1;
+    pthread_cond_signal(&capture->ready);
+    pthread_mutex_unlock(&capture->lock);
+    pthread_join(capture->thread, NULL);
+
+    pthread_cond_destroy(&capture->drained);
+    pthread_cond_destroy(&capture->ready);
+    pthread_mutex_destroy(&capture->lock);
+    munmap(capture->memory, capture->memory_size);
+}
+
+LapisReturnCode lapis_window_stop_capture(LapisWindow* window, LapisCaptureStats* stats)
+{
+    LinuxWindow* lw;
+    if (!window || !window->cpu_mem) return e_lapis_return_invalid_argument;
+
+    // Every frame swapped so far has to be presented, and so staged, before the writer is told to finish
+    lw = (LinuxWindow*)window->cpu_mem;
+    linux_window_wait_idle(lw);
+    linux_window_stop_capture(lw);
+    if (stats) {
+        stats->written = lw->capture.written;
+        stats->dropped = lw->capture.dropped;
+        stats->failed = lw->capture.failed;
+    }
+    return e_lapis_return_success;
+}
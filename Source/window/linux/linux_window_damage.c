@@ -0,0 +1,115 @@
+#include "linux_window.h"
+#include <string.h>
+
+// Clips a rectangle to the window, returns 0 if nothing is left. YUYV pixels come in pairs which share their
+// chroma, so rectangles are widened to cover whole pairs
+static int linux_clip_rect(const LinuxWindow* window, const LapisRect* rect, LapisRect* clipped)
+{
+    if (rect->x >= window->width || rect->y >= window->height || !rect->width || !rect->height) return 0;
+    clipped->x = rect->x;
+    clipped->y = rect->y;
+    clipped->width = rect->width < window->width - rect->x ? rect->width : window->width - rect->x;
+    clipped->height = rect->height < window->height - rect->y ? rect->height : window->height - rect->y;
+    if (window->header->format == e_lapis_format_yuyv) {
+        clipped->width = ((clipped->x + clipped->width + 1) & ~1u) - (clipped->x & ~1u);
+        clipped->x &= ~1u;
+    }
+    return 1;
+}
+
+static uint64_t linux_rect_area(const LapisRect* rect) { return (uint64_t)rect->width * rect->height; }
+
+static void linux_rect_union(const LapisRect* a, const LapisRect* b, LapisRect* out)
+{
+    uint32_t max_x = a->x + a->width > b->x + b->width ? a->x + a->width : b->x + b->width;
+    uint32_t max_y = a->y + a->height > b->y + b->height ? a->y + a->height : b->y + b->height;
+    out->x = a->x < b->x ? a->x : b->x;
+    out->y = a->y < b->y ? a->y : b->y;
+    out->width = max_x - out->x;
+    out->height = max_y - out->y;
+}
+
+// Adds a rectangle to a list, once the list is full it grows whichever rectangle grows the least
+static void linux_add_rect(LapisRect* list, uint32_t* count, const LapisRect* rect)
+{
+    LapisRect merged;
+    uint64_t growth, best_growth = ~(uint64_t)0;
+    uint32_t i, best = 0;
+
+    for (i = 0; i < *count; i++) {
+        linux_rect_union(&list[i], rect, &merged);
+        growth = linux_rect_area(&merged) - linux_rect_area(&list[i]);
+        if (!growth) return;
+        if (growth < best_growth) {
+            best_growth = growth;
+            best = i;
+        }
+    }
+    if (*count < LAPIS_MAX_DIRTY_RECTS) {
+        list[(*count)++] = *rect;
+        return;
+    }
+    linux_rect_union(&list[best], rect, &list[best]);
+}
+
+// Copies the parts of the frame on screen which changed into the back buffer
+static void linux_repair_back_buffer(LinuxWindow* window)
+{
+    const uint8_t* front = linux_window_buffer(window, window->header->front);
+    uint8_t* back = linux_window_buffer(window, window->back);
+    size_t stride = window->header->stride;
+    size_t bytes = lapis_format_bytes(window->header->format);
+    const LapisRect* rect;
+    size_t offset;
+    uint32_t i, y;
+
+    for (i = 0; i < window->presented_count; i++) {
+        rect = &window->presented[i];
+        for (y = rect->y; y < rect->y + rect->height; y++) {
+            offset = y * stride + rect->x * bytes;
+            memcpy(back + offset, front + offset, rect->width * bytes);
+        }
+    }
+}
+
+LapisReturnCode lapis_window_damage(LapisWindow* window, const LapisRect* rects, uint32_t count,
+                                    uint32_t covered)
+{
+    LinuxWindow* lw;
+    LapisRect clipped;
+    uint32_t i;
+    if (!window || !window->cpu_mem || (count && !rects)) return e_lapis_return_invalid_argument;
+
+    // Writing every pixel of the window makes bringing the back buffer up to date pointless, but only the
+    // caller knows whether a rectangle is really covered or just the bounds of what's drawn
+    lw = (LinuxWindow*)window->cpu_mem;
+    linux_window_wait_idle(lw);
+    if (lw->repair_pending) {
+        for (i = 0; covered && i < count; i++) {
+            if (linux_clip_rect(lw, &rects[i], &clipped) && clipped.x == 0 && clipped.y == 0 &&
+                clipped.width == lw->width && clipped.height == lw->height) {
+                break;
+            }
+        }
+        if (!covered || i == count) linux_repair_back_buffer(lw);
+        lw->repair_pending = 0;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (linux_clip_rect(lw, &rects[i], &clipped)) linux_add_rect(lw->damage, &lw->damage_count, &clipped);
+    }
+    return e_lapis_return_success;
+}
+
+void linux_window_present_damage(LinuxWindow* window, LapisRect* bounds)
+{
+    uint32_t i;
+    *bounds = window->damage[0];
+    for (i = 0; i < window->damage_count; i++) {
+        window->presented[i] = window->damage[i];
+        linux_rect_union(bounds, &window->damage[i], bounds);
+    }
+    window->presented_count = window->damage_count;
+    window->damage_count = 0;
+    window->repair_pending = 1;
+}
@@ -0,0 +1,63 @@
+#include "linux_window.h"
+#include <string.h>
+
+LapisReturnCode lapis_window_poll_events(LapisWindow* window)
+{
+    LinuxWindow* lw;
+    if (!window || !window->cpu_mem) return e_lapis_return_invalid_argument;
+
+    // With no display server the only event read here is a viewer asking for the window to close, input is
+    // pushed into the queue by whatever drives the window
+    lw = (LinuxWindow*)window->cpu_mem;
+    if (linux_atomic_load(&lw->header->close_requested)) lw->open = 0;
+    lw->event_visible = linux_atomic_load(&lw->event_head);
+    return e_lapis_return_success;
+}
+
+LapisReturnCode lapis_window_swap(LapisWindow* window)
+{
+    LinuxWindow* lw;
+    LinuxFrame frame;
+    if (!window || !window->cpu_mem) return e_lapis_return_invalid_argument;
+
+    lw = (LinuxWindow*)window->cpu_mem;
+    LAPIS_TRACE_BEGIN(e_lapis_stage_swap);
+    if (lw->threaded) {
+        linux_window_submit(lw);
+        LAPIS_TRACE_END(e_lapis_stage_swap);
+        return e_lapis_return_success;
+    }
+
+    // Finish the frame, a deferred function could defer again so the list is emptied before running them
+    memcpy(frame.deferred, lw->deferred, lw->deferred_count * sizeof(LinuxDeferred));
+    frame.deferred_count = lw->deferred_count;
+    lw->deferred_count = 0;
+    linux_atomic_store(&lw->submitted, lw->submitted + 1);
+    linux_window_present(lw, frame.deferred, frame.deferred_count);
+    linux_atomic_store(&lw->completed, lw->completed + 1);
+    LAPIS_TRACE_END(e_lapis_stage_swap);
+    return e_lapis_return_success;
+}
+
+LapisReturnCode lapis_window_defer(LapisWindow* window, LapisSwapFunc func, void* user)
+{
+    LinuxWindow* lw;
+    if (!window || !window->cpu_mem || !func) return e_lapis_return_invalid_argument;
+
+    lw = (LinuxWindow*)window->cpu_mem;
+    if (lw->deferred_count == LINUX_MAX_DEFERRED) {
+        linux_window_wait_idle(lw);
+        func(user);
+        return e_lapis_return_success;
+    }
+    lw->deferred[lw->deferred_count].func = func;
+    lw->deferred[lw->deferred_count].user = user;
+    lw->deferred_count++;
+    return e_lapis_return_success;
+}
+
+uint8_t lapis_window_stay_open(LapisWindow* window)
+{
+    if (!window || !window->cpu_mem) return 0;
+    return (uint8_t)((LinuxWindow*)window->cpu_mem)->open;
+}
@@ -0,0 +1,178 @@
+#include "linux_window.h"
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+uint64_t linux_time_now()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+uint8_t* linux_window_buffer(LinuxWindow* window, uint32_t index)
+{
+    return window->memory + window->header->buffer_offset + (size_t)index * window->header->buffer_size;
+}
+
+LapisReturnCode lapis_size_window(LapisSize* size, LapisWindowHelper* helper)
+{
+    if (!size) return e_lapis_return_invalid_argument;
+
+    // The framebuffer lives in shared memory owned by the window, not in memory the user allocates
+    size->cpu_size = sizeof(LinuxWindow);
+    size->gpu_size = 0;
+    size->gpu_align = 1;
+    return e_lapis_return_success;
+}
+
+// Opens the shared memory the frames are presented into, either named or anonymous
+static int linux_open_memory(LinuxWindow* lw, const char* name)
+{
+    if (!name) {
+        lw->name[0] = '\0';
+        return memfd_create("lapis_window", MFD_CLOEXEC);
+    }
+    strcpy(lw->name, name);
+    return shm_open(name, O_CREAT | O_TRUNC | O_RDWR | O_CLOEXEC, 0600);
+}
+
+LapisReturnCode lapis_create_window(LapisContext* context, LapisWindow* window, LapisWindowHelper* helper)
+{
+    LinuxWindow* lw;
+    LapisSharedHeader* header;
+    size_t stride, buffer_size;
+
+    if (!window || !window->cpu_mem || !helper || !helper->width || !helper->height) {
+        return e_lapis_return_invalid_argument;
+    }
+    if (helper->name && strlen(helper->name) >= LINUX_MAX_NAME) return e_lapis_return_invalid_argument;
+    if (helper->frames_in_flight > LAPIS_MAX_FRAMES_IN_FLIGHT) return e_lapis_return_invalid_argument;
+    if (!lapis_format_bytes(helper->format)) return e_lapis_return_invalid_argument;
+    if (helper->format == e_lapis_format_yuyv && (helper->width & 1)) return e_lapis_return_invalid_argument;
+
+    lw = (LinuxWindow*)window->cpu_mem;
+    lw->context.cpu_mem = context ? context->cpu_mem : NULL;
+    lw->context.gpu_mem = context ? context->gpu_mem : NULL;
+    lw->width = helper->width;
+    lw->height = helper->height;
+
+    stride = (size_t)helper->width * lapis_format_bytes(helper->format);
+    buffer_size = (stride * helper->height + LINUX_PAGE_SIZE - 1) & ~(size_t)(LINUX_PAGE_SIZE - 1);
+    lw->memory_size = LINUX_PAGE_SIZE + buffer_size * LINUX_BUFFER_COUNT;
+
+    lw->fd = linux_open_memory(lw, helper->name);
+    if (lw->fd < 0) return e_lapis_return_system_error;
+
+    // Freshly sized shared memory is zeroed, so every buffer starts out black
+    lw->memory = MAP_FAILED;
+    if (ftruncate(lw->fd, (off_t)lw->memory_size) == 0) {
+        lw->memory = mmap(NULL, lw->memory_size, PROT_READ | PROT_WRITE, MAP_SHARED, lw->fd, 0);
+    }
+    if (lw->memory == MAP_FAILED) {
+        close(lw->fd);
+        if (lw->name[0]) shm_unlink(lw->name);
+        return e_lapis_return_system_error;
+    }
+
+    header = (LapisSharedHeader*)lw->memory;
+    lw->header = header;
+    header->version = LAPIS_SHARED_VERSION;
+    header->width = helper->width;
+    header->height = helper->height;
+    header->stride = (uint32_t)stride;
+    header->format = helper->format;
+    header->buffer_count = LINUX_BUFFER_COUNT;
+    header->buffer_offset = LINUX_PAGE_SIZE;
+    header->buffer_size = (uint32_t)buffer_size;
+    header->front = 0;
+    header->frame = 0;
+    header->present_time = 0;
+    header->close_requested = 0;
+
+    // The magic goes in last so a viewer never sees a half written header
+    linux_atomic_store(&header->magic, LAPIS_SHARED_MAGIC);
+
+    lw->back = 1;
+    lw->period = helper->refresh_rate ? 1000000000u / helper->refresh_rate : 0;
+    lw->next_vsync = linux_time_now();
+    lw->deferred_count = 0;
+    lw->damage_count = 0;
+    lw->presented_count = 0;
+    lw->event_head = 0;
+    lw->event_tail = 0;
+    lw->event_visible = 0;
+    lw->event_overflow = 0;
+    lw->repair_pending = 0;
+    lw->capture.running = 0;
+    lw->capture.written = 0;
+    lw->capture.dropped = 0;
+    lw->capture.failed = 0;
+
+    lw->frames_in_flight = helper->frames_in_flight ? helper->frames_in_flight : 1;
+    lw->submitted = 0;
+    lw->completed = 0;
+    pthread_mutex_init(&lw->lock, NULL);
+    pthread_cond_init(&lw->queued, NULL);
+    pthread_cond_init(&lw->retired, NULL);
+    if (linux_window_start_thread(lw) != e_lapis_return_success) {
+        pthread_cond_destroy(&lw->retired);
+        pthread_cond_destroy(&lw->queued);
+        pthread_mutex_destroy(&lw->lock);
+        munmap(lw->memory, lw->memory_size);
+        close(lw->fd);
+        if (lw->name[0]) shm_unlink(lw->name);
+        return e_lapis_return_system_error;
+    }
+    lw->open = 1;
+    return e_lapis_return_success;
+}
+
+LapisReturnCode lapis_destroy_window(LapisWindow* window)
+{
+    LinuxWindow* lw;
+    if (!window || !window->cpu_mem) return e_lapis_return_invalid_argument;
+
+    lw = (LinuxWindow*)window->cpu_mem;
+    linux_window_stop_thread(lw);
+    linux_window_stop_capture(lw);
+    pthread_cond_destroy(&lw->retired);
+    pthread_cond_destroy(&lw->queued);
+    pthread_mutex_destroy(&lw->lock);
+    munmap(lw->memory, lw->memory_size);
+    close(lw->fd);
+    if (lw->name[0]) shm_unlink(lw->name);
+    lw->open = 0;
+    return e_lapis_return_success;
+}
+
+LapisReturnCode lapis_window_get_framebuffer(LapisWindow* window, LapisFramebuffer* framebuffer)
+{
+    LinuxWindow* lw;
+    if (!window || !window->cpu_mem || !framebuffer) return e_lapis_return_invalid_argument;
+
+    lw = (LinuxWindow*)window->cpu_mem;
+    linux_window_wait_idle(lw);
+    framebuffer->pixels = linux_window_buffer(lw, lw->back);
+    framebuffer->width = lw->width;
+    framebuffer->height = lw->height;
+    framebuffer->stride = lw->width;
+    framebuffer->format = lw->header->format;
+    return e_lapis_return_success;
+}
+
+LapisContext* lapis_window_context(LapisWindow* window)
+{
+    LinuxWindow* lw;
+    if (!window || !window->cpu_mem) return NULL;
+    lw = (LinuxWindow*)window->cpu_mem;
+    return lw->context.cpu_mem ? &lw->context : NULL;
+}
+
+intptr_t lapis_window_native_handle(LapisWindow* window)
+{
+    if (!window || !window->cpu_mem) return -1;
+    return ((LinuxWindow*)window->cpu_mem)->fd;
+}
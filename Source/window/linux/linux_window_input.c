@@ -0,0 +1,68 @@
+#include "linux_window.h"
+
+LapisReturnCode lapis_window_push_event(LapisWindow* window, const LapisEvent* event)
+{
+    LinuxWindow* lw;
+    LapisEvent* slot;
+    uint32_t head;
+    if (!window || !window->cpu_mem || !event) return e_lapis_return_invalid_argument;
+
+    // Only this thread writes the head, the tail says how far the taking thread has got
+    lw = (LinuxWindow*)window->cpu_mem;
+    head = lw->event_head;
+    if (head - linux_atomic_load(&lw->event_tail) == LINUX_MAX_EVENTS) {
+        linux_atomic_store(&lw->event_overflow, lw->event_overflow + 1);
+        return e_lapis_return_out_of_memory;
+    }
+
+    // The event has to be written before the head moves past it
+    slot = &lw->events[head & (LINUX_MAX_EVENTS - 1)];
+    *slot = *event;
+    if (!slot->time) slot->time = linux_time_now();
+    linux_atomic_store(&lw->event_head, head + 1);
+    return e_lapis_return_success;
+}
+
+// Pointer moves and scrolls come in bursts far faster than frames, and only where the pointer ended up and
+// how far it scrolled in total matter
+static int linux_event_merges(const LapisEvent* event, const LapisEvent* next)
+{
+    if (event->type != next->type) return 0;
+    return event->type == e_lapis_event_pointer_move || event->type == e_lapis_event_scroll;
+}
+
+uint8_t lapis_window_next_event(LapisWindow* window, LapisEvent* event)
+{
+    const LapisEvent* next;
+    LinuxWindow* lw;
+    uint32_t tail;
+    if (!window || !window->cpu_mem || !event) return 0;
+
+    lw = (LinuxWindow*)window->cpu_mem;
+    tail = lw->event_tail;
+    if (tail == lw->event_visible) return 0;
+    *event = lw->events[tail++ & (LINUX_MAX_EVENTS - 1)];
+    while (tail != lw->event_visible) {
+        next = &lw->events[tail & (LINUX_MAX_EVENTS - 1)];
+        if (!linux_event_merges(event, next)) break;
+        if (event->type == e_lapis_event_scroll) {
+            event->x += next->x;
+            event->y += next->y;
+        } else {
+            event->x = next->x;
+            event->y = next->y;
+        }
+        event->time = next->time;
+        tail++;
+    }
+
+    // Slots only go back to the pushing thread once they've been read
+    linux_atomic_store(&lw->event_tail, tail);
+    return 1;
+}
+
+uint32_t lapis_window_event_overflow(LapisWindow* window)
+{
+    if (!window || !window->cpu_mem) return 0;
+    return linux_atomic_load(&((LinuxWindow*)window->cpu_mem)->event_overflow);
+}
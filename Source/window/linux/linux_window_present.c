@@ -0,0 +1,164 @@
+#include "linux_window.h"
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+// Sleeps until an absolute time on the monotonic clock
+static void linux_sleep_until(uint64_t time)
+{
+    struct timespec wake;
+    wake.tv_sec = (time_t)(time / 1000000000u);
+    wake.tv_nsec = (long)(time % 1000000000u);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR) {
+    }
+}
+
+void linux_window_present(LinuxWindow* window, const LinuxDeferred* deferred, uint32_t count)
+{
+    uint64_t now, present;
+    uint32_t i;
+
+    for (i = 0; i < count; i++) {
+        deferred[i].func(deferred[i].user);
+    }
+
+    LAPIS_TRACE_BEGIN(e_lapis_stage_present);
+    now = linux_time_now();
+    present = now;
+    if (window->period) {
+        // The virtual vsync ticks at a fixed rate. A late frame waits for the next tick instead of trying to
+        // catch up on the ones it missed
+        present = window->next_vsync;
+        if (now > present) {
+            present += ((now - present + window->period - 1) / window->period) * window->period;
+        }
+        linux_sleep_until(present);
+        window->next_vsync = present + window->period;
+    }
+
+    // Publish the buffer, frame is bumped last so a viewer reading frame first sees the new front. When
+    // nothing changed the frame on screen stays up and the back buffer keeps what's been drawn into it
+    if (window->damage_count) {
+        linux_window_present_damage(window, &window->header->damage);
+        window->header->front = window->back;
+        window->header->present_time = present;
+        linux_atomic_store(&window->header->frame, window->header->frame + 1);
+        window->back = (window->back + 1) % LINUX_BUFFER_COUNT;
+    }
+    if (linux_atomic_load(&window->capture.running)) linux_window_capture(window);
+    LAPIS_TRACE_END(e_lapis_stage_present);
+    LAPIS_TRACE_END_FRAME();
+}
+
+static void* linux_present_main(void* arg)
+{
+    LinuxWindow* window = (LinuxWindow*)arg;
+    const LinuxFrame* frame;
+
+    pthread_mutex_lock(&window->lock);
+    for (;;) {
+        while (window->completed == window->submitted && !window->stopping) {
+            pthread_cond_wait(&window->queued, &window->lock);
+        }
+
+        // Stopping still presents everything which was swapped
+        if (window->completed == window->submitted) break;
+        frame = &window->queue[window->completed % LAPIS_MAX_FRAMES_IN_FLIGHT];
+        pthread_mutex_unlock(&window->lock);
+
+        linux_window_present(window, frame->deferred, frame->deferred_count);
+
+        pthread_mutex_lock(&window->lock);
+        linux_atomic_store(&window->completed, window->completed + 1);
+        pthread_cond_broadcast(&window->retired);
+    }
+    pthread_mutex_unlock(&window->lock);
+    return NULL;
+}
+
+LapisReturnCode linux_window_start_thread(LinuxWindow* window)
+{
+    window->stopping = 0;
+    window->threaded = 0;
+    if (window->frames_in_flight < 2) return e_lapis_return_success;
+    if (pthread_create(&window->thread, NULL, linux_present_main, window) != 0) {
+        return e_lapis_return_system_error;
+    }
+    window->threaded = 1;
+    return e_lapis_return_success;
+}
+
+void linux_window_stop_thread(LinuxWindow* window)
+{
+    if (!window->threaded) return;
+    pthread_mutex_lock(&window->lock);
+    window->stopping = 1;
+    pthread_cond_signal(&window->queued);
+    pthread_mutex_unlock(&window->lock);
+    pthread_join(window->thread, NULL);
+    window->threaded = 0;
+}
+
+void linux_window_submit(LinuxWindow* window)
+{
+    LinuxFrame* frame;
+
+    // The frame being recorded is in flight too, so the present thread gets one fewer than the window
+    pthread_mutex_lock(&window->lock);
+    while (window->submitted - window->completed >= window->frames_in_flight - 1) {
+        pthread_cond_wait(&window->retired, &window->lock);
+    }
+
+    frame = &window->queue[window->submitted % LAPIS_MAX_FRAMES_IN_FLIGHT];
+    memcpy(frame->deferred, window->deferred, window->deferred_count * sizeof(LinuxDeferred));
+    frame->deferred_count = window->deferred_count;
+    window->deferred_count = 0;
+    linux_atomic_store(&window->submitted, window->submitted + 1);
+    pthread_cond_signal(&window->queued);
+    pthread_mutex_unlock(&window->lock);
+}
+
+void linux_window_wait_idle(LinuxWindow* window)
+{
+    if (!window->threaded || pthread_equal(pthread_self(), window->thread)) return;
+    pthread_mutex_lock(&window->lock);
+    while (window->completed != window->submitted) {
+        pthread_cond_wait(&window->retired, &window->lock);
+    }
+    pthread_mutex_unlock(&window->lock);
+}
+
+uint32_t lapis_window_frames_in_flight(LapisWindow* window)
+{
+    if (!window || !window->cpu_mem) return 1;
+    return ((LinuxWindow*)window->cpu_mem)->frames_in_flight;
+}
+
+uint64_t lapis_window_get_fence(LapisWindow* window)
+{
+    if (!window || !window->cpu_mem) return 0;
+    return linux_atomic_load(&((LinuxWindow*)window->cpu_mem)->submitted) + 1;
+}
+
+uint8_t lapis_window_fence_reached(LapisWindow* window, uint64_t fence)
+{
+    if (!window || !window->cpu_mem) return 1;
+    return fence <= linux_atomic_load(&((LinuxWindow*)window->cpu_mem)->completed);
+}
+
+LapisReturnCode lapis_window_wait_fence(LapisWindow* window, uint64_t fence)
+{
+    LinuxWindow* lw;
+    if (!window || !window->cpu_mem) return e_lapis_return_invalid_argument;
+
+    lw = (LinuxWindow*)window->cpu_mem;
+    if (fence > linux_atomic_load(&lw->submitted)) return e_lapis_return_invalid_argument;
+    if (fence <= linux_atomic_load(&lw->completed)) return e_lapis_return_success;
+
+    pthread_mutex_lock(&lw->lock);
+    while (lw->completed < fence) {
+        pthread_cond_wait(&lw->retired, &lw->lock);
+    }
+    pthread_mutex_unlock(&lw->lock);
+    return e_lapis_return_success;
+}
@@ -9,3 +9,14 @@ LapisReturnCode lapis_create_window(LapisContext* context, LapisWindow* window,
 {
     return e_lapis_return_success;
 }
+
+LapisReturnCode lapis_destroy_window(LapisWindow* window) { return e_lapis_return_success; }
+
+LapisReturnCode lapis_window_get_framebuffer(LapisWindow* window, LapisFramebuffer* framebuffer)
+{
+    return e_lapis_return_unsupported;
+}
+
+LapisContext* lapis_window_context(LapisWindow* window) { return NULL; }
+
+intptr_t lapis_window_native_handle(LapisWindow* window) { return 0; }
@@ -2,6 +2,52 @@
 
 LapisReturnCode lapis_window_poll_events(LapisWindow* window) { return e_lapis_return_success; }
 
+LapisReturnCode lapis_window_damage(LapisWindow* window, const LapisRect* rects, uint32_t count,
+                                    uint32_t covered)
+{
+    return e_lapis_return_success;
+}
+
 LapisReturnCode lapis_window_swap(LapisWindow* window) { return e_lapis_return_success; }
 
+// Nothing waits for a swap yet, so deferred work runs straight away
+LapisReturnCode lapis_window_defer(LapisWindow* window, LapisSwapFunc func, void* user)
+{
+    if (func) func(user);
+    return e_lapis_return_success;
+}
+
+// No input is read yet
+LapisReturnCode lapis_window_push_event(LapisWindow* window, const LapisEvent* event)
+{
+    return e_lapis_return_unsupported;
+}
+
+uint8_t lapis_window_next_event(LapisWindow* window, LapisEvent* event) { return 0; }
+
+uint32_t lapis_window_event_overflow(LapisWindow* window) { return 0; }
+
+// Frames can't be read back yet
+LapisReturnCode lapis_window_start_capture(LapisWindow* window, const LapisCaptureHelper* helper)
+{
+    return e_lapis_return_unsupported;
+}
+
+LapisReturnCode lapis_window_stop_capture(LapisWindow* window, LapisCaptureStats* stats)
+{
+    return e_lapis_return_unsupported;
+}
+
 uint8_t lapis_window_stay_open(LapisWindow* window) { return e_lapis_return_success; }
+
+// Swaps never leave anything in flight
+uint32_t lapis_window_frames_in_flight(LapisWindow* window) { return 1; }
+
+uint64_t lapis_window_get_fence(LapisWindow* window) { return 0; }
+
+uint8_t lapis_window_fence_reached(LapisWindow* window, uint64_t fence) { return 1; }
+
+LapisReturnCode lapis_window_wait_fence(LapisWindow* window, uint64_t fence)
+{
+    return e_lapis_return_success;
+}